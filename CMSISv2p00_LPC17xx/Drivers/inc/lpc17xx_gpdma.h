@@ -387,6 +387,19 @@ typedef struct {
 	uint32_t Control;	/**< GPDMA Control of this LLI */
 } GPDMA_LLI_Type;
 
+/**
+ * @brief GPDMA channel register image, built once by GPDMA_BuildImage()
+ * and loaded with GPDMA_Rearm() each time the transfer is restarted
+ */
+typedef struct {
+	uint32_t SrcAddr;		/**< DMACCSrcAddr value */
+	uint32_t DestAddr;		/**< DMACCDestAddr value */
+	uint32_t LLI;			/**< DMACCLLI value */
+	uint32_t Control;		/**< DMACCControl value */
+	uint32_t Config;		/**< DMACCConfig value, without the enable bit */
+	uint32_t ChannelNum;	/**< DMA channel number, 0 to 7 */
+} GPDMA_Image_Type;
+
 
 /**
  * @}
@@ -400,6 +413,9 @@ typedef struct {
 void GPDMA_Init(void);
 //Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig, fnGPDMACbs_Type *pfnGPDMACbs);
 Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig);
+Status GPDMA_BuildImage(GPDMA_Channel_CFG_Type *GPDMAChannelConfig, GPDMA_Image_Type *Image);
+void GPDMA_BuildRingLLI(GPDMA_Image_Type *Image, GPDMA_LLI_Type *LLIList, uint32_t NumBlocks, uint32_t BlockStride);
+Status GPDMA_Rearm(const GPDMA_Image_Type *Image);
 IntStatus GPDMA_IntGetStatus(GPDMA_Status_Type type, uint8_t channel);
 void GPDMA_ClearIntPending(GPDMA_StateClear_Type type, uint8_t channel);
 void GPDMA_ChannelCmd(uint8_t channelNum, FunctionalState NewState);
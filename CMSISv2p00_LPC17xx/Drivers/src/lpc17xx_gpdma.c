@@ -229,13 +229,17 @@ void GPDMA_Init(void)
 Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 {
 	LPC_GPDMACH_TypeDef *pDMAch;
-	uint32_t tmp1, tmp2;
+	GPDMA_Image_Type image;
 
 	if (LPC_GPDMA->DMACEnbldChns & (GPDMA_DMACEnbldChns_Ch(GPDMAChannelConfig->ChannelNum))) {
 		// This channel is enabled, return ERROR, need to release this channel first
 		return ERROR;
 	}
 
+	if (GPDMA_BuildImage(GPDMAChannelConfig, &image) == ERROR) {
+		return ERROR;
+	}
+
 	// Get Channel pointer
 	pDMAch = (LPC_GPDMACH_TypeDef *) pGPDMACh[GPDMAChannelConfig->ChannelNum];
 
@@ -247,8 +251,33 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	pDMAch->DMACCControl = 0x00;
 	pDMAch->DMACCConfig = 0x00;
 
+	pDMAch->DMACCLLI = image.LLI;
+	pDMAch->DMACCSrcAddr = image.SrcAddr;
+	pDMAch->DMACCDestAddr = image.DestAddr;
+	pDMAch->DMACCControl = image.Control;
+	pDMAch->DMACCConfig = image.Config;
+
+	return SUCCESS;
+}
+
+/********************************************************************//**
+ * @brief 		Compile a channel configuration into a register image that
+ * 				can be loaded later with GPDMA_Rearm(). The request select
+ * 				(DMAREQSEL) and the global GPDMA enable are applied here,
+ * 				once; the channel registers are not touched.
+ * @param[in]	GPDMAChannelConfig Pointer to a GPDMA_CH_CFG_Type
+ * 									structure with the channel configuration
+ * @param[out]	Image		Register image to fill
+ * @return		ERROR if the transfer type is not supported, otherwise SUCCESS
+ *********************************************************************/
+Status GPDMA_BuildImage(GPDMA_Channel_CFG_Type *GPDMAChannelConfig, GPDMA_Image_Type *Image)
+{
+	uint32_t tmp1, tmp2;
+
+	Image->ChannelNum = GPDMAChannelConfig->ChannelNum;
+
 	/* Assign Linker List Item value */
-	pDMAch->DMACCLLI = GPDMAChannelConfig->DMALLI;
+	Image->LLI = GPDMAChannelConfig->DMALLI;
 
 	/* Set value to Channel Control Registers */
 	switch (GPDMAChannelConfig->TransferType)
@@ -256,9 +285,9 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	// Memory to memory
 	case GPDMA_TRANSFERTYPE_M2M:
 		// Assign physical source and destination address
-		pDMAch->DMACCSrcAddr = GPDMAChannelConfig->SrcMemAddr;
-		pDMAch->DMACCDestAddr = GPDMAChannelConfig->DstMemAddr;
-		pDMAch->DMACCControl
+		Image->SrcAddr = GPDMAChannelConfig->SrcMemAddr;
+		Image->DestAddr = GPDMAChannelConfig->DstMemAddr;
+		Image->Control
 				= GPDMA_DMACCxControl_TransferSize(GPDMAChannelConfig->TransferSize) \
 						| GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_32) \
 						| GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_32) \
@@ -271,10 +300,10 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	// Memory to peripheral
 	case GPDMA_TRANSFERTYPE_M2P:
 		// Assign physical source
-		pDMAch->DMACCSrcAddr = GPDMAChannelConfig->SrcMemAddr;
+		Image->SrcAddr = GPDMAChannelConfig->SrcMemAddr;
 		// Assign peripheral destination address
-		pDMAch->DMACCDestAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->DstConn];
-		pDMAch->DMACCControl
+		Image->DestAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->DstConn];
+		Image->Control
 				= GPDMA_DMACCxControl_TransferSize((uint32_t)GPDMAChannelConfig->TransferSize) \
 						| GPDMA_DMACCxControl_SBSize((uint32_t)GPDMA_LUTPerBurst[GPDMAChannelConfig->DstConn]) \
 						| GPDMA_DMACCxControl_DBSize((uint32_t)GPDMA_LUTPerBurst[GPDMAChannelConfig->DstConn]) \
@@ -286,10 +315,10 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	// Peripheral to memory
 	case GPDMA_TRANSFERTYPE_P2M:
 		// Assign peripheral source address
-		pDMAch->DMACCSrcAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->SrcConn];
+		Image->SrcAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->SrcConn];
 		// Assign memory destination address
-		pDMAch->DMACCDestAddr = GPDMAChannelConfig->DstMemAddr;
-		pDMAch->DMACCControl
+		Image->DestAddr = GPDMAChannelConfig->DstMemAddr;
+		Image->Control
 				= GPDMA_DMACCxControl_TransferSize((uint32_t)GPDMAChannelConfig->TransferSize) \
 						| GPDMA_DMACCxControl_SBSize((uint32_t)GPDMA_LUTPerBurst[GPDMAChannelConfig->SrcConn]) \
 						| GPDMA_DMACCxControl_DBSize((uint32_t)GPDMA_LUTPerBurst[GPDMAChannelConfig->SrcConn]) \
@@ -301,10 +330,10 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	// Peripheral to peripheral
 	case GPDMA_TRANSFERTYPE_P2P:
 		// Assign peripheral source address
-		pDMAch->DMACCSrcAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->SrcConn];
+		Image->SrcAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->SrcConn];
 		// Assign peripheral destination address
-		pDMAch->DMACCDestAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->DstConn];
-		pDMAch->DMACCControl
+		Image->DestAddr = (uint32_t)GPDMA_LUTPerAddr[GPDMAChannelConfig->DstConn];
+		Image->Control
 				= GPDMA_DMACCxControl_TransferSize((uint32_t)GPDMAChannelConfig->TransferSize) \
 						| GPDMA_DMACCxControl_SBSize((uint32_t)GPDMA_LUTPerBurst[GPDMAChannelConfig->SrcConn]) \
 						| GPDMA_DMACCxControl_DBSize((uint32_t)GPDMA_LUTPerBurst[GPDMAChannelConfig->DstConn]) \
@@ -344,7 +373,7 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	tmp2 = ((tmp2 > 15) ? (tmp2 - 8) : tmp2);
 
 	// Configure DMA Channel, enable Error Counter and Terminate counter
-	pDMAch->DMACCConfig = GPDMA_DMACCxConfig_IE | GPDMA_DMACCxConfig_ITC /*| GPDMA_DMACCxConfig_E*/ \
+	Image->Config = GPDMA_DMACCxConfig_IE | GPDMA_DMACCxConfig_ITC \
 		| GPDMA_DMACCxConfig_TransferType((uint32_t)GPDMAChannelConfig->TransferType) \
 		| GPDMA_DMACCxConfig_SrcPeripheral(tmp1) \
 		| GPDMA_DMACCxConfig_DestPeripheral(tmp2);
@@ -352,6 +381,65 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig)
 	return SUCCESS;
 }
 
+/********************************************************************//**
+ * @brief 		Build a circular LLI chain from a register image. Block i
+ * 				moves the same amount of data as the image, with the memory
+ * 				side (source for M2P, destination for P2M, both for M2M)
+ * 				advanced by i * BlockStride bytes; the last block links back
+ * 				to the first one, so the channel runs until it is disabled.
+ * @param[in,out] Image		Register image (block 0); its LLI field is
+ * 							set to the second block of the chain
+ * @param[out]	LLIList		Array of NumBlocks LLI entries, word aligned
+ * 							and in a RAM bank reachable by the GPDMA
+ * @param[in]	NumBlocks	Number of blocks in the ring
+ * @param[in]	BlockStride	Bytes between consecutive memory blocks
+ * @return		None
+ *********************************************************************/
+void GPDMA_BuildRingLLI(GPDMA_Image_Type *Image, GPDMA_LLI_Type *LLIList, uint32_t NumBlocks, uint32_t BlockStride)
+{
+	uint32_t i, type, src_step, dst_step;
+
+	type = (Image->Config >> 11) & 0x07;
+	src_step = ((type == GPDMA_TRANSFERTYPE_M2M) || (type == GPDMA_TRANSFERTYPE_M2P)) ? BlockStride : 0;
+	dst_step = ((type == GPDMA_TRANSFERTYPE_M2M) || (type == GPDMA_TRANSFERTYPE_P2M)) ? BlockStride : 0;
+
+	for (i = 0; i < NumBlocks; i++) {
+		LLIList[i].SrcAddr = Image->SrcAddr + i * src_step;
+		LLIList[i].DstAddr = Image->DestAddr + i * dst_step;
+		LLIList[i].NextLLI = (uint32_t)&LLIList[(i + 1) % NumBlocks];
+		LLIList[i].Control = Image->Control;
+	}
+	Image->LLI = (uint32_t)&LLIList[1 % NumBlocks];
+}
+
+/********************************************************************//**
+ * @brief 		Restart a channel from a register image built with
+ * 				GPDMA_BuildImage(): clears its interrupt flags, loads the
+ * 				five channel registers and enables it. No validation or
+ * 				table lookup is done here.
+ * @param[in]	Image		Register image of the channel
+ * @return		ERROR if the channel is still enabled, otherwise SUCCESS
+ *********************************************************************/
+Status GPDMA_Rearm(const GPDMA_Image_Type *Image)
+{
+	LPC_GPDMACH_TypeDef *pDMAch = (LPC_GPDMACH_TypeDef *) pGPDMACh[Image->ChannelNum];
+	uint32_t mask = GPDMA_DMACEnbldChns_Ch(Image->ChannelNum);
+
+	if (LPC_GPDMA->DMACEnbldChns & mask) {
+		return ERROR;
+	}
+
+	LPC_GPDMA->DMACIntTCClear = mask;
+	LPC_GPDMA->DMACIntErrClr = mask;
+	pDMAch->DMACCSrcAddr = Image->SrcAddr;
+	pDMAch->DMACCDestAddr = Image->DestAddr;
+	pDMAch->DMACCLLI = Image->LLI;
+	pDMAch->DMACCControl = Image->Control;
+	pDMAch->DMACCConfig = Image->Config | GPDMA_DMACCxConfig_E;
+
+	return SUCCESS;
+}
+
 
 /*********************************************************************//**
  * @brief		Enable/Disable DMA channel
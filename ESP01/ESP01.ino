@@ -1,5 +1,8 @@
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
+#include "historial.h"
+#include "lttb.h"
+#include "respuesta_cache.h"
+#include "servidor_http.h"
 
 // 1. Configuración de WiFi
 // ¡IMPORTANTE! Asegúrate de que estas credenciales sean correctas.
@@ -13,23 +16,121 @@ const char* password = "mati200200"; 	// <<--- TUS CREDENALES
 // --- CONTROL DE REFRESH AQUÍ (en milisegundos) ---
 #define REFRESH_INTERVAL_MS 500 
 // -------------------------------------------------
-ESP8266WebServer server(80);
+// Para inyectar constantes en la pagina, que queda entera en flash
+#define TEXTO(x) TEXTO_(x)
+#define TEXTO_(x) #x
 
 // 3. Variables de Almacenamiento de Datos
-const int DATA_SIZE = 10;
-// Array para almacenar las últimas 10 mediciones de la MUESTRA SIMPLE (para el gráfico).
-float co_values[DATA_SIZE] = {0.0}; 
-int co_index = 0; 
+#define DATA_SIZE 10                // Muestras del gráfico en /data
+// Historial de MUESTRAS SIMPLES (historial.h): ocupa el heap libre al
+// arrancar menos HIST_RESERVA_HEAP, que queda para lwIP y las conexiones
+#define HIST_RESERVA_HEAP 16384
+Historial historial;
+// /history reduce un tramo del historial a pocos puntos (lttb.h)
+#define HIST_PUNTOS 300             // Por omision
+#define HIST_MAX_PUNTOS 1000
+#define HISTORIA_REFRESCO_MS 5000   // De la vista por rango en la pagina
+#define DATA_BIN_CABECERA 16        // Bytes antes de los arrays de /data.bin
+#define RANGO_BINARIO_MS 600000     // Rangos que la pagina pide crudos a /data.bin
 
 // --- VARIABLES CLAVE DE DATOS ---
 float latest_co_value = 0.0;     // Última MUESTRA ("U") - Usada para la ALARMA
 float average_co_value = 0.0;    // Último PROMEDIO ("P") - Usado para la referencia suavizada
 
+// --- LATENCIA DE EXTREMO A EXTREMO ---
+// El LPC1769 manda cada dato como <prefijo><ppm>@<t_captura>+<d>, con t_captura
+// en us de su reloj y d = us entre la captura y el armado del mensaje. Para
+// llevar t_captura a micros() se mide el desfase entre relojes con pings
+// "T<t0>" -> "R<t0>,<t1>,<t2>" al estilo NTP.
+#define CHAR_US 1042                // 10 bits a 9600 baudios
+#define PING_INTERVAL_MS 5000
+#define PING_TIMEOUT_MS 100
+#define PING_MUESTRAS 8             // Se usa la de menor demora de las ultimas 8
+#define SERIE_TX_FIFO 128           // FIFO de transmision de la UART0 del ESP8266
+
+uint32_t latest_t_captura = 0;      // Reloj del LPC1769
+uint32_t latest_cola_us = 0;        // Captura -> armado del mensaje (en el LPC1769)
+uint32_t latest_llegada = 0;        // micros() estimado de llegada del mensaje completo
+uint32_t latest_len = 0;
+bool latest_valido = false;
+
+struct Ping { uint32_t desfase; uint32_t demora; };
+Ping pings[PING_MUESTRAS];
+int ping_n = 0, ping_index = 0;
+uint32_t desfase_us = 0;            // Reloj LPC1769 - micros()
+uint32_t rtt_us = 0;
+bool sincronizado = false;
+unsigned long ultimo_ping = 0;
+bool ping_pendiente = false;        // "T<ping_t0>" enviado, esperando la "R"
+uint32_t ping_t0 = 0;
+
+// --- RESPUESTA /data MEMORIZADA ---
+// estado_seq cambia con cada dato que llega (y con cada ajuste del desfase,
+// que mueve la captura en el reloj del ESP); /data se serializa una vez por
+// cambio y se responde 304 a quien ya tiene esa version. Lo que depende del
+// momento de la consulta va en el encabezado X-Reloj-us (micros() al
+// responder), asi el cuerpo no cambia entre consultas.
+#define DATA_CACHE_TAM 512
+uint32_t estado_seq = 0;
+RespuestaCache<DATA_CACHE_TAM> data_cache;
+
+// --- LECTURA SERIAL SIN BLOQUEO ---
+// Las lineas se arman caracter a caracter con lo que haya en el buffer de
+// la UART; loop() nunca espera un '\n'. Lineas mas largas que el buffer se
+// descartan enteras.
+#define SERIE_TAM_LINEA 48
+char serie_linea[SERIE_TAM_LINEA];
+uint8_t serie_len = 0;
+bool serie_larga = false;
+uint32_t serie_t_primero = 0;       // Llegada estimada del primer caracter
+uint32_t serie_lineas = 0, serie_descartadas = 0, serie_desbordes = 0;
+
+// --- SERVIDOR HTTP ---
+// Sin bloqueo y con varias conexiones (servidor_http.h); WiFiClient por debajo
+class TransporteWifi : public TransporteHttp {
+public:
+	explicit TransporteWifi(WiFiServer &s) : s_(s) {}
+	bool pendiente() override { return s_.hasClient(); }
+	bool aceptar(int r) override {
+		c_[r] = s_.accept();
+		if (!c_[r]) return false;
+		c_[r].setNoDelay(true);
+		return true;
+	}
+	int leer(int r, uint8_t *buf, size_t n) override {
+		int d = c_[r].available();
+		if (d > 0) return c_[r].read(buf, (size_t)d < n ? d : n);
+		return c_[r].connected() ? 0 : -1;
+	}
+	// Solo lo que entra en la ventana de envio: write() no llega a esperar
+	int escribir(int r, const uint8_t *buf, size_t n) override {
+		if (!c_[r].connected()) return -1;
+		size_t libre = c_[r].availableForWrite();
+		if (libre == 0) return 0;
+		return c_[r].write(buf, n < libre ? n : libre);
+	}
+	// stop() sin esperar el ACK de lo pendiente: lwIP lo sigue enviando
+	void cerrar(int r) override { c_[r].stop(1); }
+private:
+	WiFiServer &s_;
+	WiFiClient c_[HTTP_MAX_CONEX];
+};
+
+WiFiServer tcp(80);
+TransporteWifi transporte(tcp);
+ServidorHttp servidor(transporte);
+
 // --- DECLARACIÓN DE FUNCIONES ---
-void handleRoot();
-void handleData(); 
+void handleRoot(const PeticionHttp &p, RespuestaHttp &r);
+void handleData(const PeticionHttp &p, RespuestaHttp &r);
+void handleEstado(const PeticionHttp &p, RespuestaHttp &r);
+void handleHistory(const PeticionHttp &p, RespuestaHttp &r);
+void handleDataBin(const PeticionHttp &p, RespuestaHttp &r);
 void handleSerial();
-String getCoDataJson();
+void procesarLinea(const char *linea, uint32_t t_primero, uint32_t llegada);
+void procesarPing(const char *linea, uint32_t t3);
+void enviarPing();
+size_t renderCoDataJson(char *buf, size_t tam);
 
 // --- SETUP ---
 void setup() {
@@ -48,97 +149,418 @@ void setup() {
 	Serial.print("Dirección IP: ");
 	Serial.println(WiFi.localIP()); 
 
-	server.on("/", handleRoot); 
-	server.on("/data", handleData); 
+	servidor.en("/", handleRoot); 
+	servidor.en("/data", handleData); 
+	servidor.en("/estado", handleEstado);
+	servidor.en("/history", handleHistory);
+	servidor.en("/data.bin", handleDataBin);
+	data_cache.fijarArranque(ESP.random());   // Distingue los ETag entre reinicios
 	
-	server.begin();
+	tcp.begin();
+	tcp.setNoDelay(true);
+	uint32_t libre = ESP.getFreeHeap();
+	historial.iniciar(libre > HIST_RESERVA_HEAP ? libre - HIST_RESERVA_HEAP : 0);
 	Serial.println("Servidor HTTP iniciado");
 }
 
 // --- LOOP PRINCIPAL ---
+// Cada vuelta hace trabajo acotado: una pasada por las conexiones HTTP
+// (HTTP_PASO bytes cada una) y todo lo que haya en el puerto serie. Nada
+// espera, asi la UART se vacia mucho antes de que se llene su buffer.
 void loop() {
-	server.handleClient(); 
 	handleSerial();
+	servidor.servicio(millis());
+	if (ping_pendiente && millis() - ultimo_ping >= PING_TIMEOUT_MS) {
+		ping_pendiente = false;   // Se perdio la respuesta
+	}
+	if (millis() - ultimo_ping >= PING_INTERVAL_MS) {
+		enviarPing();
+	}
 }
 
 // --- FUNCIONES DE LECTURA SERIAL ---
 
 void handleSerial() {
-	if (Serial.available() > 0) {
-		String dataString = Serial.readStringUntil('\n');
-		dataString.trim(); // Elimina espacios en blanco y caracteres de control
+	int n = Serial.available();
+	if (n <= 0) return;
+	if (Serial.hasOverrun()) serie_desbordes++;
+	// Los n caracteres llegaron uno tras otro y el ultimo justo antes de t
+	uint32_t t = micros();
+	for (int k = 0; k < n; k++) {
+		uint32_t llegada = t - (uint32_t)(n - 1 - k) * CHAR_US;
+		char c = Serial.read();
+		if (serie_len == 0 && !serie_larga) serie_t_primero = llegada;
+		if (c != '\n') {
+			if (serie_len < SERIE_TAM_LINEA - 1) serie_linea[serie_len++] = c;
+			else serie_larga = true;
+			continue;
+		}
+		serie_linea[serie_len] = '\0';
+		if (serie_larga) {
+			serie_descartadas++;
+		} else {
+			serie_lineas++;
+			procesarLinea(serie_linea, serie_t_primero, llegada);
+		}
+		serie_len = 0;
+		serie_larga = false;
+	}
+}
 
-		if (dataString.length() > 0) {
-			
-			// 1. EXTRAER EL PREFIJO (Primer caracter: 'U' o 'P')
-			char prefix = dataString.charAt(0);
-			
-			// 2. EXTRAER EL VALOR (Removiendo el prefijo)
-			// La subcadena empieza en el índice 1 (después de 'U' o 'P')
-			String valueString = dataString.substring(1); 
-			
-			float newValue = valueString.toFloat();
-			
-			// DEPURA: Imprime el dato y su tipo
-			Serial.print("Received: ");
-			Serial.print(prefix);
-			Serial.print("=");
-			Serial.println(newValue, 2); 
+// llegada: estimacion de micros() al recibir el '\n'
+void procesarLinea(const char *linea, uint32_t t_primero, uint32_t llegada) {
+	// Sin espacios ni caracteres de control al principio y al final
+	while (*linea != '\0' && (uint8_t)*linea <= ' ') linea++;
+	size_t largo = strlen(linea);
+	while (largo > 0 && (uint8_t)linea[largo - 1] <= ' ') largo--;
+
+	if (largo > 0) {
+		
+		// 1. EXTRAER EL PREFIJO (Primer caracter: 'U', 'P' o 'R')
+		char prefix = linea[0];
+		if (prefix == 'R') {
+			procesarPing(linea, t_primero);
+			return;
+		}
+		
+		// 2. EXTRAER EL VALOR (a partir del índice 1, después de 'U' o 'P')
+		float newValue = atof(linea + 1);
+
+		// Marcas de tiempo opcionales: @<t_captura>+<d>
+		const char *arroba = strchr(linea, '@');
+		const char *mas = arroba ? strchr(arroba, '+') : NULL;
+		
+		// DEPURA: Imprime el dato y su tipo
+		Serial.print("Received: ");
+		Serial.print(prefix);
+		Serial.print("=");
+		Serial.println(newValue, 2); 
 
-			// 3. ASIGNACIÓN CONDICIONAL: 
+		// 3. ASIGNACIÓN CONDICIONAL: 
             // Guarda el valor en la variable correspondiente según el prefijo
-			if (prefix == 'U') {
-				// Dato es la MUESTRA SIMPLE (latest_co_value)
-				latest_co_value = newValue;
-				
-				// Usamos la muestra simple para el historial del gráfico
-				co_values[co_index] = newValue;
-				co_index = (co_index + 1) % DATA_SIZE; 
-				
-			} else if (prefix == 'P') {
-				// Dato es el PROMEDIO (average_co_value)
-				average_co_value = newValue;
+		if (prefix == 'U') {
+			// Dato es la MUESTRA SIMPLE (latest_co_value)
+			latest_co_value = newValue;
+			
+			latest_valido = mas != NULL;
+			if (latest_valido) {
+				latest_t_captura = strtoul(arroba + 1, NULL, 10);
+				latest_cola_us = strtoul(mas + 1, NULL, 10);
+				latest_llegada = llegada;
+				latest_len = largo + 1;
 			}
+
+			// Al historial con el momento de la captura en millis() si se
+			// conoce; si no, el de llegada
+			uint32_t edad_us = micros() - llegada;
+			if (latest_valido && sincronizado) edad_us = micros() - (latest_t_captura - desfase_us);
+			historial.agregar(millis() - edad_us / 1000, newValue);
+			
+		} else if (prefix == 'P') {
+			// Dato es el PROMEDIO (average_co_value)
+			average_co_value = newValue;
 		}
+		if (prefix == 'U' || prefix == 'P') estado_seq++;
+	}
+}
+
+// --- SINCRONISMO DE RELOJES ---
+
+// Manda "T<t0>" con la UART de salida vacia, asi t0 es cuando sale el 'T'.
+// La respuesta llega por handleSerial() como cualquier otra linea; si la
+// transmision esta ocupada se reintenta en la vuelta siguiente.
+void enviarPing() {
+	if (Serial.availableForWrite() < SERIE_TX_FIFO) return;
+	ultimo_ping = millis();
+	ping_t0 = micros();
+	ping_pendiente = true;
+	Serial.print('T');
+	Serial.print(ping_t0);
+	Serial.print('\n');
+}
+
+// "R<t0>,<t1>,<t2>": t1 y t2 en el reloj del LPC1769; t3 es la llegada
+// estimada del primer caracter de la respuesta
+void procesarPing(const char *linea, uint32_t t3) {
+	if (!ping_pendiente) return;
+	char *fin;
+	uint32_t eco = strtoul(linea + 1, &fin, 10);
+	if (eco != ping_t0 || *fin != ',') return;
+	uint32_t m1 = strtoul(fin + 1, &fin, 10);
+	if (*fin != ',') return;
+	uint32_t m2 = strtoul(fin + 1, NULL, 10);
+	ping_pendiente = false;
+
+	// Ida y vuelta cuestan un caracter cada una hasta la interrupcion del
+	// otro lado: t3 y m1 son simetricos
+	uint32_t t0 = ping_t0;
+	uint32_t demora = (t3 - t0) - (m2 - m1);
+	int32_t asimetria = (int32_t)((m2 - m1) - (t3 - t0)) / 2;
+	pings[ping_index].desfase = (m1 - t0) + asimetria;
+	pings[ping_index].demora = demora;
+	ping_index = (ping_index + 1) % PING_MUESTRAS;
+	if (ping_n < PING_MUESTRAS) ping_n++;
+
+	int mejor = 0;
+	for (int i = 1; i < ping_n; i++) {
+		if (pings[i].demora < pings[mejor].demora) mejor = i;
 	}
+	if (!sincronizado || desfase_us != pings[mejor].desfase) estado_seq++;
+	desfase_us = pings[mejor].desfase;
+	rtt_us = pings[mejor].demora;
+	sincronizado = true;
 }
 
 // --- FUNCIONES DEL SERVIDOR WEB ---
 
-// Construye la cadena JSON con la muestra, el promedio y el historial.
-String getCoDataJson() {
-	String json = "{\"values\":["; // Historial de MUESTRAS SIMPLES
-	
-	// 1. Array de valores (Muestras Simples para el gráfico)
-	for (int i = 0; i < DATA_SIZE; i++) {
-		json += String(co_values[i], 2); 
-		if (i < DATA_SIZE - 1) {
-			json += ","; 
+// Serializa la muestra, el promedio y el historial en buf; devuelve el largo
+// (como snprintf). Solo se llama cuando cambia estado_seq.
+size_t renderCoDataJson(char *buf, size_t tam) {
+	size_t n = 0;
+	// Agrega texto con formato sin pasarse del buffer
+	auto agregar = [&](const char *fmt, auto... args) {
+		int r = snprintf(buf + (n < tam ? n : tam), n < tam ? tam - n : 0, fmt, args...);
+		if (r > 0) n += r;
+	};
+
+	// 1. Array de valores (últimas Muestras Simples del historial, de la más vieja a la más nueva)
+	agregar("{\"values\":[");
+	Historial::Cursor c = historial.ultimas(DATA_SIZE);
+	uint32_t t_ms;
+	uint16_t q;
+	for (int i = 0; historial.siguiente(c, &t_ms, &q); i++) {
+		agregar(i ? ",%.2f" : "%.2f", Historial::aPpm(q));
+	}
+	agregar("],");
+
+	// 2. Última Muestra Simple ("U") y 3. Último Promedio ("P")
+	agregar("\"latest\":%.2f,\"average\":%.2f", latest_co_value, average_co_value);
+
+	// 4. Desglose de la latencia de la ultima muestra, en us del reloj del ESP.
+	// La edad sale de X-Reloj-us - captura_us al responder.
+	if (latest_valido) {
+		uint32_t uart = latest_len * CHAR_US;
+		uint32_t captura = latest_llegada - uart - latest_cola_us;
+		if (sincronizado) {
+			// Captura llevada al reloj del ESP
+			captura = latest_t_captura - desfase_us;
+			uart = latest_llegada - captura - latest_cola_us;
 		}
+		agregar(",\"lat\":{\"captura_us\":%lu,\"llegada_us\":%lu,\"cola_us\":%lu,\"uart_us\":%ld,\"sync\":%d,\"rtt_us\":%lu}",
+				(unsigned long)captura, (unsigned long)latest_llegada, (unsigned long)latest_cola_us,
+				(long)(int32_t)uart, sincronizado ? 1 : 0, (unsigned long)rtt_us);
 	}
-	json += "],";
-	
-	// 2. Última Muestra Simple ("U")
-	json += "\"latest\":" + String(latest_co_value, 2) + ",";
-	
-	// 3. Último Promedio ("P")
-	json += "\"average\":" + String(average_co_value, 2);
-	
-	json += "}";
-	// Formato JSON final: {"values":[1.0, 2.0, ...], "latest": 3.0, "average": 2.5}
-	return json;
+
+	agregar("}");
+	// Formato JSON final: {"values":[1.0, 2.0, ...], "latest": 3.0, "average": 2.5, "lat": {...}}
+	return n;
 }
 
-// Sirve el array de datos completo como JSON para AJAX
-void handleData() {
-	server.send(200, "application/json", getCoDataJson());
+// Sirve el JSON memorizado; 304 si el cliente ya tiene esta version. El
+// cuerpo se copia a la conexion: puede cambiar antes de terminar de enviarse.
+void handleData(const PeticionHttp &p, RespuestaHttp &r) {
+	data_cache.actualizar(estado_seq, renderCoDataJson);
+	char reloj[12];
+	snprintf(reloj, sizeof(reloj), "%lu", (unsigned long)micros());
+	r.encabezado("ETag", data_cache.etag());
+	r.encabezado("Cache-Control", "no-cache");
+	r.encabezado("X-Reloj-us", reloj);
+	if (data_cache.noModificada(p.if_none_match)) {
+		r.estado(304);
+		return;
+	}
+	r.tipo("application/json");
+	r.cuerpo(data_cache.cuerpo(), data_cache.largo());
 }
 
+// Contadores del servidor y del puerto serie, para seguir la carga
+void handleEstado(const PeticionHttp &p, RespuestaHttp &r) {
+	const http_stats_t &h = servidor.stats();
+	char buf[400];
+	int n = snprintf(buf, sizeof(buf),
+			"{\"http\":{\"conexiones\":%lu,\"activas\":%u,\"peticiones\":%lu,\"no_modificadas\":%lu,"
+			"\"errores\":%lu,\"desalojos\":%lu,\"vencidas\":%lu,\"bytes\":%lu},"
+			"\"serie\":{\"lineas\":%lu,\"descartadas\":%lu,\"desbordes\":%lu},"
+			"\"historial\":{\"muestras\":%lu,\"capacidad\":%lu,\"bytes\":%lu},\"heap\":%lu}",
+			(unsigned long)h.conexiones, h.activas, (unsigned long)h.peticiones, (unsigned long)h.no_modificadas,
+			(unsigned long)h.errores, (unsigned long)h.desalojos, (unsigned long)h.vencidas, (unsigned long)h.bytes_enviados,
+			(unsigned long)serie_lineas, (unsigned long)serie_descartadas, (unsigned long)serie_desbordes,
+			(unsigned long)historial.cantidad(), (unsigned long)historial.capacidad(), (unsigned long)historial.bytesUsados(),
+			(unsigned long)ESP.getFreeHeap());
+	r.encabezado("Cache-Control", "no-store");
+	r.tipo("application/json");
+	r.cuerpo(buf, n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+}
 
-// Genera la página HTML principal con el gráfico y el script de actualización AJAX
-void handleRoot() {
-	// Usamos la macro F() y R"=====" para guardar memoria (PROGMEM) y simplificar el HTML
-	String html = F(R"=====(
+// Estado de una respuesta de /history mientras se envia
+enum { HISTORIA_INICIO, HISTORIA_PRIMERO, HISTORIA_PUNTOS, HISTORIA_FIN };
+struct HistoriaCtx {
+	Lttb lttb;
+	uint32_t ahora;
+	uint8_t fase;
+};
+static_assert(sizeof(HistoriaCtx) <= HTTP_TAM_CTX, "HistoriaCtx no entra en la conexion");
+
+// Escribe puntos mientras queden al menos 64 bytes (un punto ocupa < 40).
+// El historial sigue creciendo entre llamadas; si se borra el tramo que
+// falta, la respuesta termina ahi con JSON valido.
+size_t generarHistoria(uint8_t *buf, size_t tam, size_t offset, void *ctx) {
+	HistoriaCtx &h = *(HistoriaCtx *)ctx;
+	char *s = (char *)buf;
+	size_t n = 0;
+	if (h.fase == HISTORIA_FIN) return 0;
+	if (h.fase == HISTORIA_INICIO) {
+		n = snprintf(s, tam, "{\"ahora\":%lu,\"muestras\":%lu,\"puntos\":%u,\"p\":[",
+				(unsigned long)h.ahora, (unsigned long)h.lttb.muestras(), h.lttb.puntos());
+		h.fase = HISTORIA_PRIMERO;
+	}
+	// ppm con dos decimales sin pasar por float: q / HIST_ESCALA en centesimos
+	auto centi = [](uint16_t q) { return (uint32_t)(q * 25u + 2) / 4; };
+	PuntoLttb p;
+	while (tam - n >= 64) {
+		if (!h.lttb.siguiente(historial, &p)) {
+			n += snprintf(s + n, tam - n, "]}");
+			h.fase = HISTORIA_FIN;
+			break;
+		}
+		uint32_t v = centi(p.q), lo = centi(p.lo), hi = centi(p.hi);
+		n += snprintf(s + n, tam - n, "%s[%lu,%lu.%02lu,%lu.%02lu,%lu.%02lu]",
+				h.fase == HISTORIA_PRIMERO ? "" : ",", (unsigned long)p.t_ms,
+				(unsigned long)(v / 100), (unsigned long)(v % 100),
+				(unsigned long)(lo / 100), (unsigned long)(lo % 100),
+				(unsigned long)(hi / 100), (unsigned long)(hi % 100));
+		h.fase = HISTORIA_PUNTOS;
+	}
+	return n;
+}
+
+// Tramo pedido con from=<ms>&to=<ms>: millis() del ESP; negativos,
+// relativos a ahora. Por omision, desde la muestra mas vieja hasta ahora.
+void leerTramo(const PeticionHttp &p, uint32_t ahora, uint32_t *desde, uint32_t *hasta) {
+	long long v;
+	if (http_parametro(p.consulta, "from", &v)) {
+		*desde = v < 0 ? ahora + (uint32_t)v : (uint32_t)v;
+	} else {
+		// La muestra mas vieja (o ahora, si no hay ninguna)
+		Historial::Cursor c = historial.ultimas(historial.cantidad());
+		uint16_t q;
+		if (!historial.siguiente(c, desde, &q)) *desde = ahora;
+	}
+	*hasta = ahora;
+	if (http_parametro(p.consulta, "to", &v)) *hasta = v < 0 ? ahora + (uint32_t)v : (uint32_t)v;
+}
+
+// Tramo del historial reducido con LTTB para graficar:
+//   /history?from=<ms>&to=<ms>&points=<n>
+// Responde
+//   {"ahora":ms,"muestras":n,"puntos":p,"p":[[t_ms,ppm,min,max],...]}
+// con min y max del balde de cada punto (la envolvente).
+void handleHistory(const PeticionHttp &p, RespuestaHttp &r) {
+	HistoriaCtx h;
+	h.ahora = millis();
+	h.fase = HISTORIA_INICIO;
+
+	long long v;
+	uint32_t desde, hasta;
+	uint32_t puntos = HIST_PUNTOS;
+	leerTramo(p, h.ahora, &desde, &hasta);
+	if (http_parametro(p.consulta, "points", &v)) puntos = v < 3 ? 3 : v > HIST_MAX_PUNTOS ? HIST_MAX_PUNTOS : (uint32_t)v;
+
+	h.lttb.iniciar(historial, desde, hasta, puntos);
+	r.encabezado("Cache-Control", "no-store");
+	r.tipo("application/json");
+	r.generador(HTTP_LARGO_VARIABLE, generarHistoria, &h, sizeof(h));
+}
+
+// Estado de una respuesta de /data.bin mientras se envia
+enum { BIN_CABECERA, BIN_PPM, BIN_RELLENO, BIN_TIEMPOS };
+struct DataBinCtx {
+	Historial::Cursor c;	// Para los tiempos
+	uint32_t s, n;			// Primera muestra y cantidad
+	uint32_t i;				// Valores ya escritos de la fase
+	uint32_t ahora;
+	uint8_t fase;
+};
+static_assert(sizeof(DataBinCtx) <= HTTP_TAM_CTX, "DataBinCtx no entra en la conexion");
+
+static void le16(uint8_t *b, uint16_t v) { b[0] = v; b[1] = v >> 8; }
+static void le32(uint8_t *b, uint32_t v) { le16(b, v); le16(b + 2, v >> 16); }
+
+// Cada llamada escribe solo valores enteros (el servidor acepta tramos
+// cortos). Los ppm salen del anillo con memcpy: el ESP8266 es little-endian
+// como el formato. Si el tramo se borra antes de terminar devuelve 0 y el
+// servidor corta la conexion sin completar el Content-Length.
+size_t generarDataBin(uint8_t *buf, size_t tam, size_t offset, void *ctx) {
+	DataBinCtx &d = *(DataBinCtx *)ctx;
+	size_t n = 0;
+	if (d.fase == BIN_CABECERA) {
+		le32(buf, d.ahora);
+		le32(buf + 4, d.n);
+		le32(buf + 8, d.s);
+		le16(buf + 12, HIST_ESCALA);
+		le16(buf + 14, HIST_DT_MS);
+		n = DATA_BIN_CABECERA;
+		d.fase = BIN_PPM;
+		d.i = 0;
+	}
+	if (d.fase == BIN_PPM) {
+		size_t k = (tam - n) / sizeof(uint16_t);
+		if (k > d.n - d.i) k = d.n - d.i;
+		if (k && historial.copiar(d.s + d.i, buf + n, k) != k) return 0;
+		n += k * sizeof(uint16_t);
+		d.i += k;
+		if (d.i == d.n) d.fase = BIN_RELLENO;
+	}
+	if (d.fase == BIN_RELLENO && tam - n >= 2) {
+		// Los tiempos empiezan alineados a 4 para leerlos con Uint32Array
+		if (d.n & 1) {
+			le16(buf + n, 0);
+			n += 2;
+		}
+		d.fase = BIN_TIEMPOS;
+		d.i = 0;
+	}
+	if (d.fase == BIN_TIEMPOS) {
+		uint32_t t;
+		uint16_t q;
+		for (; tam - n >= sizeof(uint32_t) && d.i < d.n; d.i++) {
+			if (!historial.siguiente(d.c, &t, &q)) return 0;
+			le32(buf + n, t);
+			n += sizeof(uint32_t);
+		}
+	}
+	return n;
+}
+
+// Muestras de un tramo del historial sin formatear, para no pagar el JSON
+// ni en el ESP ni en el navegador:
+//   /data.bin?from=<ms>&to=<ms>   (como /history)
+// Todo little-endian:
+//   uint32 ahora_ms, uint32 n, uint32 seq de la primera,
+//   uint16 HIST_ESCALA (pasos por ppm), uint16 HIST_DT_MS
+//   uint16 ppm_cuantizado[n], relleno a multiplo de 4, uint32 t_ms[n]
+void handleDataBin(const PeticionHttp &p, RespuestaHttp &r) {
+	DataBinCtx d;
+	d.ahora = millis();
+	d.fase = BIN_CABECERA;
+	d.i = 0;
+
+	uint32_t desde, hasta;
+	leerTramo(p, d.ahora, &desde, &hasta);
+	d.c = historial.buscar(desde);
+	d.s = d.c.seq;
+	uint32_t e = historial.buscar(hasta + 1).seq;
+	d.n = (int32_t)(e - d.s) > 0 ? e - d.s : 0;
+
+	size_t largo = DATA_BIN_CABECERA + d.n * sizeof(uint16_t) + (d.n & 1) * 2 + d.n * sizeof(uint32_t);
+	r.encabezado("Cache-Control", "no-store");
+	r.tipo("application/octet-stream");
+	r.generador(largo, generarDataBin, &d, sizeof(d));
+}
+
+// Página HTML principal con el gráfico y el script de actualización AJAX. Queda
+// entera en flash (PROGMEM) y se envia por partes desde ahi, sin copiarla a RAM.
+static const char PAGINA_HTML[] PROGMEM = R"=====(
 <!DOCTYPE html>
 <html>
 <head>
@@ -186,30 +608,82 @@ void handleRoot() {
 		<div id="status_bar_container">
 			<div class="status-indicator status-safe" id="status_bar">Nivel Seguro</div>
 		</div>
+
+		<div class="data-display">
+			<div class="metric">
+				<p class="metric-value" id="age_p50">-</p>
+				<p class="metric-label">Edad p50 (ms)</p>
+			</div>
+			<div class="metric">
+				<p class="metric-value" id="age_p99">-</p>
+				<p class="metric-label">Edad p99 (ms)</p>
+			</div>
+		</div>
+		<p class="sub-header" id="age_detail">Sin marcas de tiempo</p>
 		
-		<p class="sub-header">Historial de <span id="data_size_display">)=====");
-	html += String(DATA_SIZE); // Inyecta DATA_SIZE
-	html += F(R"=====(</span> muestras. Actualizacion cada )=====");
-	html += String((float)REFRESH_INTERVAL_MS / 1000.0f, 2); // Inyecta el tiempo de refresco en segundos
-	html += F(R"=====(s.</p>
+		<p class="sub-header">Historial de <span id="data_size_display">)=====" TEXTO(DATA_SIZE) R"=====(</span> muestras. Actualizacion cada <span id="refresh_display"></span>s.</p>
+		<p class="sub-header">Rango:
+			<select id="rango">
+				<option value="0">Ultimas )=====" TEXTO(DATA_SIZE) R"=====( muestras</option>
+				<option value="600000">10 minutos</option>
+				<option value="3600000">1 hora</option>
+				<option value="21600000">6 horas</option>
+				<option value="-1">Todo el historial</option>
+			</select>
+			<span id="rango_detalle"></span>
+		</p>
 		
 		<canvas id='coChart' width='600' height='300'></canvas>
 	</div>
 
 	<script>
 		// Constantes inyectadas desde C++
-		const DATA_SIZE = )=====");
-	html += String(DATA_SIZE); 
-	html += F(R"=====(;
-		const REFRESH_INTERVAL_MS = )=====");
-	html += String(REFRESH_INTERVAL_MS); // Inyección clave del tiempo de refresco
-	html += F(R"=====(;
+		const DATA_SIZE = )=====" TEXTO(DATA_SIZE) R"=====(;
+		const REFRESH_INTERVAL_MS = )=====" TEXTO(REFRESH_INTERVAL_MS) R"=====(;
+		const HISTORIA_REFRESCO_MS = )=====" TEXTO(HISTORIA_REFRESCO_MS) R"=====(;
+		const RANGO_BINARIO_MS = )=====" TEXTO(RANGO_BINARIO_MS) R"=====(;
+		const DATA_BIN_CABECERA = )=====" TEXTO(DATA_BIN_CABECERA) R"=====(;
+		document.getElementById('refresh_display').textContent = (REFRESH_INTERVAL_MS / 1000).toFixed(2);
 
 		// Umbrales para la visualizacion (deben coincidir con tu lógica de PPM)
 		const UMBRAL_PRECAUCION = 25; 
 		const UMBRAL_CRITICO = 200; 
 		
 		let co_data = []; 
+		// Rango del grafico en ms (0: las ultimas DATA_SIZE de /data, -1: todo)
+		let rango = 0;
+
+		// Edad del dato al dibujarse: captura -> respuesta del ESP (X-Reloj-us - lat.captura_us)
+		// + media vuelta de red + espera hasta el siguiente cuadro
+		const AGE_SAMPLES = 200;
+		let ages = [];
+
+		function percentile(sorted, p) {
+			return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+		}
+
+		function recordAge(lat, reloj, tReq, tResp) {
+			// Restas en 32 bits sin signo, como micros()
+			const edad_us = (reloj - lat.captura_us) >>> 0;
+			const espera_us = (reloj - lat.llegada_us) >>> 0;
+			requestAnimationFrame(function() {
+				const tRender = performance.now();
+				const red = (tResp - tReq) / 2;
+				const age = edad_us / 1000 + red + (tRender - tResp);
+				ages.push(age);
+				if (ages.length > AGE_SAMPLES) ages.shift();
+
+				const sorted = ages.slice().sort(function(a, b) { return a - b; });
+				document.getElementById('age_p50').textContent = percentile(sorted, 0.5).toFixed(0);
+				document.getElementById('age_p99').textContent = percentile(sorted, 0.99).toFixed(0);
+				document.getElementById('age_detail').textContent =
+					'LPC ' + (lat.cola_us / 1000).toFixed(1) + ' ms, UART ' + (lat.uart_us / 1000).toFixed(1) +
+					' ms, ESP ' + (espera_us / 1000).toFixed(1) + ' ms, red ' + red.toFixed(1) +
+					' ms, dibujo ' + (tRender - tResp).toFixed(1) + ' ms' +
+					(lat.sync ? ' (relojes sincronizados, rtt UART ' + (lat.rtt_us / 1000).toFixed(1) + ' ms)' : ' (sin sincronismo)') +
+					' - ' + ages.length + ' muestras';
+			});
+		}
 		
 		const canvas = document.getElementById('coChart');
 		const ctx = canvas.getContext('2d');
@@ -225,15 +699,16 @@ void handleRoot() {
 
 		// --- FUNCIONES DE GRÁFICO ---
 
-		function drawChart() {
+		// serie: [{x (0 a 1), v, lo, hi}]; lo y hi son la envolvente de cada punto
+		function drawChart(serie) {
 			const w = canvas.width;
 			const h = canvas.height;
 			const padding = 30;
 
-			if (co_data.length === 0) return; 
+			if (serie.length === 0) return; 
 
 			// Calcula el valor máximo para la escala Y
-			let maxVal = Math.max(...co_data);
+			let maxVal = Math.max(...serie.map(function(p) { return p.hi; }));
 			if (maxVal === -Infinity || maxVal < UMBRAL_CRITICO) maxVal = UMBRAL_CRITICO * 1.5; 
 			else maxVal *= 1.2; 
 			
@@ -294,16 +769,27 @@ void handleRoot() {
 				ctx.stroke();
 			}
 
+			const px = function(p) { return padding + p.x * (w - 2 * padding); };
+			const py = function(v) { return h - padding - (v / maxVal) * (h - 2 * padding); };
+
+			// --- Envolvente (mínimo y máximo de cada balde) ---
+			if (serie.some(function(p) { return p.lo !== p.hi; })) {
+				ctx.fillStyle = 'rgba(0, 123, 255, 0.2)';
+				ctx.beginPath();
+				serie.forEach(function(p, i) { if (i === 0) ctx.moveTo(px(p), py(p.hi)); else ctx.lineTo(px(p), py(p.hi)); });
+				for (let i = serie.length - 1; i >= 0; i--) ctx.lineTo(px(serie[i]), py(serie[i].lo));
+				ctx.closePath();
+				ctx.fill();
+			}
+
 			// --- Línea de datos ---
 			ctx.beginPath();
 			ctx.strokeStyle = '#007BFF'; // Azul
-			ctx.lineWidth = 2;
+			ctx.lineWidth = serie.length > DATA_SIZE ? 1 : 2;
 
-			for(let i = 0; i < co_data.length; i++){
-				let x = padding + (i / (DATA_SIZE - 1)) * (w - 2 * padding);
-				let value = co_data[i] || 0; 
-				let normalizedY = (value / maxVal) * (h - 2 * padding);
-				let y = h - padding - normalizedY;
+			for(let i = 0; i < serie.length; i++){
+				let x = px(serie[i]);
+				let y = py(serie[i].v || 0);
 
 				if (i === 0) {
 					ctx.moveTo(x, y);
@@ -311,15 +797,24 @@ void handleRoot() {
 					ctx.lineTo(x, y);
 				}
 				
-				// Puntos de dato
-				ctx.fillStyle = '#007BFF';
-				ctx.beginPath();
-				ctx.arc(x, y, 3, 0, Math.PI * 2);
-				ctx.fill();
+				// Puntos de dato (solo con pocas muestras)
+				if (serie.length <= DATA_SIZE) {
+					ctx.stroke();
+					ctx.fillStyle = '#007BFF';
+					ctx.beginPath();
+					ctx.arc(x, y, 3, 0, Math.PI * 2);
+					ctx.fill();
+					ctx.beginPath();
+					ctx.moveTo(x, y);
+				}
 			}
 			ctx.stroke();
 		}
 
+		function drawData() {
+			drawChart(co_data.map(function(v, i) { return { x: i / (DATA_SIZE - 1), v: v, lo: v, hi: v }; }));
+		}
+
 		// --- FUNCIÓN DE ESTADO ---
 		function updateStatus(latestValue, averageValue) {
 			const statusElement = document.getElementById('status_bar');
@@ -349,15 +844,28 @@ void handleRoot() {
 
 		// --- FUNCIÓN DE ACTUALIZACIÓN AJAX (CLAVE) ---
 
+		// Ultima respuesta completa: con 304 se sigue usando
+		let etag = null;
+		let lastData = null;
+
 		function updateData() {
 			const xhr = new XMLHttpRequest();
 			xhr.open('GET', '/data', true); 
 			xhr.setRequestHeader('Content-Type', 'application/json');
+			if (etag) xhr.setRequestHeader('If-None-Match', etag);
+			const tReq = performance.now();
 
 			xhr.onload = function() {
-				if (xhr.status === 200) {
+				const tResp = performance.now();
+				const reloj = parseInt(xhr.getResponseHeader('X-Reloj-us'));
+				if (xhr.status === 304 && lastData) {
+					// Sin datos nuevos: no hay nada que redibujar
+					if (lastData.lat) recordAge(lastData.lat, reloj, tReq, tResp);
+				} else if (xhr.status === 200) {
 					try {
 						const data = JSON.parse(xhr.responseText);
+						etag = xhr.getResponseHeader('ETag');
+						lastData = data;
 						
 						// 1. Obtener Historial (Muestras Simples)
 						co_data = data.values; 
@@ -365,8 +873,11 @@ void handleRoot() {
 						// 2. Actualizar Estado y Valores Numéricos con Muestra y Promedio
 						updateStatus(data.latest, data.average);
 
-						// 3. Redibujar el Gráfico
-						drawChart(); 
+						// 3. Redibujar el Gráfico (si muestra las ultimas de /data)
+						if (rango === 0) drawData(); 
+
+						// 4. Edad del dato en pantalla
+						if (data.lat) recordAge(data.lat, reloj, tReq, tResp);
 					} catch (e) {
 						console.error("Error al parsear JSON:", e);
 					}
@@ -378,8 +889,106 @@ void handleRoot() {
 			xhr.send();
 		}
 
+		// Los arrays de /data.bin son little-endian: se leen directo con
+		// Uint16Array/Uint32Array salvo en una CPU big-endian
+		const LITTLE_ENDIAN = new Uint8Array(new Uint16Array([1]).buffer)[0] === 1;
+
+		// Decodifica /data.bin; null si llego cortado
+		function decodeDataBin(buf) {
+			const dv = new DataView(buf);
+			if (buf.byteLength < DATA_BIN_CABECERA) return null;
+			const n = dv.getUint32(4, true);
+			const offT = DATA_BIN_CABECERA + 2 * n + (n & 1) * 2;
+			if (buf.byteLength !== offT + 4 * n) return null;
+			const d = { ahora: dv.getUint32(0, true), seq: dv.getUint32(8, true), escala: dv.getUint16(12, true) };
+			if (LITTLE_ENDIAN) {
+				d.q = new Uint16Array(buf, DATA_BIN_CABECERA, n);
+				d.t = new Uint32Array(buf, offT, n);
+			} else {
+				d.q = new Uint16Array(n);
+				d.t = new Uint32Array(n);
+				for (let i = 0; i < n; i++) {
+					d.q[i] = dv.getUint16(DATA_BIN_CABECERA + 2 * i, true);
+					d.t[i] = dv.getUint32(offT + 4 * i, true);
+				}
+			}
+			return d;
+		}
+
+		// Rangos cortos: las muestras crudas, reducidas aca a promedio, minimo y
+		// maximo por columna de pixeles
+		function updateDataBin(ancho, pedido) {
+			const xhr = new XMLHttpRequest();
+			xhr.open('GET', '/data.bin?from=-' + rango, true);
+			xhr.responseType = 'arraybuffer';
+			xhr.onload = function() {
+				if (xhr.status !== 200 || pedido !== rango) return;
+				const d = decodeDataBin(xhr.response);
+				if (!d) return;
+				const suma = new Float64Array(ancho), cuenta = new Uint32Array(ancho);
+				const lo = new Uint16Array(ancho).fill(0xFFFF), hi = new Uint16Array(ancho);
+				for (let i = 0; i < d.q.length; i++) {
+					const edad = (d.ahora - d.t[i]) >>> 0;
+					const col = Math.min(ancho - 1, Math.max(0, Math.floor((1 - edad / rango) * ancho)));
+					const q = d.q[i];
+					suma[col] += q;
+					cuenta[col]++;
+					if (q < lo[col]) lo[col] = q;
+					if (q > hi[col]) hi[col] = q;
+				}
+				const serie = [];
+				for (let col = 0; col < ancho; col++) {
+					if (!cuenta[col]) continue;
+					serie.push({ x: (col + 0.5) / ancho, v: suma[col] / cuenta[col] / d.escala, lo: lo[col] / d.escala, hi: hi[col] / d.escala });
+				}
+				drawChart(serie);
+				document.getElementById('rango_detalle').textContent =
+					d.q.length + ' muestras (binario, ' + xhr.response.byteLength + ' bytes)';
+			};
+			xhr.send();
+		}
+
+		// Vista por rango: rangos cortos crudos de /data.bin, los largos de
+		// /history reducidos en el ESP a un punto por pixel
+		function updateHistory() {
+			if (rango === 0) return;
+			const ancho = Math.max(3, Math.min(1000, canvas.width - 60));
+			if (rango > 0 && rango <= RANGO_BINARIO_MS) {
+				updateDataBin(ancho, rango);
+				return;
+			}
+			const url = '/history?points=' + ancho + (rango > 0 ? '&from=-' + rango : '');
+			const pedido = rango;
+			const xhr = new XMLHttpRequest();
+			xhr.open('GET', url, true);
+			xhr.onload = function() {
+				if (xhr.status !== 200 || pedido !== rango) return;
+				try {
+					const d = JSON.parse(xhr.responseText);
+					// Tiempos como edad (resta de 32 bits sin signo, como millis())
+					const edad = function(t) { return (d.ahora - t) >>> 0; };
+					const span = rango > 0 ? rango : (d.p.length ? Math.max(1, edad(d.p[0][0])) : 1);
+					drawChart(d.p.map(function(p) {
+						return { x: 1 - edad(p[0]) / span, v: p[1], lo: p[2], hi: p[3] };
+					}));
+					document.getElementById('rango_detalle').textContent =
+						d.muestras + ' muestras en ' + d.puntos + ' puntos';
+				} catch (e) {
+					console.error("Error al parsear JSON:", e);
+				}
+			};
+			xhr.send();
+		}
+
+		document.getElementById('rango').addEventListener('change', function(e) {
+			rango = parseInt(e.target.value);
+			document.getElementById('rango_detalle').textContent = '';
+			if (rango === 0) drawData(); else updateHistory();
+		});
+
 		// Configurar la actualización dinámica usando la constante inyectada
 		setInterval(updateData, REFRESH_INTERVAL_MS); 
+		setInterval(updateHistory, HISTORIA_REFRESCO_MS);
 
 		// Intentar una carga inicial y resize
 		updateData();
@@ -388,8 +997,9 @@ void handleRoot() {
 
 </body>
 </html>
-)=====");
+)=====";
 
-	// Enviar la respuesta HTTP al cliente
-	server.send(200, "text/html", html);
+void handleRoot(const PeticionHttp &p, RespuestaHttp &r) {
+	r.tipo("text/html");
+	r.cuerpoEstatico(PAGINA_HTML, sizeof(PAGINA_HTML) - 1);
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "historial.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool Historial::iniciar(size_t bytes) {
+	free(ppm_);
+	free(dt_);
+	free(bloques_);
+	ppm_ = NULL;
+	dt_ = NULL;
+	bloques_ = NULL;
+	cap_ = cap_bloques_ = 0;
+	total_ = bloques_total_ = 0;
+	n_bloques_ = 0;
+
+	// Por muestra: 2 + 1 bytes y la parte que le toca de su bloque
+	size_t fijo = HIST_BLOQUES_EXTRA * sizeof(Bloque);
+	if (bytes <= fijo) return false;
+	size_t cap = (bytes - fijo) * HIST_BLOQUE / (3 * HIST_BLOQUE + sizeof(Bloque));
+	if (cap < 2 * HIST_BLOQUE) return false;
+	size_t cap_bloques = cap / HIST_BLOQUE + HIST_BLOQUES_EXTRA;
+
+	ppm_ = (uint16_t *)malloc(cap * sizeof(uint16_t));
+	dt_ = (uint8_t *)malloc(cap);
+	bloques_ = (Bloque *)malloc(cap_bloques * sizeof(Bloque));
+	if (!ppm_ || !dt_ || !bloques_) {
+		iniciar(0);
+		return false;
+	}
+	cap_ = cap;
+	cap_bloques_ = cap_bloques;
+	return true;
+}
+
+size_t Historial::bytesUsados() const {
+	return cap_ * (sizeof(uint16_t) + sizeof(uint8_t)) + cap_bloques_ * sizeof(Bloque);
+}
+
+void Historial::borrarBloque() {
+	n_bloques_--;
+}
+
+void Historial::agregar(uint32_t t_ms, float ppm) {
+	if (cap_ == 0) return;
+	float escalado = ppm * HIST_ESCALA + 0.5f;
+	uint16_t q = escalado <= 0.0f ? 0 : escalado >= 65535.0f ? 65535 : (uint16_t)escalado;
+
+	// Sigue en el bloque abierto si hay lugar y el avance entra en 8 bits
+	uint32_t paso = 0;
+	bool nuevo = true;
+	if (n_bloques_) {
+		const Bloque &b = bloque(bloques_total_ - 1);
+		int32_t d = (int32_t)(t_ms - b.t0_ms);
+		uint32_t q_t = d > 0 ? (uint32_t)d / HIST_DT_MS : 0;
+		if (q_t < b.q_fin) q_t = b.q_fin;   // El tiempo no retrocede
+		paso = q_t - b.q_fin;
+		nuevo = b.n == HIST_BLOQUE || paso > UINT8_MAX;
+	}
+
+	// Lugar para la muestra y, si hace falta, para el bloque
+	while (total_ - primera() >= cap_) borrarBloque();
+	if (nuevo) {
+		if (n_bloques_ == cap_bloques_) borrarBloque();
+		Bloque &b = bloque(bloques_total_++);
+		n_bloques_++;
+		b.seq0 = total_;
+		b.t0_ms = t_ms;
+		b.n = 0;
+		b.q_fin = 0;
+		b.min = b.max = q;
+		b.q_min = b.q_max = 0;
+		b.suma = b.suma_q = 0;
+		paso = 0;
+	}
+	Bloque &b = bloque(bloques_total_ - 1);
+	b.n++;
+	b.q_fin += paso;
+	if (q < b.min) {
+		b.min = q;
+		b.q_min = b.q_fin;
+	}
+	if (q > b.max) {
+		b.max = q;
+		b.q_max = b.q_fin;
+	}
+	b.suma += q;
+	b.suma_q += b.q_fin;
+	ppm_[total_ % cap_] = q;
+	dt_[total_ % cap_] = (uint8_t)paso;
+	total_++;
+}
+
+Historial::Cursor Historial::cursorEn(uint32_t b) const {
+	Cursor c = { bloque(b).seq0, bloque(b).seq0 % (uint32_t)cap_, b, bloque(b).t0_ms };
+	return c;
+}
+
+// El cursor y el tramo hasta e siguen en el historial
+bool Historial::enTramo(const Cursor &c, uint32_t e) const {
+	return (int32_t)(c.seq - primera()) >= 0 && (int32_t)(e - c.seq) >= 0 && (int32_t)(e - total_) <= 0;
+}
+
+Historial::Cursor Historial::buscar(uint32_t t_ms) const {
+	Cursor fin = { total_, cap_ ? total_ % (uint32_t)cap_ : 0, bloques_total_, 0 };
+	if (n_bloques_ == 0) return fin;
+
+	// Ultimo bloque que empieza en t_ms o antes
+	uint32_t lo = bloques_total_ - n_bloques_, hi = bloques_total_;
+	if ((int32_t)(bloque(lo).t0_ms - t_ms) >= 0) return cursorEn(lo);
+	while (hi - lo > 1) {
+		uint32_t m = lo + (hi - lo) / 2;
+		if ((int32_t)(bloque(m).t0_ms - t_ms) <= 0) lo = m;
+		else hi = m;
+	}
+
+	Cursor c = cursorEn(lo);
+	for (;;) {
+		Cursor antes = c;
+		uint32_t t;
+		uint16_t q;
+		if (!siguiente(c, &t, &q)) return c;    // Despues de la ultima muestra
+		if ((int32_t)(t - t_ms) >= 0) return antes;
+	}
+}
+
+Historial::Cursor Historial::ultimas(size_t n) const {
+	Cursor fin = { total_, cap_ ? total_ % (uint32_t)cap_ : 0, bloques_total_, 0 };
+	if (n_bloques_ == 0) return fin;
+	if (n > cantidad()) n = cantidad();
+	return enSeq(total_ - n);
+}
+
+Historial::Cursor Historial::enSeq(uint32_t seq) const {
+	// Bloque que contiene seq
+	uint32_t lo = bloques_total_ - n_bloques_, hi = bloques_total_;
+	while (hi - lo > 1) {
+		uint32_t m = lo + (hi - lo) / 2;
+		if ((int32_t)(bloque(m).seq0 - seq) <= 0) lo = m;
+		else hi = m;
+	}
+	Cursor c = cursorEn(lo);
+	uint32_t t;
+	uint16_t q;
+	while (c.seq < seq) siguiente(c, &t, &q);
+	return c;
+}
+
+bool Historial::promedio(Cursor &c, uint32_t e, uint32_t ref_ms, float *t, float *q) const {
+	// Sumas relativas a ref_ms: en float no se pierde resolucion con millis() grandes
+	int64_t suma_t = 0;
+	uint32_t suma = 0;
+	uint32_t n = e - c.seq;
+	if (n == 0 || !enTramo(c, e)) return false;
+	while (c.seq != e) {
+		c.bloque = bloqueDe(c);
+		const Bloque &b = bloque(c.bloque);
+		uint32_t fin = b.seq0 + b.n;
+		if (c.seq == b.seq0 && cerrado(c.bloque) && (int32_t)(fin - e) <= 0) {
+			suma_t += (int64_t)b.n * (int32_t)(b.t0_ms - ref_ms) + (int64_t)b.suma_q * HIST_DT_MS;
+			suma += b.suma;
+			c = cursorEn(c.bloque + 1);
+			continue;
+		}
+		recorrerBloque(c, b, (int32_t)(fin - e) > 0 ? e : fin, [&](uint32_t tm, uint16_t qm) {
+			suma_t += (int32_t)(tm - ref_ms);
+			suma += qm;
+		});
+	}
+	*t = (float)suma_t / n;
+	*q = (float)suma / n;
+	return true;
+}
+
+size_t Historial::copiar(uint32_t seq, void *destino, size_t n) const {
+	if ((int32_t)(seq - primera()) < 0 || (int32_t)(total_ - seq) <= 0) return 0;
+	if (n > total_ - seq) n = total_ - seq;
+	// A lo sumo dos tramos: hasta el final del anillo y desde el principio
+	size_t i = seq % cap_;
+	size_t a = n < cap_ - i ? n : cap_ - i;
+	memcpy(destino, ppm_ + i, a * sizeof(uint16_t));
+	memcpy((uint8_t *)destino + a * sizeof(uint16_t), ppm_, (n - a) * sizeof(uint16_t));
+	return n;
+}
+
+uint32_t Historial::bloqueDe(const Cursor &c) const {
+	uint32_t b = c.bloque, viejo = bloques_total_ - n_bloques_;
+	if ((int32_t)(b - viejo) < 0) b = viejo;
+	if (c.seq == bloque(b).seq0 + bloque(b).n) b++;
+	return b;
+}
+
+bool Historial::siguiente(Cursor &c, uint32_t *t_ms, uint16_t *q) const {
+	if ((int32_t)(c.seq - primera()) < 0) return false;    // Ya se borro
+	if (c.seq == total_) return false;
+	c.bloque = bloqueDe(c);
+	const Bloque *b = &bloque(c.bloque);
+	uint32_t i = c.i;
+	uint32_t t = (c.seq == b->seq0) ? b->t0_ms : c.t_ms + dt_[i] * HIST_DT_MS;
+	*t_ms = t;
+	*q = ppm_[i];
+	c.t_ms = t;
+	c.seq++;
+	c.i = (i + 1 == cap_) ? 0 : i + 1;
+	return true;
+}
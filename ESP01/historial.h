@@ -0,0 +1,150 @@
+#ifndef HISTORIAL_H_
+#define HISTORIAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Historial de muestras de CO ---
+// Anillo de muestras cuantizadas que ocupa buena parte del heap libre del
+// ESP8266, en lugar de los 10 float de antes. Cada muestra son 3 bytes:
+//   - ppm en 16 bits con HIST_ESCALA pasos por ppm (satura en 4095.9 ppm)
+//   - uint8 con el avance del tiempo en pasos de HIST_DT_MS
+// Las muestras se agrupan en bloques de hasta HIST_BLOQUE con el tiempo
+// absoluto de la primera; un salto de tiempo que no entra en 8 bits abre un
+// bloque nuevo. Los tiempos se reconstruyen desde el inicio del bloque, asi
+// el error de cuantizacion no se acumula (< HIST_DT_MS).
+//
+// agregar() es O(1). buscar() ubica un tiempo con busqueda binaria sobre los
+// bloques y recorre a lo sumo uno. Cada bloque guarda ademas su minimo y su
+// maximo (con sus tiempos) y las sumas para el promedio, asi recorrer() y
+// promedio() cruzan un bloque entero en O(1) (ver lttb.h); dentro de un
+// bloque avanzan muestra por muestra sin volver a buscarlo.
+//
+// Muestras y bloques llevan numeros de secuencia absolutos: un Cursor
+// guardado entre vueltas del loop sigue siendo valido mientras no lo
+// alcance el borrado de lo mas viejo.
+//
+// Los tiempos son ms de 32 bits (millis()); se comparan por diferencia, asi
+// que el historial no debe abarcar mas de ~24 dias.
+//
+// No depende de Arduino: se compila igual en la PC.
+
+#define HIST_ESCALA				16		// Pasos por ppm
+#define HIST_DT_MS				8		// Resolucion del tiempo
+#define HIST_BLOQUE				64		// Muestras por bloque como maximo
+#define HIST_BLOQUES_EXTRA		16		// Bloques cortados por saltos de tiempo
+
+class Historial {
+public:
+	struct Cursor {
+		uint32_t seq;		// Proxima muestra
+		uint32_t i;			// Su lugar en el anillo (seq % capacidad)
+		uint32_t bloque;	// Bloque de esa muestra
+		uint32_t t_ms;		// Tiempo de la muestra anterior del bloque
+	};
+
+	// Reparte 'bytes' del heap entre muestras y bloques; false sin memoria
+	bool iniciar(size_t bytes);
+	void agregar(uint32_t t_ms, float ppm);
+
+	size_t cantidad() const { return total_ - primera(); }
+	size_t capacidad() const { return cap_; }
+	size_t bytesUsados() const;
+	uint32_t total() const { return total_; }
+
+	// Cursor en la primera muestra con t >= t_ms (o al final)
+	Cursor buscar(uint32_t t_ms) const;
+	// Cursor en las ultimas n muestras
+	Cursor ultimas(size_t n) const;
+	// Cursor en la muestra seq, que tiene que seguir en el historial
+	Cursor enSeq(uint32_t seq) const;
+	// Muestra siguiente; false al final o si el cursor quedo en lo borrado
+	bool siguiente(Cursor &c, uint32_t *t_ms, uint16_t *q) const;
+	// Copia tal cual (uint16 en el orden de la CPU) hasta n valores desde la
+	// muestra seq; devuelve cuantos copio, 0 si seq ya se borro
+	size_t copiar(uint32_t seq, void *destino, size_t n) const;
+
+	static float aPpm(uint16_t q) { return q * (1.0f / HIST_ESCALA); }
+
+	// Secuencia de la muestra mas vieja que queda
+	uint32_t primeraSeq() const { return primera(); }
+
+	// Visita las muestras desde el cursor hasta la secuencia e (excluida) con
+	// visitar(t_ms, q) y deja el cursor en e. Con 'resumir', cada bloque
+	// entero dentro del tramo aporta solo su minimo y su maximo. false si
+	// parte del tramo ya se borro.
+	template <typename F>
+	bool recorrer(Cursor &c, uint32_t e, bool resumir, F visitar) const;
+	// Promedio de (t - ref_ms) y de q desde el cursor hasta e, que lo deja en e
+	bool promedio(Cursor &c, uint32_t e, uint32_t ref_ms, float *t, float *q) const;
+
+private:
+	struct Bloque {
+		uint32_t seq0;		// Secuencia de la primera muestra
+		uint32_t t0_ms;		// Tiempo de la primera muestra
+		uint16_t n;
+		uint16_t q_fin;		// Avance acumulado (en HIST_DT_MS) de la ultima
+		uint16_t min, max;
+		uint16_t q_min, q_max;	// Avance hasta el minimo y el maximo
+		uint32_t suma;			// De los ppm cuantizados
+		uint32_t suma_q;		// De los avances
+	};
+
+	uint32_t primera() const { return n_bloques_ ? bloque(bloques_total_ - n_bloques_).seq0 : total_; }
+	const Bloque &bloque(uint32_t b) const { return bloques_[b % cap_bloques_]; }
+	Bloque &bloque(uint32_t b) { return bloques_[b % cap_bloques_]; }
+	// El bloque b ya no recibe muestras: solo el ultimo sigue abierto
+	bool cerrado(uint32_t b) const { return b + 1 != bloques_total_; }
+	Cursor cursorEn(uint32_t b) const;
+	// Visita desde el cursor hasta fin (excluida), todo dentro del bloque b
+	template <typename F>
+	void recorrerBloque(Cursor &c, const Bloque &b, uint32_t fin, F visitar) const;
+	// Bloque del cursor; uno al final de un bloque ya borrado sigue en el mas viejo
+	uint32_t bloqueDe(const Cursor &c) const;
+	bool enTramo(const Cursor &c, uint32_t e) const;
+	void borrarBloque();
+
+	uint16_t *ppm_ = NULL;
+	uint8_t *dt_ = NULL;
+	Bloque *bloques_ = NULL;
+	size_t cap_ = 0, cap_bloques_ = 0;
+	uint32_t total_ = 0;			// Muestras agregadas desde el inicio
+	uint32_t bloques_total_ = 0;
+	size_t n_bloques_ = 0;
+};
+
+template <typename F>
+void Historial::recorrerBloque(Cursor &c, const Bloque &b, uint32_t fin, F visitar) const {
+	// El avance de la primera muestra de un bloque es 0
+	uint32_t t = c.seq == b.seq0 ? b.t0_ms : c.t_ms;
+	uint32_t i = c.i;
+	for (uint32_t s = c.seq; s != fin; s++) {
+		t += dt_[i] * HIST_DT_MS;
+		visitar(t, ppm_[i]);
+		if (++i == cap_) i = 0;
+	}
+	c.seq = fin;
+	c.i = i;
+	c.t_ms = t;
+}
+
+template <typename F>
+bool Historial::recorrer(Cursor &c, uint32_t e, bool resumir, F visitar) const {
+	if (!enTramo(c, e)) return false;
+	while (c.seq != e) {
+		c.bloque = bloqueDe(c);
+		const Bloque &b = bloque(c.bloque);
+		uint32_t fin = b.seq0 + b.n;
+		if (resumir && c.seq == b.seq0 && cerrado(c.bloque) && (int32_t)(fin - e) <= 0) {
+			// Bloque cerrado y entero en el tramo: solo sus extremos
+			visitar(b.t0_ms + (uint32_t)b.q_min * HIST_DT_MS, b.min);
+			visitar(b.t0_ms + (uint32_t)b.q_max * HIST_DT_MS, b.max);
+			c = cursorEn(c.bloque + 1);
+			continue;
+		}
+		recorrerBloque(c, b, (int32_t)(fin - e) > 0 ? e : fin, visitar);
+	}
+	return true;
+}
+
+#endif /* HISTORIAL_H_ */
@@ -0,0 +1,78 @@
+#include "lttb.h"
+#include <math.h>
+
+void Lttb::iniciar(const Historial &h, uint32_t desde_ms, uint32_t hasta_ms, uint16_t puntos, bool resumir) {
+	s_ = h.buscar(desde_ms).seq;
+	uint32_t e = h.buscar(hasta_ms + 1).seq;
+	n_ = (int32_t)(e - s_) > 0 ? e - s_ : 0;
+	if (puntos < 3) puntos = 3;
+	puntos_ = n_ < puntos ? n_ : puntos;
+	i_ = 0;
+	resumir_ = resumir && puntos_ > 2 && (n_ - 2) / (puntos_ - 2) >= LTTB_RESUMIR_BLOQUES * HIST_BLOQUE;
+}
+
+// Primera muestra (relativa a s_) del balde intermedio 'balde'
+uint32_t Lttb::limite(uint32_t balde) const {
+	return 1 + (uint32_t)((uint64_t)balde * (n_ - 2) / (puntos_ - 2));
+}
+
+bool Lttb::siguiente(const Historial &h, PuntoLttb *p) {
+	if (i_ >= puntos_) return false;
+
+	// Primera y ultima: tal cual
+	if (i_ == 0 || i_ == puntos_ - 1) {
+		uint32_t seq = s_ + (i_ == 0 ? 0 : n_ - 1);
+		Historial::Cursor c = h.enSeq(seq);
+		bool ok = h.recorrer(c, seq + 1, false, [&](uint32_t t, uint16_t q) {
+			p->t_ms = t;
+			p->q = p->lo = p->hi = q;
+		});
+		if (!ok) return false;
+		a_t_ = p->t_ms;
+		a_q_ = p->q;
+		if (i_ == 0 && puntos_ > 2) {
+			// Cursores en el primer balde y en el segundo
+			balde_ = siguiente_ = c;
+			if (!h.recorrer(siguiente_, s_ + limite(1), true, [](uint32_t, uint16_t) {})) return false;
+		}
+		i_++;
+		return true;
+	}
+
+	// Tercer vertice: promedio del balde siguiente (o la ultima muestra).
+	// Tiempos relativos al punto anterior, que queda en el origen.
+	uint32_t balde = i_ - 1;
+	float c_t, c_q;
+	if (balde + 1 < (uint32_t)puntos_ - 2) {
+		if (!h.promedio(siguiente_, s_ + limite(balde + 2), a_t_, &c_t, &c_q)) return false;
+	} else {
+		uint32_t ult = s_ + n_ - 1;
+		Historial::Cursor c = h.enSeq(ult);
+		bool ok = h.recorrer(c, ult + 1, false, [&](uint32_t t, uint16_t q) {
+			c_t = (float)(int32_t)(t - a_t_);
+			c_q = q;
+		});
+		if (!ok) return false;
+	}
+
+	float mejor = -1.0f;
+	float dq = c_q - a_q_;
+	uint16_t lo = UINT16_MAX, hi = 0;
+	bool ok = h.recorrer(balde_, s_ + limite(balde + 1), resumir_, [&](uint32_t t, uint16_t q) {
+		float area = fabsf(-c_t * ((float)q - a_q_) + (float)(int32_t)(t - a_t_) * dq);
+		if (area > mejor) {
+			mejor = area;
+			p->t_ms = t;
+			p->q = q;
+		}
+		if (q < lo) lo = q;
+		if (q > hi) hi = q;
+	});
+	if (!ok) return false;
+	p->lo = lo;
+	p->hi = hi;
+	a_t_ = p->t_ms;
+	a_q_ = p->q;
+	i_++;
+	return true;
+}
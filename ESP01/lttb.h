@@ -0,0 +1,63 @@
+#ifndef LTTB_H_
+#define LTTB_H_
+
+#include <stdint.h>
+#include "historial.h"
+
+// --- Reduccion Largest-Triangle-Three-Buckets del historial ---
+// Elige 'puntos' muestras de un tramo del historial que conservan la forma
+// de la curva: la primera, la ultima y, de cada balde intermedio, la que
+// forma el triangulo mas grande con la elegida antes y el promedio del balde
+// siguiente. Cada punto lleva tambien el minimo y el maximo de su balde para
+// dibujar la envolvente.
+//
+// Con 'resumir', los bloques del historial enteros dentro de un balde
+// aportan solo su minimo y su maximo (precalculados) como candidatos y sus
+// sumas para el promedio: el costo es O(puntos * HIST_BLOQUE + muestras /
+// HIST_BLOQUE) en vez de O(muestras). La envolvente sale exacta; el punto
+// elegido puede diferir del LTTB original cuando el mejor candidato no es
+// un extremo de su bloque. Se resume solo si los baldes abarcan al menos
+// LTTB_RESUMIR_BLOQUES bloques: con baldes mas chicos casi todo el balde
+// son bordes de bloque que igual se recorren muestra por muestra, y el
+// recorrido directo es igual de rapido y da el LTTB exacto.
+//
+// Cada balde se recorre dos veces en total: una para el promedio (como
+// balde siguiente) y otra para elegir su punto, con dos cursores que
+// avanzan juntos. El estado es chico y se puede copiar: siguiente() se llama
+// de a tramos desde un GeneradorHttp mientras el historial sigue creciendo.
+
+#define LTTB_RESUMIR_BLOQUES	2
+
+struct PuntoLttb {
+	uint32_t t_ms;
+	uint16_t q;			// Muestra elegida
+	uint16_t lo, hi;	// Envolvente del balde
+};
+
+class Lttb {
+public:
+	// Tramo [desde_ms, hasta_ms]; puntos < 3 se toma como 3
+	void iniciar(const Historial &h, uint32_t desde_ms, uint32_t hasta_ms, uint16_t puntos, bool resumir = true);
+	// Proximo punto; false al terminar o si el tramo se borro mientras tanto
+	bool siguiente(const Historial &h, PuntoLttb *p);
+
+	uint32_t muestras() const { return n_; }
+	uint16_t puntos() const { return puntos_; }
+	// Si este tramo usa los resumenes de los bloques
+	bool resumido() const { return resumir_; }
+
+private:
+	uint32_t limite(uint32_t balde) const;
+
+	Historial::Cursor balde_;		// Inicio del balde actual
+	Historial::Cursor siguiente_;	// Inicio del balde siguiente
+	uint32_t s_;		// Secuencia de la primera muestra del tramo
+	uint32_t n_;		// Muestras en el tramo
+	uint32_t a_t_;		// Ultimo punto elegido
+	uint16_t a_q_;
+	uint16_t puntos_;
+	uint16_t i_;		// Proximo punto a entregar
+	bool resumir_;
+};
+
+#endif /* LTTB_H_ */
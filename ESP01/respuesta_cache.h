@@ -0,0 +1,62 @@
+#ifndef RESPUESTA_CACHE_H_
+#define RESPUESTA_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// --- Respuesta HTTP memorizada ---
+// El cuerpo se serializa una sola vez por cambio de estado en un buffer fijo
+// y se sirve tal cual a todos los clientes. 'version' es la secuencia de
+// muestras recibidas del LPC1769 (mas los cambios de sincronismo): mientras
+// no cambie, actualizar() no hace nada. El ETag lleva un numero de arranque
+// para que un reinicio del ESP no coincida con lo que el navegador guardo.
+//
+// No depende de Arduino: se compila igual en la PC.
+
+template <size_t TAM>
+class RespuestaCache {
+public:
+	explicit RespuestaCache(uint32_t arranque = 0) : arranque_(arranque) {}
+
+	void fijarArranque(uint32_t arranque) {
+		arranque_ = arranque;
+		valida_ = false;
+	}
+
+	// render(buf, tam) escribe el cuerpo y devuelve su largo (como snprintf)
+	template <typename Render>
+	bool actualizar(uint32_t version, Render render) {
+		if (valida_ && version == version_) return false;
+		size_t n = render(cuerpo_, TAM);
+		largo_ = (n < TAM) ? n : TAM - 1;   // Truncado: el buffer quedo corto
+		version_ = version;
+		valida_ = true;
+		snprintf(etag_, sizeof(etag_), "\"%08lx-%lx\"", (unsigned long)arranque_, (unsigned long)version_);
+		renders_++;
+		return true;
+	}
+
+	// If-None-Match puede traer varios ETag separados por comas o "*"
+	bool noModificada(const char *if_none_match) const {
+		if (!valida_ || if_none_match == NULL || *if_none_match == '\0') return false;
+		return strcmp(if_none_match, "*") == 0 || strstr(if_none_match, etag_) != NULL;
+	}
+
+	const char *cuerpo() const { return cuerpo_; }
+	size_t largo() const { return largo_; }
+	const char *etag() const { return etag_; }
+	uint32_t renders() const { return renders_; }
+
+private:
+	char cuerpo_[TAM];
+	size_t largo_ = 0;
+	char etag_[24] = "";
+	uint32_t arranque_;
+	uint32_t version_ = 0;
+	uint32_t renders_ = 0;
+	bool valida_ = false;
+};
+
+#endif /* RESPUESTA_CACHE_H_ */
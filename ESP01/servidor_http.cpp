@@ -0,0 +1,423 @@
+#include "servidor_http.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Los cuerpos estaticos del ESP estan en flash (PROGMEM): solo se leen de a 32 bits
+#ifdef ARDUINO
+#include <pgmspace.h>
+#define HTTP_COPIAR_ESTATICO	memcpy_P
+#else
+#define HTTP_COPIAR_ESTATICO	memcpy
+#endif
+
+static const char *razon(int codigo) {
+	switch (codigo) {
+	case 200: return "OK";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 431: return "Request Header Fields Too Large";
+	default:  return "Internal Server Error";
+	}
+}
+
+bool http_parametro(const char *consulta, const char *nombre, long long *valor) {
+	size_t n = strlen(nombre);
+	for (const char *p = consulta; p && *p; p = strchr(p, '&'), p = p ? p + 1 : NULL) {
+		if (strncmp(p, nombre, n) == 0 && p[n] == '=') {
+			char *fin;
+			long long v = strtoll(p + n + 1, &fin, 10);
+			if (fin == p + n + 1) return false;
+			*valor = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+// --- RespuestaHttp ---
+
+bool RespuestaHttp::encabezado(const char *nombre, const char *valor) {
+	int r = snprintf(extra_ + extra_len_, HTTP_TAM_EXTRA - extra_len_, "%s: %s\r\n", nombre, valor);
+	if (r < 0 || (size_t)r >= HTTP_TAM_EXTRA - extra_len_) {
+		extra_[extra_len_] = '\0';
+		return false;
+	}
+	extra_len_ += r;
+	return true;
+}
+
+bool RespuestaHttp::cuerpo(const void *datos, size_t n) {
+	if (n > HTTP_TAM_TX - HTTP_TAM_CAB) return false;
+	memcpy(copia_, datos, n);
+	copia_len_ = n;
+	estatico_ = NULL;
+	generador_ = NULL;
+	largo_ = 0;
+	return true;
+}
+
+void RespuestaHttp::cuerpoEstatico(const char *datos, size_t n) {
+	copia_len_ = 0;
+	estatico_ = datos;
+	generador_ = NULL;
+	largo_ = n;
+}
+
+bool RespuestaHttp::generador(size_t largo, GeneradorHttp fn, const void *ctx, size_t tam_ctx) {
+	if (tam_ctx > HTTP_TAM_CTX) return false;
+	memcpy(ctx_, ctx, tam_ctx);
+	copia_len_ = 0;
+	estatico_ = NULL;
+	generador_ = fn;
+	largo_ = largo;
+	return true;
+}
+
+// --- ServidorHttp ---
+
+ServidorHttp::ServidorHttp(TransporteHttp &t) : t_(t), n_rutas_(0), turno_(0) {
+	memset(conex_, 0, sizeof(conex_));
+	memset(&stats_, 0, sizeof(stats_));
+}
+
+void ServidorHttp::en(const char *ruta, ManejadorHttp fn) {
+	if (n_rutas_ == HTTP_MAX_RUTAS) return;
+	rutas_[n_rutas_].ruta = ruta;
+	rutas_[n_rutas_].fn = fn;
+	n_rutas_++;
+}
+
+// Una vuelta: a lo sumo una conexion nueva y un paso acotado por conexion
+void ServidorHttp::servicio(uint32_t ahora_ms) {
+	aceptar(ahora_ms);
+	uint8_t activas = 0;
+	for (int k = 0; k < HTTP_MAX_CONEX; k++) {
+		int i = (turno_ + k) % HTTP_MAX_CONEX;
+		if (conex_[i].estado == LIBRE) continue;
+		paso(conex_[i], i, ahora_ms);
+		if (conex_[i].estado != LIBRE) activas++;
+	}
+	turno_ = (turno_ + 1) % HTTP_MAX_CONEX;
+	stats_.activas = activas;
+}
+
+void ServidorHttp::aceptar(uint32_t ahora_ms) {
+	if (!t_.pendiente()) return;
+	int libre = -1, inactiva = -1;
+	for (int i = 0; i < HTTP_MAX_CONEX; i++) {
+		Conexion &c = conex_[i];
+		if (c.estado == LIBRE) {
+			libre = i;
+			break;
+		}
+		// Keep-alive sin peticion a medias: la mas vieja se puede desalojar
+		if (c.estado == LEYENDO && c.rx_len == 0 &&
+				(uint32_t)(ahora_ms - c.ultimo_ms) >= HTTP_DESALOJO_MS &&
+				(inactiva < 0 || (int32_t)(c.ultimo_ms - conex_[inactiva].ultimo_ms) < 0)) {
+			inactiva = i;
+		}
+	}
+	if (libre < 0) {
+		if (inactiva < 0) return;   // Todas ocupadas: espera en la cola de lwIP
+		cerrar(conex_[inactiva], inactiva);
+		stats_.desalojos++;
+		libre = inactiva;
+	}
+	if (!t_.aceptar(libre)) return;
+	Conexion &c = conex_[libre];
+	c.estado = LEYENDO;
+	c.rx_len = 0;
+	c.consumidos = 0;
+	c.ultimo_ms = ahora_ms;
+	stats_.conexiones++;
+}
+
+bool ServidorHttp::colmado() {
+	for (int i = 0; i < HTTP_MAX_CONEX; i++) {
+		if (conex_[i].estado == LIBRE) return false;
+	}
+	return t_.pendiente();
+}
+
+void ServidorHttp::paso(Conexion &c, int i, uint32_t ahora_ms) {
+	if (c.estado == LEYENDO) {
+		if (!leer(c, i, ahora_ms)) return;
+		// Fin de los encabezados: linea vacia
+		size_t fin = 0;
+		for (size_t k = 1; k < c.rx_len; k++) {
+			if (c.rx[k] != '\n') continue;
+			if (c.rx[k - 1] == '\n') fin = k + 1;
+			else if (k >= 2 && c.rx[k - 1] == '\r' && c.rx[k - 2] == '\n') fin = k + 1;
+			if (fin) break;
+		}
+		if (fin) {
+			procesar(c, fin);
+		} else if (c.rx_len == HTTP_TAM_RX) {
+			c.consumidos = c.rx_len;
+			c.keep_alive = false;
+			error(c, 431);
+		} else {
+			if ((uint32_t)(ahora_ms - c.ultimo_ms) >= HTTP_INACTIVO_MS) {
+				stats_.vencidas++;
+				cerrar(c, i);
+			}
+			return;
+		}
+	}
+	if (!escribir(c, i, ahora_ms)) return;
+	if (c.tx_pos == c.tx_len && (c.largo == HTTP_LARGO_VARIABLE ? c.fin_flujo : c.enviado == c.largo)) {
+		terminar(c, i);
+	} else if ((uint32_t)(ahora_ms - c.ultimo_ms) >= HTTP_INACTIVO_MS) {
+		stats_.vencidas++;  // El cliente dejo de leer
+		cerrar(c, i);
+	}
+}
+
+bool ServidorHttp::leer(Conexion &c, int i, uint32_t ahora_ms) {
+	size_t espacio = HTTP_TAM_RX - c.rx_len;
+	if (espacio == 0) return true;
+	int n = t_.leer(i, (uint8_t *)c.rx + c.rx_len, espacio < HTTP_PASO ? espacio : HTTP_PASO);
+	if (n < 0) {
+		cerrar(c, i);
+		return false;
+	}
+	if (n > 0) {
+		c.rx_len += n;
+		c.ultimo_ms = ahora_ms;
+	}
+	return true;
+}
+
+// Analiza la peticion en rx[0, fin) en el lugar (cortando con '\0') y arma la respuesta
+void ServidorHttp::procesar(Conexion &c, size_t fin) {
+	c.consumidos = fin;
+	for (size_t k = 0; k < fin; k++) {
+		if (c.rx[k] == '\r' || c.rx[k] == '\n') c.rx[k] = '\0';
+	}
+
+	PeticionHttp p;
+	p.if_none_match = "";
+	p.metodo = c.rx;
+	char *objetivo = strchr(c.rx, ' ');
+	char *version = objetivo ? strchr(objetivo + 1, ' ') : NULL;
+	if (!version) {
+		c.keep_alive = false;
+		error(c, 400);
+		return;
+	}
+	*objetivo++ = '\0';
+	*version++ = '\0';
+	c.http11 = strcmp(version, "HTTP/1.1") == 0;
+	c.keep_alive = c.http11;
+	c.solo_cabecera = strcmp(p.metodo, "HEAD") == 0;
+
+	bool con_cuerpo = false;
+	for (char *linea = version + strlen(version) + 1; linea < c.rx + fin; linea += strlen(linea) + 1) {
+		char *dos_puntos = strchr(linea, ':');
+		if (!dos_puntos) continue;
+		*dos_puntos = '\0';
+		char *valor = dos_puntos + 1;
+		while (*valor == ' ' || *valor == '\t') valor++;
+		if (strcasecmp(linea, "Connection") == 0) {
+			if (strncasecmp(valor, "close", 5) == 0) c.keep_alive = false;
+			else if (strncasecmp(valor, "keep-alive", 10) == 0) c.keep_alive = true;
+		} else if (strcasecmp(linea, "If-None-Match") == 0) {
+			p.if_none_match = valor;
+		} else if (strcasecmp(linea, "Content-Length") == 0) {
+			con_cuerpo = strtoul(valor, NULL, 10) > 0;
+		} else if (strcasecmp(linea, "Transfer-Encoding") == 0) {
+			con_cuerpo = true;
+		}
+	}
+	if (con_cuerpo) {
+		// No se leen cuerpos: lo que sigue no se podria separar de la proxima peticion
+		c.keep_alive = false;
+		error(c, 400);
+		return;
+	}
+	if (!c.solo_cabecera && strcmp(p.metodo, "GET") != 0) {
+		error(c, 405);
+		return;
+	}
+
+	char *consulta = strchr(objetivo, '?');
+	if (consulta) *consulta++ = '\0';
+	p.ruta = objetivo;
+	p.consulta = consulta ? consulta : "";
+
+	ManejadorHttp fn = NULL;
+	for (int k = 0; k < n_rutas_; k++) {
+		if (strcmp(rutas_[k].ruta, p.ruta) == 0) {
+			fn = rutas_[k].fn;
+			break;
+		}
+	}
+	if (!fn) {
+		error(c, 404);
+		return;
+	}
+
+	char extra[HTTP_TAM_EXTRA];
+	RespuestaHttp r;
+	r.codigo_ = 200;
+	r.tipo_ = "text/plain";
+	r.extra_ = extra;
+	r.extra_len_ = 0;
+	extra[0] = '\0';
+	r.copia_ = c.tx + HTTP_TAM_CAB;
+	r.copia_len_ = 0;
+	r.estatico_ = NULL;
+	r.generador_ = NULL;
+	r.ctx_ = c.ctx;
+	r.largo_ = 0;
+	fn(p, r);
+	stats_.peticiones++;
+	if (r.codigo_ == 304) stats_.no_modificadas++;
+	armar(c, r, extra);
+}
+
+void ServidorHttp::error(Conexion &c, int codigo) {
+	char extra[1] = "";
+	RespuestaHttp r;
+	r.codigo_ = codigo;
+	r.tipo_ = "text/plain";
+	r.extra_ = extra;
+	r.extra_len_ = 0;
+	r.copia_ = c.tx + HTTP_TAM_CAB;
+	r.estatico_ = NULL;
+	r.generador_ = NULL;
+	r.largo_ = 0;
+	const char *texto = razon(codigo);
+	r.copia_len_ = strlen(texto);
+	memcpy(r.copia_, texto, r.copia_len_);
+	stats_.peticiones++;
+	stats_.errores++;
+	armar(c, r, extra);
+}
+
+// El encabezado se escribe justo antes del cuerpo copiado en tx[HTTP_TAM_CAB]
+void ServidorHttp::armar(Conexion &c, RespuestaHttp &r, char *extra) {
+	if (c.keep_alive && colmado()) c.keep_alive = false;   // Ceder la ranura al que espera
+	bool variable = r.generador_ && r.largo_ == HTTP_LARGO_VARIABLE;
+	c.troceado = variable && c.http11;
+	if (variable && !c.http11) c.keep_alive = false;         // El final es el cierre
+	char cab[HTTP_TAM_CAB];
+	int h = snprintf(cab, sizeof(cab), "HTTP/1.1 %d %s\r\n", r.codigo_, razon(r.codigo_));
+	if (r.codigo_ != 304) {
+		h += snprintf(cab + h, sizeof(cab) - h, "Content-Type: %s\r\n", r.tipo_);
+	}
+	if (c.troceado) {
+		h += snprintf(cab + h, sizeof(cab) - h, "Transfer-Encoding: chunked\r\n");
+	} else if (r.codigo_ != 304 && !variable) {
+		h += snprintf(cab + h, sizeof(cab) - h, "Content-Length: %lu\r\n",
+				(unsigned long)(r.copia_len_ + r.largo_));
+	}
+	if (h < (int)sizeof(cab)) {
+		h += snprintf(cab + h, sizeof(cab) - h, "%sConnection: %s\r\n\r\n",
+				extra, c.keep_alive ? "keep-alive" : "close");
+	}
+	if (h >= (int)sizeof(cab)) {
+		// Encabezados agregados demasiado largos: no deberia pasar con HTTP_TAM_EXTRA
+		c.keep_alive = false;
+		error(c, 500);
+		return;
+	}
+	memcpy(c.tx + HTTP_TAM_CAB - h, cab, h);
+	c.tx_pos = HTTP_TAM_CAB - h;
+	c.tx_len = HTTP_TAM_CAB + (c.solo_cabecera ? 0 : r.copia_len_);
+	c.largo = c.solo_cabecera ? 0 : r.largo_;
+	c.enviado = 0;
+	c.fin_flujo = false;
+	c.estatico = r.estatico_;
+	c.generador = r.generador_;
+	c.estado = RESPONDIENDO;
+}
+
+// Hasta HTTP_PASO bytes; false si la conexion se cerro
+bool ServidorHttp::escribir(Conexion &c, int i, uint32_t ahora_ms) {
+	size_t presupuesto = HTTP_PASO;
+	while (presupuesto > 0) {
+		if (c.tx_pos == c.tx_len) {
+			if (c.largo == HTTP_LARGO_VARIABLE ? c.fin_flujo : c.enviado == c.largo) break;
+			if (!rellenar(c)) {
+				// El generador no cumplio el Content-Length anunciado
+				cerrar(c, i);
+				return false;
+			}
+			if (c.tx_pos == c.tx_len) break;    // Fin de un flujo sin trozos
+		}
+		size_t n = c.tx_len - c.tx_pos;
+		int w = t_.escribir(i, c.tx + c.tx_pos, n < presupuesto ? n : presupuesto);
+		if (w < 0) {
+			cerrar(c, i);
+			return false;
+		}
+		if (w == 0) break;
+		c.tx_pos += w;
+		presupuesto -= w;
+		stats_.bytes_enviados += w;
+		c.ultimo_ms = ahora_ms;
+	}
+	return true;
+}
+
+// Siguiente tramo del cuerpo en flujo; false si el generador fallo
+bool ServidorHttp::rellenar(Conexion &c) {
+	c.tx_pos = 0;
+	if (c.largo != HTTP_LARGO_VARIABLE) {
+		size_t n = c.largo - c.enviado;
+		if (n > HTTP_TAM_TX) n = HTTP_TAM_TX;
+		if (c.estatico) {
+			HTTP_COPIAR_ESTATICO(c.tx, c.estatico + c.enviado, n);
+		} else {
+			n = c.generador(c.tx, n, c.enviado, c.ctx);
+		}
+		c.tx_len = n;
+		c.enviado += n;
+		return n > 0;
+	}
+	if (!c.troceado) {
+		size_t n = c.generador(c.tx, HTTP_TAM_TX, c.enviado, c.ctx);
+		c.tx_len = n;
+		c.enviado += n;
+		c.fin_flujo = n == 0;
+		return true;
+	}
+	// Trozo: "<largo en hex>\r\n<datos>\r\n"; el ultimo es "0\r\n\r\n"
+	size_t n = c.generador(c.tx + 5, HTTP_TAM_TX - 5 - 2, c.enviado, c.ctx);
+	if (n == 0) {
+		memcpy(c.tx, "0\r\n\r\n", 5);
+		c.tx_len = 5;
+		c.fin_flujo = true;
+		return true;
+	}
+	char largo[6];
+	snprintf(largo, sizeof(largo), "%03x\r\n", (unsigned)n);
+	memcpy(c.tx, largo, 5);
+	memcpy(c.tx + 5 + n, "\r\n", 2);
+	c.tx_len = 5 + n + 2;
+	c.enviado += n;
+	return true;
+}
+
+void ServidorHttp::terminar(Conexion &c, int i) {
+	if (!c.keep_alive) {
+		cerrar(c, i);
+		return;
+	}
+	// Lo que siguio a la peticion (pipelining) queda para la proxima vuelta
+	c.rx_len -= c.consumidos;
+	memmove(c.rx, c.rx + c.consumidos, c.rx_len);
+	c.consumidos = 0;
+	c.estado = LEYENDO;
+}
+
+void ServidorHttp::cerrar(Conexion &c, int i) {
+	t_.cerrar(i);
+	c.estado = LIBRE;
+	c.rx_len = 0;
+}
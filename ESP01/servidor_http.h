@@ -0,0 +1,155 @@
+#ifndef SERVIDOR_HTTP_H_
+#define SERVIDOR_HTTP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Servidor HTTP sin bloqueo para varios clientes ---
+// Reemplaza a ESP8266WebServer, que atiende un cliente por vez y espera a
+// que cada uno termine: un navegador lento frenaba la lectura del puerto
+// serie y a los demas. Aca cada llamada a servicio() hace a lo sumo
+// HTTP_PASO bytes de trabajo por conexion, en ronda empezando cada vez por
+// una distinta, y vuelve; loop() atiende el puerto serie entre llamadas.
+//
+// - Hasta HTTP_MAX_CONEX conexiones con keep-alive (HTTP/1.1 por defecto).
+//   Con todas las ranuras ocupadas y alguien esperando, las respuestas salen
+//   con "Connection: close" y se cede la conexion inactiva mas vieja.
+// - Buffers fijos por conexion: HTTP_TAM_RX para la peticion (mas larga ->
+//   431) y HTTP_TAM_TX para encabezados y cuerpos copiados.
+// - Solo GET y HEAD, sin cuerpo en la peticion.
+// - Cuerpos de largo desconocido (generador con HTTP_LARGO_VARIABLE) en
+//   trozos de a lo sumo HTTP_TAM_TX; a clientes HTTP/1.0, hasta el cierre.
+//
+// El transporte es una interfaz: en el ESP son WiFiClient (ESP01.ino); en la
+// PC se puede compilar con sockets o con clientes simulados.
+
+#define HTTP_MAX_CONEX			4		// lwIP del ESP8266 admite pocas mas
+#define HTTP_TAM_RX				512
+#define HTTP_TAM_TX				1024
+#define HTTP_TAM_CAB			256		// Parte de HTTP_TAM_TX reservada al encabezado
+#define HTTP_TAM_EXTRA			160		// Encabezados agregados por el manejador
+#define HTTP_PASO				256		// Bytes por conexion y por vuelta
+#define HTTP_INACTIVO_MS		5000
+#define HTTP_DESALOJO_MS		200		// Inactividad minima para ceder la ranura
+#define HTTP_MAX_RUTAS			8
+#define HTTP_TAM_CTX			64		// Estado de un generador de cuerpo
+#define HTTP_LARGO_VARIABLE		((size_t)-1)	// Generador de largo desconocido
+
+class TransporteHttp {
+public:
+	// Hay una conexion esperando ser aceptada
+	virtual bool pendiente() = 0;
+	// Toma una conexion pendiente en 'ranura'; false si no hay
+	virtual bool aceptar(int ranura) = 0;
+	// Bytes leidos/escritos sin esperar (0 = nada por ahora), -1 = cerrada
+	virtual int leer(int ranura, uint8_t *buf, size_t n) = 0;
+	virtual int escribir(int ranura, const uint8_t *buf, size_t n) = 0;
+	virtual void cerrar(int ranura) = 0;
+	virtual ~TransporteHttp() {}
+};
+
+struct PeticionHttp {
+	const char *metodo;
+	const char *ruta;
+	const char *consulta;		// Lo que sigue al '?', "" si no hay
+	const char *if_none_match;	// "" si no vino
+};
+
+// Valor numerico, con signo, de un parametro de la consulta ("from=-10&to=20")
+bool http_parametro(const char *consulta, const char *nombre, long long *valor);
+
+// Genera el cuerpo por partes: escribe hasta 'tam' bytes a partir de
+// 'offset' y devuelve cuantos escribio. ctx es una copia por conexion.
+// Con HTTP_LARGO_VARIABLE cada llamada escribe lo que quiera (al menos un
+// byte) y 0 marca el final; va en trozos (Transfer-Encoding: chunked), o
+// hasta cerrar la conexion si el cliente es HTTP/1.0.
+typedef size_t (*GeneradorHttp)(uint8_t *buf, size_t tam, size_t offset, void *ctx);
+
+class RespuestaHttp {
+public:
+	void estado(int codigo) { codigo_ = codigo; }
+	void tipo(const char *tipo) { tipo_ = tipo; }
+	bool encabezado(const char *nombre, const char *valor);
+	// Copia el cuerpo al buffer de la conexion (hasta HTTP_TAM_TX - HTTP_TAM_CAB)
+	bool cuerpo(const void *datos, size_t n);
+	// Cuerpo que no cambia mientras se envia (flash o memoria estatica)
+	void cuerpoEstatico(const char *datos, size_t n);
+	// Cuerpo armado a medida que se envia (largo o HTTP_LARGO_VARIABLE)
+	bool generador(size_t largo, GeneradorHttp fn, const void *ctx, size_t tam_ctx);
+
+private:
+	friend class ServidorHttp;
+	int codigo_;
+	const char *tipo_;
+	char *extra_;
+	size_t extra_len_;
+	uint8_t *copia_;
+	size_t copia_len_;
+	const char *estatico_;
+	GeneradorHttp generador_;
+	uint8_t *ctx_;
+	size_t largo_;
+};
+
+typedef void (*ManejadorHttp)(const PeticionHttp &p, RespuestaHttp &r);
+
+typedef struct {
+	uint32_t conexiones;
+	uint32_t peticiones;
+	uint32_t no_modificadas;	// Respuestas 304
+	uint32_t errores;			// 4xx/5xx generadas por el servidor
+	uint32_t desalojos;			// Conexiones inactivas cerradas para aceptar otra
+	uint32_t vencidas;			// Cerradas por HTTP_INACTIVO_MS
+	uint32_t bytes_enviados;
+	uint8_t activas;
+} http_stats_t;
+
+class ServidorHttp {
+public:
+	explicit ServidorHttp(TransporteHttp &t);
+	void en(const char *ruta, ManejadorHttp fn);
+	void servicio(uint32_t ahora_ms);
+	const http_stats_t &stats() const { return stats_; }
+
+private:
+	enum Estado : uint8_t { LIBRE, LEYENDO, RESPONDIENDO };
+	struct Conexion {
+		Estado estado;
+		bool keep_alive;
+		bool solo_cabecera;		// HEAD
+		bool http11;
+		bool troceado;			// Transfer-Encoding: chunked
+		bool fin_flujo;			// El generador de largo variable termino
+		uint16_t rx_len;
+		uint16_t consumidos;	// Bytes de la peticion en curso (pipelining)
+		uint16_t tx_pos, tx_len;
+		uint32_t ultimo_ms;
+		size_t largo, enviado;	// Parte en flujo del cuerpo
+		const char *estatico;
+		GeneradorHttp generador;
+		alignas(8) uint8_t ctx[HTTP_TAM_CTX];
+		char rx[HTTP_TAM_RX + 1];
+		uint8_t tx[HTTP_TAM_TX];
+	};
+
+	void aceptar(uint32_t ahora_ms);
+	bool colmado();
+	void paso(Conexion &c, int i, uint32_t ahora_ms);
+	bool leer(Conexion &c, int i, uint32_t ahora_ms);
+	void procesar(Conexion &c, size_t fin);
+	void error(Conexion &c, int codigo);
+	void armar(Conexion &c, RespuestaHttp &r, char *extra);
+	bool escribir(Conexion &c, int i, uint32_t ahora_ms);
+	bool rellenar(Conexion &c);
+	void terminar(Conexion &c, int i);
+	void cerrar(Conexion &c, int i);
+
+	TransporteHttp &t_;
+	Conexion conex_[HTTP_MAX_CONEX];
+	struct { const char *ruta; ManejadorHttp fn; } rutas_[HTTP_MAX_RUTAS];
+	uint8_t n_rutas_;
+	uint8_t turno_;
+	http_stats_t stats_;
+};
+
+#endif /* SERVIDOR_HTTP_H_ */
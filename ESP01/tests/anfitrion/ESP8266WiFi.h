@@ -0,0 +1,85 @@
+#ifndef ANFITRION_ESP8266WIFI_H_
+#define ANFITRION_ESP8266WIFI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Lo del nucleo de Arduino para ESP8266 que usa ESP01.ino, en la PC ---
+// Alcanza para compilar el sketch entero (las pruebas lo incluyen) y correr
+// sus funciones: el reloj lo mueve la prueba (anfitrion_us), Serial lee de
+// un buffer de 256 bytes como el del ESP que llena la prueba (lo que no
+// entra se pierde y se cuenta) y descarta lo que se escribe, y WiFi no
+// acepta conexiones (los servidores de prueba usan su propio transporte).
+
+#define PROGMEM
+#define F(x) (x)
+
+extern uint64_t anfitrion_us;				// micros() y millis() salen de aca
+void anfitrion_serie(const char *texto);	// Llega por la UART
+extern uint32_t anfitrion_serie_perdidos;	// Bytes que no entraron en el buffer
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+class IPAddress {};
+
+class HardwareSerial {
+public:
+	void begin(unsigned long baudios) { (void)baudios; }
+	int available();
+	int read();
+	bool hasOverrun();
+	int availableForWrite() { return 128; }
+	template <typename T> void print(const T &) {}
+	template <typename T> void print(const T &, int) {}
+	template <typename T> void println(const T &) {}
+	template <typename T> void println(const T &, int) {}
+	void println() {}
+};
+extern HardwareSerial Serial;
+
+class WiFiClient {
+public:
+	explicit operator bool() const { return false; }
+	void setNoDelay(bool) {}
+	int available() { return 0; }
+	int read(uint8_t *, size_t) { return -1; }
+	bool connected() { return false; }
+	size_t availableForWrite() { return 0; }
+	size_t write(const uint8_t *, size_t) { return 0; }
+	bool stop(unsigned int) { return true; }
+};
+
+class WiFiServer {
+public:
+	explicit WiFiServer(int puerto) { (void)puerto; }
+	void begin() {}
+	void setNoDelay(bool) {}
+	bool hasClient() { return false; }
+	WiFiClient accept() { return WiFiClient(); }
+};
+
+enum { WIFI_STA };
+enum { WL_CONNECTED = 3 };
+
+class ESP8266WiFiClass {
+public:
+	void mode(int) {}
+	void begin(const char *, const char *) {}
+	int status() { return WL_CONNECTED; }
+	IPAddress localIP() { return IPAddress(); }
+};
+extern ESP8266WiFiClass WiFi;
+
+class EspClass {
+public:
+	uint32_t random() { return 0x5EED1234u; }
+	uint32_t getFreeHeap() { return 40960; }		// Lo que queda con el WiFi andando
+};
+extern EspClass ESP;
+
+#endif /* ANFITRION_ESP8266WIFI_H_ */
@@ -0,0 +1,28 @@
+#ifndef ANFITRION_H_
+#define ANFITRION_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// --- Soporte para correr el codigo del ESP-01 en la PC ---
+// Los modulos (historial, lttb, servidor_http, respuesta_cache) no dependen
+// de Arduino y se compilan tal cual. Las pruebas que necesitan el sketch lo
+// incluyen (#include "../ESP01.ino") con el nucleo de Arduino reemplazado
+// por anfitrion/ESP8266WiFi.h.
+
+#define VERIFICAR(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: fallo: %s\n", __FILE__, __LINE__, #cond); \
+		exit(1); \
+	} \
+} while (0)
+
+static inline uint64_t ahora_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#endif /* ANFITRION_H_ */
@@ -0,0 +1,51 @@
+#include "ESP8266WiFi.h"
+
+HardwareSerial Serial;
+ESP8266WiFiClass WiFi;
+EspClass ESP;
+
+uint64_t anfitrion_us = 1000000;
+
+// Buffer de recepcion de la UART0 del ESP8266 (256 bytes por defecto)
+static char serie[256];
+static size_t serie_cab, serie_cola;
+static bool serie_desborde;
+uint32_t anfitrion_serie_perdidos;
+
+unsigned long millis(void) {
+	return (unsigned long)(uint32_t)(anfitrion_us / 1000);
+}
+
+unsigned long micros(void) {
+	return (unsigned long)(uint32_t)anfitrion_us;
+}
+
+void delay(unsigned long ms) {
+	anfitrion_us += (uint64_t)ms * 1000;
+}
+
+void anfitrion_serie(const char *texto) {
+	for (; *texto; texto++) {
+		if (serie_cab - serie_cola == sizeof(serie)) {
+			serie_desborde = true;		// Lleno: el byte se pierde
+			anfitrion_serie_perdidos++;
+			continue;
+		}
+		serie[serie_cab++ % sizeof(serie)] = *texto;
+	}
+}
+
+int HardwareSerial::available() {
+	return (int)(serie_cab - serie_cola);
+}
+
+int HardwareSerial::read() {
+	if (serie_cab == serie_cola) return -1;
+	return (uint8_t)serie[serie_cola++ % sizeof(serie)];
+}
+
+bool HardwareSerial::hasOverrun() {
+	bool d = serie_desborde;
+	serie_desborde = false;
+	return d;
+}
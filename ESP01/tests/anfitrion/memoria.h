@@ -0,0 +1,80 @@
+#ifndef ANFITRION_MEMORIA_H_
+#define ANFITRION_MEMORIA_H_
+
+#include "servidor_http.h"
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// --- Transporte HTTP en memoria ---
+// Cada ranura es un cliente simulado: la prueba deja la peticion en
+// 'entrada' y el servidor escribe en 'salida'. 'ventana' es lo que queda
+// libre en el buffer de envio (como availableForWrite() de lwIP): cada
+// escribir() lo descuenta hasta que la prueba lo vuelve a fijar. 'pendientes'
+// son conexiones esperando ser aceptadas.
+
+class TransporteMemoria : public TransporteHttp {
+public:
+	std::string entrada[HTTP_MAX_CONEX], salida[HTTP_MAX_CONEX];
+	bool abierta[HTTP_MAX_CONEX] = {};
+	int pendientes = 0;
+	size_t ventana = (size_t)-1;
+
+	bool pendiente() override { return pendientes > 0; }
+	bool aceptar(int r) override {
+		if (pendientes == 0) return false;
+		pendientes--;
+		abierta[r] = true;
+		salida[r].clear();
+		return true;
+	}
+	int leer(int r, uint8_t *buf, size_t n) override {
+		if (!abierta[r]) return -1;
+		if (n > entrada[r].size()) n = entrada[r].size();
+		memcpy(buf, entrada[r].data(), n);
+		entrada[r].erase(0, n);
+		return (int)n;
+	}
+	int escribir(int r, const uint8_t *buf, size_t n) override {
+		if (!abierta[r]) return -1;
+		if (n > ventana) n = ventana;
+		ventana -= n;
+		salida[r].append((const char *)buf, n);
+		return (int)n;
+	}
+	void cerrar(int r) override { abierta[r] = false; }
+};
+
+// Vueltas del servidor hasta que deja de escribir; devuelve lo escrito en
+// la ranura 0 y lo saca de la salida
+static inline std::string http_atender(ServidorHttp &s, TransporteMemoria &t, uint32_t ahora_ms) {
+	int quieto = 0;
+	while (quieto < 2) {
+		size_t antes = t.salida[0].size();
+		s.servicio(ahora_ms);
+		quieto = (t.salida[0].size() == antes) ? quieto + 1 : 0;
+	}
+	std::string r;
+	r.swap(t.salida[0]);
+	return r;
+}
+
+// Valor de un encabezado de la primera respuesta en 'r' ("" si no esta)
+static inline std::string http_encabezado(const std::string &r, const char *nombre) {
+	size_t fin = r.find("\r\n\r\n");
+	std::string buscado = std::string("\r\n") + nombre + ": ";
+	size_t p = r.find(buscado);
+	if (p == std::string::npos || p > fin) return "";
+	p += buscado.size();
+	return r.substr(p, r.find("\r\n", p) - p);
+}
+
+// Cuerpo de la primera respuesta en 'r', segun su Content-Length
+static inline std::string http_cuerpo(const std::string &r) {
+	size_t fin = r.find("\r\n\r\n");
+	if (fin == std::string::npos) return "";
+	std::string largo = http_encabezado(r, "Content-Length");
+	return r.substr(fin + 4, largo.empty() ? std::string::npos : strtoul(largo.c_str(), NULL, 10));
+}
+
+#endif /* ANFITRION_MEMORIA_H_ */
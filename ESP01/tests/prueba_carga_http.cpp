@@ -0,0 +1,374 @@
+// --- Prueba de carga del servidor HTTP con sockets ---
+// El loop() del sketch (handleSerial() y una vuelta del servidor) corre en la
+// PC con un transporte de sockets TCP no bloqueantes en 127.0.0.1, con el
+// buffer de envio de 2920 bytes (la ventana de 2 MSS de lwIP en el ESP). Por
+// la UART llegan lineas U/P sin pausa a 9600 baudios (960 bytes/s) a un
+// buffer de 256 bytes: si una vuelta de loop() tarda mas de ~267 ms se
+// pierden bytes. NAVEGADORES hilos piden /data con If-None-Match y cada 20
+// peticiones la pagina (cuerpo estatico de ~15 KB); LENTOS de ellos,
+// repartidos, leen de a 64 bytes con pausas (se corre sin y con ellos). Un navegador que espera mas de
+// ESPERA_S segundos la conexion o la respuesta la da por perdida.
+//
+// Lo mismo corre con un servidor como ESP8266WebServer: un cliente por vez,
+// lectura y escritura bloqueantes, Connection: close y el cuerpo armado en
+// cada peticion. Verifica, con el servidor sin bloqueo:
+//   - ningun byte perdido en la UART y ninguna linea descartada
+//   - todos los navegadores rapidos reciben respuestas, y sin errores
+// Informa respuestas por segundo, 304, desalojos, la vuelta mas larga y los
+// bytes perdidos de cada servidor. Con un nucleo los navegadores le quitan
+// tiempo al servidor: las cifras sirven para comparar, no son las del ESP.
+
+#include "anfitrion.h"
+#include "memoria.h"
+#include "../ESP01.ino"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define NAVEGADORES		64
+#define LENTOS			8
+#define SEGUNDOS		2
+#define VENTANA_TCP		2920
+#define PAGINA_CADA		20
+#define ESPERA_S		2			// El navegador da la peticion por perdida
+
+static uint64_t ahora_us(void) {
+	return ahora_ns() / 1000;
+}
+
+// --- Transporte con sockets ---
+
+class TransporteSocket : public TransporteHttp {
+public:
+	TransporteSocket() {
+		escucha_ = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in a = {};
+		a.sin_family = AF_INET;
+		a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		VERIFICAR(bind(escucha_, (sockaddr *)&a, sizeof(a)) == 0 && listen(escucha_, NAVEGADORES) == 0);
+		socklen_t largo = sizeof(a);
+		getsockname(escucha_, (sockaddr *)&a, &largo);
+		puerto_ = ntohs(a.sin_port);
+		fcntl(escucha_, F_SETFL, O_NONBLOCK);
+		for (int &f : fd_) f = -1;
+	}
+	~TransporteSocket() {
+		for (int f : fd_) if (f >= 0) close(f);
+		if (pendiente_ >= 0) close(pendiente_);
+		close(escucha_);
+	}
+	int puerto() const { return puerto_; }
+	int escucha() const { return escucha_; }
+
+	bool pendiente() override {
+		if (pendiente_ < 0) pendiente_ = accept(escucha_, NULL, NULL);
+		return pendiente_ >= 0;
+	}
+	bool aceptar(int r) override {
+		if (!pendiente()) return false;
+		fd_[r] = pendiente_;
+		pendiente_ = -1;
+		int uno = 1, ventana = VENTANA_TCP;
+		fcntl(fd_[r], F_SETFL, O_NONBLOCK);
+		setsockopt(fd_[r], IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+		setsockopt(fd_[r], SOL_SOCKET, SO_SNDBUF, &ventana, sizeof(ventana));
+		return true;
+	}
+	int leer(int r, uint8_t *buf, size_t n) override {
+		ssize_t k = recv(fd_[r], buf, n, 0);
+		if (k > 0) return (int)k;
+		return (k < 0 && errno == EAGAIN) ? 0 : -1;
+	}
+	int escribir(int r, const uint8_t *buf, size_t n) override {
+		ssize_t k = send(fd_[r], buf, n, MSG_NOSIGNAL);
+		if (k >= 0) return (int)k;
+		return errno == EAGAIN ? 0 : -1;
+	}
+	void cerrar(int r) override {
+		close(fd_[r]);
+		fd_[r] = -1;
+	}
+
+private:
+	int escucha_, puerto_;
+	int pendiente_ = -1;
+	int fd_[HTTP_MAX_CONEX];
+};
+
+// --- Navegadores ---
+
+static std::atomic<bool> fin;
+static std::atomic<long> errores, reintentos;
+static long respuestas[NAVEGADORES];
+static int lentos;
+
+// Los lentos, repartidos entre los demas
+static bool es_lento(int id) {
+	return lentos && id % (NAVEGADORES / lentos) == 0;
+}
+
+static int conectar(int puerto, bool lento) {
+	int s = socket(AF_INET, SOCK_STREAM, 0);
+	if (lento) {
+		int rx = 1024;
+		setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rx, sizeof(rx));
+	}
+	sockaddr_in a = {};
+	a.sin_family = AF_INET;
+	a.sin_port = htons(puerto);
+	a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	// Como un navegador, deja de esperar a los ESPERA_S segundos (sin esto
+	// connect() reintenta el SYN por minutos si la cola de aceptar esta llena)
+	fcntl(s, F_SETFL, O_NONBLOCK);
+	int error = 0;
+	socklen_t largo = sizeof(error);
+	pollfd p = { s, POLLOUT, 0 };
+	if ((connect(s, (sockaddr *)&a, sizeof(a)) != 0 && errno != EINPROGRESS) || poll(&p, 1, ESPERA_S * 1000) != 1 ||
+			getsockopt(s, SOL_SOCKET, SO_ERROR, &error, &largo) != 0 || error != 0) {
+		close(s);
+		return -1;
+	}
+	fcntl(s, F_SETFL, 0);
+	int uno = 1;
+	timeval espera = { ESPERA_S, 0 };
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &espera, sizeof(espera));
+	return s;
+}
+
+// Lee una respuesta entera (segun Content-Length); los lentos de a 64 bytes
+static bool recibir(int s, std::string &buf, bool lento, std::string *etag, bool *cierra) {
+	char tmp[4096];
+	size_t tam = lento ? 64 : sizeof(tmp);
+	size_t fin_cab;
+	while ((fin_cab = buf.find("\r\n\r\n")) == std::string::npos) {
+		ssize_t k = recv(s, tmp, tam, 0);
+		if (k <= 0) return false;
+		buf.append(tmp, k);
+		if (lento) usleep(2000);
+	}
+	std::string r = buf.substr(0, fin_cab + 4);
+	std::string largo = http_encabezado(r, "Content-Length");
+	std::string e = http_encabezado(r, "ETag");
+	if (!e.empty()) *etag = e;
+	*cierra = http_encabezado(r, "Connection") == "close";
+	size_t total = fin_cab + 4 + strtoul(largo.c_str(), NULL, 10);
+	while (buf.size() < total) {
+		ssize_t k = recv(s, tmp, tam, 0);
+		if (k <= 0) return false;
+		buf.append(tmp, k);
+		if (lento) usleep(2000);
+	}
+	buf.erase(0, total);
+	return true;
+}
+
+static void navegador(int puerto, int id) {
+	bool lento = es_lento(id);
+	std::string etag, buf;
+	int s = -1, n = 0, en_conexion = 0;
+	while (!fin) {
+		if (s < 0) {
+			s = conectar(puerto, lento);
+			buf.clear();
+			en_conexion = 0;
+			if (s < 0) {
+				if (!fin) errores++;
+				continue;
+			}
+		}
+		std::string pedido = "GET / HTTP/1.1\r\nHost: esp\r\n\r\n";
+		if (n % PAGINA_CADA != 0) {
+			pedido = "GET /data HTTP/1.1\r\nHost: esp\r\n";
+			if (!etag.empty()) pedido += "If-None-Match: " + etag + "\r\n";
+			pedido += "\r\n";
+		}
+		bool cierra = false;
+		if (send(s, pedido.data(), pedido.size(), MSG_NOSIGNAL) != (ssize_t)pedido.size() ||
+				!recibir(s, buf, lento, &etag, &cierra)) {
+			// Una conexion reusada que el servidor cerro (desalojo) se reintenta
+			close(s);
+			s = -1;
+			if (fin) break;
+			if (en_conexion) reintentos++;
+			else errores++;
+			continue;
+		}
+		n++;
+		en_conexion++;
+		respuestas[id]++;
+		if (cierra) {
+			close(s);
+			s = -1;
+		}
+	}
+	if (s >= 0) close(s);
+}
+
+// --- UART: lineas U/P sin pausa a 960 bytes/s ---
+
+static std::string uart_flujo;
+static uint64_t uart_enviados, uart_inicio;
+
+static void uart_llegan(void) {
+	uint64_t deben = (ahora_us() - uart_inicio) * 960 / 1000000;
+	while (uart_flujo.size() < deben - uart_enviados) {
+		char linea[40];
+		snprintf(linea, sizeof(linea), "%c%.2f@%lu+150\n", (uart_enviados + uart_flujo.size()) % 2 ? 'P' : 'U',
+				20.0 + uart_enviados % 1000 / 100.0, (unsigned long)micros());
+		uart_flujo += linea;
+	}
+	std::string llegan = uart_flujo.substr(0, deben - uart_enviados);
+	uart_flujo.erase(0, llegan.size());
+	uart_enviados += llegan.size();
+	anfitrion_serie(llegan.c_str());
+}
+
+// --- Servidor como ESP8266WebServer ---
+
+static std::string pagina(PAGINA_HTML);
+static uint32_t base_respuestas;
+
+static void base_vuelta(int escucha) {
+	int s = accept(escucha, NULL, NULL);
+	if (s < 0) return;
+	int ventana = VENTANA_TCP, uno = 1;
+	timeval espera = { 5, 0 };
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &uno, sizeof(uno));
+	setsockopt(s, SOL_SOCKET, SO_SNDBUF, &ventana, sizeof(ventana));
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &espera, sizeof(espera));
+	std::string pedido;
+	char tmp[512];
+	while (pedido.find("\r\n\r\n") == std::string::npos) {
+		ssize_t k = recv(s, tmp, sizeof(tmp), 0);
+		if (k <= 0) {
+			close(s);
+			return;
+		}
+		pedido.append(tmp, k);
+	}
+	std::string cuerpo, tipo = "text/html";
+	if (pedido.compare(0, 6, "GET / ") == 0) {
+		cuerpo = pagina;
+	} else {
+		char json[DATA_CACHE_TAM];
+		cuerpo.assign(json, renderCoDataJson(json, sizeof(json)));
+		tipo = "application/json";
+	}
+	std::string r = "HTTP/1.1 200 OK\r\nContent-Type: " + tipo + "\r\nContent-Length: " +
+			std::to_string(cuerpo.size()) + "\r\nConnection: close\r\n\r\n" + cuerpo;
+	for (size_t e = 0; e < r.size(); ) {
+		ssize_t k = send(s, r.data() + e, r.size() - e, MSG_NOSIGNAL);
+		if (k <= 0) break;
+		e += k;
+	}
+	close(s);
+	base_respuestas++;
+}
+
+// --- Una corrida ---
+
+typedef struct {
+	double por_segundo;
+	long errores, reintentos, min_rapido, max_rapido, lentos;
+	uint64_t vuelta_max_us;
+	uint32_t perdidos, descartadas;
+} resultado_t;
+
+static resultado_t correr(bool bloqueante, int n_lentos) {
+	TransporteSocket t;
+	ServidorHttp s(t);
+	s.en("/", handleRoot);
+	s.en("/data", handleData);
+
+	fin = false;
+	lentos = n_lentos;
+	errores = reintentos = 0;
+	memset(respuestas, 0, sizeof(respuestas));
+	uint32_t perdidos = anfitrion_serie_perdidos, descartadas = serie_descartadas;
+	uint32_t atendidas = bloqueante ? base_respuestas : s.stats().peticiones;
+	std::vector<std::thread> hilos;
+	for (int i = 0; i < NAVEGADORES; i++) hilos.emplace_back(navegador, t.puerto(), i);
+
+	resultado_t res = {};
+	uint64_t t0 = ahora_us();
+	uart_inicio = t0;
+	uart_enviados = 0;
+	uart_flujo.clear();
+	while (ahora_us() - t0 < SEGUNDOS * 1000000ull) {
+		uint64_t a = ahora_us();
+		anfitrion_us = a;
+		uart_llegan();
+		handleSerial();
+		if (bloqueante) {
+			base_vuelta(t.escucha());
+		} else {
+			s.servicio(millis());
+			if (s.stats().activas == 0) usleep(100);
+		}
+		uint64_t d = ahora_us() - a;
+		if (d > res.vuelta_max_us) res.vuelta_max_us = d;
+	}
+	uint64_t dt = ahora_us() - t0;
+	uart_llegan();
+	handleSerial();
+	fin = true;
+	for (std::thread &h : hilos) h.join();
+
+	atendidas = (bloqueante ? base_respuestas : s.stats().peticiones) - atendidas;
+	res.por_segundo = atendidas * 1e6 / dt;
+	res.errores = errores;
+	res.reintentos = reintentos;
+	res.min_rapido = 1L << 40;
+	for (int i = 0; i < NAVEGADORES; i++) {
+		if (es_lento(i)) {
+			res.lentos += respuestas[i];
+			continue;
+		}
+		if (respuestas[i] < res.min_rapido) res.min_rapido = respuestas[i];
+		if (respuestas[i] > res.max_rapido) res.max_rapido = respuestas[i];
+	}
+	res.perdidos = anfitrion_serie_perdidos - perdidos;
+	res.descartadas = serie_descartadas - descartadas;
+	if (!bloqueante) {
+		const http_stats_t &h = s.stats();
+		printf("  %u 304, %u errores del servidor, %u desalojos, %u vencidas\n",
+				h.no_modificadas, h.errores, h.desalojos, h.vencidas);
+		VERIFICAR(h.errores == 0);
+	}
+	return res;
+}
+
+static void informar(const char *nombre, const resultado_t &r) {
+	printf("%-26s %6.0f resp/s, %ld errores/esperas agotadas, %ld reintentos; por navegador rapido %ld..%ld,"
+			" lentos %ld en total\n", nombre, r.por_segundo, r.errores, r.reintentos, r.min_rapido, r.max_rapido,
+			r.lentos);
+	printf("%-26s vuelta de loop() mas larga %.1f ms, %u bytes perdidos en la UART, %u lineas descartadas\n", "",
+			r.vuelta_max_us / 1000.0, r.perdidos, r.descartadas);
+}
+
+int main(void) {
+	setup();
+	for (int n_lentos : { 0, LENTOS }) {
+		printf("%d navegadores (%d lentos), %d s cada servidor, UART a 960 bytes/s sin pausa\n",
+				NAVEGADORES, n_lentos, SEGUNDOS);
+		resultado_t nuevo = correr(false, n_lentos);
+		informar("sin bloqueo", nuevo);
+		resultado_t base = correr(true, n_lentos);
+		informar("bloqueante (linea base)", base);
+		printf("sin bloqueo / bloqueante: %.1fx respuestas por segundo\n\n", nuevo.por_segundo / base.por_segundo);
+		VERIFICAR(nuevo.perdidos == 0 && nuevo.descartadas == 0);
+		VERIFICAR(nuevo.errores == 0 && nuevo.min_rapido > 0);
+	}
+	printf("carga_http: OK\n");
+	return 0;
+}
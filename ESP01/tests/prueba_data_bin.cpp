@@ -0,0 +1,227 @@
+// --- Prueba de /data.bin contra JSON con las mismas muestras ---
+// handleDataBin del sketch detras de un ServidorHttp con el transporte en
+// memoria, con el historial lleno (200000 muestras cada 500 ms en el
+// historial que deja setup()). Para comparar, /json manda las mismas
+// muestras crudas en JSON, en trozos como /history: [[t_ms,ppm],...] con los
+// ppm en centesimos enteros (como generarHistoria) o con %.2f. Verifica:
+//   - la cabecera (ahora, n, seq de la primera, HIST_ESCALA, HIST_DT_MS),
+//     el relleno a multiplo de 4 y el Content-Length
+//   - ppm y tiempos iguales a los del historial en el tramo pedido, con
+//     from y to absolutos, relativos y por omision, y un tramo vacio
+//   - el JSON de las dos formas trae los mismos valores
+// Informa bytes en el cable y us por peticion de cada formato para los
+// ultimos 10 minutos y para todo el historial. Solo cuenta el tiempo del
+// servidor en la PC: sirve para comparar los formatos, no es la cifra del ESP.
+
+#include "anfitrion.h"
+#include "memoria.h"
+#include "../ESP01.ino"
+#include <math.h>
+#include <vector>
+
+#define MUESTRAS		200000
+#define PERIODO_MS		500
+#define REPETICIONES	200
+
+typedef struct {
+	uint32_t t;
+	uint16_t q;
+} muestra_t;
+
+// Muestras crudas de un tramo en JSON, de a trozos
+enum { JSON_INICIO, JSON_PRIMERA, JSON_RESTO, JSON_FIN };
+struct JsonCtx {
+	Historial::Cursor c;
+	uint32_t e, ahora;
+	uint8_t fase;
+	bool flotante;
+};
+
+static bool json_flotante;
+
+static size_t generarJson(uint8_t *buf, size_t tam, size_t offset, void *ctx) {
+	(void)offset;
+	JsonCtx &j = *(JsonCtx *)ctx;
+	char *s = (char *)buf;
+	size_t n = 0;
+	if (j.fase == JSON_FIN) return 0;
+	if (j.fase == JSON_INICIO) {
+		n = snprintf(s, tam, "{\"ahora\":%lu,\"p\":[", (unsigned long)j.ahora);
+		j.fase = JSON_PRIMERA;
+	}
+	uint32_t t;
+	uint16_t q;
+	while (tam - n >= 64) {
+		if (j.c.seq == j.e || !historial.siguiente(j.c, &t, &q)) {
+			n += snprintf(s + n, tam - n, "]}");
+			j.fase = JSON_FIN;
+			break;
+		}
+		const char *sep = j.fase == JSON_PRIMERA ? "" : ",";
+		if (j.flotante) {
+			n += snprintf(s + n, tam - n, "%s[%lu,%.2f]", sep, (unsigned long)t, Historial::aPpm(q));
+		} else {
+			uint32_t v = (q * 25u + 2) / 4;
+			n += snprintf(s + n, tam - n, "%s[%lu,%lu.%02lu]", sep, (unsigned long)t,
+					(unsigned long)(v / 100), (unsigned long)(v % 100));
+		}
+		j.fase = JSON_RESTO;
+	}
+	return n;
+}
+
+static void handleJson(const PeticionHttp &p, RespuestaHttp &r) {
+	JsonCtx j;
+	j.ahora = millis();
+	j.fase = JSON_INICIO;
+	j.flotante = json_flotante;
+	uint32_t desde, hasta;
+	leerTramo(p, j.ahora, &desde, &hasta);
+	j.c = historial.buscar(desde);
+	j.e = historial.buscar(hasta + 1).seq;
+	r.tipo("application/json");
+	r.generador(HTTP_LARGO_VARIABLE, generarJson, &j, sizeof(j));
+}
+
+// Cuerpo de una respuesta en trozos (Transfer-Encoding: chunked)
+static std::string sin_trozos(const std::string &r) {
+	std::string c;
+	size_t p = r.find("\r\n\r\n") + 4;
+	for (;;) {
+		size_t largo = strtoul(r.c_str() + p, NULL, 16);
+		p = r.find("\r\n", p) + 2;
+		if (largo == 0) return c;
+		c.append(r, p, largo);
+		p += largo + 2;
+	}
+}
+
+static uint32_t lee32(const std::string &b, size_t i) {
+	return (uint8_t)b[i] | (uint8_t)b[i + 1] << 8 | (uint8_t)b[i + 2] << 16 | (uint32_t)(uint8_t)b[i + 3] << 24;
+}
+
+static uint16_t lee16(const std::string &b, size_t i) {
+	return (uint8_t)b[i] | (uint8_t)b[i + 1] << 8;
+}
+
+// Muestras del historial con desde <= t <= hasta
+static std::vector<muestra_t> tramo(uint32_t desde, uint32_t hasta, uint32_t *primera) {
+	std::vector<muestra_t> v;
+	Historial::Cursor c = historial.ultimas(historial.cantidad());
+	*primera = historial.total();
+	muestra_t m;
+	for (;;) {
+		uint32_t seq = c.seq;
+		if (!historial.siguiente(c, &m.t, &m.q)) break;
+		if ((int32_t)(m.t - desde) < 0 || (int32_t)(m.t - hasta) > 0) continue;
+		if (v.empty()) *primera = seq;
+		v.push_back(m);
+	}
+	return v;
+}
+
+static std::string pedir(ServidorHttp &s, TransporteMemoria &t, const std::string &ruta) {
+	t.entrada[0] = "GET " + ruta + " HTTP/1.1\r\n\r\n";
+	return http_atender(s, t, millis());
+}
+
+// /data.bin de [desde, hasta] igual al historial
+static void verificar_bin(ServidorHttp &s, TransporteMemoria &t, const std::string &ruta, uint32_t desde, uint32_t hasta) {
+	uint32_t primera;
+	std::vector<muestra_t> ref = tramo(desde, hasta, &primera);
+	std::string r = pedir(s, t, ruta);
+	std::string b = http_cuerpo(r);
+	uint32_t n = ref.size();
+	size_t tiempos = DATA_BIN_CABECERA + 2 * n + (n & 1) * 2;
+	VERIFICAR(r.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+	VERIFICAR(http_encabezado(r, "Content-Type") == "application/octet-stream");
+	VERIFICAR(b.size() == tiempos + 4 * n && strtoul(http_encabezado(r, "Content-Length").c_str(), NULL, 10) == b.size());
+	VERIFICAR(lee32(b, 0) == millis() && lee32(b, 4) == n && (n == 0 || lee32(b, 8) == primera));
+	VERIFICAR(lee16(b, 12) == HIST_ESCALA && lee16(b, 14) == HIST_DT_MS && tiempos % 4 == 0);
+	if (n & 1) VERIFICAR(lee16(b, tiempos - 2) == 0);
+	for (uint32_t i = 0; i < n; i++) {
+		VERIFICAR(lee16(b, DATA_BIN_CABECERA + 2 * i) == ref[i].q && lee32(b, tiempos + 4 * i) == ref[i].t);
+	}
+}
+
+// /json con las dos formas: los mismos tiempos y ppm que /data.bin
+static void verificar_json(ServidorHttp &s, TransporteMemoria &t, const std::string &consulta) {
+	std::string b = http_cuerpo(pedir(s, t, "/data.bin" + consulta));
+	uint32_t n = lee32(b, 4);
+	size_t tiempos = DATA_BIN_CABECERA + 2 * n + (n & 1) * 2;
+	for (int f = 0; f < 2; f++) {
+		json_flotante = f;
+		std::string r = pedir(s, t, "/json" + consulta);
+		VERIFICAR(http_encabezado(r, "Transfer-Encoding") == "chunked");
+		std::string j = sin_trozos(r);
+		VERIFICAR(j.compare(j.size() - 2, 2, "]}") == 0);
+		const char *p = strstr(j.c_str(), "\"p\":[");
+		VERIFICAR(p != NULL);
+		p += 5;
+		uint32_t i = 0;
+		unsigned long tm;
+		double ppm;
+		int leidos;
+		while (sscanf(p, "[%lu,%lf]%n", &tm, &ppm, &leidos) == 2) {
+			VERIFICAR(i < n && tm == lee32(b, tiempos + 4 * i));
+			VERIFICAR(fabs(ppm - Historial::aPpm(lee16(b, DATA_BIN_CABECERA + 2 * i))) < 0.0051);
+			i++;
+			p += leidos;
+			if (*p == ',') p++;
+		}
+		VERIFICAR(i == n && strcmp(p, "]}") == 0);
+	}
+}
+
+// Bytes en el cable y us por peticion
+static void medir(ServidorHttp &s, TransporteMemoria &t, const char *nombre, const std::string &ruta, size_t bin) {
+	std::string r;
+	uint64_t t0 = ahora_ns();
+	for (int k = 0; k < REPETICIONES; k++) r = pedir(s, t, ruta);
+	uint64_t ns = ahora_ns() - t0;
+	printf("  %-16s %8zu bytes", nombre, r.size());
+	if (bin) printf(" (%4.1fx)", (double)r.size() / bin);
+	else printf("        ");
+	printf(" %9.1f us\n", ns / 1e3 / REPETICIONES);
+}
+
+int main(void) {
+	setup();		// Historial en el heap libre
+	for (uint32_t i = 0; i < MUESTRAS; i++) {
+		historial.agregar(millis(), 20 + 10 * sinf(i / 50.0f) + (i % 97 == 0 ? 300 : 0) + (i % 7) * 0.37f);
+		anfitrion_us += PERIODO_MS * 1000;
+	}
+	TransporteMemoria t;
+	ServidorHttp s(t);
+	s.en("/data.bin", handleDataBin);
+	s.en("/json", handleJson);
+	t.pendientes = 1;
+	printf("historial: %zu muestras en %zu bytes\n", historial.cantidad(), historial.bytesUsados());
+
+	uint32_t ahora = millis(), vieja = ahora - historial.cantidad() * PERIODO_MS;
+	verificar_bin(s, t, "/data.bin", vieja, ahora);
+	verificar_bin(s, t, "/data.bin?from=-600000", ahora - 600000, ahora);
+	verificar_bin(s, t, "/data.bin?from=-599500&to=-1", ahora - 599500, ahora - 1);	// Cantidad impar
+	char consulta[64];
+	snprintf(consulta, sizeof(consulta), "/data.bin?from=%lu&to=%lu", (unsigned long)(vieja + 12345), (unsigned long)(vieja + 45678));
+	verificar_bin(s, t, consulta, vieja + 12345, vieja + 45678);
+	verificar_bin(s, t, "/data.bin?from=-100&to=-50", ahora - 100, ahora - 50);		// Vacio
+	verificar_json(s, t, "?from=-600000");
+	verificar_json(s, t, "");
+	printf("/data.bin: cabecera, relleno y muestras iguales al historial; /json con los mismos valores\n");
+
+	const char *tramos[] = { "?from=-600000", "" };
+	for (const char *consulta : tramos) {
+		std::string b = http_cuerpo(pedir(s, t, std::string("/data.bin") + consulta));
+		printf("%s: %lu muestras\n", *consulta ? "ultimos 10 minutos" : "todo el historial", (unsigned long)lee32(b, 4));
+		size_t bin = pedir(s, t, std::string("/data.bin") + consulta).size();
+		medir(s, t, "/data.bin", std::string("/data.bin") + consulta, 0);
+		json_flotante = false;
+		medir(s, t, "JSON centesimos", std::string("/json") + consulta, bin);
+		json_flotante = true;
+		medir(s, t, "JSON %.2f", std::string("/json") + consulta, bin);
+	}
+
+	printf("data_bin: OK\n");
+	return 0;
+}
@@ -0,0 +1,148 @@
+// --- Prueba del historial de muestras (historial.cpp) ---
+// Agrega 5 veces la capacidad en muestras con pasos de ~1 s con ruido,
+// saltos largos (bloque nuevo), pasos nulos y el desborde de millis(), y
+// compara contra una referencia sin cuantizar el tiempo (deque). Verifica:
+//   - valores iguales a los cuantizados y tiempos con error < HIST_DT_MS,
+//     nunca hacia atras
+//   - buscar(t) da la primera muestra con t reconstruido >= t; ultimas(n)
+//   - copiar() da los mismos valores, tambien cruzando el final del anillo,
+//     y 0 desde una muestra borrada
+//   - un cursor guardado a lo largo de todos los agregar() lee cada muestra
+//     una vez y en orden; uno que alcanza el borrado devuelve false
+//   - iniciar() sin memoria suficiente
+// Informa bytes por muestra y mide agregar, buscar y un recorrido completo
+// con dos tamanios: lo que queda en el ESP y 10 veces mas.
+
+#include "anfitrion.h"
+#include "historial.h"
+#include <deque>
+#include <random>
+#include <vector>
+
+#define REPETICIONES	1000	// Entre verificaciones completas
+
+typedef struct {
+	uint32_t t;
+	uint16_t q;
+} muestra_t;
+
+static uint16_t cuantizar(float ppm) {
+	float e = ppm * HIST_ESCALA + 0.5f;
+	return e <= 0.0f ? 0 : e >= 65535.0f ? 65535 : (uint16_t)e;
+}
+
+// Todas las muestras con sus tiempos reconstruidos
+static std::vector<muestra_t> volcar(const Historial &h) {
+	std::vector<muestra_t> v;
+	Historial::Cursor c = h.ultimas(h.cantidad());
+	muestra_t m;
+	while (h.siguiente(c, &m.t, &m.q)) v.push_back(m);
+	return v;
+}
+
+static void verificar(const Historial &h, const std::deque<muestra_t> &ref, std::mt19937 &azar) {
+	std::vector<muestra_t> v = volcar(h);
+	VERIFICAR(v.size() == h.cantidad() && v.size() == ref.size());
+	for (size_t k = 0; k < v.size(); k++) {
+		int32_t error = (int32_t)(ref[k].t - v[k].t);
+		VERIFICAR(v[k].q == ref[k].q && error >= 0 && error < HIST_DT_MS);
+		VERIFICAR(k == 0 || (int32_t)(v[k].t - v[k - 1].t) >= 0);
+	}
+
+	uint32_t primera = h.primeraSeq();
+	VERIFICAR(primera == h.total() - h.cantidad());
+	for (int j = 0; j < 20; j++) {
+		size_t k = azar() % v.size();
+		uint32_t t = v[k].t - azar() % 1500;
+		size_t esperado = 0;
+		while (esperado < v.size() && (int32_t)(v[esperado].t - t) < 0) esperado++;
+		VERIFICAR(h.buscar(t).seq == primera + esperado);
+
+		size_t n = azar() % (v.size() + 10);
+		VERIFICAR(h.ultimas(n).seq == h.total() - (n < v.size() ? n : v.size()));
+
+		// copiar: desde cualquier muestra, por lo general cruzando el final del anillo
+		uint16_t copia[300];
+		size_t m = h.copiar(primera + k, copia, 300);
+		VERIFICAR(m == (v.size() - k < 300 ? v.size() - k : 300));
+		for (size_t i = 0; i < m; i++) VERIFICAR(copia[i] == v[k + i].q);
+	}
+	VERIFICAR(h.buscar(v.back().t + 1).seq == h.total());
+	uint16_t copia;
+	VERIFICAR(h.copiar(primera - 1, &copia, 1) == 0 && h.copiar(h.total(), &copia, 1) == 0);
+}
+
+static void probar(size_t bytes) {
+	Historial h;
+	VERIFICAR(h.iniciar(bytes));
+	printf("%zu bytes: %zu muestras, %zu bytes usados, %.2f bytes por muestra (t y ppm en float: 8)\n",
+			bytes, h.capacidad(), h.bytesUsados(), (double)h.bytesUsados() / h.capacidad());
+	VERIFICAR(h.bytesUsados() <= bytes);
+
+	std::mt19937 azar(1);
+	std::deque<muestra_t> ref;
+	std::vector<muestra_t> seguidas;
+	uint32_t t = 0xFFFFFFFFu - 3600000u;		// millis() desborda a la hora
+	Historial::Cursor guardado = h.ultimas(0);
+	size_t n = h.capacidad() * 5;
+	for (size_t i = 0; i < n; i++) {
+		uint32_t paso = 950 + azar() % 100;
+		if (azar() % 500 == 0) paso = 60000 + azar() % 100000;
+		if (azar() % 300 == 0) paso = 0;
+		t += paso;
+		float ppm = (azar() % 40000) / 10.0f;
+		h.agregar(t, ppm);
+		muestra_t m = { t, cuantizar(ppm) };
+		ref.push_back(m);
+		while (ref.size() > h.cantidad()) ref.pop_front();
+		// El cursor guardado lee lo nuevo en cada vuelta
+		while (h.siguiente(guardado, &m.t, &m.q)) seguidas.push_back(m);
+		if (i % REPETICIONES == REPETICIONES - 1) verificar(h, ref, azar);
+	}
+	VERIFICAR(seguidas.size() == n);
+	for (size_t k = 0; k < ref.size(); k++) VERIFICAR(seguidas[n - ref.size() + k].q == ref[k].q);
+
+	// Cursor alcanzado por el borrado: false en vez de datos de otra vuelta del anillo
+	Historial::Cursor viejo = h.ultimas(h.cantidad());
+	for (size_t i = 0; i < h.capacidad(); i++) h.agregar(t += 1000, 1.0f);
+	uint32_t tt;
+	uint16_t q;
+	VERIFICAR(!h.siguiente(viejo, &tt, &q));
+	printf("  %zu agregados contra la referencia: valores, tiempos, buscar, ultimas, copiar y cursores\n", n);
+
+	// Tiempos
+	uint64_t t0 = ahora_ns();
+	uint32_t agregados = 5000000;
+	for (uint32_t i = 0; i < agregados; i++) h.agregar(t += 1000, (i & 1023) * 0.5f);
+	uint64_t t1 = ahora_ns();
+	uint32_t consultas = 200000;
+	volatile uint32_t suma = 0;
+	for (uint32_t i = 0; i < consultas; i++) {
+		Historial::Cursor c = h.buscar(t - (azar() % h.cantidad()) * 1000);
+		h.siguiente(c, &tt, &q);
+		suma += q;
+	}
+	uint64_t t2 = ahora_ns();
+	uint32_t recorridos = 100;
+	for (uint32_t i = 0; i < recorridos; i++) {
+		Historial::Cursor c = h.ultimas(h.cantidad());
+		while (h.siguiente(c, &tt, &q)) suma += q;
+	}
+	uint64_t t3 = ahora_ns();
+	printf("  agregar %.1f ns, buscar %.2f us, recorrido completo %.3f ms (%.1f ns por muestra)\n",
+			(double)(t1 - t0) / agregados, (t2 - t1) / 1e3 / consultas, (t3 - t2) / 1e6 / recorridos,
+			(double)(t3 - t2) / recorridos / h.cantidad());
+}
+
+int main(void) {
+	Historial h;
+	VERIFICAR(!h.iniciar(0) && !h.iniciar(600) && h.capacidad() == 0);
+	h.agregar(1000, 1.0f);										// Sin memoria: no hace nada
+	VERIFICAR(h.cantidad() == 0 && h.buscar(0).seq == h.total());
+
+	probar(24 * 1024);		// Lo que queda en el ESP con el WiFi y HIST_RESERVA_HEAP
+	probar(240 * 1024);
+
+	printf("historial: OK\n");
+	return 0;
+}
@@ -0,0 +1,229 @@
+// --- Prueba de la reduccion LTTB (lttb.cpp) y de los recorridos resumidos ---
+// Llena el historial con una curva de gas (seno lento, ruido y picos que
+// decaen), con huecos y el desborde de millis(), y compara contra un LTTB de
+// referencia sobre el arreglo de muestras (misma particion en baldes y misma
+// aritmetica en float). Verifica:
+//   - sin resumir, los puntos son identicos a los de la referencia
+//   - resumido, la envolvente (lo, hi) es exacta en cada balde
+//   - se resume solo con baldes de LTTB_RESUMIR_BLOQUES bloques o mas; si
+//     no, el resultado es el de la referencia, y el camino elegido nunca
+//     tarda mas que el recorrido sin resumir
+//   - recorrer() y promedio() hasta el final del historial (e == total()),
+//     con el ultimo bloque todavia abierto: terminan, dejan el cursor en e y
+//     dan el minimo, el maximo y el promedio exactos; igual en tramos que
+//     empiezan o terminan a mitad de un bloque
+// Informa, por tramo y cantidad de puntos, cuantos puntos resumidos coinciden
+// con la referencia, la diferencia media en ppm y el tiempo de cada version
+// (el mejor de INTENTOS).
+
+#include "anfitrion.h"
+#include "lttb.h"
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <vector>
+
+#define INTENTOS		5
+
+typedef struct {
+	uint32_t t;
+	uint16_t q;
+} muestra_t;
+
+// LTTB de referencia sobre el arreglo crudo
+static std::vector<PuntoLttb> referencia(const std::vector<muestra_t> &d, uint32_t puntos) {
+	std::vector<PuntoLttb> r;
+	uint32_t n = d.size();
+	if (puntos < 3) puntos = 3;
+	if (n < puntos) puntos = n;
+	auto limite = [&](uint32_t b) { return 1 + (uint32_t)((uint64_t)b * (n - 2) / (puntos - 2)); };
+	for (uint32_t k = 0; k < puntos; k++) {
+		if (k == 0 || k == puntos - 1) {
+			const muestra_t &m = d[k == 0 ? 0 : n - 1];
+			r.push_back({ m.t, m.q, m.q, m.q });
+			continue;
+		}
+		// Tercer vertice: el promedio del balde siguiente (o la ultima muestra)
+		PuntoLttb a = r.back();
+		uint32_t j = k - 1;
+		float ct, cq;
+		if (j + 1 < puntos - 2) {
+			uint32_t i0 = limite(j + 1), i1 = limite(j + 2);
+			int64_t st = 0;
+			uint32_t sq = 0;
+			for (uint32_t i = i0; i < i1; i++) {
+				st += (int32_t)(d[i].t - a.t_ms);
+				sq += d[i].q;
+			}
+			ct = (float)st / (i1 - i0);
+			cq = (float)sq / (i1 - i0);
+		} else {
+			ct = (float)(int32_t)(d[n - 1].t - a.t_ms);
+			cq = d[n - 1].q;
+		}
+		float mejor = -1.0f, dq = cq - a.q;
+		PuntoLttb p = { 0, 0, 65535, 0 };
+		for (uint32_t i = limite(j); i < limite(j + 1); i++) {
+			float area = fabsf(-ct * ((float)d[i].q - a.q) + (float)(int32_t)(d[i].t - a.t_ms) * dq);
+			if (area > mejor) {
+				mejor = area;
+				p.t_ms = d[i].t;
+				p.q = d[i].q;
+			}
+			p.lo = std::min(p.lo, d[i].q);
+			p.hi = std::max(p.hi, d[i].q);
+		}
+		r.push_back(p);
+	}
+	return r;
+}
+
+static std::vector<muestra_t> volcar(const Historial &h) {
+	std::vector<muestra_t> v;
+	Historial::Cursor c = h.ultimas(h.cantidad());
+	muestra_t m;
+	while (h.siguiente(c, &m.t, &m.q)) v.push_back(m);
+	return v;
+}
+
+static std::vector<PuntoLttb> reducir(const Historial &h, uint32_t desde, uint32_t hasta, uint16_t puntos, bool resumir,
+		bool *resumido = NULL) {
+	std::vector<PuntoLttb> r;
+	Lttb l;
+	l.iniciar(h, desde, hasta, puntos, resumir);
+	if (resumido) *resumido = l.resumido();
+	PuntoLttb p;
+	while (l.siguiente(h, &p)) r.push_back(p);
+	return r;
+}
+
+// ms por repeticion de f(), el mejor de INTENTOS
+template <typename F>
+static double medir(int repeticiones, F f) {
+	double mejor = 1e30;
+	for (int k = 0; k < INTENTOS; k++) {
+		uint64_t t0 = ahora_ns();
+		for (int i = 0; i < repeticiones; i++) f();
+		mejor = std::min(mejor, (ahora_ns() - t0) / 1e6 / repeticiones);
+	}
+	return mejor;
+}
+
+// recorrer() y promedio() de [s, e) contra las muestras d (d[0] es la primera del historial)
+static void verificar_tramo(const Historial &h, const std::vector<muestra_t> &d, uint32_t s, uint32_t e) {
+	uint32_t primera = h.total() - d.size();
+	uint16_t lo = 65535, hi = 0;
+	int64_t suma_t = 0;
+	uint32_t suma = 0;
+	for (uint32_t i = s; i != e; i++) {
+		const muestra_t &m = d[i - primera];
+		lo = std::min(lo, m.q);
+		hi = std::max(hi, m.q);
+		suma_t += (int32_t)(m.t - d[s - primera].t);
+		suma += m.q;
+	}
+
+	for (int resumir = 0; resumir < 2; resumir++) {
+		Historial::Cursor c = h.ultimas(h.total() - s);
+		uint32_t visitas = 0;
+		uint16_t vlo = 65535, vhi = 0;
+		bool en_orden = true;
+		VERIFICAR(h.recorrer(c, e, resumir, [&](uint32_t t, uint16_t q) {
+			if (!resumir) en_orden &= t == d[s + visitas - primera].t && q == d[s + visitas - primera].q;
+			visitas++;
+			vlo = std::min(vlo, q);
+			vhi = std::max(vhi, q);
+		}));
+		VERIFICAR(c.seq == e && en_orden && vlo == lo && vhi == hi);
+		VERIFICAR(resumir ? visitas <= e - s : visitas == e - s);
+	}
+
+	Historial::Cursor c = h.ultimas(h.total() - s);
+	float t, q;
+	VERIFICAR(h.promedio(c, e, d[s - primera].t, &t, &q) && c.seq == e);
+	VERIFICAR(t == (float)suma_t / (e - s) && q == (float)suma / (e - s));
+}
+
+static void probar(size_t bytes) {
+	Historial h;
+	VERIFICAR(h.iniciar(bytes));
+	std::mt19937 azar(7);
+	std::normal_distribution<float> ruido(0.0f, 1.5f);
+	uint32_t t = 0xFFFFFFFFu - 5000000u;		// millis() desborda a la hora y media
+	float pico = 0.0f;
+	for (size_t i = 0; i < h.capacidad() + h.capacidad() / 3; i++) {
+		t += 950 + azar() % 100;
+		if (azar() % 5000 == 0) t += 120000;
+		if (azar() % 2000 == 0) pico = 200 + azar() % 800;
+		pico *= 0.97f;
+		float ppm = 20 + 5 * sinf(i * 1e-4f) + ruido(azar) + pico;
+		h.agregar(t, ppm < 0 ? 0 : ppm);
+	}
+	printf("%zu bytes: %zu muestras\n", bytes, h.cantidad());
+
+	// Tramos hasta el final con el ultimo bloque en distintos llenados, y a
+	// mitad de bloque
+	std::vector<muestra_t> todo;
+	for (uint32_t vuelta = 0; vuelta < 6; vuelta++) {
+		todo = volcar(h);
+		uint32_t fin = h.total(), primera = h.primeraSeq();
+		verificar_tramo(h, todo, primera, fin);
+		verificar_tramo(h, todo, primera + 5, fin);
+		verificar_tramo(h, todo, fin - 1, fin);
+		verificar_tramo(h, todo, primera + 1000, fin - 1);
+		verificar_tramo(h, todo, fin - 3 * HIST_BLOQUE, fin - HIST_BLOQUE / 2);
+		for (uint32_t i = 0; i < 37; i++) h.agregar(t += 1000, 20.0f + i);
+	}
+	todo = volcar(h);
+	printf("  recorrer y promedio hasta total(), con y sin resumir: OK\n");
+
+	const float fracciones[] = { 1.0f, 0.1f, 0.01f };
+	const uint16_t puntos[] = { 100, 500, 2000 };
+	for (float f : fracciones) {
+		for (uint16_t p : puntos) {
+			size_t a = (size_t)(todo.size() * (1 - f) * 0.5f), b = a + (size_t)(todo.size() * f) - 1;
+			uint32_t desde = todo[a].t, hasta = todo[b].t;
+			// El tramo por tiempo incluye las muestras con el mismo t
+			while (a > 0 && todo[a - 1].t == desde) a--;
+			while (b + 1 < todo.size() && todo[b + 1].t == hasta) b++;
+			std::vector<muestra_t> tramo(todo.begin() + a, todo.begin() + b + 1);
+			int repeticiones = f == 1.0f ? 3 : 20;
+
+			std::vector<PuntoLttb> r, o[2];
+			bool resumido;
+			double ms_ref = medir(repeticiones, [&] { r = referencia(tramo, p); });
+			double ms_crudo = medir(repeticiones, [&] { o[0] = reducir(h, desde, hasta, p, false); });
+			double ms_elegido = medir(repeticiones, [&] { o[1] = reducir(h, desde, hasta, p, true, &resumido); });
+
+			// El camino elegido no tarda mas que el directo (con margen por el ruido)
+			VERIFICAR(resumido == ((tramo.size() - 2) / (p - 2) >= LTTB_RESUMIR_BLOQUES * HIST_BLOQUE));
+			if (ms_elegido > ms_crudo * 1.15 + 0.002) {
+				printf("  %zu muestras, %u puntos: elegido %.3f ms, sin resumir %.3f ms\n", tramo.size(), p, ms_elegido, ms_crudo);
+				VERIFICAR(0);
+			}
+			VERIFICAR(o[0].size() == r.size() && o[1].size() == r.size());
+			size_t iguales = 0;
+			double dif = 0, ancho = 0;
+			for (size_t k = 0; k < r.size(); k++) {
+				VERIFICAR(o[0][k].t_ms == r[k].t_ms && o[0][k].q == r[k].q && o[0][k].lo == r[k].lo && o[0][k].hi == r[k].hi);
+				VERIFICAR(o[1][k].lo == r[k].lo && o[1][k].hi == r[k].hi);
+				if (!resumido) VERIFICAR(o[1][k].t_ms == r[k].t_ms && o[1][k].q == r[k].q);
+				iguales += o[1][k].t_ms == r[k].t_ms;
+				dif += fabsf(Historial::aPpm(o[1][k].q) - Historial::aPpm(r[k].q));
+				ancho += Historial::aPpm(r[k].hi) - Historial::aPpm(r[k].lo);
+			}
+			printf("  %6zu muestras, %4u puntos: referencia %7.3f ms, sin resumir %7.3f ms, %s %6.3f ms"
+					" (%5.1f%% iguales, |dif| media %.2f ppm con baldes de %.1f ppm)\n",
+					tramo.size(), p, ms_ref, ms_crudo, resumido ? "resumido" : "directo ", ms_elegido,
+					100.0 * iguales / r.size(), dif / r.size(), ancho / r.size());
+		}
+	}
+}
+
+int main(void) {
+	probar(24 * 1024);		// Lo que queda en el ESP con el WiFi y HIST_RESERVA_HEAP
+	probar(240 * 1024);
+
+	printf("lttb: OK\n");
+	return 0;
+}
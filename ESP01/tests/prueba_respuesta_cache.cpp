@@ -0,0 +1,163 @@
+// --- Prueba de la respuesta memorizada de /data (respuesta_cache.h) ---
+// Primero RespuestaCache sola, con un render que cuenta sus llamadas; despues
+// el handleData del sketch detras de un ServidorHttp con el transporte en
+// memoria, con los datos llegando por la UART como los manda el LPC1769.
+// Verifica:
+//   - un render por version; la misma version no vuelve a serializar
+//   - el ETag "<arranque>-<version>", y uno nuevo al cambiar el arranque
+//   - If-None-Match: el ETag, una lista que lo contiene, "*"; vacio, otro
+//     ETag o antes del primer render no coinciden
+//   - un cuerpo mas largo que el buffer queda truncado y terminado en '\0'
+//   - /data: 200 con el mismo cuerpo que renderCoDataJson, 304 sin cuerpo con
+//     el ETag, 200 con ETag nuevo al llegar un dato; X-Reloj-us en todas
+// Mide peticiones por segundo a /data con el cuerpo serializado en cada
+// peticion (como antes) y memorizado, con un dato nuevo cada DATO_CADA
+// consultas, sin y con If-None-Match, y con todas 304. Solo cuenta el tiempo
+// del servidor: la PC da la relacion entre las formas, no la cifra del ESP.
+
+#include "anfitrion.h"
+#include "memoria.h"
+#include "../ESP01.ino"
+
+#define PETICIONES		100000
+#define DATO_CADA		10
+
+static uint32_t llamadas;
+
+static size_t contar(char *buf, size_t tam) {
+	llamadas++;
+	return snprintf(buf, tam, "{\"n\":%u}", llamadas);
+}
+
+static size_t largo(char *buf, size_t tam) {
+	memset(buf, 'x', tam);
+	buf[tam - 1] = '\0';
+	return tam + 100;
+}
+
+static void cache_sola(void) {
+	RespuestaCache<64> c(0x1234);
+
+	VERIFICAR(!c.noModificada("*"));				// Nada memorizado todavia
+	VERIFICAR(c.actualizar(7, contar) && llamadas == 1);
+	VERIFICAR(!c.actualizar(7, contar) && !c.actualizar(7, contar) && llamadas == 1);
+	VERIFICAR(strcmp(c.cuerpo(), "{\"n\":1}") == 0 && c.largo() == 7);
+	VERIFICAR(strcmp(c.etag(), "\"00001234-7\"") == 0);
+	VERIFICAR(c.actualizar(8, contar) && llamadas == 2 && c.renders() == 2);
+	VERIFICAR(strcmp(c.etag(), "\"00001234-8\"") == 0);
+
+	VERIFICAR(c.noModificada("\"00001234-8\""));
+	VERIFICAR(c.noModificada("\"otro\", \"00001234-8\""));
+	VERIFICAR(c.noModificada("*"));
+	VERIFICAR(!c.noModificada("\"00001234-7\""));
+	VERIFICAR(!c.noModificada(""));
+	VERIFICAR(!c.noModificada(NULL));
+
+	// Reinicio del ESP: la misma version con otro arranque no coincide
+	c.fijarArranque(0xABCD);
+	VERIFICAR(c.actualizar(8, contar) && llamadas == 3);
+	VERIFICAR(strcmp(c.etag(), "\"0000abcd-8\"") == 0 && !c.noModificada("\"00001234-8\""));
+
+	VERIFICAR(c.actualizar(9, largo));
+	VERIFICAR(c.largo() == 63 && c.cuerpo()[63] == '\0');
+	printf("RespuestaCache: un render por version, ETag con arranque, If-None-Match y truncado\n");
+}
+
+// Un dato "U" como lo manda el LPC1769, con su captura 20 ms antes
+static void dato(float ppm) {
+	char linea[40];
+	snprintf(linea, sizeof(linea), "U%.2f@%lu+150\n", ppm, (unsigned long)(micros() - 20000));
+	anfitrion_serie(linea);
+	anfitrion_us += 1000000;
+	handleSerial();
+}
+
+// Como handleData pero serializando en cada peticion
+static void handleDataSinCache(const PeticionHttp &p, RespuestaHttp &r) {
+	(void)p;
+	char cuerpo[DATA_CACHE_TAM];
+	char reloj[12];
+	size_t n = renderCoDataJson(cuerpo, sizeof(cuerpo));
+	snprintf(reloj, sizeof(reloj), "%lu", (unsigned long)micros());
+	r.encabezado("Cache-Control", "no-cache");
+	r.encabezado("X-Reloj-us", reloj);
+	r.tipo("application/json");
+	r.cuerpo(cuerpo, n < sizeof(cuerpo) ? n : sizeof(cuerpo) - 1);
+}
+
+// Peticiones por segundo a 'ruta', contando solo el tiempo del servidor; un
+// dato cada 'cada' (0: nunca) y con el ETag de la respuesta anterior si
+// 'condicional'
+static double medir(ServidorHttp &s, TransporteMemoria &t, const char *ruta, uint32_t cada, bool condicional) {
+	std::string etag;
+	uint64_t ns = 0;
+	for (uint32_t i = 0; i < PETICIONES; i++) {
+		if (cada && i % cada == 0) dato(20.0f + i % 50);
+		t.entrada[0] = std::string("GET ") + ruta + " HTTP/1.1\r\n";
+		if (condicional && !etag.empty()) t.entrada[0] += "If-None-Match: " + etag + "\r\n";
+		t.entrada[0] += "\r\n";
+		uint64_t t0 = ahora_ns();
+		std::string r = http_atender(s, t, millis());
+		ns += ahora_ns() - t0;
+		if (condicional) etag = http_encabezado(r, "ETag");
+	}
+	return PETICIONES / (ns / 1e9);
+}
+
+int main(void) {
+	cache_sola();
+
+	setup();		// Historial en el heap libre y arranque de los ETag
+	TransporteMemoria t;
+	ServidorHttp s(t);
+	s.en("/data", handleData);
+	s.en("/sin_cache", handleDataSinCache);
+	t.pendientes = 1;
+	for (int i = 0; i < DATA_SIZE + 2; i++) dato(10.0f + i);
+	anfitrion_serie("P15.50\n");
+	handleSerial();
+
+	// Primera consulta: 200 con lo mismo que serializa renderCoDataJson
+	char directo[DATA_CACHE_TAM];
+	size_t n = renderCoDataJson(directo, sizeof(directo));
+	t.entrada[0] = "GET /data HTTP/1.1\r\n\r\n";
+	std::string r = http_atender(s, t, millis());
+	std::string etag = http_encabezado(r, "ETag");
+	VERIFICAR(r.compare(0, 15, "HTTP/1.1 200 OK") == 0 && http_cuerpo(r) == std::string(directo, n));
+	VERIFICAR(etag.size() > 2 && !http_encabezado(r, "X-Reloj-us").empty());
+	VERIFICAR(strstr(directo, "\"average\":15.50") && strstr(directo, "\"lat\":{"));
+
+	// Con el ETag: 304 sin cuerpo, y sin volver a serializar
+	uint32_t renders = data_cache.renders();
+	t.entrada[0] = "GET /data HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n";
+	r = http_atender(s, t, millis());
+	VERIFICAR(r.compare(0, 25, "HTTP/1.1 304 Not Modified") == 0 && http_cuerpo(r).empty());
+	VERIFICAR(http_encabezado(r, "ETag") == etag && !http_encabezado(r, "X-Reloj-us").empty());
+	VERIFICAR(data_cache.renders() == renders);
+
+	// Llega un dato: el mismo ETag ya no coincide
+	dato(42.0f);
+	t.entrada[0] = "GET /data HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n";
+	r = http_atender(s, t, millis());
+	VERIFICAR(r.compare(0, 15, "HTTP/1.1 200 OK") == 0 && http_encabezado(r, "ETag") != etag);
+	VERIFICAR(http_cuerpo(r).find("\"latest\":42.00") != std::string::npos);
+	VERIFICAR(data_cache.renders() == renders + 1);
+	printf("/data: 200 igual a renderCoDataJson, 304 con el ETag, ETag nuevo con cada dato\n");
+
+	// Rendimiento
+	renders = data_cache.renders();
+	double sin_cache = medir(s, t, "/sin_cache", DATO_CADA, false);
+	double con_cache = medir(s, t, "/data", DATO_CADA, false);
+	VERIFICAR(data_cache.renders() - renders == PETICIONES / DATO_CADA);
+	double con_304 = medir(s, t, "/data", DATO_CADA, true);
+	double solo_304 = medir(s, t, "/data", 0, true);
+	VERIFICAR(s.stats().no_modificadas >= PETICIONES - 1);
+	printf("/data, un dato cada %u consultas (peticiones/s en la PC):\n", DATO_CADA);
+	printf("  serializando en cada peticion %9.0f\n", sin_cache);
+	printf("  memorizada                    %9.0f (%.1fx)\n", con_cache, con_cache / sin_cache);
+	printf("  memorizada, con If-None-Match %9.0f (%.1fx)\n", con_304, con_304 / sin_cache);
+	printf("  todas 304                     %9.0f (%.1fx)\n", solo_304, solo_304 / sin_cache);
+
+	printf("respuesta_cache: OK\n");
+	return 0;
+}
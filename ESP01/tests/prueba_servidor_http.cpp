@@ -0,0 +1,241 @@
+// --- Prueba de los bordes del servidor HTTP (servidor_http.cpp) ---
+// Clientes simulados con el transporte en memoria; el reloj lo pasa la
+// prueba a servicio(). Verifica:
+//   - pipelining: seis peticiones seguidas en una conexion salen en orden
+//     (200, HEAD sin cuerpo, 404, 405, generador de largo conocido, cuerpo
+//     estatico a un cliente HTTP/1.0, que despues se cierra)
+//   - http_parametro con negativos, ausentes y sin numero
+//   - peticion mas larga que HTTP_TAM_RX: 431 y cierre; con cuerpo: 400 y
+//     cierre
+//   - cuerpo de largo variable: trozos bien formados con HTTP/1.1 y la
+//     conexion sigue; sin trozos y hasta el cierre con HTTP/1.0
+//   - cada servicio() escribe a lo sumo HTTP_PASO bytes por conexion, y
+//     nunca mas de lo que acepta el transporte
+//   - con las ranuras llenas y alguien esperando: "Connection: close" y se
+//     cede la conexion inactiva mas vieja
+//   - una conexion sin peticion o que deja de leer vence a HTTP_INACTIVO_MS
+
+#include "anfitrion.h"
+#include "memoria.h"
+
+#define GRANDE		3000
+#define GENERADO	5000
+
+static std::string grande(GRANDE, 'g');
+
+static size_t letras(uint8_t *buf, size_t tam, size_t offset, void *ctx) {
+	(void)ctx;
+	for (size_t i = 0; i < tam; i++) buf[i] = 'a' + (offset + i) % 26;
+	return tam;
+}
+
+// Trozos de largo variable (1 a 700 bytes) hasta la llamada 40
+static size_t variable(uint8_t *buf, size_t tam, size_t offset, void *ctx) {
+	int &k = *(int *)ctx;
+	if (k == 40) return 0;
+	size_t n = 1 + k * 37 % 700;
+	if (n > tam) n = tam;
+	for (size_t i = 0; i < n; i++) buf[i] = 'A' + (offset + i) % 26;
+	k++;
+	return n;
+}
+
+static std::string variable_esperado(void) {
+	std::string e;
+	uint8_t buf[HTTP_TAM_TX];
+	int k = 0;
+	for (size_t n; (n = variable(buf, sizeof(buf), e.size(), &k)) != 0; ) e.append((char *)buf, n);
+	return e;
+}
+
+static void raiz(const PeticionHttp &p, RespuestaHttp &r) {
+	(void)p;
+	r.tipo("text/html");
+	r.cuerpoEstatico(grande.data(), grande.size());
+}
+
+static void consulta(const PeticionHttp &p, RespuestaHttp &r) {
+	long long desde = 0, hasta = 0;
+	bool ok = http_parametro(p.consulta, "from", &desde) && http_parametro(p.consulta, "to", &hasta);
+	char buf[64];
+	int n = snprintf(buf, sizeof(buf), "%d %lld %lld", ok, desde, hasta);
+	r.cuerpo(buf, n);
+}
+
+static void generado(const PeticionHttp &p, RespuestaHttp &r) {
+	(void)p;
+	int nada = 0;
+	r.generador(GENERADO, letras, &nada, sizeof(nada));
+}
+
+static void flujo(const PeticionHttp &p, RespuestaHttp &r) {
+	(void)p;
+	int k = 0;
+	r.generador(HTTP_LARGO_VARIABLE, variable, &k, sizeof(k));
+}
+
+// Lineas de estado de las respuestas en 's', en orden
+static std::string estados(const std::string &s) {
+	std::string e;
+	for (size_t p = 0; (p = s.find("HTTP/1.1 ", p)) != std::string::npos; p++) {
+		e += s.substr(p + 9, 3) + " ";
+	}
+	return e;
+}
+
+// Saca un cuerpo en trozos de 's' desde 'p'; false si esta mal formado
+static bool destrozar(const std::string &s, size_t &p, std::string *cuerpo) {
+	for (;;) {
+		size_t fin = s.find("\r\n", p);
+		if (fin == std::string::npos) return false;
+		size_t n = strtoul(s.c_str() + p, NULL, 16);
+		p = fin + 2;
+		if (n == 0) {
+			p += 2;
+			return s.compare(p - 2, 2, "\r\n") == 0;
+		}
+		*cuerpo += s.substr(p, n);
+		p += n;
+		if (s.compare(p, 2, "\r\n") != 0) return false;
+		p += 2;
+	}
+}
+
+static void parametros(void) {
+	long long v = 0;
+	VERIFICAR(http_parametro("from=-3&to=7", "from", &v) && v == -3);
+	VERIFICAR(http_parametro("from=-3&to=7", "to", &v) && v == 7);
+	VERIFICAR(http_parametro("xfrom=1&from=2", "from", &v) && v == 2);
+	VERIFICAR(!http_parametro("from=&to=7", "from", &v));
+	VERIFICAR(!http_parametro("to=7", "from", &v));
+	VERIFICAR(!http_parametro("", "from", &v));
+}
+
+int main(void) {
+	TransporteMemoria t;
+	ServidorHttp s(t);
+	s.en("/", raiz);
+	s.en("/q", consulta);
+	s.en("/g", generado);
+	s.en("/v", flujo);
+	uint32_t ahora = 0;
+	parametros();
+
+	// 1. Pipelining
+	t.pendientes = 1;
+	t.entrada[0] = "GET /q?to=7&from=-3 HTTP/1.1\r\nHost: a\r\n\r\n"
+			"HEAD / HTTP/1.1\r\n\r\n"
+			"GET /nada HTTP/1.1\r\n\r\n"
+			"POST /q HTTP/1.1\r\n\r\n"
+			"GET /g HTTP/1.1\r\n\r\n"
+			"GET / HTTP/1.0\r\n\r\n";
+	std::string r = http_atender(s, t, ahora);
+	VERIFICAR(estados(r) == "200 200 404 405 200 200 ");
+	VERIFICAR(r.find("Content-Length: 6\r\nConnection: keep-alive\r\n\r\n1 -3 7") != std::string::npos);
+	// HEAD: el largo del cuerpo pero sin cuerpo; sigue la respuesta siguiente
+	VERIFICAR(r.find("Content-Length: 3000\r\nConnection: keep-alive\r\n\r\nHTTP/1.1 404") != std::string::npos);
+	std::string letras_esperadas;
+	for (int i = 0; i < GENERADO; i++) letras_esperadas += 'a' + i % 26;
+	VERIFICAR(r.find("Content-Length: 5000\r\nConnection: keep-alive\r\n\r\n" + letras_esperadas + "HTTP/1.1 200")
+			!= std::string::npos);
+	VERIFICAR(r.size() > GRANDE && r.compare(r.size() - GRANDE, GRANDE, grande) == 0);
+	VERIFICAR(r.find("Connection: close\r\n\r\n" + grande) != std::string::npos && !t.abierta[0]);
+	printf("pipelining: 6 peticiones en orden (HEAD sin cuerpo, 404, 405), HTTP/1.0 cerrada al final\n");
+
+	// 2. 431 y peticion con cuerpo
+	t.pendientes = 1;
+	t.entrada[0] = std::string(HTTP_TAM_RX + 100, 'x');
+	r = http_atender(s, t, ahora);
+	VERIFICAR(estados(r) == "431 " && !t.abierta[0]);
+	t.pendientes = 1;
+	t.entrada[0] = "GET /q HTTP/1.1\r\nContent-Length: 4\r\n\r\nabcd";
+	r = http_atender(s, t, ahora);
+	VERIFICAR(estados(r) == "400 " && !t.abierta[0]);
+	printf("431 con %u bytes sin fin de encabezados, 400 con cuerpo; las dos cierran\n", HTTP_TAM_RX);
+
+	// 3. Largo variable: en trozos y la conexion sigue
+	t.pendientes = 1;
+	t.entrada[0] = "GET /v HTTP/1.1\r\n\r\nGET /q?from=1&to=2 HTTP/1.1\r\n\r\n";
+	r = http_atender(s, t, ahora);
+	size_t p = r.find("\r\n\r\n");
+	VERIFICAR(p != std::string::npos && r.substr(0, p).find("Transfer-Encoding: chunked") != std::string::npos);
+	VERIFICAR(r.substr(0, p).find("Content-Length") == std::string::npos);
+	std::string cuerpo;
+	p += 4;
+	VERIFICAR(destrozar(r, p, &cuerpo) && cuerpo == variable_esperado());
+	VERIFICAR(r.compare(p, 9, "HTTP/1.1 ") == 0 && r.find("\r\n\r\n1 1 2", p) != std::string::npos && t.abierta[0]);
+	// HTTP/1.0 en la misma conexion: hasta el cierre
+	t.entrada[0] = "GET /v HTTP/1.0\r\n\r\n";
+	r = http_atender(s, t, ahora);
+	p = r.find("\r\n\r\n");
+	VERIFICAR(r.substr(0, p).find("Transfer-Encoding") == std::string::npos);
+	VERIFICAR(r.substr(p + 4) == variable_esperado() && !t.abierta[0]);
+	printf("largo variable: %zu bytes en trozos y sigue la conexion; con HTTP/1.0 hasta el cierre\n", cuerpo.size());
+
+	// 4. Trabajo acotado por vuelta: HTTP_PASO bytes por conexion
+	t.pendientes = 1;
+	t.entrada[0] = "GET /g HTTP/1.1\r\n\r\n";
+	size_t antes = 0, max_vuelta = 0;
+	for (int i = 0; i < 100; i++) {
+		s.servicio(ahora);
+		if (t.salida[0].size() - antes > max_vuelta) max_vuelta = t.salida[0].size() - antes;
+		antes = t.salida[0].size();
+	}
+	VERIFICAR(max_vuelta == HTTP_PASO && http_cuerpo(t.salida[0]) == letras_esperadas);
+	// Ventana de envio chica: nunca mas de lo que acepta el transporte
+	t.salida[0].clear();
+	t.entrada[0] = "GET / HTTP/1.1\r\n\r\n";
+	antes = max_vuelta = 0;
+	for (int i = 0; i < 100; i++) {
+		t.ventana = 100;			// Lo que lwIP libero desde la vuelta anterior
+		s.servicio(ahora);
+		if (t.salida[0].size() - antes > max_vuelta) max_vuelta = t.salida[0].size() - antes;
+		antes = t.salida[0].size();
+	}
+	VERIFICAR(max_vuelta == 100 && http_cuerpo(t.salida[0]) == grande);
+	t.ventana = (size_t)-1;
+	printf("a lo sumo %u bytes por conexion y por vuelta; respeta la ventana del transporte\n", HTTP_PASO);
+
+	// 5. Ranuras llenas: la conexion 0 sigue abierta; se llenan las otras
+	t.pendientes = HTTP_MAX_CONEX - 1;
+	for (int i = 0; i < HTTP_MAX_CONEX; i++) s.servicio(ahora);
+	VERIFICAR(s.stats().activas == HTTP_MAX_CONEX);
+	uint32_t lleno = ahora;									// Ultima actividad de 0, 2 y 3
+	ahora += 100;
+	t.entrada[1] = "GET /q HTTP/1.1\r\n\r\n";
+	t.pendientes = 1;										// Alguien espera
+	s.servicio(ahora);
+	VERIFICAR(http_encabezado(t.salida[1], "Connection") == "close" && !t.abierta[1]);
+	// Ranura 1 libre: entra el que esperaba
+	s.servicio(ahora);
+	VERIFICAR(t.pendientes == 0 && t.abierta[1]);
+	// Todas ocupadas otra vez; la mas vieja inactiva (0) se cede
+	uint32_t desalojos = s.stats().desalojos;
+	t.pendientes = 1;
+	s.servicio(lleno + HTTP_DESALOJO_MS - 1);
+	VERIFICAR(t.pendientes == 1);							// Ninguna inactiva lo suficiente
+	s.servicio(lleno + HTTP_DESALOJO_MS);
+	VERIFICAR(t.pendientes == 0 && t.abierta[0] && s.stats().desalojos == desalojos + 1);
+	printf("ranuras llenas: Connection: close y se cede la inactiva mas vieja\n");
+
+	// 6. Vencimiento: sin peticion y sin leer la respuesta
+	for (int i = 0; i < HTTP_MAX_CONEX; i++) t.cerrar(i);
+	ahora += 1000;
+	for (int i = 0; i < 3; i++) s.servicio(ahora);
+	VERIFICAR(s.stats().activas == 0);
+	uint32_t vencidas = s.stats().vencidas;
+	t.pendientes = 2;
+	s.servicio(ahora);
+	s.servicio(ahora);
+	t.ventana = 0;											// El cliente no lee
+	t.entrada[1] = "GET / HTTP/1.1\r\n\r\n";
+	s.servicio(ahora);
+	s.servicio(ahora + HTTP_INACTIVO_MS - 1);
+	VERIFICAR(t.abierta[0] && t.abierta[1]);
+	s.servicio(ahora + HTTP_INACTIVO_MS + 10);
+	VERIFICAR(!t.abierta[0] && !t.abierta[1] && s.stats().vencidas == vencidas + 2);
+	printf("sin peticion o sin leer: cerradas a los %u ms\n", HTTP_INACTIVO_MS);
+
+	printf("servidor_http: OK\n");
+	return 0;
+}
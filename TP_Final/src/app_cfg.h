@@ -0,0 +1,24 @@
+#ifndef APP_CFG_H_
+#define APP_CFG_H_
+
+// --- Seleccion de subsistemas opcionales ---
+// Cada uno necesita hardware adicional conectado a la placa. Poner en 0 los
+// que no se usen para liberar pines, canales DMA y memoria.
+
+#define APP_USE_SD_LOG			1	// Tarjeta SD por SSP0: P0.15 SCK, P0.16 CS, P0.17 MISO, P0.18 MOSI
+#define APP_USE_ETH				1	// Telemetria UDP por el EMAC: P1.0-P1.17 (RMII) y PHY de la placa
+#define APP_USE_CAN				1	// Red de monitores por CAN1: P0.0 RD1, P0.1 TD1 (transceptor externo)
+#define APP_CAN_CONCENTRADOR	0	// 1 = este equipo recibe y tabula los demas nodos
+#define APP_USE_MODBUS			1	// Esclavo Modbus RTU por RS-485: P2.0 TXD1, P2.1 RXD1, P2.5 DTR1 (DE/RE)
+#define APP_USE_PERFIL			0	// Perfilador por muestreo (SysTick) con UART3 de diagnostico: P0.25 TXD3, P0.26 RXD3
+#define APP_USE_TRAZA			0	// Registro de eventos con marca de tiempo (traza.h), leido con el depurador
+#define APP_USE_BITACORA		0	// Bitacora binaria (bitacora.h) por la UART3 de diagnostico: P0.25 TXD3
+
+#if APP_USE_PERFIL && APP_USE_BITACORA
+#error "El perfilador y la bitacora comparten la UART3: habilitar uno solo"
+#endif
+
+// --- Ubicacion del codigo ---
+#define APP_USE_RAMFUNC			1	// Interrupciones y conversion en RamLoc32 (secciones.h); 0 = todo en flash
+
+#endif /* APP_CFG_H_ */
@@ -0,0 +1,228 @@
+#ifndef ATOMICO_H_
+#define ATOMICO_H_
+
+#include <stdint.h>
+#include "secciones.h"
+
+// --- Primitivas sin bloqueo ---
+// En el Cortex-M3 se implementan con LDREX/STREX (core_cmInstr.h): si una
+// interrupcion se mete entre la lectura y la escritura, el STREX falla y se
+// reintenta, sin deshabilitar interrupciones. Compilado fuera del micro usa
+// atomicos de C11, de modo que los mismos algoritmos (colas y seqlock) se
+// pueden ejercitar con hilos en una PC.
+//
+// Las colas solo manejan indices: el dato vive en un arreglo del usuario del
+// mismo tamanio (potencia de 2), que se escribe entre reservar y publicar.
+
+#if defined(__arm__) && !defined(ATOMICO_C11)
+
+#include "lpc17xx.h"
+
+typedef volatile uint32_t atomico_u32_t;
+
+#define atomico_barrera()			__DMB()
+
+EN_LINEA uint32_t atomico_leer(atomico_u32_t *p){
+	return *p;
+}
+
+EN_LINEA void atomico_escribir(atomico_u32_t *p, uint32_t v){
+	__DMB();
+	*p = v;
+}
+
+// Devuelve el valor nuevo
+EN_LINEA uint32_t atomico_sumar(atomico_u32_t *p, uint32_t v){
+	uint32_t nuevo;
+	do{
+		nuevo = __LDREXW(p) + v;
+	} while(__STREXW(nuevo, p));
+	return nuevo;
+}
+
+// Devuelve el valor anterior
+EN_LINEA uint32_t atomico_intercambiar(atomico_u32_t *p, uint32_t v){
+	uint32_t viejo;
+	do{
+		viejo = __LDREXW(p);
+	} while(__STREXW(v, p));
+	return viejo;
+}
+
+EN_LINEA uint8_t atomico_cas(atomico_u32_t *p, uint32_t esperado, uint32_t nuevo){
+	do{
+		if(__LDREXW(p) != esperado){
+			__CLREX();
+			return 0;
+		}
+	} while(__STREXW(nuevo, p));
+	return 1;
+}
+
+// Alias de bit-band: cada bit de la SRAM (0x20000000-0x200FFFFF, incluye la
+// RAM AHB y los GPIO) y de los perifericos APB (0x40000000-0x400FFFFF) tiene
+// una palabra propia; escribirla modifica solo ese bit, en una transaccion.
+#define BITBAND_SRAM(dir, bit)		(*(volatile uint32_t *)(0x22000000UL + (((uint32_t)(dir) - 0x20000000UL) << 5) + ((bit) << 2)))
+#define BITBAND_PERIF(dir, bit)		(*(volatile uint32_t *)(0x42000000UL + (((uint32_t)(dir) - 0x40000000UL) << 5) + ((bit) << 2)))
+
+#else
+
+#include <stdatomic.h>
+
+typedef _Atomic uint32_t atomico_u32_t;
+
+#define atomico_barrera()			atomic_thread_fence(memory_order_seq_cst)
+
+EN_LINEA uint32_t atomico_leer(atomico_u32_t *p){
+	return atomic_load_explicit(p, memory_order_acquire);
+}
+
+EN_LINEA void atomico_escribir(atomico_u32_t *p, uint32_t v){
+	atomic_store_explicit(p, v, memory_order_release);
+}
+
+EN_LINEA uint32_t atomico_sumar(atomico_u32_t *p, uint32_t v){
+	return atomic_fetch_add(p, v) + v;
+}
+
+EN_LINEA uint32_t atomico_intercambiar(atomico_u32_t *p, uint32_t v){
+	return atomic_exchange(p, v);
+}
+
+EN_LINEA uint8_t atomico_cas(atomico_u32_t *p, uint32_t esperado, uint32_t nuevo){
+	return atomic_compare_exchange_strong(p, &esperado, nuevo);
+}
+
+#endif
+
+// --- Banderas ---
+
+EN_LINEA void atomico_bandera_poner(atomico_u32_t *f){
+	atomico_escribir(f, 1);
+}
+
+// Devuelve 1 si estaba puesta, y la deja en 0
+EN_LINEA uint8_t atomico_bandera_tomar(atomico_u32_t *f){
+	return atomico_intercambiar(f, 0) != 0;
+}
+
+// --- Seqlock: un escritor, lectores que reintentan ---
+// El contador es impar mientras el escritor modifica los datos.
+
+typedef struct {
+	atomico_u32_t seq;
+} seqlock_t;
+
+EN_LINEA void seqlock_escribir_inicio(seqlock_t *s){
+	atomico_escribir(&s->seq, atomico_leer(&s->seq) + 1);
+	atomico_barrera();
+}
+
+EN_LINEA void seqlock_escribir_fin(seqlock_t *s){
+	atomico_barrera();
+	atomico_escribir(&s->seq, atomico_leer(&s->seq) + 1);
+}
+
+EN_LINEA uint32_t seqlock_leer_inicio(const seqlock_t *s){
+	uint32_t seq;
+	while((seq = atomico_leer((atomico_u32_t *)&s->seq)) & 1);
+	atomico_barrera();
+	return seq;
+}
+
+// Devuelve 1 si hubo una escritura durante la lectura
+EN_LINEA uint8_t seqlock_reintentar(const seqlock_t *s, uint32_t seq){
+	atomico_barrera();
+	return atomico_leer((atomico_u32_t *)&s->seq) != seq;
+}
+
+// --- Cola SPSC: un productor y un consumidor ---
+
+typedef struct {
+	atomico_u32_t cabeza;		// Solo la escribe el productor
+	atomico_u32_t cola;			// Solo la escribe el consumidor
+	uint32_t mascara;
+} cola_spsc_t;
+
+#define COLA_SPSC_INIT(n)		{0, 0, (n) - 1}
+
+// Indice libre para escribir, o -1 si esta llena
+EN_LINEA int32_t cola_spsc_reservar(cola_spsc_t *c){
+	uint32_t cab = atomico_leer(&c->cabeza);
+	if(cab - atomico_leer(&c->cola) > c->mascara) return -1;
+	return (int32_t)(cab & c->mascara);
+}
+
+EN_LINEA void cola_spsc_publicar(cola_spsc_t *c){
+	atomico_escribir(&c->cabeza, atomico_leer(&c->cabeza) + 1);
+}
+
+// Indice del elemento mas viejo, o -1 si esta vacia
+EN_LINEA int32_t cola_spsc_siguiente(cola_spsc_t *c){
+	uint32_t co = atomico_leer(&c->cola);
+	if(co == atomico_leer(&c->cabeza)) return -1;
+	atomico_barrera();
+	return (int32_t)(co & c->mascara);
+}
+
+EN_LINEA void cola_spsc_liberar(cola_spsc_t *c){
+	atomico_escribir(&c->cola, atomico_leer(&c->cola) + 1);
+}
+
+// --- Cola MPSC acotada: varios productores (p. ej. interrupciones de
+// distinta prioridad) y un consumidor. Cada posicion lleva un numero de
+// secuencia que indica si ya fue publicada (algoritmo de D. Vyukov).
+
+typedef struct {
+	atomico_u32_t cabeza;
+	atomico_u32_t cola;
+	uint32_t mascara;
+	atomico_u32_t *seq;			// Un contador por posicion
+} cola_mpsc_t;
+
+EN_LINEA void cola_mpsc_init(cola_mpsc_t *c, atomico_u32_t *seq, uint32_t n){
+	c->mascara = n - 1;
+	c->seq = seq;
+	for(uint32_t i = 0; i < n; i++) atomico_escribir(&seq[i], i);
+	atomico_escribir(&c->cabeza, 0);
+	atomico_escribir(&c->cola, 0);
+}
+
+// Reserva una posicion (devuelve su indice, o -1 si esta llena) y deja en
+// *pos el numero que hay que pasar a cola_mpsc_publicar()
+EN_LINEA int32_t cola_mpsc_reservar(cola_mpsc_t *c, uint32_t *pos){
+	uint32_t p = atomico_leer(&c->cabeza);
+	for(;;){
+		int32_t dif = (int32_t)(atomico_leer(&c->seq[p & c->mascara]) - p);
+		if(dif == 0){
+			if(atomico_cas(&c->cabeza, p, p + 1)) break;
+			p = atomico_leer(&c->cabeza);
+		} else if(dif < 0){
+			return -1;
+		} else{
+			p = atomico_leer(&c->cabeza);
+		}
+	}
+	*pos = p;
+	return (int32_t)(p & c->mascara);
+}
+
+EN_LINEA void cola_mpsc_publicar(cola_mpsc_t *c, uint32_t pos){
+	atomico_escribir(&c->seq[pos & c->mascara], pos + 1);
+}
+
+// Indice del siguiente elemento publicado, o -1 si no hay
+EN_LINEA int32_t cola_mpsc_siguiente(cola_mpsc_t *c){
+	uint32_t p = atomico_leer(&c->cola);
+	if(atomico_leer(&c->seq[p & c->mascara]) != p + 1) return -1;
+	atomico_barrera();
+	return (int32_t)(p & c->mascara);
+}
+
+EN_LINEA void cola_mpsc_liberar(cola_mpsc_t *c){
+	uint32_t p = atomico_leer(&c->cola);
+	atomico_escribir(&c->seq[p & c->mascara], p + c->mascara + 1);
+	atomico_escribir(&c->cola, p + 1);
+}
+
+#endif /* ATOMICO_H_ */
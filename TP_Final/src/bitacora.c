@@ -0,0 +1,111 @@
+#include "bitacora.h"
+#include "lpc17xx_uart.h"
+#include "tiempo.h"
+#include <string.h>
+
+// Tabla de llamadas armada por el enlazador con la seccion 'bitacora_fmt'.
+// Debil: sin ninguna llamada (APP_USE_BITACORA en 0) la seccion no existe.
+extern const bitacora_sitio_t __start_bitacora_fmt[] __attribute__((weak));
+
+static uint8_t tx_buf[BITACORA_TAM];
+static volatile uint32_t tx_cabeza = 0;		// Escriben los mensajes (cualquier prioridad)
+static volatile uint32_t tx_cola = 0;		// Lee bitacora_service
+static bitacora_stats_t stats;
+
+// Tiempos de la ultima trama enviada y de la ultima con el tiempo completo
+static uint32_t t_anterior;
+static uint32_t t_absoluto;
+static uint8_t absoluto_pendiente;			// La proxima va con el tiempo completo
+
+void bitacora_init(void){
+	UART_CFG_Type cfg;
+	UART_FIFO_CFG_Type fifo;
+
+	tx_cabeza = tx_cola = 0;
+	memset(&stats, 0, sizeof(stats));
+	absoluto_pendiente = 1;
+
+	UART_ConfigStructInit(&cfg);
+	cfg.Baud_rate = BITACORA_BAUD;
+	UART_Init(LPC_UART3, &cfg);
+	UART_FIFOConfigStructInit(&fifo);
+	UART_FIFOConfig(LPC_UART3, &fifo);
+	UART_TxCmd(LPC_UART3, ENABLE);
+}
+
+// Desde el lazo principal: la UART3 se llena por sondeo, sin interrupcion
+void bitacora_service(void){
+	if(!(LPC_UART3->LSR & UART_LSR_THRE)) return;
+	for(uint8_t i = 0; i < UART_TX_FIFO_SIZE && tx_cola != tx_cabeza; i++){
+		LPC_UART3->THR = tx_buf[tx_cola];
+		tx_cola = (tx_cola + 1) & (BITACORA_TAM - 1);
+	}
+}
+
+const bitacora_stats_t *bitacora_get_stats(void){
+	return &stats;
+}
+
+static inline void escribir(bitacora_msj_t *m, uint8_t b){
+	if(m->desborde) return;
+	if(((m->pos + 1) & (BITACORA_TAM - 1)) == tx_cola){
+		m->desborde = 1;
+		return;
+	}
+	tx_buf[m->pos] = b;
+	m->pos = (m->pos + 1) & (BITACORA_TAM - 1);
+	m->suma += b;
+}
+
+void bitacora_u8(bitacora_msj_t *m, uint8_t v){
+	escribir(m, v);
+}
+
+void bitacora_u32(bitacora_msj_t *m, uint32_t v){
+	while(v >= 0x80){
+		escribir(m, (uint8_t)v | 0x80);
+		v >>= 7;
+	}
+	escribir(m, (uint8_t)v);
+}
+
+void bitacora_i32(bitacora_msj_t *m, int32_t v){
+	bitacora_u32(m, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+void bitacora_abrir(bitacora_msj_t *m, const bitacora_sitio_t *sitio){
+	m->primask = __get_PRIMASK();
+	__disable_irq();
+	m->pos = tx_cabeza;
+	m->desborde = 0;
+	m->suma = 0;
+	m->t = tiempo_us();
+	m->absoluto = absoluto_pendiente || m->t - t_absoluto >= BITACORA_SINCRO_US;
+	escribir(m, m->absoluto ? BITACORA_SINCRO_ABS : BITACORA_SINCRO);
+	bitacora_u32(m, (uint32_t)(sitio - __start_bitacora_fmt));
+	if(m->absoluto){
+		for(uint8_t i = 0; i < 32; i += 8) escribir(m, (uint8_t)(m->t >> i));
+	} else{
+		bitacora_u32(m, m->t - t_anterior);
+	}
+}
+
+void bitacora_cerrar(bitacora_msj_t *m){
+	escribir(m, m->suma);
+	if(m->desborde){
+		// Buffer lleno (UART saturada o recien conectada): la proxima lleva
+		// el tiempo completo para que el lector retome la hora enseguida
+		stats.descartados++;
+		absoluto_pendiente = 1;
+	} else{
+		stats.bytes += (m->pos - tx_cabeza) & (BITACORA_TAM - 1);
+		stats.mensajes++;
+		tx_cabeza = m->pos;
+		t_anterior = m->t;
+		if(m->absoluto){
+			t_absoluto = m->t;
+			absoluto_pendiente = 0;
+		}
+	}
+	__set_PRIMASK(m->primask);
+}
@@ -0,0 +1,141 @@
+#ifndef BITACORA_H_
+#define BITACORA_H_
+
+#include "lpc17xx.h"
+#include "app_cfg.h"
+
+// --- Bitacora binaria con formato diferido ---
+// Cada llamada a BITACORA() registra en tiempo de compilacion su texto de
+// formato, archivo, linea y tipos de argumento en la seccion 'bitacora_fmt'
+// (queda en flash, el enlazador define __start_/__stop_bitacora_fmt). En
+// ejecucion solo se envia el numero de ese registro y los argumentos en
+// binario; tools/bitacora.py lee la tabla del .axf y arma el texto en la PC.
+//
+// Trama por la UART3 de diagnostico, P0.25 TXD3:
+//   0xA5, id, diferencia de tiempo_us() con la trama anterior, argumentos, suma
+//   0xA6, id, tiempo_us() completo (4 bytes, little endian), argumentos, suma
+// El id, la diferencia y los argumentos de 16 y 32 bits van como varint (7
+// bits por byte, el bit alto indica que sigue otro; los con signo en zigzag);
+// los de 8 bits, tal cual. La suma es la suma modulo 256 de toda la trama; el
+// lector se resincroniza con ella si se pierden bytes.
+//
+// Las diferencias encadenan cada trama con la anterior: si el lector pierde
+// una, no sabe la hora hasta la proxima trama 0xA6. Va con el tiempo completo
+// la primera trama, la primera despues de un mensaje descartado y la primera
+// pasados BITACORA_SINCRO_US desde la ultima con tiempo completo.
+//
+// El formato admite %u %d %x %c (con ancho, p. ej. %04x) y hasta
+// BITACORA_MAX_ARGS argumentos enteros de hasta 32 bits. Los tipos salen de
+// los argumentos (_Generic): un tipo no previsto no compila.
+//   BITACORA("alarma %u -> %u (%u ppm)", anterior, nuevo, ppm);
+// Sin APP_USE_BITACORA las llamadas no generan codigo ni ocupan flash.
+
+#define BITACORA_TAM			512		// Buffer de TX, potencia de 2
+#define BITACORA_BAUD			115200
+#define BITACORA_SINCRO			0xA5	// Trama con diferencia de tiempo
+#define BITACORA_SINCRO_ABS		0xA6	// Trama con el tiempo completo
+#define BITACORA_SINCRO_US		10000000UL
+#define BITACORA_MAX_ARGS		6
+
+// Codigos de tipo, 4 bits por argumento en bitacora_sitio_t.tipos
+#define BITACORA_U8				1
+#define BITACORA_U16			2
+#define BITACORA_U32			3
+#define BITACORA_I8				4
+#define BITACORA_I16			5
+#define BITACORA_I32			6
+
+typedef struct {
+	const char *formato;
+	const char *archivo;
+	uint16_t linea;
+	uint16_t reservado;
+	uint32_t tipos;			// Codigo del argumento i en los bits 4i..4i+3; 0 = no hay mas
+} bitacora_sitio_t;
+
+// Mensaje en armado: se escribe directo en el buffer de TX con las
+// interrupciones deshabilitadas entre abrir y cerrar
+typedef struct {
+	uint32_t pos;
+	uint32_t primask;
+	uint32_t t;
+	uint8_t suma;
+	uint8_t desborde;
+	uint8_t absoluto;
+} bitacora_msj_t;
+
+typedef struct {
+	uint32_t mensajes;
+	uint32_t bytes;
+	uint32_t descartados;	// Mensajes sin lugar en el buffer
+} bitacora_stats_t;
+
+void bitacora_init(void);
+void bitacora_service(void);
+const bitacora_stats_t *bitacora_get_stats(void);
+
+void bitacora_abrir(bitacora_msj_t *m, const bitacora_sitio_t *sitio);
+void bitacora_cerrar(bitacora_msj_t *m);
+void bitacora_u8(bitacora_msj_t *m, uint8_t v);
+void bitacora_u32(bitacora_msj_t *m, uint32_t v);	// Varint
+void bitacora_i32(bitacora_msj_t *m, int32_t v);	// Varint en zigzag
+
+#define BITACORA_TIPO(x) _Generic((x), \
+	char: BITACORA_U8, \
+	unsigned char: BITACORA_U8, \
+	signed char: BITACORA_I8, \
+	unsigned short: BITACORA_U16, \
+	short: BITACORA_I16, \
+	unsigned int: BITACORA_U32, \
+	unsigned long: BITACORA_U32, \
+	int: BITACORA_I32, \
+	long: BITACORA_I32)
+
+#define BITACORA_ARG(m, x) _Generic((x), \
+	char: bitacora_u8, \
+	unsigned char: bitacora_u8, \
+	signed char: bitacora_u8, \
+	unsigned short: bitacora_u32, \
+	short: bitacora_i32, \
+	unsigned int: bitacora_u32, \
+	unsigned long: bitacora_u32, \
+	int: bitacora_i32, \
+	long: bitacora_i32)((m), (x))
+
+#define BITACORA_T0()					0
+#define BITACORA_T1(a)					BITACORA_TIPO(a)
+#define BITACORA_T2(a, b)				BITACORA_T1(a) | (BITACORA_TIPO(b) << 4)
+#define BITACORA_T3(a, b, c)			BITACORA_T2(a, b) | (BITACORA_TIPO(c) << 8)
+#define BITACORA_T4(a, b, c, d)			BITACORA_T3(a, b, c) | (BITACORA_TIPO(d) << 12)
+#define BITACORA_T5(a, b, c, d, e)		BITACORA_T4(a, b, c, d) | (BITACORA_TIPO(e) << 16)
+#define BITACORA_T6(a, b, c, d, e, f)	BITACORA_T5(a, b, c, d, e) | (BITACORA_TIPO(f) << 20)
+
+#define BITACORA_A0(m)					((void)(m))
+#define BITACORA_A1(m, a)				BITACORA_ARG(m, a)
+#define BITACORA_A2(m, a, ...)			BITACORA_ARG(m, a); BITACORA_A1(m, __VA_ARGS__)
+#define BITACORA_A3(m, a, ...)			BITACORA_ARG(m, a); BITACORA_A2(m, __VA_ARGS__)
+#define BITACORA_A4(m, a, ...)			BITACORA_ARG(m, a); BITACORA_A3(m, __VA_ARGS__)
+#define BITACORA_A5(m, a, ...)			BITACORA_ARG(m, a); BITACORA_A4(m, __VA_ARGS__)
+#define BITACORA_A6(m, a, ...)			BITACORA_ARG(m, a); BITACORA_A5(m, __VA_ARGS__)
+
+// Elige la variante segun la cantidad de argumentos (0 a 6)
+#define BITACORA_ELEGIR(_0, _1, _2, _3, _4, _5, _6, N, ...)	N
+#define BITACORA_TIPOS(...)		(BITACORA_ELEGIR(_, ##__VA_ARGS__, BITACORA_T6, BITACORA_T5, \
+	BITACORA_T4, BITACORA_T3, BITACORA_T2, BITACORA_T1, BITACORA_T0)(__VA_ARGS__))
+#define BITACORA_ARGS(m, ...)	BITACORA_ELEGIR(_, ##__VA_ARGS__, BITACORA_A6, BITACORA_A5, \
+	BITACORA_A4, BITACORA_A3, BITACORA_A2, BITACORA_A1, BITACORA_A0)(m, ##__VA_ARGS__)
+
+#if APP_USE_BITACORA
+#define BITACORA(formato, ...)	do{ \
+	static const bitacora_sitio_t __attribute__((section("bitacora_fmt"), used, aligned(4))) sitio_ = \
+		{ (formato), __FILE__, __LINE__, 0, BITACORA_TIPOS(__VA_ARGS__) }; \
+	bitacora_msj_t m_; \
+	bitacora_abrir(&m_, &sitio_); \
+	BITACORA_ARGS(&m_, ##__VA_ARGS__); \
+	bitacora_cerrar(&m_); \
+} while(0)
+#else
+#define BITACORA(formato, ...)	((void)0)
+#endif
+
+#endif /* BITACORA_H_ */
@@ -0,0 +1,72 @@
+#include "can_net.h"
+
+// Modelo de la red CAN. No usa registros del micro, asi se puede compilar en
+// una PC (gcc can_modelo.c) junto con un generador de trafico sobre vcan.
+
+#define PERIODO_MUESTRA_US		1000000UL		// 1 muestra por segundo
+#define PERIODO_ALARMA_US		1000000UL		// Un cambio de estado como maximo por muestra
+#define PERIODO_PROMEDIO_US		13000000UL		// Ciclo vivo (10 s) + promedio (3 s)
+
+// Bits de una trama estandar en el peor caso de relleno de bits
+uint32_t can_modelo_bits_trama(uint8_t largo){
+	uint32_t d = 8u * largo;
+	return d + 47u + (34u + d - 1u) / 4u;
+}
+
+uint32_t can_modelo_carga_pmil(const can_flujo_t *flujos, uint32_t n, uint32_t baud){
+	uint64_t ns_bit = 1000000000ULL / baud;
+	uint64_t suma = 0;	// Utilizacion * 1e6
+
+	for(uint32_t i = 0; i < n; i++){
+		uint64_t c_ns = can_modelo_bits_trama(flujos[i].largo) * ns_bit;
+		suma += (c_ns * 1000ULL) / flujos[i].periodo_us;
+	}
+	return (uint32_t)(suma / 1000ULL);
+}
+
+// Peor tiempo de respuesta de la trama idx, desde que se encola hasta que
+// termina de transmitirse. Devuelve UINT32_MAX si no se cumple su periodo.
+uint32_t can_modelo_latencia_us(const can_flujo_t *flujos, uint32_t n, uint32_t idx, uint32_t baud){
+	uint64_t ns_bit = 1000000000ULL / baud;
+	uint64_t c = can_modelo_bits_trama(flujos[idx].largo) * ns_bit;
+	uint64_t bloqueo = 0;
+
+	for(uint32_t k = 0; k < n; k++){
+		uint64_t ck = can_modelo_bits_trama(flujos[k].largo) * ns_bit;
+		if(flujos[k].id > flujos[idx].id && ck > bloqueo) bloqueo = ck;
+	}
+
+	uint64_t limite = (uint64_t)flujos[idx].periodo_us * 1000ULL;
+	uint64_t w = bloqueo, w_ant;
+	do{
+		w_ant = w;
+		w = bloqueo;
+		for(uint32_t j = 0; j < n; j++){
+			if(flujos[j].id >= flujos[idx].id) continue;
+			uint64_t tj = (uint64_t)flujos[j].periodo_us * 1000ULL;
+			uint64_t cj = can_modelo_bits_trama(flujos[j].largo) * ns_bit;
+			w += ((w_ant + ns_bit + tj - 1) / tj) * cj;
+		}
+		if(w + c > limite) return UINT32_MAX;
+	} while(w != w_ant);
+
+	return (uint32_t)((w + c + 999ULL) / 1000ULL);
+}
+
+// Carga y latencias de una red de 'nodos' monitores con el trafico de TP_Final
+void can_modelo_red(uint32_t nodos, uint32_t baud, can_modelo_t *res){
+	can_flujo_t flujos[3 * 63];
+	uint32_t n = 0;
+
+	if(nodos > 63) nodos = 63;
+	for(uint32_t nodo = 1; nodo <= nodos; nodo++){
+		flujos[n++] = (can_flujo_t){CAN_ID(CAN_CLASE_ALARMA, nodo), 8, PERIODO_ALARMA_US};
+		flujos[n++] = (can_flujo_t){CAN_ID(CAN_CLASE_PROMEDIO, nodo), 8, PERIODO_PROMEDIO_US};
+		flujos[n++] = (can_flujo_t){CAN_ID(CAN_CLASE_MUESTRA, nodo), 8, PERIODO_MUESTRA_US};
+	}
+
+	// El ultimo nodo es el de menor prioridad dentro de cada clase
+	res->carga_pmil = can_modelo_carga_pmil(flujos, n, baud);
+	res->latencia_alarma_us = n ? can_modelo_latencia_us(flujos, n, n - 3, baud) : 0;
+	res->latencia_muestra_us = n ? can_modelo_latencia_us(flujos, n, n - 1, baud) : 0;
+}
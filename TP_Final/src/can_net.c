@@ -0,0 +1,133 @@
+#include "can_net.h"
+#include "lpc17xx.h"
+#include "lpc17xx_can.h"
+#include "flash_log.h"
+#include "traza.h"
+#include <string.h>
+
+static can_nodo_t nodos[CAN_NET_MAX_NODOS];
+static can_stats_t stats;
+static uint8_t can_ok = 0;
+static uint8_t seq_tx = 0;
+
+// Una entrada de grupo por clase: todos los nodos 1..CAN_NET_MAX_NODOS.
+// El filtro exige las entradas ordenadas por ID ascendente.
+static SFF_GPR_Entry grupos[] = {
+	{CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_ALARMA, 1),   CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_ALARMA, CAN_NET_MAX_NODOS)},
+	{CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_INICIO, 1),   CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_INICIO, CAN_NET_MAX_NODOS)},
+	{CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_PROMEDIO, 1), CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_PROMEDIO, CAN_NET_MAX_NODOS)},
+	{CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_MUESTRA, 1),  CAN1_CTRL, MSG_ENABLE, CAN_ID(CAN_CLASE_MUESTRA, CAN_NET_MAX_NODOS)},
+};
+
+static uint8_t clase_de_tipo(uint8_t tipo){
+	switch(tipo){
+	case FLOG_EVENTO_ALARMA:	return CAN_CLASE_ALARMA;
+	case FLOG_EVENTO_INICIO:	return CAN_CLASE_INICIO;
+	case FLOG_PROMEDIO:			return CAN_CLASE_PROMEDIO;
+	default:					return CAN_CLASE_MUESTRA;
+	}
+}
+
+uint8_t can_net_init(uint8_t concentrador){
+	memset(nodos, 0, sizeof(nodos));
+	memset(&stats, 0, sizeof(stats));
+	stats.concentrador = concentrador;
+
+	// Deja el filtro en modo normal con la tabla vacia: sin entradas no se
+	// acepta ninguna trama, que es lo que necesita un nodo que solo transmite
+	CAN_Init(LPC_CAN1, CAN_NET_BAUD);
+
+	if(concentrador){
+		AF_SectionDef tabla;
+		memset(&tabla, 0, sizeof(tabla));
+		tabla.SFF_GPR_Sec = grupos;
+		tabla.SFF_GPR_NumEntry = sizeof(grupos) / sizeof(grupos[0]);
+		if(CAN_SetupAFLUT(LPC_CANAF, &tabla) != CAN_OK) return 0;
+		CAN_SetAFMode(LPC_CANAF, CAN_Normal);
+
+		CAN_IRQCmd(LPC_CAN1, CANINT_RIE, ENABLE);
+		CAN_IRQCmd(LPC_CAN1, CANINT_BEIE, ENABLE);
+		NVIC_EnableIRQ(CAN_IRQn);
+	}
+
+	can_ok = 1;
+	// Avisa al concentrador que este nodo arranco (reinicia su seq)
+	can_net_append(FLOG_EVENTO_INICIO, 0, 0, 0);
+	return 1;
+}
+
+// Se llama desde PendSV (log_dispatch) y, una vez, desde can_net_init en el
+// programa principal; nunca espera al bus
+void can_net_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t){
+	CAN_MSG_Type msg;
+
+	if(!can_ok || stats.concentrador) return;
+
+	msg.id = CAN_ID(clase_de_tipo(tipo), CAN_NET_NODO);
+	msg.format = STD_ID_FORMAT;
+	msg.type = DATA_FRAME;
+	msg.len = 8;
+	msg.dataA[0] = (uint8_t)t;
+	msg.dataA[1] = (uint8_t)(t >> 8);
+	msg.dataA[2] = (uint8_t)(t >> 16);
+	msg.dataA[3] = (uint8_t)(t >> 24);
+	msg.dataB[0] = (uint8_t)valor;
+	msg.dataB[1] = (uint8_t)(valor >> 8);
+	msg.dataB[2] = aux;
+	msg.dataB[3] = seq_tx;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	// Con los tres buffers ocupados (bus caido o saturado) se descarta
+	if(CAN_SendMsg(LPC_CAN1, &msg) == SUCCESS){
+		stats.tramas_enviadas++;
+	} else{
+		stats.tramas_perdidas++;
+	}
+	seq_tx++;
+	__set_PRIMASK(primask);
+}
+
+const can_nodo_t *can_net_get_nodo(uint8_t nodo){
+	if(nodo == 0 || nodo > CAN_NET_MAX_NODOS) return 0;
+	return &nodos[nodo - 1];
+}
+
+const can_stats_t *can_net_get_stats(void){
+	return &stats;
+}
+
+static void procesar_trama(const CAN_MSG_Type *msg){
+	uint8_t n = CAN_ID_NODO(msg->id);
+	if(msg->format != STD_ID_FORMAT || msg->len < 8 || n == 0 || n > CAN_NET_MAX_NODOS) return;
+
+	can_nodo_t *nodo = &nodos[n - 1];
+	uint16_t valor = msg->dataB[0] | ((uint16_t)msg->dataB[1] << 8);
+	uint8_t seq = msg->dataB[3];
+	uint8_t clase = CAN_ID_CLASE(msg->id);
+
+	if(clase == CAN_CLASE_INICIO) nodo->visto = 0;	// El nodo reinicio su seq
+	if(nodo->visto) nodo->perdidas += (uint8_t)(seq - nodo->seq - 1);
+	nodo->seq = seq;
+	nodo->visto = 1;
+	nodo->tramas++;
+	nodo->t = msg->dataA[0] | ((uint32_t)msg->dataA[1] << 8) |
+			((uint32_t)msg->dataA[2] << 16) | ((uint32_t)msg->dataA[3] << 24);
+
+	if(clase == CAN_CLASE_MUESTRA) nodo->ultimo_ppm = valor;
+	else if(clase == CAN_CLASE_PROMEDIO) nodo->promedio_ppm = valor;
+	nodo->estado = msg->dataB[2];
+}
+
+void CAN_IRQHandler(void){
+	CAN_MSG_Type msg;
+	uint32_t icr = CAN_IntGetStatus(LPC_CAN1);	// La lectura limpia las banderas
+
+	TRAZA_ENTRA();
+	if(icr & (1<<7)) stats.errores_bus++;		// BEI
+	while(CAN_ReceiveMsg(LPC_CAN1, &msg) == SUCCESS){
+		stats.tramas_recibidas++;
+		procesar_trama(&msg);
+	}
+	TRAZA_SALE();
+}
@@ -0,0 +1,81 @@
+#ifndef CAN_NET_H_
+#define CAN_NET_H_
+
+#include <stdint.h>
+
+// --- Red de monitores por CAN (CAN1: P0.0 RD1, P0.1 TD1, transceptor externo) ---
+// Cada nodo envia sus registros en tramas estandar de 8 bytes. El ID de 11 bits
+// lleva la clase de registro en los 5 bits altos y el numero de nodo en los 6
+// bajos, de modo que una alarma de cualquier nodo gana el arbitraje frente a
+// las muestras periodicas. El concentrador solo acepta, por tabla del filtro
+// de aceptacion en hardware, los rangos de ID de los nodos configurados.
+//
+// Datos de la trama (little-endian):
+//   [0..3] t (muestras desde el arranque del nodo)
+//   [4..5] valor (ppm)
+//   [6]    aux (estado de alarma)
+//   [7]    seq (contador por nodo, para detectar tramas perdidas)
+
+#define CAN_NET_BAUD			125000
+#define CAN_NET_NODO			1		// 1..CAN_NET_MAX_NODOS, unico en el bus
+#define CAN_NET_MAX_NODOS		16		// Nodos atendidos por el concentrador (max 63)
+
+// Clases de trama, en orden de prioridad (menor ID = mayor prioridad)
+#define CAN_CLASE_ALARMA		2
+#define CAN_CLASE_INICIO		3
+#define CAN_CLASE_PROMEDIO		4
+#define CAN_CLASE_MUESTRA		5
+
+#define CAN_ID(clase, nodo)		((uint16_t)(((clase) << 6) | ((nodo) & 0x3F)))
+#define CAN_ID_CLASE(id)		(((id) >> 6) & 0x1F)
+#define CAN_ID_NODO(id)			((id) & 0x3F)
+
+// Estado de cada nodo remoto visto por el concentrador
+typedef struct {
+	uint32_t t;				// t del ultimo registro recibido
+	uint32_t tramas;
+	uint32_t perdidas;		// Huecos en seq
+	uint16_t ultimo_ppm;
+	uint16_t promedio_ppm;
+	uint8_t  estado;		// Ultimo estado de alarma informado
+	uint8_t  seq;
+	uint8_t  visto;
+} can_nodo_t;
+
+typedef struct {
+	uint32_t tramas_enviadas;
+	uint32_t tramas_perdidas;	// Sin buffer de transmision libre
+	uint32_t tramas_recibidas;
+	uint32_t errores_bus;
+	uint8_t  concentrador;
+} can_stats_t;
+
+// --- Modelo de carga y latencia del bus ---
+// Sin dependencias del hardware: se puede compilar tal cual en una PC para
+// dimensionar la red. La latencia es el peor caso del analisis de tiempo de
+// respuesta de CAN (bloqueo por la trama de menor prioridad mas larga +
+// interferencia de las de mayor prioridad), con relleno de bits en peor caso.
+
+typedef struct {
+	uint16_t id;
+	uint8_t  largo;			// Bytes de datos
+	uint32_t periodo_us;	// Periodo o separacion minima entre tramas
+} can_flujo_t;
+
+typedef struct {
+	uint32_t carga_pmil;			// Utilizacion del bus en tanto por mil
+	uint32_t latencia_alarma_us;	// Peor caso de una alarma del nodo de menor prioridad
+	uint32_t latencia_muestra_us;	// Peor caso de una muestra del nodo de menor prioridad
+} can_modelo_t;
+
+uint32_t can_modelo_bits_trama(uint8_t largo);
+uint32_t can_modelo_carga_pmil(const can_flujo_t *flujos, uint32_t n, uint32_t baud);
+uint32_t can_modelo_latencia_us(const can_flujo_t *flujos, uint32_t n, uint32_t idx, uint32_t baud);
+void can_modelo_red(uint32_t nodos, uint32_t baud, can_modelo_t *res);
+
+uint8_t can_net_init(uint8_t concentrador);
+void can_net_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t);
+const can_nodo_t *can_net_get_nodo(uint8_t nodo);
+const can_stats_t *can_net_get_stats(void);
+
+#endif /* CAN_NET_H_ */
@@ -47,6 +47,12 @@ extern "C" {
 extern void SystemInit(void);
 #endif
 
+#if defined (__USE_CMSIS)
+// Ciclos del DWT hasta que SystemInit conecta el PLL (ver main.c)
+#include "registros.h"
+extern unsigned int arranque_ciclos_iniciales;
+#endif
+
 //*****************************************************************************
 //
 // Forward declaration of the default handlers. These are aliased.
@@ -222,16 +228,25 @@ __attribute__ ((section(".after_vectors")))
 void data_init(unsigned int romstart, unsigned int start, unsigned int len) {
     unsigned int *pulDest = (unsigned int*) start;
     unsigned int *pulSrc = (unsigned int*) romstart;
-    unsigned int loop;
-    for (loop = 0; loop < len; loop = loop + 4)
+    unsigned int *pulEnd = (unsigned int*) (start + len);
+    // Cuatro palabras por LDM/STM (tambien en -O0); las secciones estan
+    // alineadas a 4, el resto se copia palabra por palabra
+    while (pulEnd - pulDest >= 4)
+        __asm volatile ("ldmia %0!, {r3-r6}\n\tstmia %1!, {r3-r6}"
+                        : "+r" (pulSrc), "+r" (pulDest) : : "r3", "r4", "r5", "r6", "memory");
+    while (pulDest < pulEnd)
         *pulDest++ = *pulSrc++;
 }
 
 __attribute__ ((section(".after_vectors")))
 void bss_init(unsigned int start, unsigned int len) {
     unsigned int *pulDest = (unsigned int*) start;
-    unsigned int loop;
-    for (loop = 0; loop < len; loop = loop + 4)
+    unsigned int *pulEnd = (unsigned int*) (start + len);
+    while (pulEnd - pulDest >= 4)
+        __asm volatile ("movs r3, #0\n\tmovs r4, #0\n\tmovs r5, #0\n\tmovs r6, #0\n\t"
+                        "stmia %0!, {r3-r6}"
+                        : "+r" (pulDest) : : "r3", "r4", "r5", "r6", "memory");
+    while (pulDest < pulEnd)
         *pulDest++ = 0;
 }
 
@@ -256,6 +271,16 @@ __attribute__ ((section(".after_vectors")))
 void
 ResetISR(void) {
 
+#if defined (__USE_CMSIS)
+    // Primero el PLL: asi las secciones se copian a la velocidad final y no
+    // a 4 MHz. SystemInit solo toca registros, no usa .data ni .bss.
+    unsigned int ciclos_iniciales;
+    dwt_init();
+    SystemInit();
+    ciclos_iniciales = dwt_ciclos();
+    DWT_CYCCNT = 0;
+#endif
+
     //
     // Copy the data sections from flash to SRAM.
     //
@@ -280,7 +305,9 @@ ResetISR(void) {
         bss_init(ExeAddr, SectionLen);
     }
 
-#if defined (__USE_CMSIS) || defined (__USE_LPCOPEN)
+#if defined (__USE_CMSIS)
+    arranque_ciclos_iniciales = ciclos_iniciales;
+#elif defined (__USE_LPCOPEN)
     SystemInit();
 #endif
 
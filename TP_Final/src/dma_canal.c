@@ -0,0 +1,97 @@
+#include "dma_canal.h"
+#include "secciones.h"
+#include "traza.h"
+#include "tiempo.h"
+
+typedef struct {
+	dma_fn_t fin;
+	dma_fn_t error;
+	uint32_t inicio_us;
+	uint8_t  asignado;
+} dma_canal_t;
+
+static dma_canal_t canales[DMA_NUM_CANALES];
+static dma_stats_t stats[DMA_NUM_CANALES];
+
+void dma_canal_init(void){
+	NVIC_DisableIRQ(DMA_IRQn);
+	GPDMA_Init();
+	for(uint8_t c = 0; c < DMA_NUM_CANALES; c++){
+		canales[c].asignado = 0;
+		canales[c].fin = 0;
+		canales[c].error = 0;
+	}
+	NVIC_EnableIRQ(DMA_IRQn);
+}
+
+// Devuelve el canal asignado o DMA_SIN_CANAL si estan todos ocupados
+uint8_t dma_canal_pedir(uint8_t prioridad, dma_fn_t fin, dma_fn_t error){
+	uint8_t elegido = DMA_SIN_CANAL;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for(uint8_t i = 0; i < DMA_NUM_CANALES; i++){
+		uint8_t c = (prioridad == DMA_PRIO_ALTA) ? i : (DMA_NUM_CANALES - 1 - i);
+		if(!canales[c].asignado){
+			canales[c].asignado = 1;
+			canales[c].fin = fin;
+			canales[c].error = error;
+			stats[c] = (dma_stats_t){0, 0, 0, 0};
+			elegido = c;
+			break;
+		}
+	}
+	__set_PRIMASK(primask);
+	return elegido;
+}
+
+void dma_canal_liberar(uint8_t canal){
+	if(canal >= DMA_NUM_CANALES) return;
+	GPDMA_ChannelCmd(canal, DISABLE);
+	canales[canal].asignado = 0;
+	canales[canal].fin = 0;
+	canales[canal].error = 0;
+}
+
+// Arranca el canal desde su imagen de registros y marca el inicio
+Status dma_canal_arrancar(const GPDMA_Image_Type *imagen){
+	uint8_t c = imagen->ChannelNum;
+
+	canales[c].inicio_us = tiempo_us();
+	stats[c].transferencias++;
+	return GPDMA_Rearm(imagen);
+}
+
+const dma_stats_t *dma_canal_get_stats(uint8_t canal){
+	return (canal < DMA_NUM_CANALES) ? &stats[canal] : 0;
+}
+
+EN_RAM void DMA_IRQHandler(void){
+	// Una lectura de cada registro de estado por interrupcion; los canales
+	// se atienden en orden de prioridad (bit mas bajo primero)
+	uint32_t tc = LPC_GPDMA->DMACIntTCStat & 0xFF;
+	uint32_t err = LPC_GPDMA->DMACIntErrStat & 0xFF;
+	uint32_t ahora = tiempo_us();
+
+	TRAZA_ENTRA();
+	LPC_GPDMA->DMACIntTCClear = tc;
+	LPC_GPDMA->DMACIntErrClr = err;
+
+	uint32_t pendientes = tc | err;
+	while(pendientes){
+		uint8_t c = __CLZ(__RBIT(pendientes));
+		uint32_t bit = 1UL << c;
+		pendientes &= ~bit;
+
+		stats[c].ocupado_us += ahora - canales[c].inicio_us;
+		TRAZA(TRAZA_DMA, c, (err & bit) ? 1 : 0);
+		if(err & bit){
+			stats[c].errores++;
+			if(canales[c].error) canales[c].error(c);
+		} else{
+			stats[c].completas++;
+			if(canales[c].fin) canales[c].fin(c);
+		}
+	}
+	TRAZA_SALE();
+}
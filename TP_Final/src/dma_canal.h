@@ -0,0 +1,35 @@
+#ifndef DMA_CANAL_H_
+#define DMA_CANAL_H_
+
+#include "lpc17xx.h"
+#include "lpc17xx_gpdma.h"
+
+// --- Administrador de canales GPDMA ---
+// Los 8 canales se reparten por prioridad (el canal 0 es el de mayor
+// prioridad en el arbitraje del GPDMA). Cada modulo pide un canal con sus
+// funciones de fin de transferencia y de error; la unica DMA_IRQHandler del
+// sistema esta aca y las despacha a partir de los registros de estado.
+
+#define DMA_NUM_CANALES			8
+#define DMA_SIN_CANAL			0xFF
+
+// Prioridad pedida: ALTA toma el canal libre de menor numero, BAJA el de mayor
+#define DMA_PRIO_ALTA			0
+#define DMA_PRIO_BAJA			1
+
+typedef void (*dma_fn_t)(uint8_t canal);
+
+typedef struct {
+	uint32_t transferencias;	// Arranques con dma_canal_arrancar()
+	uint32_t completas;			// Fin de cuenta (TC)
+	uint32_t errores;
+	uint32_t ocupado_us;		// Tiempo acumulado entre arranque y fin
+} dma_stats_t;
+
+void dma_canal_init(void);
+uint8_t dma_canal_pedir(uint8_t prioridad, dma_fn_t fin, dma_fn_t error);
+void dma_canal_liberar(uint8_t canal);
+Status dma_canal_arrancar(const GPDMA_Image_Type *imagen);
+const dma_stats_t *dma_canal_get_stats(uint8_t canal);
+
+#endif /* DMA_CANAL_H_ */
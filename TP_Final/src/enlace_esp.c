@@ -0,0 +1,141 @@
+#include "enlace_esp.h"
+#include "lpc17xx_uart.h"
+#include "tiempo.h"
+#include "traza.h"
+
+static char tx_buf[ESP_TAM_TX];
+static volatile uint32_t tx_cabeza = 0;	// Escribe enlace_esp_enviar
+static volatile uint32_t tx_cola = 0;	// Lee la interrupcion
+static enlace_esp_stats_t stats;
+
+static char rx_linea[ESP_TAM_RX_LINEA];
+static uint8_t rx_n = 0;
+static uint8_t rx_descartar = 0;		// Linea demasiado larga: se ignora hasta el '\n'
+static uint32_t rx_inicio_us;			// Llegada del primer caracter de la linea
+
+void enlace_esp_init(void){
+	tx_cabeza = tx_cola = 0;
+	rx_n = 0;
+	UART_IntConfig(LPC_UART2, UART_INTCFG_THRE, ENABLE);
+	UART_IntConfig(LPC_UART2, UART_INTCFG_RBR, ENABLE);		// FIFO con disparo en 1 caracter
+	UART_IntConfig(LPC_UART2, UART_INTCFG_RLS, ENABLE);
+	NVIC_EnableIRQ(UART2_IRQn);
+}
+
+// Pasa bytes del buffer a la FIFO de TX; con el THR vacio y nada que enviar
+// la UART no vuelve a interrumpir hasta la proxima escritura
+static void cargar_fifo(void){
+	uint8_t i;
+	for(i = 0; i < UART_TX_FIFO_SIZE && tx_cola != tx_cabeza; i++){
+		LPC_UART2->THR = (uint8_t)tx_buf[tx_cola];
+		tx_cola = (tx_cola + 1) & (ESP_TAM_TX - 1);
+		stats.bytes_enviados++;
+	}
+	TRAZA(TRAZA_UART, 2, i);
+}
+
+void enlace_esp_abrir(fmt_t *f){
+	f->estado = __get_PRIMASK();
+	__disable_irq();
+	f->buf = tx_buf;
+	f->mascara = ESP_TAM_TX - 1;
+	f->pos = tx_cabeza;
+	f->fin = tx_cabeza + ((tx_cola - tx_cabeza - 1) & (ESP_TAM_TX - 1));
+	f->desborde = 0;
+}
+
+uint32_t enlace_esp_cerrar(fmt_t *f){
+	uint32_t len = f->pos - tx_cabeza;
+
+	if(f->desborde){
+		stats.bytes_descartados += len;
+		len = 0;
+	} else{
+		tx_cabeza = f->pos & (ESP_TAM_TX - 1);
+		// Si la UART esta inactiva no habra interrupcion THRE: se arranca aca
+		if(LPC_UART2->LSR & UART_LSR_THRE) cargar_fifo();
+	}
+	__set_PRIMASK(f->estado);
+	return len;
+}
+
+// Encola un mensaje completo o nada; devuelve los bytes encolados
+uint32_t enlace_esp_enviar(const char *datos, uint32_t len){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t libres = (tx_cola - tx_cabeza - 1) & (ESP_TAM_TX - 1);
+	if(len > libres){
+		stats.bytes_descartados += len;
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	for(uint32_t i = 0; i < len; i++){
+		tx_buf[tx_cabeza] = datos[i];
+		tx_cabeza = (tx_cabeza + 1) & (ESP_TAM_TX - 1);
+	}
+	// Si la UART esta inactiva no habra interrupcion THRE: se arranca aca
+	if(LPC_UART2->LSR & UART_LSR_THRE) cargar_fifo();
+	__set_PRIMASK(primask);
+	return len;
+}
+
+const enlace_esp_stats_t *enlace_esp_get_stats(void){
+	return &stats;
+}
+
+// Responde un ping: "T<t0>" -> "R<t0>,<t1>,<t2>"
+static void responder_ping(void){
+	fmt_t f;
+	uint32_t t0 = 0;
+
+	for(uint8_t i = 1; i < rx_n; i++){
+		if(rx_linea[i] < '0' || rx_linea[i] > '9') return;
+		t0 = t0 * 10 + (rx_linea[i] - '0');
+	}
+	enlace_esp_abrir(&f);
+	FMT(&f, "R", t0, ",", rx_inicio_us, ",", tiempo_us(), "\n");
+	if(enlace_esp_cerrar(&f)) stats.pings++;
+}
+
+static void recibir(char c){
+	if(rx_n == 0 && !rx_descartar) rx_inicio_us = tiempo_us();
+	if(c == '\n'){
+		if(!rx_descartar && rx_n > 1 && rx_linea[0] == 'T') responder_ping();
+		rx_n = 0;
+		rx_descartar = 0;
+	} else if(c == '\r' || rx_descartar){
+		return;
+	} else if(rx_n < ESP_TAM_RX_LINEA){
+		rx_linea[rx_n++] = c;
+	} else{
+		rx_descartar = 1;
+		stats.errores_rx++;
+	}
+}
+
+void UART2_IRQHandler(void){
+	uint32_t iir;
+
+	TRAZA_ENTRA();
+	// La lectura del IIR reconoce la interrupcion THRE
+	while(!((iir = LPC_UART2->IIR) & UART_IIR_INTSTAT_PEND)){
+		switch(iir & UART_IIR_INTID_MASK){
+		case UART_IIR_INTID_THRE:{
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			cargar_fifo();
+			__set_PRIMASK(primask);
+			break;
+		}
+		case UART_IIR_INTID_RDA:
+		case UART_IIR_INTID_CTI:
+			while(LPC_UART2->LSR & UART_LSR_RDR) recibir(LPC_UART2->RBR);
+			break;
+		case UART_IIR_INTID_RLS:
+			if(LPC_UART2->LSR & (UART_LSR_OE | UART_LSR_PE | UART_LSR_FE | UART_LSR_BI)) stats.errores_rx++;
+			break;
+		}
+	}
+	TRAZA_SALE();
+}
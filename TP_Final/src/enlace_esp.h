@@ -0,0 +1,38 @@
+#ifndef ENLACE_ESP_H_
+#define ENLACE_ESP_H_
+
+#include "lpc17xx.h"
+#include "formato.h"
+
+// --- Enlace serie con el ESP8266 (UART2, TXD2 P0.10, RXD2 P0.11) ---
+// Transmision sin espera: los bytes se encolan en un buffer circular y la
+// interrupcion THRE de la UART2 los pasa a la FIFO de 16 bytes.
+//
+// Recepcion: el ESP8266 mide el desfase entre su reloj y tiempo_us() con
+// un intercambio al estilo NTP. Envia "T<t0>\n" con su hora de envio; la
+// respuesta es "R<t0>,<t1>,<t2>\n", con t1 = llegada del primer caracter y
+// t2 = momento de encolar la respuesta, ambos en us del LPC1769. Las demas
+// lineas que llegan (mensajes de depuracion del ESP) se ignoran.
+
+#define ESP_TAM_TX				256		// Potencia de 2
+#define ESP_TAM_RX_LINEA		24
+
+typedef struct {
+	uint32_t bytes_enviados;
+	uint32_t bytes_descartados;		// Buffer lleno
+	uint32_t pings;
+	uint32_t errores_rx;			// Paridad, framing, overrun o linea demasiado larga
+} enlace_esp_stats_t;
+
+void enlace_esp_init(void);
+uint32_t enlace_esp_enviar(const char *datos, uint32_t len);
+
+// Arma un mensaje directamente en el buffer de TX (con FMT o fmt_*): entre
+// abrir y cerrar las interrupciones quedan deshabilitadas, asi que solo para
+// mensajes cortos. cerrar lo publica completo o lo descarta; devuelve los
+// bytes encolados.
+void enlace_esp_abrir(fmt_t *f);
+uint32_t enlace_esp_cerrar(fmt_t *f);
+const enlace_esp_stats_t *enlace_esp_get_stats(void);
+
+#endif /* ENLACE_ESP_H_ */
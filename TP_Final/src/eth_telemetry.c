@@ -0,0 +1,382 @@
+#include "eth_telemetry.h"
+#include "lpc17xx_emac.h"
+#include "secciones.h"
+#include <string.h>
+
+// Desplazamientos dentro de la trama Ethernet
+#define OFS_ETH_TIPO		12
+#define OFS_IP				14
+#define OFS_UDP				34
+#define OFS_DATOS			42
+
+#define ETH_TIPO_IP			0x0800
+#define ETH_TIPO_ARP		0x0806
+#define IP_PROTO_ICMP		1
+#define IP_PROTO_UDP		17
+
+static const uint8_t mac_propia[6] = ETH_MAC;
+static const uint8_t ip_propia[4] = ETH_IP;
+static const uint8_t ip_colector[4] = ETH_IP_COLECTOR;
+static const uint8_t mac_broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// Descriptores y buffers en RAM AHB, accesible por el DMA del EMAC
+static RX_Desc   rx_desc[ETH_NUM_RX] BUFFER_AHB;
+static RX_Stat   rx_stat[ETH_NUM_RX] BUFFER_AHB __attribute__((aligned(8)));
+static TX_Desc   tx_desc[ETH_NUM_TX] BUFFER_AHB;
+static TX_Stat   tx_stat[ETH_NUM_TX] BUFFER_AHB;
+static uint32_t  rx_buf[ETH_NUM_RX][ETH_TAM_RX / 4] BUFFER_AHB;
+static uint32_t  tx_buf[ETH_NUM_TX][ETH_TAM_TX / 4] BUFFER_AHB;
+
+static uint8_t   mac_colector[6];
+static uint32_t  seq_datagrama = 0;
+static uint16_t  arranque_actual = 0;
+static uint8_t   eth_ok = 0;
+static volatile uint8_t arp_pendiente = 0;
+static volatile uint8_t enlace_pendiente = 0;
+
+// Datagrama en construccion (solo si ETH_REGS_DATAGRAMA > 1)
+static volatile uint8_t  abierto = 0;
+static uint32_t  idx_abierto = 0;
+static uint8_t   n_abierto = 0;
+
+static eth_stats_t stats;
+
+
+static void put16(uint8_t *p, uint16_t v){
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)v;
+}
+
+static uint16_t get16(const uint8_t *p){
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static uint16_t checksum(const uint8_t *p, uint32_t len){
+	uint32_t suma = 0;
+	for(uint32_t i = 0; i + 1 < len; i += 2) suma += get16(&p[i]);
+	if(len & 1) suma += (uint16_t)p[len - 1] << 8;
+	while(suma >> 16) suma = (suma & 0xFFFF) + (suma >> 16);
+	return (uint16_t)~suma;
+}
+
+static uint8_t tx_libre(uint32_t idx){
+	uint32_t sig = (idx + 1) % ETH_NUM_TX;
+	return sig != LPC_EMAC->TxConsumeIndex;
+}
+
+static void tx_enviar(uint32_t idx, uint32_t len){
+	tx_desc[idx].Ctrl = (len - 1) | EMAC_TCTRL_LAST;
+	LPC_EMAC->TxProduceIndex = (idx + 1) % ETH_NUM_TX;
+}
+
+static void armar_eth(uint8_t *f, const uint8_t *dst, uint16_t tipo){
+	memcpy(&f[0], dst, 6);
+	memcpy(&f[6], mac_propia, 6);
+	put16(&f[OFS_ETH_TIPO], tipo);
+}
+
+// Completa los encabezados IP/UDP del datagrama de telemetria en el buffer
+static void armar_udp(uint8_t *f, uint16_t largo_datos){
+	uint8_t *ip = &f[OFS_IP];
+	uint8_t *udp = &f[OFS_UDP];
+
+	armar_eth(f, stats.colector_resuelto ? mac_colector : mac_broadcast, ETH_TIPO_IP);
+
+	ip[0] = 0x45;
+	ip[1] = 0;
+	put16(&ip[2], 20 + 8 + largo_datos);
+	put16(&ip[4], (uint16_t)seq_datagrama);
+	put16(&ip[6], 0x4000);			// No fragmentar
+	ip[8] = 64;
+	ip[9] = IP_PROTO_UDP;
+	put16(&ip[10], 0);
+	memcpy(&ip[12], ip_propia, 4);
+	memcpy(&ip[16], ip_colector, 4);
+	put16(&ip[10], checksum(ip, 20));
+
+	put16(&udp[0], ETH_PUERTO_ORIGEN);
+	put16(&udp[2], ETH_PUERTO_COLECTOR);
+	put16(&udp[4], 8 + largo_datos);
+	put16(&udp[6], 0);				// Checksum UDP opcional en IPv4
+}
+
+static uint16_t mii_leer(uint32_t reg){
+	LPC_EMAC->MADR = EMAC_DEF_ADR | reg;
+	LPC_EMAC->MCMD = EMAC_MCMD_READ;
+	for(uint32_t tout = 0; tout < 0x10000; tout++){
+		if(!(LPC_EMAC->MIND & EMAC_MIND_BUSY)) break;
+	}
+	LPC_EMAC->MCMD = 0;
+	return (uint16_t)LPC_EMAC->MRDD;
+}
+
+static void mii_escribir(uint32_t reg, uint16_t valor){
+	LPC_EMAC->MADR = EMAC_DEF_ADR | reg;
+	LPC_EMAC->MWTD = valor;
+	for(uint32_t tout = 0; tout < 0x10000; tout++){
+		if(!(LPC_EMAC->MIND & EMAC_MIND_BUSY)) break;
+	}
+}
+
+// Ajusta velocidad y duplex del MAC al resultado de la autonegociacion.
+// Usa solo registros estandar del PHY (ANAR/ANLPAR), asi sirve para el
+// LAN8720 de la LPCXpresso y para el DP83848 que espera el driver.
+static void revisar_enlace(void){
+	uint16_t bmsr = mii_leer(EMAC_PHY_REG_BMSR);
+	uint8_t enlace = (bmsr & EMAC_PHY_BMSR_LINK_ESTABLISHED) && (bmsr & EMAC_PHY_BMSR_AUTO_DONE);
+
+	if(enlace && !stats.enlace_ok){
+		uint16_t comun = mii_leer(EMAC_PHY_REG_ANAR) & mii_leer(EMAC_PHY_REG_ANLPAR);
+		uint8_t full = (comun & 0x0100) || (!(comun & 0x0080) && (comun & 0x0040));
+		uint8_t rapido = (comun & 0x0180) != 0;
+
+		if(full){
+			LPC_EMAC->MAC2 |= EMAC_MAC2_FULL_DUP;
+			LPC_EMAC->Command |= EMAC_CR_FULL_DUP;
+			LPC_EMAC->IPGT = EMAC_IPGT_FULL_DUP;
+		} else{
+			LPC_EMAC->MAC2 &= ~EMAC_MAC2_FULL_DUP;
+			LPC_EMAC->Command &= ~EMAC_CR_FULL_DUP;
+			LPC_EMAC->IPGT = EMAC_IPGT_HALF_DUP;
+		}
+		LPC_EMAC->SUPP = rapido ? EMAC_SUPP_SPEED : 0;
+	}
+	stats.enlace_ok = enlace;
+}
+
+uint8_t eth_telemetry_init(uint16_t arranque){
+	EMAC_CFG_Type cfg;
+	uint8_t mac[6] = ETH_MAC;
+
+	memset(&stats, 0, sizeof(stats));
+	arranque_actual = arranque;
+
+	// EMAC_Init resetea el MAC, habilita RMII y resetea el PHY. Su configuracion
+	// de PHY solo reconoce el DP83848C, por lo que con otro PHY devuelve ERROR
+	// aunque el MAC quede listo; el PHY y la direccion se configuran aca.
+	// Se pide modo fijo para que no bloquee esperando la autonegociacion.
+	cfg.Mode = EMAC_MODE_100M_FULL;
+	cfg.pbEMAC_Addr = mac;
+	EMAC_Init(&cfg);
+
+	uint16_t id = mii_leer(EMAC_PHY_REG_IDR1);
+	if(id == 0x0000 || id == 0xFFFF) return 0;	// Sin PHY
+
+	LPC_EMAC->SA0 = ((uint32_t)mac[5] << 8) | mac[4];
+	LPC_EMAC->SA1 = ((uint32_t)mac[3] << 8) | mac[2];
+	LPC_EMAC->SA2 = ((uint32_t)mac[1] << 8) | mac[0];
+	mii_escribir(EMAC_PHY_REG_BMCR, EMAC_PHY_BMCR_AN | EMAC_PHY_BMCR_RE_AN);
+
+	// Se reemplazan los descriptores de EMAC_Init (en RamLoc32) por los
+	// anillos en RAM AHB, con RX y TX detenidos
+	LPC_EMAC->Command &= ~(EMAC_CR_RX_EN | EMAC_CR_TX_EN);
+	LPC_EMAC->MAC1 &= ~EMAC_MAC1_REC_EN;
+
+	for(uint32_t i = 0; i < ETH_NUM_RX; i++){
+		rx_desc[i].Packet = (uint32_t)rx_buf[i];
+		rx_desc[i].Ctrl = EMAC_RCTRL_SIZE((ETH_TAM_RX - 1));
+		rx_stat[i].Info = 0;
+		rx_stat[i].HashCRC = 0;
+	}
+	for(uint32_t i = 0; i < ETH_NUM_TX; i++){
+		tx_desc[i].Packet = (uint32_t)tx_buf[i];
+		tx_desc[i].Ctrl = 0;
+		tx_stat[i].Info = 0;
+	}
+	LPC_EMAC->RxDescriptor = (uint32_t)rx_desc;
+	LPC_EMAC->RxStatus = (uint32_t)rx_stat;
+	LPC_EMAC->RxDescriptorNumber = ETH_NUM_RX - 1;
+	LPC_EMAC->RxConsumeIndex = 0;
+	LPC_EMAC->TxDescriptor = (uint32_t)tx_desc;
+	LPC_EMAC->TxStatus = (uint32_t)tx_stat;
+	LPC_EMAC->TxDescriptorNumber = ETH_NUM_TX - 1;
+	LPC_EMAC->TxProduceIndex = 0;
+
+	// Se atiende por sondeo desde el lazo principal
+	LPC_EMAC->IntEnable = 0;
+	LPC_EMAC->IntClear = 0xFFFF;
+	LPC_EMAC->RxFilterCtrl = EMAC_RFC_BCAST_EN | EMAC_RFC_PERFECT_EN;
+
+	LPC_EMAC->Command |= (EMAC_CR_RX_EN | EMAC_CR_TX_EN);
+	LPC_EMAC->MAC1 |= EMAC_MAC1_REC_EN;
+
+	eth_ok = 1;
+	enlace_pendiente = 1;
+	return 1;
+}
+
+// Escribe el registro directamente en el buffer del descriptor de TX
+void eth_telemetry_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t){
+	if(!eth_ok) return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(!abierto){
+		idx_abierto = LPC_EMAC->TxProduceIndex;
+		if(!tx_libre(idx_abierto)){
+			stats.registros_perdidos++;
+			__set_PRIMASK(primask);
+			return;
+		}
+		n_abierto = 0;
+		abierto = 1;
+	}
+
+	uint8_t *f = (uint8_t *)tx_buf[idx_abierto];
+	flog_reg_t *r = (flog_reg_t *)&f[OFS_DATOS + sizeof(eth_tlm_hdr_t) + n_abierto * sizeof(flog_reg_t)];
+	r->t = t;
+	r->valor = valor;
+	r->tipo = tipo;
+	r->aux = aux;
+
+	if(++n_abierto == ETH_REGS_DATAGRAMA){
+		eth_tlm_hdr_t *h = (eth_tlm_hdr_t *)&f[OFS_DATOS];
+		uint16_t largo = sizeof(eth_tlm_hdr_t) + n_abierto * sizeof(flog_reg_t);
+
+		h->magic[0] = 'C';
+		h->magic[1] = 'O';
+		h->version = 1;
+		h->nodo = ETH_NODO;
+		h->seq = seq_datagrama;
+		h->arranque = arranque_actual;
+		h->n = n_abierto;
+		h->reservado = 0;
+		armar_udp(f, largo);
+		tx_enviar(idx_abierto, OFS_DATOS + largo);
+
+		seq_datagrama++;
+		stats.datagramas_enviados++;
+		abierto = 0;
+	}
+	// Una vez por registro (1 s): revisar el enlace y resolver el colector
+	enlace_pendiente = 1;
+	if(!stats.colector_resuelto) arp_pendiente = 1;
+	__set_PRIMASK(primask);
+}
+
+// Envia una trama armada por fn() en el siguiente descriptor libre
+static void tx_respuesta(uint32_t (*fn)(uint8_t *f, const uint8_t *rx, uint32_t len), const uint8_t *rx, uint32_t len){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t idx = LPC_EMAC->TxProduceIndex;
+	// Con un datagrama de telemetria a medio armar el descriptor esta ocupado;
+	// la respuesta se descarta y el otro extremo reintenta
+	if(!abierto && tx_libre(idx)){
+		uint32_t largo = fn((uint8_t *)tx_buf[idx], rx, len);
+		if(largo) tx_enviar(idx, largo);
+	}
+	__set_PRIMASK(primask);
+}
+
+static uint32_t armar_arp(uint8_t *f, const uint8_t *rx, uint32_t len){
+	uint8_t *arp = &f[OFS_IP];
+	(void)len;
+
+	put16(&arp[0], 1);
+	put16(&arp[2], ETH_TIPO_IP);
+	arp[4] = 6;
+	arp[5] = 4;
+	memcpy(&arp[8], mac_propia, 6);
+	memcpy(&arp[14], ip_propia, 4);
+
+	if(rx){
+		// Respuesta a una consulta por nuestra IP
+		const uint8_t *q = &rx[OFS_IP];
+		armar_eth(f, &q[8], ETH_TIPO_ARP);
+		put16(&arp[6], 2);
+		memcpy(&arp[18], &q[8], 10);	// MAC e IP del que pregunta
+		stats.arp_respuestas++;
+	} else{
+		// Consulta por la MAC del colector
+		armar_eth(f, mac_broadcast, ETH_TIPO_ARP);
+		put16(&arp[6], 1);
+		memset(&arp[18], 0, 6);
+		memcpy(&arp[24], ip_colector, 4);
+	}
+	return OFS_IP + 28;
+}
+
+static uint32_t armar_ping(uint8_t *f, const uint8_t *rx, uint32_t len){
+	if(len > ETH_TAM_TX) return 0;
+
+	memcpy(f, rx, len);
+	armar_eth(f, &rx[6], ETH_TIPO_IP);
+
+	uint8_t *ip = &f[OFS_IP];
+	uint32_t ihl = (ip[0] & 0x0F) * 4;
+	uint32_t largo_ip = get16(&ip[2]);
+	if(largo_ip > len - OFS_IP || largo_ip < ihl + 8) return 0;
+
+	memcpy(&ip[16], &rx[OFS_IP + 12], 4);
+	memcpy(&ip[12], ip_propia, 4);
+	put16(&ip[10], 0);
+	put16(&ip[10], checksum(ip, ihl));
+
+	uint8_t *icmp = &ip[ihl];
+	icmp[0] = 0;					// Echo reply
+	put16(&icmp[2], 0);
+	put16(&icmp[2], checksum(icmp, largo_ip - ihl));
+	stats.ping_respuestas++;
+	return OFS_IP + largo_ip;
+}
+
+static void procesar_trama(const uint8_t *f, uint32_t len){
+	if(len < OFS_IP + 28) return;
+
+	uint16_t tipo = get16(&f[OFS_ETH_TIPO]);
+	const uint8_t *p = &f[OFS_IP];
+
+	if(tipo == ETH_TIPO_ARP){
+		if(memcmp(&p[24], ip_propia, 4) != 0) return;
+		// Cualquier ARP del colector sirve para aprender su MAC
+		if(memcmp(&p[14], ip_colector, 4) == 0){
+			memcpy(mac_colector, &p[8], 6);
+			stats.colector_resuelto = 1;
+		}
+		if(get16(&p[6]) == 1) tx_respuesta(armar_arp, f, len);
+	} else if(tipo == ETH_TIPO_IP){
+		uint32_t ihl = (p[0] & 0x0F) * 4;
+		// El encabezado IP y el de ICMP tienen que entrar en la trama
+		if(ihl < 20 || OFS_IP + ihl + 8 > len) return;
+		if(memcmp(&p[16], ip_propia, 4) != 0) return;
+		if(p[9] == IP_PROTO_ICMP && p[ihl] == 8){
+			tx_respuesta(armar_ping, f, len);
+		}
+	}
+}
+
+void eth_telemetry_service(void){
+	if(!eth_ok) return;
+
+	// Las tramas se procesan en el buffer del descriptor y luego se libera
+	while(LPC_EMAC->RxConsumeIndex != LPC_EMAC->RxProduceIndex){
+		uint32_t idx = LPC_EMAC->RxConsumeIndex;
+		uint32_t info = rx_stat[idx].Info;
+
+		if(info & EMAC_RINFO_ERR_MASK){
+			stats.tramas_error++;
+		} else{
+			stats.tramas_recibidas++;
+			// El tamanio informado es largo - 1 e incluye el CRC
+			uint32_t len = (info & EMAC_RINFO_SIZE) + 1;
+			if(len > 4) procesar_trama((const uint8_t *)rx_buf[idx], len - 4);
+		}
+		LPC_EMAC->RxConsumeIndex = (idx + 1) % ETH_NUM_RX;
+	}
+
+	if(enlace_pendiente){
+		enlace_pendiente = 0;
+		revisar_enlace();
+	}
+
+	if(arp_pendiente && stats.enlace_ok){
+		arp_pendiente = 0;
+		tx_respuesta(armar_arp, 0, 0);
+	}
+}
+
+const eth_stats_t *eth_telemetry_get_stats(void){
+	return &stats;
+}
@@ -0,0 +1,52 @@
+#ifndef ETH_TELEMETRY_H_
+#define ETH_TELEMETRY_H_
+
+#include "lpc17xx.h"
+#include "flash_log.h"
+
+// --- Telemetria cableada por el EMAC integrado (RMII, PHY LAN8720 de la LPCXpresso) ---
+// Pila minima: ARP, ICMP echo y UDP de solo envio. Los descriptores y buffers
+// del EMAC se ubican en la RAM AHB (el DMA del EMAC no accede a RamLoc32) y
+// las tramas se arman directamente en el buffer del descriptor, sin copias.
+
+#define ETH_MAC					{0x02, 0x00, 0x4C, 0x50, 0x43, 0x01}	// Administrada localmente
+#define ETH_IP					{192, 168, 1, 50}
+#define ETH_IP_COLECTOR			{192, 168, 1, 10}
+#define ETH_PUERTO_ORIGEN		5005
+#define ETH_PUERTO_COLECTOR		5005
+#define ETH_NODO				1
+
+#define ETH_NUM_RX				4
+#define ETH_NUM_TX				4
+#define ETH_TAM_RX				1536
+#define ETH_TAM_TX				512
+#define ETH_REGS_DATAGRAMA		1		// Registros por datagrama (1 = minima latencia)
+
+// Encabezado del datagrama de telemetria (little-endian), seguido de n flog_reg_t
+typedef struct __attribute__((packed)) {
+	uint8_t  magic[2];		// 'C', 'O'
+	uint8_t  version;
+	uint8_t  nodo;
+	uint32_t seq;			// Numero de datagrama, para detectar perdidas
+	uint16_t arranque;
+	uint8_t  n;
+	uint8_t  reservado;
+} eth_tlm_hdr_t;
+
+typedef struct {
+	uint32_t datagramas_enviados;
+	uint32_t registros_perdidos;	// Sin descriptor de TX libre
+	uint32_t tramas_recibidas;
+	uint32_t tramas_error;
+	uint32_t arp_respuestas;
+	uint32_t ping_respuestas;
+	uint8_t  enlace_ok;
+	uint8_t  colector_resuelto;
+} eth_stats_t;
+
+uint8_t eth_telemetry_init(uint16_t arranque);
+void eth_telemetry_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t);
+void eth_telemetry_service(void);
+const eth_stats_t *eth_telemetry_get_stats(void);
+
+#endif /* ETH_TELEMETRY_H_ */
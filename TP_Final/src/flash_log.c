@@ -0,0 +1,370 @@
+#include "flash_log.h"
+#include "bitacora.h"
+#include <stddef.h>
+#include <string.h>
+
+// --- IAP (In-Application Programming) de la ROM del LPC17xx ---
+#define IAP_LOCATION			0x1FFF1FF1UL
+#define IAP_PREPARAR			50
+#define IAP_COPIAR_RAM_FLASH	51
+#define IAP_BORRAR				52
+#define IAP_VERIFICAR_BLANCO	53
+#define IAP_CMD_SUCCESS			0
+#define IAP_SECTOR_NOT_BLANK	8
+
+#define FLOG_MAGIC				0x474F4C43UL	// "CLOG"
+
+typedef void (*iap_fn_t)(uint32_t *cmd, uint32_t *res);
+
+// El IAP usa los 32 bytes superiores de RamLoc32. El script de linker toma
+// __user_stack_top como tope de la pila si esta definido, asi que se lo baja
+// 32 bytes para que una escritura en flash no pise la pila.
+__asm__(".global __user_stack_top\n\t.equ __user_stack_top, 0x10007FE0");
+
+// Dos paginas en RAM: las interrupciones llenan una mientras el lazo
+// principal programa la otra.
+static flog_pagina_t		buf[2];
+static volatile uint8_t		buf_llenando = 0;
+static volatile uint8_t		buf_listo[2] = {0, 0};
+static volatile uint8_t		flush_pedido = 0;
+
+static uint32_t				sector_actual = 0;	// Indice relativo a FLOG_PRIMER_SECTOR
+static uint32_t				pagina_actual = 0;
+static uint32_t				seq_siguiente = 0;
+static int32_t				sector_en_blanco = -1;	// Sector borrado por adelantado (-1: ninguno)
+static uint8_t				detenido = 0;			// La flash no acepta ni la marca de pagina fallida
+
+static flog_stats_t			stats;
+
+
+static uint32_t iap_call(uint32_t *cmd, uint32_t *res){
+	// La flash no se puede leer mientras el IAP programa o borra, y la tabla
+	// de vectores esta en flash: se bloquean las interrupciones, tambien la
+	// de la alarma. Programar una pagina toma ~1 ms; borrar un sector, ~100
+	// ms: por eso los borrados se adelantan a momentos sin alarma (ver
+	// flog_service).
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	((iap_fn_t)IAP_LOCATION)(cmd, res);
+	__set_PRIMASK(primask);
+	return res[0];
+}
+
+static uint32_t iap_preparar(uint32_t sector){
+	uint32_t cmd[5] = {IAP_PREPARAR, sector, sector, 0, 0};
+	uint32_t res[5];
+	return iap_call(cmd, res);
+}
+
+static uint32_t iap_borrar(uint32_t sector){
+	uint32_t cmd[5] = {IAP_VERIFICAR_BLANCO, sector, sector, 0, 0};
+	uint32_t res[5];
+
+	if(iap_call(cmd, res) == IAP_CMD_SUCCESS) return IAP_CMD_SUCCESS; // Ya esta en blanco
+
+	uint32_t err = iap_preparar(sector);
+	if(err != IAP_CMD_SUCCESS) return err;
+	cmd[0] = IAP_BORRAR;
+	cmd[3] = SystemCoreClock / 1000;
+	stats.sectores_borrados++;
+	return iap_call(cmd, res);
+}
+
+static uint32_t iap_escribir(uint32_t sector, uint32_t dir, const void *src){
+	uint32_t cmd[5] = {IAP_COPIAR_RAM_FLASH, dir, (uint32_t)src, FLOG_TAM_PAGINA, SystemCoreClock / 1000};
+	uint32_t res[5];
+
+	uint32_t err = iap_preparar(sector);
+	if(err != IAP_CMD_SUCCESS) return err;
+	return iap_call(cmd, res);
+}
+
+// CRC16-CCITT de la pagina, sin incluir magic y tomando el campo crc como 0.
+static uint16_t pagina_crc(const flog_pagina_t *pg){
+	const uint8_t *p = (const uint8_t *)pg;
+	uint16_t crc = 0xFFFF;
+
+	for(uint32_t i = 4; i < FLOG_TAM_PAGINA; i++){
+		uint8_t b = p[i];
+		if(i == offsetof(flog_encabezado_t, crc) || i == offsetof(flog_encabezado_t, crc) + 1) b = 0;
+		crc ^= (uint16_t)b << 8;
+		for(uint8_t k = 0; k < 8; k++){
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static const flog_pagina_t *pagina_flash(uint32_t sector, uint32_t pagina){
+	return (const flog_pagina_t *)(FLOG_BASE + sector * FLOG_TAM_SECTOR + pagina * FLOG_TAM_PAGINA);
+}
+
+static uint8_t encabezado_en_blanco(const flog_pagina_t *pg){
+	const uint32_t *w = (const uint32_t *)&pg->enc;
+	return (w[0] & w[1] & w[2] & w[3]) == 0xFFFFFFFFUL;
+}
+
+// Lecturas del escaneo de arranque
+static uint8_t pagina_borrada(const flog_pagina_t *pg){
+	stats.lecturas_arranque++;
+	return encabezado_en_blanco(pg);
+}
+
+static uint8_t pagina_valida(const flog_pagina_t *pg){
+	return pg->enc.magic == FLOG_MAGIC && pg->enc.n <= FLOG_REGS_PAGINA && pg->enc.crc == pagina_crc(pg);
+}
+
+// Obtiene el numero de secuencia de la primera pagina de un sector. Si la
+// primera pagina esta corrupta se deduce de la siguiente pagina valida.
+static uint8_t sector_seq(uint32_t sector, uint32_t *seq){
+	for(uint32_t p = 0; p < FLOG_PAGINAS_SECTOR; p++){
+		const flog_pagina_t *pg = pagina_flash(sector, p);
+		if(pagina_borrada(pg)) return 0;
+		if(pagina_valida(pg)){
+			*seq = pg->enc.seq - p;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void flog_init(void){
+	int32_t  mas_nuevo = -1;
+	uint32_t seq_nuevo = 0;
+
+	memset(&stats, 0, sizeof(stats));
+	sector_en_blanco = -1;
+	detenido = 0;
+	memset(buf, 0xFF, sizeof(buf));
+	buf[0].enc.n = 0;
+	buf[1].enc.n = 0;
+
+	// 1. Un encabezado por sector: el de mayor secuencia es el sector activo
+	for(uint32_t s = 0; s < FLOG_NUM_SECTORES; s++){
+		uint32_t seq;
+		if(sector_seq(s, &seq) && (mas_nuevo < 0 || (int32_t)(seq - seq_nuevo) > 0)){
+			mas_nuevo = s;
+			seq_nuevo = seq;
+		}
+	}
+
+	if(mas_nuevo < 0){
+		// Log vacio
+		sector_actual = 0;
+		pagina_actual = 0;
+		seq_siguiente = 0;
+		stats.arranque = 0;
+	} else{
+		// 2. Busqueda binaria de la primera pagina borrada del sector activo.
+		//    Las paginas se escriben en orden, asi que las escritas son un prefijo.
+		uint32_t lo = 0, hi = FLOG_PAGINAS_SECTOR;
+		while(lo < hi){
+			uint32_t mid = (lo + hi) / 2;
+			if(pagina_borrada(pagina_flash(mas_nuevo, mid))) hi = mid;
+			else lo = mid + 1;
+		}
+
+		sector_actual = mas_nuevo;
+		pagina_actual = lo;
+		seq_siguiente = seq_nuevo + lo;
+
+		// 3. Numero de arranque a partir de la ultima pagina valida
+		stats.arranque = 0;
+		for(int32_t p = (int32_t)lo - 1; p >= 0; p--){
+			const flog_pagina_t *pg = pagina_flash(mas_nuevo, p);
+			if(pagina_valida(pg)){
+				stats.arranque = pg->enc.arranque + 1;
+				break;
+			}
+			stats.paginas_corruptas++;
+		}
+
+		if(pagina_actual == FLOG_PAGINAS_SECTOR){
+			pagina_actual = 0;
+			sector_actual = (sector_actual + 1) % FLOG_NUM_SECTORES;
+		}
+	}
+
+	flog_append(FLOG_EVENTO_INICIO, 0, 0, 0);
+}
+
+void flog_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint8_t idx = buf_llenando;
+	if(buf_listo[idx]){
+		// Ambas paginas esperan ser programadas
+		stats.registros_perdidos++;
+		__set_PRIMASK(primask);
+		return;
+	}
+
+	flog_pagina_t *pg = &buf[idx];
+	flog_reg_t *r = &pg->reg[pg->enc.n++];
+	r->t = t;
+	r->valor = valor;
+	r->tipo = tipo;
+	r->aux = aux;
+	stats.bytes_registrados += sizeof(flog_reg_t);
+
+	if(pg->enc.n == FLOG_REGS_PAGINA){
+		buf_listo[idx] = 1;
+		buf_llenando = idx ^ 1;
+	}
+	__set_PRIMASK(primask);
+}
+
+void flog_flush(void){
+	flush_pedido = 1;
+}
+
+// Marca una pagina cuya escritura fallo: una pagina de ceros no esta en
+// blanco ni es valida, asi las escritas siguen siendo un prefijo del sector
+// (la busqueda binaria de flog_init depende de eso). Programar ceros sobre lo
+// que haya quedado siempre es posible en una flash sana.
+static uint32_t marcar_fallida(uint32_t sector, uint32_t dir){
+	static uint32_t ceros[FLOG_TAM_PAGINA / 4];	// En RAM, como pide el IAP
+
+	if(!encabezado_en_blanco((const flog_pagina_t *)dir)) return IAP_CMD_SUCCESS;
+	uint32_t err = iap_escribir(sector, dir, ceros);
+	if(err == IAP_CMD_SUCCESS && encabezado_en_blanco((const flog_pagina_t *)dir)) err = IAP_SECTOR_NOT_BLANK;
+	return err;
+}
+
+// Borra por adelantado el sector que sigue, si la aplicacion lo permite: asi
+// el paso de sector no tiene que borrar (y bloquear las interrupciones 100 ms)
+// justo durante una alarma. El anillo conserva un sector menos de historia.
+static void borrar_siguiente(void){
+	uint32_t siguiente = (sector_actual + 1) % FLOG_NUM_SECTORES;
+
+	// Recien cuando el sector actual tiene datos: antes, el que se borra
+	// primero es el actual
+	if(pagina_actual == 0 || sector_en_blanco == (int32_t)siguiente) return;
+	if(!flog_borrado_permitido()) return;
+
+	uint32_t err = iap_borrar(FLOG_PRIMER_SECTOR + siguiente);
+	if(err != IAP_CMD_SUCCESS){
+		stats.error_iap = (uint8_t)err;
+		BITACORA("flash: error IAP %u al borrar el sector %u", err, FLOG_PRIMER_SECTOR + siguiente);
+		detenido = 1;
+		return;
+	}
+	sector_en_blanco = siguiente;
+}
+
+void flog_service(void){
+	uint8_t idx;
+
+	if(detenido) return;
+
+	if(flush_pedido){
+		// Cierra la pagina parcial para que quede persistida cuanto antes
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		idx = buf_llenando;
+		if(!buf_listo[idx ^ 1]){
+			// Si la otra pagina sigue pendiente se reintenta en la proxima llamada
+			if(!buf_listo[idx] && buf[idx].enc.n > 0){
+				buf_listo[idx] = 1;
+				buf_llenando = idx ^ 1;
+			}
+			flush_pedido = 0;
+		}
+		__set_PRIMASK(primask);
+	}
+
+	// Si ambas estan listas la mas vieja es la que las interrupciones llenarian a continuacion
+	idx = buf_listo[buf_llenando] ? buf_llenando : (buf_llenando ^ 1);
+	if(!buf_listo[idx]){
+		borrar_siguiente();	// Sin nada que escribir
+		return;
+	}
+
+	flog_pagina_t *pg = &buf[idx];
+	uint32_t sector = FLOG_PRIMER_SECTOR + sector_actual;
+	uint32_t dir = (uint32_t)pagina_flash(sector_actual, pagina_actual);
+
+	// Registros sin usar quedan en 0xFF, igual que la flash borrada
+	memset(&pg->reg[pg->enc.n], 0xFF, (FLOG_REGS_PAGINA - pg->enc.n) * sizeof(flog_reg_t));
+	pg->enc.magic = FLOG_MAGIC;
+	pg->enc.seq = seq_siguiente;
+	pg->enc.arranque = stats.arranque;
+	pg->enc.reservado = 0xFF;
+	pg->enc.reservado2 = 0xFFFF;
+	pg->enc.crc = pagina_crc(pg);
+
+	uint32_t err;
+	if(pagina_actual == 0 && sector_en_blanco != (int32_t)sector_actual){
+		// Primera pagina del sector: se recicla el sector mas viejo del anillo.
+		// Rotar por todos los sectores reparte los borrados por igual. Despues
+		// del primer sector solo llega aca si hubo alarma desde que se empezo
+		// el anterior.
+		err = iap_borrar(sector);
+		if(err != IAP_CMD_SUCCESS){
+			// Un sector que no se borra no se puede usar
+			stats.error_iap = (uint8_t)err;
+			BITACORA("flash: error IAP %u al borrar el sector %u", err, sector);
+			detenido = 1;
+			return;
+		}
+	}
+	err = iap_escribir(sector, dir, pg);
+	if(err == IAP_CMD_SUCCESS && memcmp((const void *)dir, pg, FLOG_TAM_PAGINA) != 0){
+		err = IAP_SECTOR_NOT_BLANK;
+	}
+
+	if(err != IAP_CMD_SUCCESS){
+		stats.error_iap = (uint8_t)err;
+		BITACORA("flash: error IAP %u en el sector %u (pagina %u)", err, sector, seq_siguiente);
+		// La pagina fallida se marca y el buffer se reintenta en la siguiente.
+		// Si ni la marca se puede programar, la pagina quedaria como un hueco
+		// en blanco: se deja de escribir hasta el proximo arranque.
+		if(marcar_fallida(sector, dir) != IAP_CMD_SUCCESS){
+			BITACORA("flash: no se pudo marcar la pagina %u, registro detenido", seq_siguiente);
+			detenido = 1;
+			return;
+		}
+	}
+
+	if(pagina_actual == 0) sector_en_blanco = -1;	// Se empezo el sector que estaba borrado
+	seq_siguiente++;
+	if(++pagina_actual == FLOG_PAGINAS_SECTOR){
+		pagina_actual = 0;
+		sector_actual = (sector_actual + 1) % FLOG_NUM_SECTORES;
+	}
+	if(err != IAP_CMD_SUCCESS) return;
+
+	stats.paginas_escritas++;
+	stats.bytes_programados += FLOG_TAM_PAGINA;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	pg->enc.n = 0;
+	buf_listo[idx] = 0;
+	__set_PRIMASK(primask);
+}
+
+// Recorre los registros persistidos del mas viejo al mas nuevo
+uint32_t flog_iterate(void (*fn)(const flog_reg_t *reg, uint32_t seq, void *ctx), void *ctx){
+	uint32_t total = 0;
+
+	for(uint32_t i = 1; i <= FLOG_NUM_SECTORES; i++){
+		uint32_t s = (sector_actual + i) % FLOG_NUM_SECTORES;
+		uint32_t fin = (s == sector_actual) ? pagina_actual : FLOG_PAGINAS_SECTOR;
+
+		for(uint32_t p = 0; p < fin; p++){
+			const flog_pagina_t *pg = pagina_flash(s, p);
+			if(!pagina_valida(pg)) continue;
+			for(uint8_t r = 0; r < pg->enc.n; r++){
+				fn(&pg->reg[r], pg->enc.seq, ctx);
+				total++;
+			}
+		}
+	}
+	return total;
+}
+
+const flog_stats_t *flog_get_stats(void){
+	return &stats;
+}
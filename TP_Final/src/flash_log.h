@@ -0,0 +1,83 @@
+#ifndef FLASH_LOG_H_
+#define FLASH_LOG_H_
+
+#include "lpc17xx.h"
+
+// --- Registro persistente en flash (sectores superiores del LPC1769) ---
+// Se usan los sectores 26..29 (4 x 32 KB, 0x00060000 - 0x0007FFFF) como un
+// anillo de paginas de 256 bytes. Cada pagina lleva un encabezado con numero
+// de secuencia y CRC: una pagina solo se considera valida si el CRC coincide,
+// por lo que un corte de energia durante la escritura deja a lo sumo una
+// pagina descartable (marca de commit).
+//
+// Programar y borrar con el IAP bloquea todas las interrupciones, incluida
+// la de la alarma: ~1 ms por pagina y ~100 ms por sector. El sector que sigue
+// se borra por adelantado cuando flog_borrado_permitido() lo deja (sin
+// alarma); solo si la alarma dura todo un sector el borrado cae durante ella.
+// De los 4 sectores quedan 3 con historia y uno listo para escribir.
+//
+// La region MFlash512 de la configuracion de memoria del proyecto (.cproject
+// y los *_memory.ld de Debug y Release) termina en FLOG_BASE: si el programa
+// crece hasta los sectores del registro, el enlazador falla.
+
+#define FLOG_PRIMER_SECTOR		26
+#define FLOG_NUM_SECTORES		4
+#define FLOG_BASE				0x00060000UL
+#define FLOG_TAM_SECTOR			0x8000UL
+#define FLOG_TAM_PAGINA			256
+#define FLOG_PAGINAS_SECTOR		(FLOG_TAM_SECTOR / FLOG_TAM_PAGINA)
+#define FLOG_REGS_PAGINA		30
+
+// Tipos de registro
+#define FLOG_MUESTRA			1	// valor = ppm de la muestra
+#define FLOG_PROMEDIO			2	// valor = ppm promedio
+#define FLOG_EVENTO_ALARMA		3	// valor = ppm, aux = nuevo estado de alarma
+#define FLOG_EVENTO_INICIO		4	// valor = 0, primer registro luego de un reset
+
+typedef struct {
+	uint32_t t;			// Segundos desde el arranque (contador de muestras)
+	uint16_t valor;
+	uint8_t  tipo;
+	uint8_t  aux;
+} flog_reg_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;		// Numero global de pagina, monotono
+	uint16_t arranque;	// Numero de arranque en que se escribio la pagina
+	uint8_t  n;			// Registros validos en la pagina
+	uint8_t  reservado;
+	uint16_t crc;		// CRC16-CCITT de todo lo que sigue a magic (excepto crc)
+	uint16_t reservado2;
+} flog_encabezado_t;
+
+typedef struct {
+	flog_encabezado_t enc;
+	flog_reg_t reg[FLOG_REGS_PAGINA];
+} flog_pagina_t;
+
+// Estadisticas para medir amplificacion de escritura y tiempo de recuperacion
+typedef struct {
+	uint32_t bytes_registrados;		// Bytes utiles (registros) aceptados
+	uint32_t bytes_programados;		// Bytes escritos en flash (paginas completas)
+	uint32_t paginas_escritas;
+	uint32_t sectores_borrados;
+	uint32_t registros_perdidos;	// Descartados por buffers llenos
+	uint32_t paginas_corruptas;		// Paginas con CRC invalido halladas al arrancar
+	uint32_t lecturas_arranque;		// Encabezados leidos durante el escaneo inicial
+	uint16_t arranque;
+	uint8_t  error_iap;				// Ultimo codigo de error del IAP (0 = CMD_SUCCESS)
+} flog_stats_t;
+
+void flog_init(void);
+void flog_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t);
+void flog_flush(void);
+void flog_service(void);
+uint32_t flog_iterate(void (*fn)(const flog_reg_t *reg, uint32_t seq, void *ctx), void *ctx);
+const flog_stats_t *flog_get_stats(void);
+
+// La define la aplicacion: 1 si ahora se puede bloquear las interrupciones
+// ~100 ms para borrar un sector (no hay alarma en curso)
+uint8_t flog_borrado_permitido(void);
+
+#endif /* FLASH_LOG_H_ */
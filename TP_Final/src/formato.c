@@ -0,0 +1,126 @@
+#include "formato.h"
+
+static const char pares[200] =
+	"00010203040506070809" "10111213141516171819" "20212223242526272829"
+	"30313233343536373839" "40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879" "80818283848586878889"
+	"90919293949596979899";
+
+static const uint32_t potencias[10] = {
+	1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL,
+	1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
+
+// Cocientes exactos para todo uint32_t (UMULL en vez de UDIV, tambien sin
+// optimizar)
+static inline uint32_t div100(uint32_t v){
+	return (uint32_t)(((uint64_t)v * 0x51EB851FULL) >> 37);
+}
+
+static inline uint32_t div10(uint32_t v){
+	return (uint32_t)(((uint64_t)v * 0xCCCCCCCDULL) >> 35);
+}
+
+static inline uint8_t cant_digitos(uint32_t v){
+	uint8_t n = 1;
+	while(n < 10 && v >= potencias[n]) n++;
+	return n;
+}
+
+// Reserva 'n' posiciones; devuelve 0 (y marca el desborde) si no entran
+static inline uint8_t reservar(fmt_t *f, uint32_t n){
+	if(f->desborde || f->fin - f->pos < n){
+		f->desborde = 1;
+		return 0;
+	}
+	return 1;
+}
+
+// Escribe los 'n' digitos menos significativos de v (con ceros a la
+// izquierda si hacen falta) terminando en la posicion 'ultima'; devuelve
+// v / 10^n
+static uint32_t escribir_digitos(fmt_t *f, uint32_t v, uint8_t n, uint32_t ultima){
+	while(n >= 2){
+		uint32_t q = div100(v);
+		const char *p = &pares[(v - q * 100) * 2];
+		f->buf[ultima-- & f->mascara] = p[1];
+		f->buf[ultima-- & f->mascara] = p[0];
+		v = q;
+		n -= 2;
+	}
+	if(n){
+		uint32_t q = div10(v);
+		f->buf[ultima & f->mascara] = '0' + (char)(v - q * 10);
+		v = q;
+	}
+	return v;
+}
+
+void fmt_en_buffer(fmt_t *f, char *buf, uint32_t tam){
+	f->buf = buf;
+	f->mascara = 0xFFFFFFFFUL;
+	f->pos = 0;
+	f->fin = tam;
+	f->estado = 0;
+	f->desborde = 0;
+}
+
+void fmt_caracter(fmt_t *f, char c){
+	if(!reservar(f, 1)) return;
+	f->buf[f->pos++ & f->mascara] = c;
+}
+
+void fmt_texto(fmt_t *f, const char *s){
+	while(*s) fmt_caracter(f, *s++);
+}
+
+void fmt_u32(fmt_t *f, uint32_t v){
+	uint8_t n = cant_digitos(v);
+	if(!reservar(f, n)) return;
+	escribir_digitos(f, v, n, f->pos + n - 1);
+	f->pos += n;
+}
+
+void fmt_i32(fmt_t *f, int32_t v){
+	uint32_t u = (uint32_t)v;
+	if(v < 0){
+		if(!reservar(f, 2)) return;	// Sin lugar para el signo y un digito no se escribe nada
+		fmt_caracter(f, '-');
+		u = 0 - u;
+	}
+	fmt_u32(f, u);
+}
+
+void fmt_hex(fmt_t *f, uint32_t v, uint8_t digitos){
+	uint8_t n = 1;
+	while(n < 8 && (v >> (4 * n))) n++;
+	if(digitos > n) n = digitos;
+	if(!reservar(f, n)) return;
+	for(uint8_t i = 0; i < n; i++){
+		uint8_t s = 4 * (n - 1 - i);
+		f->buf[f->pos++ & f->mascara] = (s < 32) ? "0123456789abcdef"[(v >> s) & 0xF] : '0';
+	}
+}
+
+void fmt_fijo(fmt_t *f, int32_t v, uint8_t decimales){
+	uint32_t u = (uint32_t)v;
+	uint8_t negativo = v < 0;
+	if(decimales > 9) decimales = 9;
+	if(negativo) u = 0 - u;
+	if(decimales == 0){
+		fmt_i32(f, v);
+		return;
+	}
+
+	// Al menos un digito entero: 5 con 2 decimales es "0.05"
+	uint8_t n = cant_digitos(u);
+	if(n < decimales + 1) n = decimales + 1;
+	if(!reservar(f, n + 1 + negativo)) return;
+	if(negativo) f->buf[f->pos++ & f->mascara] = '-';
+
+	uint32_t ultima = f->pos + n;		// Hay un lugar mas por el punto
+	u = escribir_digitos(f, u, decimales, ultima);
+	f->buf[(ultima - decimales) & f->mascara] = '.';
+	escribir_digitos(f, u, n - decimales, ultima - decimales - 1);
+	f->pos += n + 1;
+}
@@ -0,0 +1,82 @@
+#ifndef FORMATO_H_
+#define FORMATO_H_
+
+#include <stdint.h>
+
+// --- Formato de texto sin libc ---
+// Enteros, punto fijo y hexadecimal escritos directo en el destino, sin
+// vsprintf ni division: los digitos salen de a dos desde una tabla "00".."99"
+// y el cociente por 100 es una multiplicacion por el reciproco. El largo se
+// calcula antes, asi que los digitos se escriben en su lugar sin invertir.
+//
+// El destino (fmt_t) puede ser un buffer lineal o un buffer circular de
+// potencia de 2 (mascara = tamano - 1): asi el mensaje se arma directamente
+// en el buffer de TX de una UART (ver enlace_esp_abrir). Si no entra, se
+// marca 'desborde' y lo escrito no se debe publicar.
+//
+// Salida identica a snprintf con %u, %d, %x, %0*x y %.*f (valor / 10^dec).
+
+typedef struct {
+	char *buf;
+	uint32_t mascara;		// 0xFFFFFFFF en un buffer lineal
+	uint32_t pos;			// Proxima posicion (sin aplicar la mascara)
+	uint32_t fin;			// Primera posicion que no se puede escribir
+	uint32_t estado;		// Lo usa el duenio del destino (p. ej. PRIMASK)
+	uint8_t desborde;
+} fmt_t;
+
+typedef struct { uint32_t valor; uint8_t digitos; } fmt_hex_t;
+typedef struct { int32_t valor; uint8_t decimales; } fmt_fijo_t;
+
+void fmt_en_buffer(fmt_t *f, char *buf, uint32_t tam);
+static inline uint32_t fmt_largo(const fmt_t *f, uint32_t inicio){ return f->pos - inicio; }
+
+void fmt_caracter(fmt_t *f, char c);
+void fmt_texto(fmt_t *f, const char *s);
+void fmt_u32(fmt_t *f, uint32_t v);
+void fmt_i32(fmt_t *f, int32_t v);
+void fmt_hex(fmt_t *f, uint32_t v, uint8_t digitos);		// digitos = 0: sin ceros a la izquierda
+void fmt_fijo(fmt_t *f, int32_t v, uint8_t decimales);	// v / 10^decimales, decimales <= 9
+
+static inline void fmt_hex_arg(fmt_t *f, fmt_hex_t h){ fmt_hex(f, h.valor, h.digitos); }
+static inline void fmt_fijo_arg(fmt_t *f, fmt_fijo_t x){ fmt_fijo(f, x.valor, x.decimales); }
+
+// Argumentos de FMT que no son enteros ni texto
+#define FMT_HEX(v, digitos)			((fmt_hex_t){ (v), (digitos) })
+#define FMT_FIJO(v, decimales)		((fmt_fijo_t){ (v), (decimales) })
+
+// Reemplazo de printf con los tipos resueltos al compilar: cada argumento se
+// formatea segun su tipo, en orden (enteros de hasta 32 bits). Un tipo no
+// previsto es un error de compilacion, no una salida corrupta.
+//   FMT(&f, "U", ppm, "@", t, "\n");
+#define FMT_ARG(f, x) _Generic((x), \
+	char: fmt_caracter, \
+	char *: fmt_texto, \
+	const char *: fmt_texto, \
+	signed char: fmt_i32, \
+	short: fmt_i32, \
+	int: fmt_i32, \
+	long: fmt_i32, \
+	unsigned char: fmt_u32, \
+	unsigned short: fmt_u32, \
+	unsigned int: fmt_u32, \
+	unsigned long: fmt_u32, \
+	fmt_hex_t: fmt_hex_arg, \
+	fmt_fijo_t: fmt_fijo_arg)((f), (x))
+
+#define FMT_1(f, a)			FMT_ARG(f, a)
+#define FMT_2(f, a, ...)	FMT_ARG(f, a); FMT_1(f, __VA_ARGS__)
+#define FMT_3(f, a, ...)	FMT_ARG(f, a); FMT_2(f, __VA_ARGS__)
+#define FMT_4(f, a, ...)	FMT_ARG(f, a); FMT_3(f, __VA_ARGS__)
+#define FMT_5(f, a, ...)	FMT_ARG(f, a); FMT_4(f, __VA_ARGS__)
+#define FMT_6(f, a, ...)	FMT_ARG(f, a); FMT_5(f, __VA_ARGS__)
+#define FMT_7(f, a, ...)	FMT_ARG(f, a); FMT_6(f, __VA_ARGS__)
+#define FMT_8(f, a, ...)	FMT_ARG(f, a); FMT_7(f, __VA_ARGS__)
+#define FMT_9(f, a, ...)	FMT_ARG(f, a); FMT_8(f, __VA_ARGS__)
+#define FMT_10(f, a, ...)	FMT_ARG(f, a); FMT_9(f, __VA_ARGS__)
+#define FMT_ELEGIR(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, N, ...)	N
+#define FMT(f, ...)	do{ \
+	FMT_ELEGIR(__VA_ARGS__, FMT_10, FMT_9, FMT_8, FMT_7, FMT_6, FMT_5, FMT_4, FMT_3, FMT_2, FMT_1, 0)(f, __VA_ARGS__); \
+} while(0)
+
+#endif /* FORMATO_H_ */
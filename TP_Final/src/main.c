@@ -1,13 +1,41 @@
 #include "lpc17xx.h"
-#include "lpc17xx_pinsel.h"
 #include "lpc17xx_timer.h"
 #include "lpc17xx_gpio.h"
 #include "lpc17xx_uart.h"
 #include "lpc17xx_adc.h"
-#include "lpc17xx_gpdma.h"
 #include "lpc17xx_exti.h"
+#include "lpc17xx_rit.h"
+#include "app_cfg.h"
+#include "placa.h"
+#include "prioridades.h"
+#include "tiempo.h"
+#include "atomico.h"
+#include "registros.h"
+#include "secciones.h"
+#include "traza.h"
+#include "dma_canal.h"
+#include "enlace_esp.h"
+#include "formato.h"
+#include "bitacora.h"
+#include "flash_log.h"
+#include "sensor.h"
+#include "ventana.h"
+#if APP_USE_SD_LOG
+#include "sd_log.h"
+#endif
+#if APP_USE_ETH
+#include "eth_telemetry.h"
+#endif
+#if APP_USE_CAN
+#include "can_net.h"
+#endif
+#if APP_USE_MODBUS
+#include "modbus.h"
+#endif
+#if APP_USE_PERFIL
+#include "perfil.h"
+#endif
 #include <stdio.h>
-#include <math.h>
 
 #define LED_ROJO 		(1<<2)
 #define LED_VERDE 		(1<<27)
@@ -15,90 +43,167 @@
 #define BUZZER 			(1<<22)
 
 #define ADC_FREQ 		20000
-#define NUM_SAMPLES_ADC	10
+#define NUM_SAMPLES_ADC	VENTANA_MUESTRAS
 
+// Valores de calibracion por defecto (modificables por Modbus; R0 y RL en sensor.h)
 #define UMBRAL_PRECAUCION_PPM   25   	// Ajustar segun calibracion
-#define R0_SENSOR				72.41  	// Resistencia en kOhm del sensor en aire limpio
-#define RL_SENSOR				47
+#define UMBRAL_CRITICO_PPM		200		// Mismo nivel critico que el dashboard
+#define HISTERESIS_PPM			3		// Banda para bajar de nivel
 #define MUESTRAS_PELIGROSAS_SEG	10
 
 #define TIEMPO_MUESTRA_PROMEDIO 3000
 #define TIEMPO_TRANSMISION_VIVO 10000
 
+// Autotest de LEDs al arrancar, por RIT y sin demorar la adquisicion
+#define AUTOTEST_PERIODO_MS		100
+#define AUTOTEST_PASOS			6		// 3 parpadeos
+#define ARRANQUE_MHZ_INICIAL	4		// Reloj del nucleo antes de conectar el PLL
+
+// Estados de la alarma
+#define ESTADO_SEGURO			0
+#define ESTADO_PRECAUCION		1
+#define ESTADO_CRITICO			2
+
 volatile uint8_t 	flag_buzzer_toggle = 0;
+volatile uint8_t 	autotest_activo = 1;	// Los LEDs y el buzzer son del autotest hasta que termina
 volatile uint8_t 	status_flag = 0;
 
-volatile uint16_t 	actual_adc_samples[NUM_SAMPLES_ADC];
-volatile uint16_t 	last_adc_value_ppm = 0;
-volatile uint16_t 	last_samples_for_average[NUM_SAMPLES_ADC];
+volatile uint16_t 	last_adc_raw = 0;		// Codigo de la ultima muestra (lo escribe el ADC)
+volatile uint16_t 	last_adc_value_ppm = 0;	// Su conversion, hecha en PendSV
 volatile uint16_t 	samples_average_ppm = 0;
+volatile uint8_t 	alarm_state = ESTADO_SEGURO;
+volatile uint32_t 	sample_count = 0;	// Muestras desde el arranque (1 por segundo)
+volatile uint16_t 	min_raw = 0xFFFF;	// Extremos en codigos del ADC: la curva es creciente
+volatile uint16_t 	max_raw = 0;
+
+// Marcas de tiempo_us() para medir la edad del dato en el tablero: captura
+// de la ultima muestra y calculo del ultimo promedio
+volatile uint32_t 	last_adc_time_us = 0;
+volatile uint32_t 	samples_average_time_us = 0;
+
+// Tiempo desde el reset hasta la primera muestra. ResetISR guarda los ciclos
+// anteriores al PLL y reinicia el contador del DWT.
+uint32_t 			arranque_ciclos_iniciales;
+volatile uint32_t 	arranque_us = 0;
+
+volatile uint16_t 	umbral_precaucion_ppm = UMBRAL_PRECAUCION_PPM;
+
+// Umbrales en codigos del ADC (sensor.h). La interrupcion del ADC compara
+// enteros y encola el codigo crudo: la conversion a ppm se hace en PendSV.
+volatile uint16_t 	raw_precaucion;			// Entrar en PRECAUCION
+volatile uint16_t 	raw_precaucion_bajo;	// Volver a SEGURO (con histeresis)
+volatile uint16_t 	raw_critico;			// Entrar en CRITICO
+volatile uint16_t 	raw_critico_bajo;		// Volver a PRECAUCION (con histeresis)
+
+// Ventanas de NUM_SAMPLES_ADC muestras crudas, sin copias (ventana.h): la
+// interrupcion del ADC llena una mientras la otra queda publicada
+ventana_t 			sample_window = VENTANA_INIT(sample_window);
+
+// Trabajo diferido: las interrupciones encolan registros y piden PendSV, que
+// corre con la menor prioridad y los reparte a los logs y la telemetria.
+// La cola es MPSC sin bloqueo (atomico.h): el ADC y cualquier otra
+// interrupcion encolan sin deshabilitar interrupciones; el TIMER2 solo pone
+// una bandera para que PendSV calcule el promedio.
+#define LOG_PENDIENTES			16		// Potencia de 2
+#define LOG_CRUDO				0x80	// En tipo: valor es un codigo del ADC, PendSV lo pasa a ppm
+typedef struct {
+	uint32_t t;
+	uint16_t valor;
+	uint8_t  tipo;
+	uint8_t  aux;
+} log_pendiente_t;
+
+log_pendiente_t 	log_queue[LOG_PENDIENTES];
+atomico_u32_t 		log_queue_seq[LOG_PENDIENTES];
+cola_mpsc_t 		log_cola;
+atomico_u32_t 		log_dropped = 0;
+atomico_u32_t 		telemetry_pending = 0;
+atomico_u32_t 		average_pending = 0;	// TIMER2 pide el promedio; lo calcula PendSV
 
 
-void cfgPin(uint8_t port_num, uint8_t pin_num, uint8_t func_num);
-void pinConfiguration(void);
 void cfgTimer(void);
 void cfgADC(void);
 void cfgUART(void);
 void cfgDMA(void);
-void DMA_SetupAndStart_CH7(void);
+void cfgAutotest(void);
 
 uint16_t calc_average_ppm(void);
-uint16_t convert_adc_to_ppm(uint16_t raw_data);
+void recalc_thresholds(void);
 
-void UART_SendChar_Safe(char c);
-void UART_SendNumber_Safe(char prefix, uint16_t num);
+void UART_SendNumber_Safe(char prefix, uint16_t num, uint32_t t_captura);
+EN_RAM void set_alarm_state(uint8_t new_state);
+EN_RAM void aplicar_salidas(uint8_t estado);
+EN_RAM void log_event(uint8_t tipo, uint16_t valor, uint8_t aux);
+void log_dispatch(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t);
 
 int main(){
 
+	prioridades_init();
+#if APP_USE_TRAZA
+	traza_init(); // Antes de habilitar cualquier interrupcion
+#endif
+	cola_mpsc_init(&log_cola, log_queue_seq, LOG_PENDIENTES);
 	pinConfiguration();
+	recalc_thresholds();
 
-    // Indicación visual de inicio: parpadeo rapido de todos los LEDs
-    for(uint8_t i = 0; i < 3; i++){
-    	LPC_GPIO0 -> FIOSET |= (LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER);
-        for(volatile uint32_t j = 0; j < 1000000; j++); // Delay
-        LPC_GPIO0 -> FIOCLR |= (LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER);
-        for(volatile uint32_t j = 0; j < 1000000; j++); // Delay
-    }
-
-	cfgDMA();
-	cfgUART();
+	// La adquisicion y la alarma arrancan primero. PendSV queda enmascarada
+	// hasta que los logs y las comunicaciones esten listos: mientras tanto
+	// los registros esperan en la cola.
+	__set_BASEPRI(PRIO_DIFERIDO << (8 - __NVIC_PRIO_BITS));
+	tiempo_init();
     cfgADC();
     cfgTimer();
+	cfgAutotest(); // Indicación visual de inicio, en paralelo
 
-	while(1){};
+	flog_init();
+	cfgDMA();
+#if APP_USE_SD_LOG
+	sd_log_init(flog_get_stats()->arranque); // Sin tarjeta queda deshabilitado
+#endif
+#if APP_USE_ETH
+	eth_telemetry_init(flog_get_stats()->arranque); // Sin PHY queda deshabilitado
+#endif
+#if APP_USE_CAN
+	can_net_init(APP_CAN_CONCENTRADOR);
+#endif
+#if APP_USE_MODBUS
+	modbus_init();
+#endif
+	cfgUART();
+#if APP_USE_PERFIL
+	perfil_init(); // Muestrea recien cuando se le pide por la UART3
+#endif
+#if APP_USE_BITACORA
+	bitacora_init();
+#endif
+	BITACORA("arranque %u: %u paginas corruptas en flash, %u leidas",
+			flog_get_stats()->arranque, flog_get_stats()->paginas_corruptas, flog_get_stats()->lecturas_arranque);
+	__set_BASEPRI(0);
+
+	while(1){
+		// Las escrituras en flash (IAP) se hacen fuera de las interrupciones
+		flog_service();
+#if APP_USE_SD_LOG
+		sd_log_service();
+#endif
+#if APP_USE_ETH
+		eth_telemetry_service();
+#endif
+#if APP_USE_MODBUS
+		modbus_service();
+#endif
+#if APP_USE_PERFIL
+		perfil_service();
+#endif
+#if APP_USE_BITACORA
+		bitacora_service();
+#endif
+	};
 
     return 0;
 }
 
 
-void cfgPin(uint8_t port, uint8_t pin_num, uint8_t func){
-	PINSEL_CFG_Type pin;
-	pin.Portnum = port;
-	pin.Pinnum = pin_num;
-	pin.Funcnum = func;
-	pin.Pinmode = PINSEL_PINMODE_TRISTATE;
-	pin.OpenDrain = PINSEL_PINMODE_NORMAL;
-	PINSEL_ConfigPin(&pin);
-}
-
-void pinConfiguration(void){
-    // ADC0.0 (Sensor CO)
-	cfgPin(0, 23, 1);
-
-    // MAT0.1 (Trigger del ADC)
-	cfgPin(1, 29, 3);
-
-    // TXD2 (UART2 para ESP8266)
-	cfgPin(0, 10, 1);
-
-    // P0.22 (Buzzer)
-	cfgPin(0, 22, 0);
-
-    // Configuracion de LEDs (P0.2, P0.27, P0.3) y Buzzer (P0.22) como salidas
-	LPC_GPIO0 -> FIODIR |= (LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER );
-	LPC_GPIO0 -> FIOCLR |= (LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER );
-}
-
 void cfgTimer(void){
 	// --- Timer 0: Generador de Pulsos (Trigger ADC y Envio UART) ---
 	TIM_TIMERCFG_Type timerMode0;
@@ -115,6 +220,10 @@ void cfgTimer(void){
 
 	TIM_Init(LPC_TIM0, TIM_TIMER_MODE, &timerMode0);
 	TIM_ConfigMatch(LPC_TIM0, &timerMAT01);
+	// MAT0.1 arranca en alto y a 1 ms del match: la primera conversion (flanco
+	// de bajada) no espera un periodo completo
+	LPC_TIM0->EMR |= (1 << 1);
+	LPC_TIM0->TC = timerMAT01.MatchValue - 1;
 	TIM_Cmd(LPC_TIM0, ENABLE);
 
 	// --- Timer 1: Generador de Tono para Buzzer (Alarma) ---
@@ -174,213 +283,350 @@ void cfgUART(void){
 	UART_Init(LPC_UART2, &pinUART2);
 	UART_FIFOConfigStructInit(&UARTFIFO);
 	UART_FIFOConfig(LPC_UART2, &UARTFIFO);
-	UART_IntConfig(LPC_UART2, UART_INTCFG_RBR, DISABLE);
 	UART_TxCmd(LPC_UART2, ENABLE);
+	enlace_esp_init();
 }
-void DMA_SetupAndStart_CH7(void){
-    // Reconfigura el canal DMA 7 (M2M) para asegurar que el contador de transferencia se reinicie.
-	GPDMA_Channel_CFG_Type  cfgMEM_DMA_CH7;
-
-	cfgMEM_DMA_CH7.ChannelNum = 7;
-	cfgMEM_DMA_CH7.TransferSize = NUM_SAMPLES_ADC;
-	cfgMEM_DMA_CH7.TransferType = GPDMA_TRANSFERTYPE_M2M;
-	// Usar Half-Word (16 bits) ya que los buffers son uint16_t
-	cfgMEM_DMA_CH7.TransferWidth = GPDMA_WIDTH_HALFWORD;
-	cfgMEM_DMA_CH7.SrcMemAddr = (uint32_t)actual_adc_samples;
-	cfgMEM_DMA_CH7.DstMemAddr = (uint32_t)last_samples_for_average;
-	cfgMEM_DMA_CH7.SrcConn = 0;
-	cfgMEM_DMA_CH7.DstConn = 0;
-	cfgMEM_DMA_CH7.DMALLI = 0;
-
-	// Configurar y habilitar el canal para una unica transferencia
-	GPDMA_Setup(&cfgMEM_DMA_CH7);
-	GPDMA_ChannelCmd(7, ENABLE);
-	NVIC_EnableIRQ(DMA_IRQn);
-}
-
 void cfgDMA(void){
-	NVIC_DisableIRQ(DMA_IRQn);
-	GPDMA_Init();
-	// No se configura el canal aqui, sino en DMA_SetupAndStart_CH7 para poder reusarlo.
+	// Los canales los pide y configura cada modulo que los usa (tarjeta SD)
+	dma_canal_init();
 }
 
-uint16_t convert_adc_to_ppm(uint16_t raw_data){
-	// El valor raw es de 12 bits (0-4095)
-	if (raw_data == 0) return 0;
-
-	// Voltaje de salida del sensor Vs = (raw_data / 4096) * 3.3V
-	// Resistencia del sensor Rs = (3.3V - Vs) * RL / Vs
-	// Resistencia del sensor Rs = RL_SENSOR * (4096 - raw_data) / raw_data
-
-	float rs = (float) (4096.0f - raw_data) * RL_SENSOR /raw_data;
-
-	// Relacion Rs/Ro
-	float rs_ro_ratio = rs / R0_SENSOR;
-
-//	float x = 100.0f * rs_ro_ratio;
-	uint16_t concentracion_ppm = (uint16_t) 100 * pow(rs_ro_ratio, -1.52f);
+void cfgAutotest(void){
+	RIT_Init(LPC_RIT);
+	RIT_TimerConfig(LPC_RIT, AUTOTEST_PERIODO_MS);
+	NVIC_EnableIRQ(RIT_IRQn);
+}
 
-	// Asegurar un valor positivo
-	return (concentracion_ppm > 0) ? concentracion_ppm : 0;
+// Se llama al arrancar y cada vez que cambia la calibracion
+void recalc_thresholds(void){
+	uint16_t umbral = umbral_precaucion_ppm;
+	uint16_t precaucion = ppm_to_adc_threshold(umbral);
+	uint16_t bajo = ppm_to_adc_threshold(umbral > HISTERESIS_PPM ? umbral - HISTERESIS_PPM : 1);
+	uint16_t critico = ppm_to_adc_threshold(UMBRAL_CRITICO_PPM);
+	uint16_t critico_bajo = ppm_to_adc_threshold(UMBRAL_CRITICO_PPM - HISTERESIS_PPM);
+
+	NVIC_DisableIRQ(ADC_IRQn);
+	raw_precaucion = precaucion;
+	raw_precaucion_bajo = bajo;
+	raw_critico = critico;
+	raw_critico_bajo = critico_bajo;
+	NVIC_EnableIRQ(ADC_IRQn);
 }
 
+// En PendSV: NUM_SAMPLES_ADC conversiones a ppm no van en una interrupcion
 uint16_t calc_average_ppm(void){
-	uint16_t sum = 0;
+	uint32_t seq;
+	uint32_t sum;
+
+	// Se calcula sobre la ventana publicada; si se publico otra mientras
+	// tanto (la interrupcion del ADC volvio a escribir en ella), se repite
+	do{
+		const volatile uint16_t *ventana = ventana_leer_inicio(&sample_window, &seq);
+		sum = 0;
+		for(uint16_t inte = 0; inte < NUM_SAMPLES_ADC; inte++){
+			sum += convert_adc_to_ppm(ventana[inte]);
+		}
+	} while(ventana_reintentar(&sample_window, seq));
 
-	// Iteracion sobre el banco de memoria
-	for(uint16_t inte = 0; inte < NUM_SAMPLES_ADC; inte++){
-		uint16_t aux = convert_adc_to_ppm(last_samples_for_average[inte]);
-		sum += aux;
-	}
-	uint16_t samples_average = (uint16_t) sum / NUM_SAMPLES_ADC;
+	uint16_t samples_average = (uint16_t)(sum / NUM_SAMPLES_ADC);
 	return samples_average;
 }
 
-void UART_SendChar_Safe(char c) {
-    // Espera hasta que el registro de transmision (THR) este vacio, usando registro directo.
-    while (!(LPC_UART2->LSR & UART_LSR_THRE));
-    // Escribe directamente en el registro de datos
-    LPC_UART2->THR = (uint8_t)c;
+// Registra los cambios de estado de la alarma (se fuerzan a flash al despacharlos)
+EN_RAM void set_alarm_state(uint8_t new_state){
+	if(new_state != alarm_state){
+		alarm_state = new_state;
+		TRAZA(TRAZA_ALARMA, 0, new_state);
+		log_event(FLOG_EVENTO_ALARMA | LOG_CRUDO, last_adc_raw, new_state);
+	}
 }
 
-// Función manual para convertir uint16_t a string
-static char *uint16_to_string_manual(uint16_t num, char *buffer) {
-    int i = 0;
-    if (num == 0) {
-        buffer[i++] = '0';
-        buffer[i] = '\0';
-        return buffer;
-    }
-    uint16_t temp = num;
-    while (temp > 0) {
-        buffer[i++] = (temp % 10) + '0';
-        temp /= 10;
-    }
-    buffer[i] = '\0';
-
-    int start = 0;
-    int end = i - 1;
-    char swap_char;
-
-    while (start < end) {
-        swap_char = buffer[start];
-        buffer[start] = buffer[end];
-        buffer[end] = swap_char;
-        start++;
-        end--;
-    }
-    return buffer;
+// LEDs y buzzer de cada estado de la alarma (el tono lo genera TIMER1)
+EN_RAM void aplicar_salidas(uint8_t estado){
+	if(estado == ESTADO_SEGURO){
+		gpio_poner(LPC_GPIO0, LED_VERDE);
+		gpio_limpiar(LPC_GPIO0, LED_AMARILLO | LED_ROJO | BUZZER);
+		tim_detener(LPC_TIM1);
+		NVIC_DisableIRQ(TIMER1_IRQn);
+	} else if(estado == ESTADO_CRITICO){
+		gpio_limpiar(LPC_GPIO0, LED_VERDE | LED_AMARILLO);
+		gpio_poner(LPC_GPIO0, LED_ROJO);
+		tim_arrancar(LPC_TIM1); // Activar buzzer con PWM
+		NVIC_EnableIRQ(TIMER1_IRQn);
+	} else{
+		gpio_limpiar(LPC_GPIO0, LED_VERDE | LED_ROJO | BUZZER);
+		gpio_poner(LPC_GPIO0, LED_AMARILLO);
+		tim_detener(LPC_TIM1);
+		NVIC_DisableIRQ(TIMER1_IRQn);
+	}
 }
 
-// Función que utiliza UART_SendChar_Safe para transmitir
-void UART_SendNumber_Safe(char prefix, uint16_t num){
-    char tx_buffer[8];
-    int j = 0;
-
-    tx_buffer[j++] = prefix;
+// Encola un registro para PendSV; se puede llamar desde cualquier interrupcion
+EN_RAM void log_event(uint8_t tipo, uint16_t valor, uint8_t aux){
+	uint32_t pos;
+	int32_t i = cola_mpsc_reservar(&log_cola, &pos);
+	if(i >= 0){
+		log_pendiente_t *p = &log_queue[i];
+		p->t = sample_count;
+		p->valor = valor;
+		p->tipo = tipo;
+		p->aux = aux;
+		cola_mpsc_publicar(&log_cola, pos);
+		TRAZA(TRAZA_COLA, tipo, valor);
+	} else{
+		atomico_sumar(&log_dropped, 1);
+	}
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
 
-    uint16_to_string_manual(num, &tx_buffer[j]);
+// Agrega un registro a todos los destinos habilitados (logs y telemetria)
+void log_dispatch(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t){
+	switch(tipo){
+	case FLOG_MUESTRA:		BITACORA("muestra %u ppm, estado %u", valor, aux); break;
+	case FLOG_PROMEDIO:		BITACORA("promedio %u ppm", valor); break;
+	case FLOG_EVENTO_ALARMA:	BITACORA("alarma: estado %u con %u ppm", aux, valor); break;
+	}
+	flog_append(tipo, valor, aux, t);
+	if(tipo == FLOG_EVENTO_ALARMA) flog_flush();
+#if APP_USE_SD_LOG
+	sd_log_append(tipo, valor, aux, t);
+#endif
+#if APP_USE_ETH
+	eth_telemetry_append(tipo, valor, aux, t);
+#endif
+#if APP_USE_CAN
+	can_net_append(tipo, valor, aux, t);
+#endif
+}
 
-    while(tx_buffer[j] != '\0') {
-        j++;
-    }
+// Los borrados de sector de la flash bloquean la alarma ~100 ms: solo en estado seguro
+uint8_t flog_borrado_permitido(void){
+	return alarm_state == ESTADO_SEGURO;
+}
 
-    tx_buffer[j++] = '\n';
+#if APP_USE_MODBUS
+// Mapa Modbus. Input: 0 ppm actual, 1 promedio, 2 minimo, 3 maximo,
+// 4 estado de alarma, 5-6 muestras (alta, baja), 7 arranque,
+// 8-9 us desde el reset hasta la primera muestra (alta, baja).
+// Holding: 0 umbral de precaucion (ppm), 1 R0 (kOhm x 100), 2 RL (kOhm),
+// 3 escribir 1 reinicia minimo y maximo.
+uint8_t modbus_leer_registro(uint8_t tabla, uint16_t dir, uint16_t *valor){
+	if(tabla == MODBUS_INPUT){
+		uint32_t muestras = sample_count;
+		switch(dir){
+		case 0: *valor = convert_adc_to_ppm(last_adc_raw); break;
+		case 1: *valor = samples_average_ppm; break;
+		case 2: *valor = (min_raw == 0xFFFF) ? 0 : convert_adc_to_ppm(min_raw); break;
+		case 3: *valor = convert_adc_to_ppm(max_raw); break;
+		case 4: *valor = alarm_state; break;
+		case 5: *valor = (uint16_t)(muestras >> 16); break;
+		case 6: *valor = (uint16_t)muestras; break;
+		case 7: *valor = flog_get_stats()->arranque; break;
+		case 8: *valor = (uint16_t)(arranque_us >> 16); break;
+		case 9: *valor = (uint16_t)arranque_us; break;
+		default: return MODBUS_EXC_DIRECCION;
+		}
+	} else{
+		switch(dir){
+		case 0: *valor = umbral_precaucion_ppm; break;
+		case 1: *valor = (uint16_t)(r0_sensor * 100.0f + 0.5f); break;
+		case 2: *valor = (uint16_t)(rl_sensor + 0.5f); break;
+		case 3: *valor = 0; break;
+		default: return MODBUS_EXC_DIRECCION;
+		}
+	}
+	return 0;
+}
 
-	for (int i = 0; i < j; i++) {
-		UART_SendChar_Safe(tx_buffer[i]);
+uint8_t modbus_escribir_registro(uint16_t dir, uint16_t valor){
+	switch(dir){
+	case 0:
+		if(valor == 0) return MODBUS_EXC_VALOR;
+		umbral_precaucion_ppm = valor;
+		recalc_thresholds();
+		BITACORA("modbus: umbral de precaucion %u ppm", valor);
+		break;
+	case 1:
+		if(valor == 0) return MODBUS_EXC_VALOR;
+		r0_sensor = valor / 100.0f;
+		recalc_thresholds();
+		BITACORA("modbus: R0 %u.%02u kOhm", valor / 100, valor % 100);
+		break;
+	case 2:
+		if(valor == 0) return MODBUS_EXC_VALOR;
+		rl_sensor = valor;
+		recalc_thresholds();
+		BITACORA("modbus: RL %u kOhm", valor);
+		break;
+	case 3:
+		if(valor != 1) return MODBUS_EXC_VALOR;
+		NVIC_DisableIRQ(ADC_IRQn);
+		min_raw = 0xFFFF;
+		max_raw = 0;
+		NVIC_EnableIRQ(ADC_IRQn);
+		break;
+	default:
+		return MODBUS_EXC_DIRECCION;
 	}
+	return 0;
+}
+#endif
+
+// Encola el valor para el ESP8266 sin esperar a la UART. Formato:
+// <prefijo><ppm>@<t_captura>+<us desde la captura>, el ESP8266 lo pasa a su
+// reloj con el desfase que mide por ping (enlace_esp.h)
+void UART_SendNumber_Safe(char prefix, uint16_t num, uint32_t t_captura){
+	fmt_t f;
+
+	enlace_esp_abrir(&f);
+	FMT(&f, prefix, num, "@", t_captura, "+", tiempo_us() - t_captura, "\n");
+	enlace_esp_cerrar(&f);
 }
 
 
 // --- MANEJO DE INTERRUPCIONES ---
 
-void ADC_IRQHandler(void){
+EN_RAM void ADC_IRQHandler(void){
     // Contador para mantener el estado de alarma critica
 	static uint8_t alarm_counter = 0;
-	static uint8_t sample_idx = 0; // Índice para llenar el buffer actual
-
-	// Verificamos si la interrupción por canal 0 se disparó.
-    if(ADC_ChannelGetStatus(LPC_ADC, ADC_CHANNEL_0, ADC_DATA_DONE)){
 
-    	// 1. CAPTURA Y ALMACENAMIENTO DE DATO
-    	actual_adc_samples[sample_idx] = (ADC_ChannelGetData(LPC_ADC, ADC_CHANNEL_0));
-        // 2. CONVERSION y LÓGICA DE TIEMPO REAL
-        last_adc_value_ppm = convert_adc_to_ppm(actual_adc_samples[sample_idx]);
+	uint16_t raw;
+	uint32_t t = tiempo_us();	// Captura: se toma antes de cualquier proceso
 
-        // 3. ACTUALIZAR ÍNDICE (Captura circular manual)
-        sample_idx = (sample_idx + 1) % NUM_SAMPLES_ADC;
+	TRAZA_ENTRA();
+	// Verificamos si la interrupción por canal 0 se disparó (una sola lectura de ADDR0)
+    if(adc_leer_canal(ADC_CHANNEL_0, &raw)){
 
-        // --- Logica de Alarmas ---
-		if(last_adc_value_ppm < UMBRAL_PRECAUCION_PPM){
+    	// 1. CAPTURA Y ALMACENAMIENTO DE DATO
+    	ventana_agregar(&sample_window, raw);	// Publica la ventana al completarla
+    	uint8_t nuevo_estado;
+
+        // 2. LÓGICA DE TIEMPO REAL: comparaciones enteras contra los umbrales en
+        // codigos del ADC; para bajar de nivel hay que pasar la histeresis
+        uint16_t umbral = (alarm_state == ESTADO_SEGURO) ? raw_precaucion : raw_precaucion_bajo;
+        uint16_t umbral_critico = (alarm_state == ESTADO_CRITICO) ? raw_critico_bajo : raw_critico;
+		if(raw < umbral){
 			// Estado SEGURO: LED Verde
 			alarm_counter = 0;
-			LPC_GPIO0 -> FIOSET |= (LED_VERDE);
-			LPC_GPIO0 -> FIOCLR |= (LED_AMARILLO | LED_ROJO | BUZZER);
-	        TIM_Cmd(LPC_TIM1, DISABLE);
-			NVIC_DisableIRQ(TIMER1_IRQn);
-		} else if(alarm_counter >= MUESTRAS_PELIGROSAS_SEG){
-			alarm_counter++;
+			nuevo_estado = ESTADO_SEGURO;
+		} else if(raw >= umbral_critico || alarm_counter >= MUESTRAS_PELIGROSAS_SEG){
+			if(alarm_counter < 255) alarm_counter++;
 			// Estado CRITICO: LED Rojo + Buzzer
-			LPC_GPIO0 -> FIOCLR |= (LED_VERDE | LED_AMARILLO);
-			LPC_GPIO0 -> FIOSET |= (LED_ROJO);
-			TIM_Cmd(LPC_TIM1, ENABLE); // Activar buzzer con PWM
-			NVIC_EnableIRQ(TIMER1_IRQn);
-		} else if(last_adc_value_ppm >= UMBRAL_PRECAUCION_PPM){
+			nuevo_estado = ESTADO_CRITICO;
+		} else{
 			// Estado PRECAUCION: LED Amarillo
 			alarm_counter++; // Acumular lecturas de precaucion
-			LPC_GPIO0 -> FIOCLR |= (LED_VERDE | LED_ROJO | BUZZER);
-			LPC_GPIO0 -> FIOSET |= (LED_AMARILLO);
-			TIM_Cmd(LPC_TIM1, DISABLE);
-			NVIC_DisableIRQ(TIMER1_IRQn);
+			nuevo_estado = ESTADO_PRECAUCION;
 		}
+		// Durante el autotest las salidas quedan para el RIT, que al terminar
+		// aplica el estado de la ultima muestra
+		if(!autotest_activo) aplicar_salidas(nuevo_estado);
+
+        // 3. Dato crudo para telemetria y registros (PendSV lo convierte)
+        last_adc_raw = raw;
+        last_adc_time_us = t;
+
+        if(sample_count == 0){
+        	arranque_us = arranque_ciclos_iniciales / ARRANQUE_MHZ_INICIAL +
+        			dwt_ciclos() / (SystemCoreClock / 1000000);
+        	BITACORA("primera muestra a %u us del reset", arranque_us);
+        }
+        sample_count++;
+        if(raw < min_raw) min_raw = raw;
+        if(raw > max_raw) max_raw = raw;
+        log_event(FLOG_MUESTRA | LOG_CRUDO, raw, alarm_state);
+        set_alarm_state(nuevo_estado);
+
+		// El envio al ESP8266 se hace en PendSV (pedido por log_event)
+		atomico_bandera_poner(&telemetry_pending);
+    }
+    TRAZA_SALE();
+}
+
+// Menor prioridad del sistema: todo lo que no decide la alarma
+void PendSV_Handler(void){
+	int32_t i;
+
+	TRAZA_ENTRA();
+	while((i = cola_mpsc_siguiente(&log_cola)) >= 0){
+		log_pendiente_t *p = &log_queue[i];
+		uint16_t valor = (p->tipo & LOG_CRUDO) ? convert_adc_to_ppm(p->valor) : p->valor;
+		log_dispatch(p->tipo & ~LOG_CRUDO, valor, p->aux, p->t);
+		cola_mpsc_liberar(&log_cola);
+	}
 
-		// USO DE LA FUNCION UART SEGURA (HardFault Fix)
+	// Promedio de la ultima ventana publicada, sin copiarla
+	if(atomico_bandera_tomar(&average_pending)){
+		samples_average_ppm = calc_average_ppm();
+		samples_average_time_us = tiempo_us();
+		log_dispatch(FLOG_PROMEDIO, samples_average_ppm, alarm_state, sample_count);
+	}
+
+	if(atomico_bandera_tomar(&telemetry_pending)){
+		last_adc_value_ppm = convert_adc_to_ppm(last_adc_raw);
 		if(status_flag){
-			UART_SendNumber_Safe('P' ,samples_average_ppm);
+			UART_SendNumber_Safe('P', samples_average_ppm, samples_average_time_us);
 		}else{
-			UART_SendNumber_Safe('U', last_adc_value_ppm);
+			UART_SendNumber_Safe('U', last_adc_value_ppm, last_adc_time_us);
 		}
-    }
+	}
+	TRAZA_SALE();
 }
 
-void TIMER1_IRQHandler(void){
+EN_RAM void TIMER1_IRQHandler(void){
 	// Maneja la oscilacion del buzzer para generar un tono.
-    if(TIM_GetIntStatus(LPC_TIM1, TIM_MR0_INT)){
-        TIM_ClearIntPending(LPC_TIM1, TIM_MR0_INT);
+	TRAZA_ENTRA();
+    if(tim_int_pendiente(LPC_TIM1, 0)){
+        tim_int_limpiar(LPC_TIM1, 0);
         if(flag_buzzer_toggle == 0){
-			LPC_GPIO0 -> FIOSET |= (BUZZER);
+			gpio_poner(LPC_GPIO0, BUZZER);
 			flag_buzzer_toggle = 1;
         } else{
-            LPC_GPIO0 -> FIOCLR |= (BUZZER);
+            gpio_limpiar(LPC_GPIO0, BUZZER);
             flag_buzzer_toggle = 0;
         }
     }
+    TRAZA_SALE();
+}
+
+// Autotest: AUTOTEST_PASOS pasos de parpadeo de LEDs y buzzer. La adquisicion
+// ya corre (la primera muestra llega ~1 ms despues del arranque) pero no toca
+// las salidas hasta que termina; entonces se muestra el estado de la alarma.
+void RIT_IRQHandler(void){
+	static uint8_t paso = 0;
+
+	RIT_GetIntStatus(LPC_RIT); // Limpia la bandera
+	NVIC_DisableIRQ(ADC_IRQn);
+	if(paso >= AUTOTEST_PASOS){
+		RIT_Cmd(LPC_RIT, DISABLE);
+		NVIC_DisableIRQ(RIT_IRQn);
+		autotest_activo = 0;
+		if(sample_count != 0) aplicar_salidas(alarm_state);
+		else gpio_limpiar(LPC_GPIO0, LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER);
+	} else if(paso++ & 1){
+		gpio_limpiar(LPC_GPIO0, LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER);
+	} else{
+		gpio_poner(LPC_GPIO0, LED_VERDE | LED_ROJO | LED_AMARILLO | BUZZER);
+	}
+	NVIC_EnableIRQ(ADC_IRQn);
 }
 
-void TIMER2_IRQHandler(void){
-    if(TIM_GetIntStatus(LPC_TIM2, TIM_MR0_INT)){
+EN_RAM void TIMER2_IRQHandler(void){
+	TRAZA_ENTRA();
+    if(tim_int_pendiente(LPC_TIM2, 0)){
         if(status_flag == 0){
         	status_flag = 1;
-			TIM_UpdateMatchValue(LPC_TIM2, 0, (uint32_t)TIEMPO_MUESTRA_PROMEDIO);
-			TIM_ResetCounter(LPC_TIM2);
-			TIM_Cmd(LPC_TIM2, ENABLE);
+			tim_rearmar(LPC_TIM2, 0, (uint32_t)TIEMPO_MUESTRA_PROMEDIO);
 
-			DMA_SetupAndStart_CH7(); // Reinicia la transferencia de los datos
+			// El promedio se calcula y se registra en PendSV
+			atomico_bandera_poner(&average_pending);
+			SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
         } else{
         	status_flag = 0;
-			TIM_UpdateMatchValue(LPC_TIM2, 0, (uint32_t)TIEMPO_TRANSMISION_VIVO);
-			TIM_ResetCounter(LPC_TIM2);
-			TIM_Cmd(LPC_TIM2, ENABLE);
+			tim_rearmar(LPC_TIM2, 0, (uint32_t)TIEMPO_TRANSMISION_VIVO);
         }
-        TIM_ClearIntPending(LPC_TIM2, TIM_MR0_INT);
+        tim_int_limpiar(LPC_TIM2, 0);
     }
+    TRAZA_SALE();
 }
 
-void DMA_IRQHandler(void){
-	if(GPDMA_IntGetStatus(GPDMA_STAT_INTTC, 7)){
-		samples_average_ppm = calc_average_ppm();
-		GPDMA_ClearIntPending(GPDMA_STAT_INTTC, 7);
-		GPDMA_ChannelCmd(7, DISABLE);
-	}
-}
@@ -0,0 +1,268 @@
+#include "modbus.h"
+#include "tiempo.h"
+#include "lpc17xx_uart.h"
+#include "traza.h"
+
+#define MB_REPOSO			0
+#define MB_RECIBIENDO		1
+#define MB_TRAMA_LISTA		2
+#define MB_TRANSMITIENDO	3
+
+// Silencio de fin de trama: 3,5 caracteres de 11 bits; por encima de
+// 19200 baudios la especificacion lo fija en 1750 us
+#if MODBUS_BAUD > 19200
+#define MB_T35_US			1750
+#else
+#define MB_T35_US			(38500000UL / MODBUS_BAUD)
+#endif
+
+static uint8_t rx[MODBUS_TAM_TRAMA];
+static uint8_t tx[MODBUS_TAM_TRAMA];
+static volatile uint16_t rx_n = 0;
+static volatile uint8_t rx_error = 0;
+static volatile uint8_t descartando = 0;
+static volatile uint8_t estado = MB_REPOSO;
+static volatile uint16_t tx_n = 0;
+static volatile uint16_t tx_idx = 0;
+
+static modbus_stats_t stats;
+
+// CRC-16/MODBUS (polinomio reflejado 0xA001), un byte por iteracion
+static const uint16_t tabla_crc[256] = {
+	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+	0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+	0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+	0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+	0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+	0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+	0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+	0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+	0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+	0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+	0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+	0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+	0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+	0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+	0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+	0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+	0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+	0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+	0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+	0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+	0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+	0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+	0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+	0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+	0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+	0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+	0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+	0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+	0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+static uint16_t crc16(const uint8_t *p, uint32_t len){
+	uint16_t crc = 0xFFFF;
+	while(len--) crc = (crc >> 8) ^ tabla_crc[(crc ^ *p++) & 0xFF];
+	return crc;
+}
+
+static uint16_t get16(const uint8_t *p){
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static void put16(uint8_t *p, uint16_t v){
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)v;
+}
+
+// Alarma de TIMER3: pasaron 3,5 caracteres sin recibir
+static void fin_trama(void){
+	if(descartando){
+		descartando = 0;
+	} else if(estado == MB_RECIBIENDO){
+		if(rx_error){
+			stats.errores_trama++;
+			rx_n = 0;
+			rx_error = 0;
+			estado = MB_REPOSO;
+		} else{
+			estado = MB_TRAMA_LISTA;
+		}
+	}
+}
+
+void modbus_init(void){
+	UART_CFG_Type cfgUART1;
+	UART_FIFO_CFG_Type UARTFIFO;
+	UART1_RS485_CTRLCFG_Type cfg485;
+
+	UART_ConfigStructInit(&cfgUART1);
+	cfgUART1.Baud_rate = MODBUS_BAUD;
+	cfgUART1.Parity = UART_PARITY_EVEN;
+	UART_Init((LPC_UART_TypeDef *)LPC_UART1, &cfgUART1);
+	UART_FIFOConfigStructInit(&UARTFIFO); // Interrupcion por cada caracter
+	UART_FIFOConfig((LPC_UART_TypeDef *)LPC_UART1, &UARTFIFO);
+
+	// Solo se usa el control automatico de direccion; el modo multipunto de
+	// 9 bits (direccion por paridad) no es Modbus, asi que se restaura el LCR
+	// que UART_RS485Config cambia a paridad fija
+	uint8_t lcr = LPC_UART1->LCR;
+	cfg485.NormalMultiDropMode_State = DISABLE;
+	cfg485.Rx_State = ENABLE;
+	cfg485.AutoAddrDetect_State = DISABLE;
+	cfg485.AutoDirCtrl_State = ENABLE;
+	cfg485.DirCtrlPin = UART1_RS485_DIRCTRL_DTR;
+	cfg485.DirCtrlPol_Level = SET;		// DE activo en alto mientras se transmite
+	cfg485.MatchAddrValue = 0;
+	cfg485.DelayValue = 0;
+	UART_RS485Config(LPC_UART1, &cfg485);
+	LPC_UART1->LCR = lcr;
+
+	UART_IntConfig((LPC_UART_TypeDef *)LPC_UART1, UART_INTCFG_RBR, ENABLE);
+	UART_IntConfig((LPC_UART_TypeDef *)LPC_UART1, UART_INTCFG_RLS, ENABLE);
+	UART_TxCmd((LPC_UART_TypeDef *)LPC_UART1, ENABLE);
+
+	// Prioridad de comunicaciones, por debajo de la adquisicion (prioridades.h)
+	NVIC_EnableIRQ(UART1_IRQn);
+}
+
+static uint16_t excepcion(uint8_t codigo){
+	stats.excepciones++;
+	tx[1] |= 0x80;
+	tx[2] = codigo;
+	return 3;
+}
+
+// Arma la respuesta en tx (sin CRC) y devuelve su largo
+static uint16_t procesar(uint16_t n){
+	uint8_t fc = rx[1];
+	uint16_t dir = get16(&rx[2]);
+	uint16_t cant = get16(&rx[4]);
+	uint8_t e;
+
+	tx[0] = rx[0];
+	tx[1] = fc;
+
+	switch(fc){
+	case MODBUS_HOLDING:
+	case MODBUS_INPUT:
+		if(n != 6) return 0;
+		if(cant < 1 || cant > 125) return excepcion(MODBUS_EXC_VALOR);
+		for(uint16_t i = 0; i < cant; i++){
+			uint16_t v;
+			e = modbus_leer_registro(fc, dir + i, &v);
+			if(e) return excepcion(e);
+			put16(&tx[3 + 2 * i], v);
+		}
+		tx[2] = (uint8_t)(2 * cant);
+		stats.registros_leidos += cant;
+		return 3 + 2 * cant;
+
+	case 6:
+		if(n != 6) return 0;
+		e = modbus_escribir_registro(dir, cant);
+		if(e) return excepcion(e);
+		stats.registros_escritos++;
+		for(uint8_t i = 2; i < 6; i++) tx[i] = rx[i];
+		return 6;
+
+	case 16:
+		if(n < 7 || n != 7 + rx[6]) return 0;
+		if(cant < 1 || cant > 123 || rx[6] != 2 * cant) return excepcion(MODBUS_EXC_VALOR);
+		for(uint16_t i = 0; i < cant; i++){
+			e = modbus_escribir_registro(dir + i, get16(&rx[7 + 2 * i]));
+			if(e) return excepcion(e);
+		}
+		stats.registros_escritos += cant;
+		for(uint8_t i = 2; i < 6; i++) tx[i] = rx[i];
+		return 6;
+
+	default:
+		return excepcion(MODBUS_EXC_FUNCION);
+	}
+}
+
+void modbus_service(void){
+	if(estado != MB_TRAMA_LISTA) return;
+
+	uint16_t n = rx_n;
+	uint16_t largo = 0;
+
+	if(n >= 4 && crc16(rx, n - 2) == (rx[n - 2] | ((uint16_t)rx[n - 1] << 8))){
+		if(rx[0] == MODBUS_DIRECCION || rx[0] == 0){
+			stats.tramas_ok++;
+			largo = procesar(n - 2);
+			if(rx[0] == 0) largo = 0;	// Difusion: se ejecuta sin responder
+		}
+	} else{
+		stats.errores_crc++;
+	}
+
+	rx_n = 0;
+	if(!largo){
+		estado = MB_REPOSO;
+		return;
+	}
+
+	uint16_t crc = crc16(tx, largo);
+	tx[largo++] = (uint8_t)crc;
+	tx[largo++] = (uint8_t)(crc >> 8);
+	tx_n = largo;
+	tx_idx = 0;
+	estado = MB_TRANSMITIENDO;
+	// THR vacio: habilitar la interrupcion la dispara y carga la FIFO
+	UART_IntConfig((LPC_UART_TypeDef *)LPC_UART1, UART_INTCFG_THRE, ENABLE);
+}
+
+const modbus_stats_t *modbus_get_stats(void){
+	return &stats;
+}
+
+void UART1_IRQHandler(void){
+	uint32_t iir;
+	uint8_t i, lsr;
+
+	TRAZA_ENTRA();
+	while(!((iir = LPC_UART1->IIR) & UART_IIR_INTSTAT_PEND)){
+		switch(iir & UART_IIR_INTID_MASK){
+		case UART_IIR_INTID_RLS:
+			if(LPC_UART1->LSR & (UART_LSR_OE | UART_LSR_PE | UART_LSR_FE | UART_LSR_BI)) rx_error = 1;
+			break;
+
+		case UART_IIR_INTID_RDA:
+		case UART_IIR_INTID_CTI:
+			// El LSR informa el error del byte que esta al frente de la FIFO y se
+			// limpia al leerlo: se revisa en cada lectura, no solo en RLS
+			while((lsr = LPC_UART1->LSR) & UART_LSR_RDR){
+				uint8_t c = LPC_UART1->RBR;
+				if(lsr & (UART_LSR_OE | UART_LSR_PE | UART_LSR_FE | UART_LSR_BI)) rx_error = 1;
+				if(estado == MB_REPOSO && !descartando) estado = MB_RECIBIENDO;
+				if(estado == MB_RECIBIENDO){
+					if(rx_n < MODBUS_TAM_TRAMA) rx[rx_n++] = c;
+					else rx_error = 1;
+				} else{
+					// Llega mientras se procesa o responde: se ignora hasta el proximo silencio
+					descartando = 1;
+				}
+			}
+			tiempo_alarma(TIEMPO_CANAL_MODBUS, MB_T35_US, fin_trama);
+			break;
+
+		case UART_IIR_INTID_THRE:
+			for(i = 0; i < UART_TX_FIFO_SIZE && tx_idx < tx_n; i++){
+				LPC_UART1->THR = tx[tx_idx++];
+			}
+			TRAZA(TRAZA_UART, 1, i);
+			if(tx_idx >= tx_n){
+				// El resto sale de la FIFO; el DTR1 se libera solo al terminar
+				UART_IntConfig((LPC_UART_TypeDef *)LPC_UART1, UART_INTCFG_THRE, DISABLE);
+				estado = MB_REPOSO;
+			}
+			break;
+		}
+	}
+	TRAZA_SALE();
+}
@@ -0,0 +1,46 @@
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#include "lpc17xx.h"
+
+// --- Esclavo Modbus RTU por RS-485 (UART1: P2.0 TXD1, P2.1 RXD1, P2.5 DTR1) ---
+// DTR1 maneja DE/RE del transceptor con el control automatico de direccion de
+// la UART1. Los bytes se reciben por interrupcion y el fin de trama se detecta
+// con el silencio de 3,5 caracteres medido por TIMER3 (tiempo.h); la trama se
+// procesa en modbus_service(), desde el lazo principal, y la respuesta sale
+// por la interrupcion THRE. Asi una consulta nunca demora a la adquisicion.
+//
+// Funciones: 03 (holding), 04 (input), 06 y 16 (escritura de holding).
+
+#define MODBUS_DIRECCION		1
+#define MODBUS_BAUD				19200			// 8E1, paridad par segun la especificacion
+#define MODBUS_TAM_TRAMA		256
+
+// Tablas de registros
+#define MODBUS_INPUT			4
+#define MODBUS_HOLDING			3
+
+// Codigos de excepcion
+#define MODBUS_EXC_FUNCION		1
+#define MODBUS_EXC_DIRECCION	2
+#define MODBUS_EXC_VALOR		3
+
+typedef struct {
+	uint32_t tramas_ok;
+	uint32_t errores_crc;
+	uint32_t errores_trama;		// Paridad, framing, overrun o trama demasiado larga
+	uint32_t excepciones;
+	uint32_t registros_leidos;
+	uint32_t registros_escritos;
+} modbus_stats_t;
+
+void modbus_init(void);
+void modbus_service(void);
+const modbus_stats_t *modbus_get_stats(void);
+
+// Mapa de registros, implementado por la aplicacion.
+// Devuelven 0 o un codigo de excepcion.
+uint8_t modbus_leer_registro(uint8_t tabla, uint16_t dir, uint16_t *valor);
+uint8_t modbus_escribir_registro(uint16_t dir, uint16_t valor);
+
+#endif /* MODBUS_H_ */
@@ -0,0 +1,148 @@
+#include "perfil.h"
+#include "lpc17xx_uart.h"
+#include "formato.h"
+#include <string.h>
+
+#define PERFIL_SONDEOS			8		// Limita el tiempo de la interrupcion con el histograma casi lleno
+
+typedef struct {
+	uint32_t pc;			// 0 = entrada libre
+	uint32_t excepcion;
+	uint32_t n;
+} perfil_entrada_t;
+
+static perfil_entrada_t hist[PERFIL_ENTRADAS];
+static perfil_stats_t stats;
+
+// Volcado en curso: una linea a la vez, sin esperar a la UART
+static uint8_t volcando = 0;
+static int32_t volcado_idx;		// -1 = encabezado, PERFIL_ENTRADAS = cierre
+static char linea[48];
+static fmt_t linea_fmt;
+static uint8_t linea_pos = 0;
+
+void perfil_muestra(const uint32_t *marco) __attribute__((used));
+
+static void muestreo(uint8_t activo){
+	SysTick->VAL = 0;
+	SysTick->CTRL = activo ? (SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk) : 0;
+}
+
+void perfil_init(void){
+	UART_CFG_Type cfg;
+	UART_FIFO_CFG_Type fifo;
+
+	memset(hist, 0, sizeof(hist));
+	memset(&stats, 0, sizeof(stats));
+
+	UART_ConfigStructInit(&cfg);
+	cfg.Baud_rate = PERFIL_BAUD;
+	UART_Init(LPC_UART3, &cfg);
+	UART_FIFOConfigStructInit(&fifo);
+	UART_FIFOConfig(LPC_UART3, &fifo);
+	UART_TxCmd(LPC_UART3, ENABLE);
+
+	// El driver de SysTick solo acepta periodos en ms; la prioridad la fija
+	// prioridades_init() (SysTick_Config() la pisaria)
+	SysTick->LOAD = SystemCoreClock / PERFIL_HZ - 1;
+	muestreo(0);
+}
+
+const perfil_stats_t *perfil_get_stats(void){
+	return &stats;
+}
+
+// Toma el marco apilado de la pila que estaba en uso
+__attribute__((naked)) void SysTick_Handler(void){
+	__asm volatile(
+		"tst lr, #4			\n"
+		"ite eq				\n"
+		"mrseq r0, msp		\n"
+		"mrsne r0, psp		\n"
+		"b perfil_muestra	\n"
+	);
+}
+
+// marco: r0, r1, r2, r3, r12, lr, pc, xPSR
+void perfil_muestra(const uint32_t *marco){
+	uint32_t pc = marco[6];
+	uint32_t excepcion = marco[7] & 0x1FF;	// IPSR de lo interrumpido
+	uint32_t i = ((pc >> 1) ^ (excepcion * 0x9E37UL)) & (PERFIL_ENTRADAS - 1);
+
+	stats.muestras++;
+	for(uint8_t k = 0; k < PERFIL_SONDEOS; k++){
+		perfil_entrada_t *e = &hist[i];
+		if(e->pc == pc && e->excepcion == excepcion){
+			e->n++;
+			return;
+		}
+		if(e->pc == 0){
+			e->pc = pc;
+			e->excepcion = excepcion;
+			e->n = 1;
+			return;
+		}
+		i = (i + 1) & (PERFIL_ENTRADAS - 1);
+	}
+	stats.perdidas++;
+}
+
+// Arma la proxima linea del volcado; devuelve 0 al terminar
+static uint8_t siguiente_linea(void){
+	fmt_t *f = &linea_fmt;
+
+	fmt_en_buffer(f, linea, sizeof(linea));
+	linea_pos = 0;
+	if(volcado_idx < 0){
+		FMT(f, "#perfil hz=", (uint32_t)PERFIL_HZ, " muestras=", stats.muestras, " perdidas=", stats.perdidas);
+	} else{
+		while(volcado_idx < PERFIL_ENTRADAS && hist[volcado_idx].pc == 0) volcado_idx++;
+		if(volcado_idx > PERFIL_ENTRADAS) return 0;
+		if(volcado_idx == PERFIL_ENTRADAS){
+			fmt_texto(f, "#fin");
+		} else{
+			const perfil_entrada_t *e = &hist[volcado_idx];
+			FMT(f, FMT_HEX(e->pc, 8), " ", e->excepcion, " ", e->n);
+		}
+	}
+	fmt_caracter(f, '\n');
+	volcado_idx++;
+	return 1;
+}
+
+// Desde el lazo principal: comandos por la UART3 y volcado sin bloquear
+void perfil_service(void){
+	while(LPC_UART3->LSR & UART_LSR_RDR){
+		char c = LPC_UART3->RBR;
+		if(volcando) continue;
+		switch(c){
+		case 'r':
+			muestreo(0);
+			memset(hist, 0, sizeof(hist));
+			stats.muestras = stats.perdidas = 0;
+			stats.activo = 1;
+			muestreo(1);
+			break;
+		case 'd':
+			stats.activo = 0;
+			muestreo(0);
+			break;
+		case 'v':
+			muestreo(0);
+			volcando = 1;
+			volcado_idx = -1;
+			siguiente_linea();
+			break;
+		}
+	}
+
+	if(!volcando || !(LPC_UART3->LSR & UART_LSR_THRE)) return;
+	for(uint8_t i = 0; i < UART_TX_FIFO_SIZE; i++){
+		if(linea_pos == linea_fmt.pos && !siguiente_linea()){
+			volcando = 0;
+			if(stats.activo) muestreo(1);
+			return;
+		}
+		LPC_UART3->THR = (uint8_t)linea[linea_pos++];
+	}
+}
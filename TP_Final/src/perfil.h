@@ -0,0 +1,35 @@
+#ifndef PERFIL_H_
+#define PERFIL_H_
+
+#include "lpc17xx.h"
+
+// --- Perfilador estadistico por muestreo del PC ---
+// SysTick interrumpe PERFIL_HZ veces por segundo con la mayor prioridad y
+// anota el PC apilado y la excepcion que estaba activa (0 = lazo principal)
+// en un histograma en RAM. Se maneja desde la UART3 de diagnostico (P0.25
+// TXD3, P0.26 RXD3), con un caracter por comando:
+//   r  borra el histograma y empieza a muestrear
+//   d  detiene el muestreo
+//   v  vuelca el histograma (el muestreo se pausa mientras tanto)
+//
+// Formato del volcado, una linea por registro:
+//   #perfil hz=<PERFIL_HZ> muestras=<n> perdidas=<n>
+//   <pc en hex> <excepcion> <muestras>
+//   #fin
+// tools/perfil.py lo traduce a funciones con el .map o el .axf.
+
+#define PERFIL_HZ				1009	// Primo: no se sincroniza con los timers de 1 ms
+#define PERFIL_ENTRADAS			256		// Pares (PC, excepcion) distintos; potencia de 2
+#define PERFIL_BAUD				115200
+
+typedef struct {
+	uint32_t muestras;
+	uint32_t perdidas;		// Histograma lleno
+	uint8_t  activo;
+} perfil_stats_t;
+
+void perfil_init(void);
+void perfil_service(void);
+const perfil_stats_t *perfil_get_stats(void);
+
+#endif /* PERFIL_H_ */
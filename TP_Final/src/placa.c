@@ -0,0 +1,30 @@
+#include "placa.h"
+
+// Aplica las imagenes de placa.h: una escritura por registro. Primero los
+// niveles de las salidas, para que no haya un pulso al pasarlas a salida.
+void pinConfiguration(void){
+	static const uint32_t pinsel[10] = {
+		PLACA_PINSEL(0), PLACA_PINSEL(1), PLACA_PINSEL(2), PLACA_PINSEL(3), PLACA_PINSEL(4),
+		PLACA_PINSEL(5), PLACA_PINSEL(6), PLACA_PINSEL(7), PLACA_PINSEL(8), PLACA_PINSEL(9)
+	};
+	static const uint32_t pinmode[10] = {
+		PLACA_PINMODE(0), PLACA_PINMODE(1), PLACA_PINMODE(2), PLACA_PINMODE(3), PLACA_PINMODE(4),
+		PLACA_PINMODE(5), PLACA_PINMODE(6), PLACA_PINMODE(7), PLACA_PINMODE(8), PLACA_PINMODE(9)
+	};
+	static const uint32_t od[5] = {PLACA_OD(0), PLACA_OD(1), PLACA_OD(2), PLACA_OD(3), PLACA_OD(4)};
+	static const uint32_t dir[5] = {PLACA_DIR(0), PLACA_DIR(1), PLACA_DIR(2), PLACA_DIR(3), PLACA_DIR(4)};
+	static const uint32_t alto[5] = {PLACA_ALTO(0), PLACA_ALTO(1), PLACA_ALTO(2), PLACA_ALTO(3), PLACA_ALTO(4)};
+	static const uint32_t bajo[5] = {PLACA_BAJO(0), PLACA_BAJO(1), PLACA_BAJO(2), PLACA_BAJO(3), PLACA_BAJO(4)};
+	LPC_GPIO_TypeDef *const gpio[5] = {LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3, LPC_GPIO4};
+
+	for(uint8_t p = 0; p < 5; p++){
+		gpio[p] -> FIOSET = alto[p];
+		gpio[p] -> FIOCLR = bajo[p];
+		gpio[p] -> FIODIR = dir[p];
+		(&LPC_PINCON->PINMODE_OD0)[p] = od[p];
+	}
+	for(uint8_t r = 0; r < 10; r++){
+		(&LPC_PINCON->PINMODE0)[r] = pinmode[r];
+		(&LPC_PINCON->PINSEL0)[r] = pinsel[r];
+	}
+}
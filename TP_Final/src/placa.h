@@ -0,0 +1,131 @@
+#ifndef PLACA_H_
+#define PLACA_H_
+
+#include "lpc17xx.h"
+#include "app_cfg.h"
+
+// --- Descripcion de la placa ---
+// Cada pin usado aparece una sola vez en la tabla. Al compilar se reduce a un
+// valor por registro PINSEL, PINMODE, PINMODE_OD y FIODIR (y los niveles
+// iniciales de las salidas), que pinConfiguration() escribe de una vez. Un pin
+// repetido o un campo fuera de rango no compila.
+//
+// X(a, puerto, pin, funcion, modo, open_drain, salida, nivel)
+//   funcion:	0 GPIO, 1..3 funcion alternativa (tabla 8 del manual)
+//   modo:		PIN_PULLUP, PIN_REPETIDOR, PIN_SIN_PULL o PIN_PULLDOWN
+//   salida:	1 si es una salida GPIO, que arranca en 'nivel'
+
+#define PIN_PULLUP				0
+#define PIN_REPETIDOR			1
+#define PIN_SIN_PULL			2
+#define PIN_PULLDOWN			3
+
+#define PLACA_PINES_BASE(X, a) \
+	X(a, 0, 23, 1, PIN_SIN_PULL, 0, 0, 0)	/* ADC0.0: sensor de CO */ \
+	X(a, 1, 29, 3, PIN_SIN_PULL, 0, 0, 0)	/* MAT0.1: disparo del ADC */ \
+	X(a, 0, 10, 1, PIN_SIN_PULL, 0, 0, 0)	/* TXD2: ESP8266 */ \
+	X(a, 0, 11, 1, PIN_PULLUP, 0, 0, 0)		/* RXD2: ESP8266 (pings de sincronismo) */ \
+	X(a, 0, 22, 0, PIN_SIN_PULL, 0, 1, 0)	/* Buzzer */ \
+	X(a, 0,  2, 0, PIN_SIN_PULL, 0, 1, 0)	/* LED rojo */ \
+	X(a, 0, 27, 0, PIN_SIN_PULL, 0, 1, 0)	/* LED verde */ \
+	X(a, 0,  3, 0, PIN_SIN_PULL, 0, 1, 0)	/* LED amarillo */
+
+#if APP_USE_SD_LOG
+#define PLACA_PINES_SD(X, a) \
+	X(a, 0, 15, 2, PIN_SIN_PULL, 0, 0, 0)	/* SCK0 */ \
+	X(a, 0, 17, 2, PIN_SIN_PULL, 0, 0, 0)	/* MISO0 */ \
+	X(a, 0, 18, 2, PIN_SIN_PULL, 0, 0, 0)	/* MOSI0 */ \
+	X(a, 0, 16, 0, PIN_SIN_PULL, 0, 1, 1)	/* CS de la tarjeta, inactivo en alto */
+#else
+#define PLACA_PINES_SD(X, a)
+#endif
+
+#if APP_USE_ETH
+#define PLACA_PINES_ETH(X, a) \
+	X(a, 1,  0, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_TXD0 */ \
+	X(a, 1,  1, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_TXD1 */ \
+	X(a, 1,  4, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_TX_EN */ \
+	X(a, 1,  8, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_CRS */ \
+	X(a, 1,  9, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_RXD0 */ \
+	X(a, 1, 10, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_RXD1 */ \
+	X(a, 1, 14, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_RX_ER */ \
+	X(a, 1, 15, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_REF_CLK */ \
+	X(a, 1, 16, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_MDC */ \
+	X(a, 1, 17, 1, PIN_SIN_PULL, 0, 0, 0)	/* ENET_MDIO */
+#else
+#define PLACA_PINES_ETH(X, a)
+#endif
+
+#if APP_USE_CAN
+#define PLACA_PINES_CAN(X, a) \
+	X(a, 0,  0, 1, PIN_SIN_PULL, 0, 0, 0)	/* RD1 */ \
+	X(a, 0,  1, 1, PIN_SIN_PULL, 0, 0, 0)	/* TD1 */
+#else
+#define PLACA_PINES_CAN(X, a)
+#endif
+
+#if APP_USE_MODBUS
+#define PLACA_PINES_MODBUS(X, a) \
+	X(a, 2,  0, 2, PIN_SIN_PULL, 0, 0, 0)	/* TXD1 */ \
+	X(a, 2,  1, 2, PIN_SIN_PULL, 0, 0, 0)	/* RXD1 */ \
+	X(a, 2,  5, 2, PIN_SIN_PULL, 0, 0, 0)	/* DTR1: direccion del RS-485 */
+#else
+#define PLACA_PINES_MODBUS(X, a)
+#endif
+
+#if APP_USE_PERFIL || APP_USE_BITACORA
+#define PLACA_PINES_DIAG(X, a) \
+	X(a, 0, 25, 3, PIN_SIN_PULL, 0, 0, 0)	/* TXD3: UART de diagnostico */ \
+	X(a, 0, 26, 3, PIN_PULLUP, 0, 0, 0)		/* RXD3, en reposo alto sin adaptador */
+#else
+#define PLACA_PINES_DIAG(X, a)
+#endif
+
+#define PLACA_PINES(X, a) \
+	PLACA_PINES_BASE(X, a) \
+	PLACA_PINES_SD(X, a) \
+	PLACA_PINES_ETH(X, a) \
+	PLACA_PINES_CAN(X, a) \
+	PLACA_PINES_MODBUS(X, a) \
+	PLACA_PINES_DIAG(X, a)
+
+// --- Imagenes de registros (expresiones constantes) ---
+// Cada entrada aporta su campo al registro 'r' si le corresponde. Los pines
+// que no estan en la tabla quedan con el valor de reset (GPIO, pull-up,
+// entrada), que es 0 en todos estos registros.
+
+#define PLACA_PINSEL_X(r, p, n, f, m, od, s, v)		+ ((((p) * 2 + (n) / 16) == (r)) ? ((uint32_t)(f) << (((n) & 15) * 2)) : 0UL)
+#define PLACA_PINMODE_X(r, p, n, f, m, od, s, v)	+ ((((p) * 2 + (n) / 16) == (r)) ? ((uint32_t)(m) << (((n) & 15) * 2)) : 0UL)
+#define PLACA_OD_X(r, p, n, f, m, od, s, v)			+ (((p) == (r) && (od)) ? (1UL << (n)) : 0UL)
+#define PLACA_DIR_X(r, p, n, f, m, od, s, v)		+ (((p) == (r) && (s)) ? (1UL << (n)) : 0UL)
+#define PLACA_ALTO_X(r, p, n, f, m, od, s, v)		+ (((p) == (r) && (s) && (v)) ? (1UL << (n)) : 0UL)
+#define PLACA_BAJO_X(r, p, n, f, m, od, s, v)		+ (((p) == (r) && (s) && !(v)) ? (1UL << (n)) : 0UL)
+
+#define PLACA_PINSEL(r)			((uint32_t)(0UL PLACA_PINES(PLACA_PINSEL_X, r)))
+#define PLACA_PINMODE(r)		((uint32_t)(0UL PLACA_PINES(PLACA_PINMODE_X, r)))
+#define PLACA_OD(puerto)		((uint32_t)(0UL PLACA_PINES(PLACA_OD_X, puerto)))
+#define PLACA_DIR(puerto)		((uint32_t)(0UL PLACA_PINES(PLACA_DIR_X, puerto)))
+#define PLACA_ALTO(puerto)		((uint32_t)(0UL PLACA_PINES(PLACA_ALTO_X, puerto)))
+#define PLACA_BAJO(puerto)		((uint32_t)(0UL PLACA_PINES(PLACA_BAJO_X, puerto)))
+
+// Escribe las imagenes en PINSEL, PINMODE, PINMODE_OD y los GPIO (placa.c)
+void pinConfiguration(void);
+
+// --- Verificaciones al compilar ---
+// Un pin repetido hace que la suma de sus bits difiera del OR (hay acarreo)
+
+#define PLACA_SUMA_X(r, p, n, f, m, od, s, v)		+ (((p) == (r)) ? (1ULL << (n)) : 0ULL)
+#define PLACA_OR_X(r, p, n, f, m, od, s, v)			| (((p) == (r)) ? (1ULL << (n)) : 0ULL)
+#define PLACA_INVALIDO_X(r, p, n, f, m, od, s, v)	+ ((p) > 4 || (n) > 31 || (f) > 3 || (m) > 3 || (od) > 1 || (s) > 1 || (v) > 1)
+
+#define PLACA_SIN_CONFLICTO(puerto) \
+	((0ULL PLACA_PINES(PLACA_SUMA_X, puerto)) == (0ULL PLACA_PINES(PLACA_OR_X, puerto)))
+
+_Static_assert((0 PLACA_PINES(PLACA_INVALIDO_X, 0)) == 0, "placa.h: campo fuera de rango");
+_Static_assert(PLACA_SIN_CONFLICTO(0), "placa.h: pin del puerto 0 asignado dos veces");
+_Static_assert(PLACA_SIN_CONFLICTO(1), "placa.h: pin del puerto 1 asignado dos veces");
+_Static_assert(PLACA_SIN_CONFLICTO(2), "placa.h: pin del puerto 2 asignado dos veces");
+_Static_assert(PLACA_SIN_CONFLICTO(3), "placa.h: pin del puerto 3 asignado dos veces");
+_Static_assert(PLACA_SIN_CONFLICTO(4), "placa.h: pin del puerto 4 asignado dos veces");
+
+#endif /* PLACA_H_ */
@@ -0,0 +1,18 @@
+#include "lpc17xx.h"
+#include "prioridades.h"
+
+void prioridades_init(void){
+	NVIC_SetPriorityGrouping(PRIO_GRUPO);
+
+	NVIC_SetPriority(TIMER1_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_ALARMA, 0));
+	NVIC_SetPriority(SysTick_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_ALARMA, 0));
+	NVIC_SetPriority(TIMER3_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_TIEMPO, 0));
+	NVIC_SetPriority(ADC_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_ADQUISICION, 0));
+	NVIC_SetPriority(DMA_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_DMA, 0));
+	NVIC_SetPriority(UART1_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_COMUNICACION, 0));
+	NVIC_SetPriority(UART2_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_COMUNICACION, 0));
+	NVIC_SetPriority(CAN_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_COMUNICACION, 0));
+	NVIC_SetPriority(TIMER2_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_CONTROL, 0));
+	NVIC_SetPriority(RIT_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_CONTROL, 0));
+	NVIC_SetPriority(PendSV_IRQn, NVIC_EncodePriority(PRIO_GRUPO, PRIO_DIFERIDO, 0));
+}
@@ -0,0 +1,31 @@
+#ifndef PRIORIDADES_H_
+#define PRIORIDADES_H_
+
+// --- Plan de prioridades de interrupcion ---
+// El LPC1769 implementa 5 bits de prioridad (0 = mas alta). Se usan todos
+// como prioridad de expropiacion, sin subprioridades, asi cada nivel puede
+// interrumpir a los de numero mayor. Todas las prioridades se asignan aca,
+// en prioridades_init(); los modulos solo habilitan sus lineas.
+//
+//   0  Salidas de alarma (tono del buzzer) y muestreo del perfilador (SysTick,
+//      solo con APP_USE_PERFIL; no ve al TIMER1, que no puede expropiar)
+//   1  Base de tiempo (alarmas de TIMER3, p. ej. fin de trama Modbus)
+//   2  Adquisicion (ADC y decision de alarma)
+//   3  DMA (fin de bloque de la tarjeta SD)
+//   4  Comunicaciones (Modbus, CAN, UART2 al ESP8266)
+//   5  Control (cambio vivo/promedio de TIMER2, autotest de LEDs por RIT)
+//  31  Trabajo diferido en PendSV: registros, telemetria y estadisticas
+
+#define PRIO_GRUPO				2		// PRIGROUP: 5 bits de expropiacion, 0 de subprioridad
+
+#define PRIO_ALARMA				0
+#define PRIO_TIEMPO				1
+#define PRIO_ADQUISICION		2
+#define PRIO_DMA				3
+#define PRIO_COMUNICACION		4
+#define PRIO_CONTROL			5
+#define PRIO_DIFERIDO			31
+
+void prioridades_init(void);
+
+#endif /* PRIORIDADES_H_ */
@@ -0,0 +1,98 @@
+#ifndef REGISTROS_H_
+#define REGISTROS_H_
+
+#include "lpc17xx.h"
+#include "secciones.h"
+
+// --- Acceso directo a registros para los caminos rapidos ---
+// Reemplazos en linea de las llamadas a los drivers que se hacen en cada
+// interrupcion. Los drivers validan parametros (CHECK_PARAM), resuelven el
+// canal con un switch y hacen lectura-modificacion-escritura; aca el canal
+// es una constante, asi que cada funcion queda en una carga o un store, en
+// linea tambien con -O0 (EN_LINEA).
+// La configuracion sigue haciendose con los drivers.
+
+// Campos de bits: posicion y ancho constantes, la mascara se resuelve al compilar
+#define CAMPO_MASCARA(pos, ancho)		((((1UL << (ancho)) - 1UL)) << (pos))
+#define CAMPO_LEER(v, pos, ancho)		(((v) >> (pos)) & ((1UL << (ancho)) - 1UL))
+#define CAMPO_VALOR(pos, ancho, x)		(((uint32_t)(x) << (pos)) & CAMPO_MASCARA(pos, ancho))
+
+// ADDRn del ADC
+#define ADC_DR_RESULTADO_POS	4
+#define ADC_DR_RESULTADO_ANCHO	12
+#define ADC_DR_LISTO			CAMPO_MASCARA(31, 1)
+
+// TCR de los timers
+#define TIM_TCR_HABILITAR		CAMPO_MASCARA(0, 1)
+#define TIM_TCR_RESET			CAMPO_MASCARA(1, 1)
+
+// --- GPIO ---
+// FIOSET y FIOCLR solo actuan sobre los bits en 1: se escriben sin leerlos
+
+EN_LINEA void gpio_poner(LPC_GPIO_TypeDef *gpio, uint32_t mascara){
+	gpio->FIOSET = mascara;
+}
+
+EN_LINEA void gpio_limpiar(LPC_GPIO_TypeDef *gpio, uint32_t mascara){
+	gpio->FIOCLR = mascara;
+}
+
+// --- ADC ---
+
+// Una sola lectura de ADDRn (que borra DONE): devuelve 1 y el resultado de
+// 12 bits en *dato si la conversion del canal estaba lista
+EN_LINEA uint8_t adc_leer_canal(uint8_t canal, uint16_t *dato){
+	uint32_t dr = (&LPC_ADC->ADDR0)[canal];
+	*dato = (uint16_t)CAMPO_LEER(dr, ADC_DR_RESULTADO_POS, ADC_DR_RESULTADO_ANCHO);
+	return (dr & ADC_DR_LISTO) != 0;
+}
+
+// --- Timers ---
+
+EN_LINEA uint8_t tim_int_pendiente(LPC_TIM_TypeDef *tim, uint8_t canal){
+	return (tim->IR & (1UL << canal)) != 0;
+}
+
+// IR se borra escribiendo 1: solo el bit del canal, sin tocar otros pendientes
+EN_LINEA void tim_int_limpiar(LPC_TIM_TypeDef *tim, uint8_t canal){
+	tim->IR = (1UL << canal);
+}
+
+EN_LINEA void tim_arrancar(LPC_TIM_TypeDef *tim){
+	tim->TCR = TIM_TCR_HABILITAR;
+}
+
+EN_LINEA void tim_detener(LPC_TIM_TypeDef *tim){
+	tim->TCR = 0;
+}
+
+// Nuevo match y cuenta desde cero (lo que hacen TIM_UpdateMatchValue,
+// TIM_ResetCounter y TIM_Cmd juntos)
+EN_LINEA void tim_rearmar(LPC_TIM_TypeDef *tim, uint8_t canal, uint32_t match){
+	(&tim->MR0)[canal] = match;
+	tim->TCR = TIM_TCR_RESET;
+	tim->TCR = TIM_TCR_HABILITAR;
+}
+
+// --- Contador de ciclos del DWT ---
+// El core_cm3.h de CMSIS 2.00 no define el DWT. El contador corre con el
+// reloj del nucleo y desborda cada ~36 s a 120 MHz; las diferencias sin
+// signo siguen siendo validas.
+
+#define DWT_CTRL				(*(volatile uint32_t *)0xE0001000UL)
+#ifndef DWT_CYCCNT				// En la PC lo define anfitrion/lpc17xx.h
+#define DWT_CYCCNT				(*(volatile uint32_t *)0xE0001004UL)
+#endif
+#define DWT_CTRL_CYCCNTENA		CAMPO_MASCARA(0, 1)
+
+EN_LINEA void dwt_init(void){
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+EN_LINEA uint32_t dwt_ciclos(void){
+	return DWT_CYCCNT;
+}
+
+#endif /* REGISTROS_H_ */
@@ -0,0 +1,391 @@
+#include "sd_log.h"
+#include "lpc17xx_ssp.h"
+#include "dma_canal.h"
+#include "secciones.h"
+#include "bitacora.h"
+#include <string.h>
+
+#define SD_MAGIC			0x4C44534DUL	// "MSDL"
+#define SD_MAGIC_SUPER		0x52505553UL	// "SUPR"
+
+// Comandos SD (modo SPI). Los marcados con 0x80 son ACMD (van precedidos de CMD55)
+#define CMD0				0
+#define CMD8				8
+#define CMD12				12
+#define CMD16				16
+#define CMD17				17
+#define CMD24				24
+#define CMD25				25
+#define CMD55				55
+#define CMD58				58
+#define ACMD41				(0x80 | 41)
+
+#define TOKEN_BLOQUE		0xFE
+#define TOKEN_MULTI			0xFC
+#define TOKEN_STOP			0xFD
+
+#define SD_CLK_INIT			400000
+#define SD_CLK_DATOS		12500000
+
+// Estados de la escritura en curso
+#define SD_INACTIVO			0
+#define SD_DMA				1
+#define SD_OCUPADO			2
+
+typedef struct {
+	uint32_t magic;
+	uint32_t gen;
+} sd_super_t;
+
+// Doble buffer: las interrupciones llenan uno mientras el DMA envia el otro
+static sd_bloque_t			buf[2] BUFFER_AHB;	// Lo lee el DMA
+static volatile uint8_t		buf_llenando = 0;
+static volatile uint8_t		buf_listo[2] = {0, 0};
+static volatile uint8_t		dma_terminado = 0;
+static GPDMA_Image_Type		imagen_dma[2];	// Canal ya armado para enviar cada buffer
+static uint8_t				canal_dma = DMA_SIN_CANAL;
+
+static uint8_t				estado = SD_INACTIVO;
+static uint8_t				buf_en_curso = 0;
+static uint8_t				multi_abierto = 0;
+static uint32_t				gen = 0;
+static uint32_t				seq_siguiente = 0;
+static uint16_t				arranque_actual = 0;
+
+static sd_stats_t			stats;
+
+
+// --- Capa SPI (sondeo, solo para comandos y respuestas cortas) ---
+
+static void spi_clock(uint32_t hz){
+	SSP_CFG_Type cfg;
+	SSP_ConfigStructInit(&cfg);
+	cfg.ClockRate = hz;
+	SSP_Cmd(LPC_SSP0, DISABLE);
+	SSP_Init(LPC_SSP0, &cfg);
+	SSP_Cmd(LPC_SSP0, ENABLE);
+}
+
+static uint8_t spi_xfer(uint8_t b){
+	while(!(LPC_SSP0->SR & SSP_SR_TNF));
+	LPC_SSP0->DR = b;
+	while(!(LPC_SSP0->SR & SSP_SR_RNE));
+	return (uint8_t)LPC_SSP0->DR;
+}
+
+static void spi_flush_rx(void){
+	while(LPC_SSP0->SR & SSP_SR_BSY);
+	while(LPC_SSP0->SR & SSP_SR_RNE) (void)LPC_SSP0->DR;
+	SSP_ClearIntPending(LPC_SSP0, SSP_INTCLR_ROR);
+}
+
+static void cs_alto(void){
+	LPC_GPIO0->FIOSET = SD_CS;
+	spi_xfer(0xFF);
+}
+
+static void cs_bajo(void){
+	LPC_GPIO0->FIOCLR = SD_CS;
+}
+
+static uint8_t esperar_listo(uint32_t intentos){
+	while(intentos--){
+		if(spi_xfer(0xFF) == 0xFF) return 1;
+	}
+	return 0;
+}
+
+static uint8_t sd_cmd(uint8_t cmd, uint32_t arg){
+	uint8_t r;
+
+	if(cmd & 0x80){
+		cmd &= 0x7F;
+		r = sd_cmd(CMD55, 0);
+		if(r > 1) return r;
+	}
+
+	cs_alto();
+	cs_bajo();
+	if(!esperar_listo(50000)) return 0xFF;
+
+	spi_xfer(0x40 | cmd);
+	spi_xfer((uint8_t)(arg >> 24));
+	spi_xfer((uint8_t)(arg >> 16));
+	spi_xfer((uint8_t)(arg >> 8));
+	spi_xfer((uint8_t)arg);
+	// CRC solo obligatorio para CMD0 y CMD8
+	spi_xfer(cmd == CMD0 ? 0x95 : (cmd == CMD8 ? 0x87 : 0x01));
+	if(cmd == CMD12) spi_xfer(0xFF);
+
+	for(uint8_t n = 0; n < 10; n++){
+		r = spi_xfer(0xFF);
+		if(!(r & 0x80)) break;
+	}
+	return r;
+}
+
+static uint32_t lba_dir(uint32_t lba){
+	// Las tarjetas SDSC direccionan por byte, las SDHC/SDXC por bloque
+	return stats.sdhc ? lba : lba * SD_TAM_BLOQUE;
+}
+
+static uint8_t sd_leer_bloque(uint32_t lba, uint8_t *dst){
+	uint8_t ok = 0;
+
+	if(sd_cmd(CMD17, lba_dir(lba)) == 0){
+		uint8_t token = 0xFF;
+		for(uint32_t n = 0; n < 100000 && token == 0xFF; n++) token = spi_xfer(0xFF);
+		if(token == TOKEN_BLOQUE){
+			for(uint32_t i = 0; i < SD_TAM_BLOQUE; i++) dst[i] = spi_xfer(0xFF);
+			spi_xfer(0xFF);	// CRC
+			spi_xfer(0xFF);
+			ok = 1;
+		}
+	}
+	cs_alto();
+	return ok;
+}
+
+static uint8_t sd_escribir_bloque(uint32_t lba, const uint8_t *src){
+	uint8_t ok = 0;
+
+	if(sd_cmd(CMD24, lba_dir(lba)) == 0){
+		spi_xfer(TOKEN_BLOQUE);
+		for(uint32_t i = 0; i < SD_TAM_BLOQUE; i++) spi_xfer(src[i]);
+		spi_xfer(0xFF);
+		spi_xfer(0xFF);
+		ok = ((spi_xfer(0xFF) & 0x1F) == 0x05) && esperar_listo(500000);
+	}
+	cs_alto();
+	return ok;
+}
+
+static uint8_t sd_iniciar_tarjeta(void){
+	uint8_t r, ocr[4];
+	uint8_t v2 = 0;
+
+	spi_clock(SD_CLK_INIT);
+	LPC_GPIO0->FIOSET = SD_CS;
+	for(uint8_t i = 0; i < 10; i++) spi_xfer(0xFF);	// >= 74 ciclos con CS alto
+
+	if(sd_cmd(CMD0, 0) != 0x01) return 0;
+
+	if(sd_cmd(CMD8, 0x1AA) == 0x01){
+		for(uint8_t i = 0; i < 4; i++) ocr[i] = spi_xfer(0xFF);
+		if(ocr[2] != 0x01 || ocr[3] != 0xAA) return 0;
+		v2 = 1;
+	}
+
+	uint32_t intentos = 100000;
+	do{
+		r = sd_cmd(ACMD41, v2 ? (1UL << 30) : 0);
+	} while(r != 0 && --intentos);
+	if(r != 0) return 0;
+
+	stats.sdhc = 0;
+	if(v2 && sd_cmd(CMD58, 0) == 0){
+		for(uint8_t i = 0; i < 4; i++) ocr[i] = spi_xfer(0xFF);
+		stats.sdhc = (ocr[0] & 0x40) ? 1 : 0;
+	}
+	if(!stats.sdhc && sd_cmd(CMD16, SD_TAM_BLOQUE) != 0) return 0;
+
+	cs_alto();
+	spi_clock(SD_CLK_DATOS);
+	return 1;
+}
+
+static uint8_t bloque_valido(const sd_bloque_t *b, uint32_t seq){
+	return b->magic == SD_MAGIC && b->gen == gen && b->seq == seq && b->n <= SD_REGS_BLOQUE;
+}
+
+
+// Fin (o error) de la transferencia de un bloque por GPDMA
+static void dma_fin(uint8_t canal){
+	(void)canal;
+	dma_terminado = 1;
+}
+
+uint8_t sd_log_init(uint16_t arranque){
+	memset(&stats, 0, sizeof(stats));
+	arranque_actual = arranque;
+
+	if(!sd_iniciar_tarjeta()) return 0;
+
+	// Superbloque: si no existe se crea una generacion nueva, invalidando
+	// cualquier dato viejo que hubiera en la tarjeta
+	sd_super_t *sup = (sd_super_t *)&buf[0];
+	if(!sd_leer_bloque(SD_LOG_LBA_INICIO, (uint8_t *)&buf[0])) return 0;
+	if(sup->magic == SD_MAGIC_SUPER){
+		gen = sup->gen;
+	} else{
+		gen = (sup->gen + 1) | 1;
+		memset(&buf[0], 0, sizeof(buf[0]));
+		sup->magic = SD_MAGIC_SUPER;
+		sup->gen = gen;
+		if(!sd_escribir_bloque(SD_LOG_LBA_INICIO, (const uint8_t *)&buf[0])) return 0;
+	}
+
+	// Busqueda binaria del primer bloque no escrito (los escritos son un prefijo)
+	uint32_t lo = 0, hi = SD_LOG_MAX_BLOQUES;
+	while(lo < hi){
+		uint32_t mid = (lo + hi) / 2;
+		if(sd_leer_bloque(SD_LOG_LBA_INICIO + 1 + mid, (uint8_t *)&buf[0]) && bloque_valido(&buf[0], mid)){
+			lo = mid + 1;
+		} else{
+			hi = mid;
+		}
+	}
+	seq_siguiente = lo;
+
+	buf[0].n = 0;
+	buf[1].n = 0;
+	buf_llenando = 0;
+	buf_listo[0] = buf_listo[1] = 0;
+	estado = SD_INACTIVO;
+
+	// SSP0 Tx -> GPDMA para los bloques de datos: la configuracion del canal
+	// se compila una vez por buffer y cada bloque solo recarga los registros.
+	// El error tambien cierra la espera; el servicio detecta la respuesta
+	// invalida de la tarjeta.
+	if(canal_dma == DMA_SIN_CANAL) canal_dma = dma_canal_pedir(DMA_PRIO_ALTA, dma_fin, dma_fin);
+	if(canal_dma == DMA_SIN_CANAL) return 0;
+	for(uint8_t i = 0; i < 2; i++){
+		GPDMA_Channel_CFG_Type cfg;
+
+		cfg.ChannelNum = canal_dma;
+		cfg.TransferSize = SD_TAM_BLOQUE;
+		cfg.TransferType = GPDMA_TRANSFERTYPE_M2P;
+		cfg.TransferWidth = 0;
+		cfg.SrcMemAddr = (uint32_t)&buf[i];
+		cfg.DstMemAddr = 0;
+		cfg.SrcConn = 0;
+		cfg.DstConn = GPDMA_CONN_SSP0_Tx;
+		cfg.DMALLI = 0;
+		GPDMA_BuildImage(&cfg, &imagen_dma[i]);
+	}
+
+	stats.tarjeta_ok = 1;
+	return 1;
+}
+
+void sd_log_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t){
+	if(!stats.tarjeta_ok) return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint8_t idx = buf_llenando;
+	if(buf_listo[idx]){
+		stats.registros_perdidos++;
+		__set_PRIMASK(primask);
+		return;
+	}
+
+	sd_bloque_t *b = &buf[idx];
+	flog_reg_t *r = &b->reg[b->n++];
+	r->t = t;
+	r->valor = valor;
+	r->tipo = tipo;
+	r->aux = aux;
+
+	if(b->n == SD_REGS_BLOQUE){
+		buf_listo[idx] = 1;
+		buf_llenando = idx ^ 1;
+	}
+	__set_PRIMASK(primask);
+}
+
+static void iniciar_dma(uint8_t idx){
+	dma_terminado = 0;
+	SSP_DMACmd(LPC_SSP0, SSP_DMA_TX, ENABLE);
+	dma_canal_arrancar(&imagen_dma[idx]);
+}
+
+static void error_escritura(void){
+	// Se cierra la escritura multiple; el bloque se reintenta en la proxima llamada
+	stats.errores++;
+	BITACORA("sd: error de escritura en el bloque %u (estado %u)", seq_siguiente, estado);
+	spi_flush_rx();
+	if(multi_abierto){
+		spi_xfer(TOKEN_STOP);
+		esperar_listo(500000);
+		multi_abierto = 0;
+	}
+	cs_alto();
+	estado = SD_INACTIVO;
+}
+
+// Maquina de estados llamada desde el lazo principal. Nunca espera a la
+// tarjeta: cada llamada avanza a lo sumo un paso y vuelve.
+void sd_log_service(void){
+	if(!stats.tarjeta_ok) return;
+
+	switch(estado){
+	case SD_INACTIVO: {
+		uint8_t idx = buf_listo[buf_llenando] ? buf_llenando : (buf_llenando ^ 1);
+		if(!buf_listo[idx]) return;
+		if(seq_siguiente >= SD_LOG_MAX_BLOQUES) return;	// Log lleno
+
+		if(!multi_abierto){
+			// CMD25 queda abierto mientras haya bloques: evita un comando por bloque
+			if(sd_cmd(CMD25, lba_dir(SD_LOG_LBA_INICIO + 1 + seq_siguiente)) != 0){
+				error_escritura();
+				return;
+			}
+			multi_abierto = 1;
+		}
+
+		sd_bloque_t *b = &buf[idx];
+		memset(&b->reg[b->n], 0, (SD_REGS_BLOQUE - b->n) * sizeof(flog_reg_t));
+		b->magic = SD_MAGIC;
+		b->gen = gen;
+		b->seq = seq_siguiente;
+		b->arranque = arranque_actual;
+
+		buf_en_curso = idx;
+		spi_xfer(TOKEN_MULTI);
+		estado = SD_DMA;
+		iniciar_dma(idx);
+		break;
+	}
+
+	case SD_DMA:
+		if(!dma_terminado) return;
+		SSP_DMACmd(LPC_SSP0, SSP_DMA_TX, DISABLE);
+		GPDMA_ChannelCmd(canal_dma, DISABLE);
+		spi_flush_rx();		// Lo recibido durante el DMA se descarta
+
+		spi_xfer(0xFF);		// CRC (ignorado en modo SPI)
+		spi_xfer(0xFF);
+		if((spi_xfer(0xFF) & 0x1F) != 0x05){
+			error_escritura();
+			return;
+		}
+		estado = SD_OCUPADO;
+		break;
+
+	case SD_OCUPADO:
+		// La tarjeta mantiene MISO en 0 mientras programa el bloque
+		if(spi_xfer(0xFF) != 0xFF){
+			stats.esperas_ocupado++;
+			return;
+		}
+
+		seq_siguiente++;
+		stats.bloques_escritos++;
+		stats.bytes_escritos += SD_TAM_BLOQUE;
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		buf[buf_en_curso].n = 0;
+		buf_listo[buf_en_curso] = 0;
+		__set_PRIMASK(primask);
+
+		estado = SD_INACTIVO;
+		break;
+	}
+}
+
+const sd_stats_t *sd_log_get_stats(void){
+	return &stats;
+}
@@ -0,0 +1,45 @@
+#ifndef SD_LOG_H_
+#define SD_LOG_H_
+
+#include "lpc17xx.h"
+#include "flash_log.h"
+
+// --- Registro de larga duracion en tarjeta SD (modo SPI por SSP0) ---
+// Formato propio de solo-agregado, sin FAT: la tarjeta queda dedicada al
+// equipo. El bloque SD_LOG_LBA_INICIO es un superbloque con un numero de
+// generacion; los bloques siguientes llevan generacion y numero de secuencia,
+// de modo que el final del log se encuentra por busqueda binaria al arrancar.
+// Los registros usan el mismo formato que el log en flash (flog_reg_t).
+
+#define SD_TAM_BLOQUE			512
+#define SD_LOG_LBA_INICIO		2048UL
+#define SD_LOG_MAX_BLOQUES		(1UL << 20)		// 512 MB, varios anios a 1 muestra/s
+#define SD_REGS_BLOQUE			62
+
+#define SD_CS					(1<<16)			// P0.16
+
+typedef struct {
+	uint32_t magic;
+	uint32_t gen;
+	uint32_t seq;		// Indice del bloque dentro del log (LBA - SD_LOG_LBA_INICIO - 1)
+	uint16_t n;
+	uint16_t arranque;
+	flog_reg_t reg[SD_REGS_BLOQUE];
+} sd_bloque_t;
+
+typedef struct {
+	uint32_t bloques_escritos;
+	uint32_t bytes_escritos;
+	uint32_t registros_perdidos;	// Ambos buffers ocupados cuando llego un registro
+	uint32_t errores;
+	uint32_t esperas_ocupado;		// Llamadas a sd_log_service con la tarjeta ocupada
+	uint8_t  tarjeta_ok;
+	uint8_t  sdhc;
+} sd_stats_t;
+
+uint8_t sd_log_init(uint16_t arranque);
+void sd_log_append(uint8_t tipo, uint16_t valor, uint8_t aux, uint32_t t);
+void sd_log_service(void);
+const sd_stats_t *sd_log_get_stats(void);
+
+#endif /* SD_LOG_H_ */
@@ -0,0 +1,31 @@
+#ifndef SECCIONES_H_
+#define SECCIONES_H_
+
+#include "app_cfg.h"
+
+// --- Ubicacion en memoria ---
+// El script de enlace generado por el IDE ya copia las secciones .ramfunc*
+// junto con .data a RamLoc32 en ResetISR, y deja .bss.$RAM2 en RamAHB32
+// (puesta en cero con el resto de la .bss). Solo hay que etiquetar.
+
+// Codigo de los caminos rapidos (interrupciones, conversion, estadisticas):
+// desde la SRAM local se ejecuta sin los estados de espera de la flash, que
+// el acelerador no oculta en los saltos. La RAM esta a mas de 16 MB de la
+// flash, asi que las llamadas desde flash usan long_call; el enlazador agrega
+// los saltos largos de RAM hacia la flash.
+#if APP_USE_RAMFUNC && defined(__arm__)
+#define EN_RAM				__attribute__((section(".ramfunc"), long_call, noinline))
+#else
+#define EN_RAM
+#endif
+
+// Funciones de los encabezados que usan los caminos rapidos: en linea aun con
+// -O0 (configuracion Debug), asi una interrupcion EN_RAM no llama a una copia
+// que quedo en la flash
+#define EN_LINEA			static inline __attribute__((always_inline))
+
+// Buffers que recorre el DMA: en el banco AHB el DMA no compite con la CPU,
+// que trabaja sobre RamLoc32, por el mismo puerto de la matriz
+#define BUFFER_AHB			__attribute__((section(".bss.$RAM2")))
+
+#endif /* SECCIONES_H_ */
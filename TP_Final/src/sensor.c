@@ -0,0 +1,41 @@
+#include "sensor.h"
+#include "secciones.h"
+#include <math.h>
+
+volatile float 		r0_sensor = R0_SENSOR;
+volatile float 		rl_sensor = RL_SENSOR;
+
+EN_RAM uint16_t convert_adc_to_ppm(uint16_t raw_data){
+	// El valor raw es de 12 bits (0-4095)
+	if (raw_data == 0) return 0;
+
+	// Voltaje de salida del sensor Vs = (raw_data / 4096) * 3.3V
+	// Resistencia del sensor Rs = (3.3V - Vs) * RL / Vs
+	// Resistencia del sensor Rs = RL_SENSOR * (4096 - raw_data) / raw_data
+
+	float rs = (float) (4096.0f - raw_data) * rl_sensor /raw_data;
+
+	// Relacion Rs/Ro
+	float rs_ro_ratio = rs / r0_sensor;
+
+//	float x = 100.0f * rs_ro_ratio;
+	float concentracion_ppm = 100.0f * pow(rs_ro_ratio, -1.52f);
+
+	// Saturar: cerca del fondo de escala la curva supera los 16 bits
+	return (concentracion_ppm < 65535.0f) ? (uint16_t)concentracion_ppm : 65535;
+}
+
+// Primer codigo del ADC cuya conversion alcanza 'ppm' (4096 si ninguno).
+// Se busca sobre la propia convert_adc_to_ppm, por lo que comparar
+// raw >= umbral da exactamente el mismo resultado que comparar en ppm
+// (tests/prueba_sensor.c lo verifica en todos los codigos).
+uint16_t ppm_to_adc_threshold(uint16_t ppm){
+	uint16_t bajo = 0, alto = 4096;
+
+	while(bajo < alto){
+		uint16_t medio = (bajo + alto) / 2;
+		if(convert_adc_to_ppm(medio) >= ppm) alto = medio;
+		else bajo = medio + 1;
+	}
+	return bajo;
+}
@@ -0,0 +1,23 @@
+#ifndef SENSOR_H_
+#define SENSOR_H_
+
+#include <stdint.h>
+
+// --- Curva del sensor de CO ---
+// Conversion del codigo de 12 bits del ADC a ppm y su inversa para los
+// umbrales. La curva es creciente: cada nivel en ppm equivale al primer
+// codigo que lo alcanza, asi la alarma compara codigos crudos y la
+// conversion (pow en punto flotante por software) queda fuera de la
+// interrupcion del ADC.
+
+#define R0_SENSOR				72.41  	// Resistencia en kOhm del sensor en aire limpio
+#define RL_SENSOR				47		// Resistencia de carga en kOhm
+
+// Calibracion (modificable por Modbus; despues llamar a recalc_thresholds)
+extern volatile float 		r0_sensor;
+extern volatile float 		rl_sensor;
+
+uint16_t convert_adc_to_ppm(uint16_t raw_data);
+uint16_t ppm_to_adc_threshold(uint16_t ppm);
+
+#endif /* SENSOR_H_ */
@@ -0,0 +1,55 @@
+#include "tiempo.h"
+#include "lpc17xx_timer.h"
+#include "secciones.h"
+#include "traza.h"
+
+static volatile tiempo_fn_t alarmas[4];
+
+void tiempo_init(void){
+	TIM_TIMERCFG_Type timerMode3;
+	timerMode3.PrescaleOption = TIM_PRESCALE_USVAL;
+	timerMode3.PrescaleValue = 1; // Base de tiempo de 1us
+
+	TIM_Init(LPC_TIM3, TIM_TIMER_MODE, &timerMode3);
+	LPC_TIM3->MCR = 0;
+	TIM_Cmd(LPC_TIM3, ENABLE);
+	NVIC_EnableIRQ(TIMER3_IRQn);
+}
+
+// Programa (o reprograma) la alarma del canal para dentro de retardo_us.
+// Se usa desde interrupciones, por eso escribe los registros directamente.
+void tiempo_alarma(uint8_t canal, uint32_t retardo_us, tiempo_fn_t fn){
+	volatile uint32_t *mr = &LPC_TIM3->MR0 + canal;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	alarmas[canal] = fn;
+	*mr = LPC_TIM3->TC + retardo_us;
+	LPC_TIM3->IR = (1 << canal);
+	LPC_TIM3->MCR |= (1 << (3 * canal));	// Solo interrupcion, sin reset ni stop
+	__set_PRIMASK(primask);
+}
+
+void tiempo_cancelar(uint8_t canal){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	LPC_TIM3->MCR &= ~(1 << (3 * canal));
+	LPC_TIM3->IR = (1 << canal);
+	__set_PRIMASK(primask);
+}
+
+EN_RAM void TIMER3_IRQHandler(void){
+	uint32_t ir = LPC_TIM3->IR & 0x0F;
+
+	TRAZA_ENTRA();
+	for(uint8_t canal = 0; canal < 4; canal++){
+		if(ir & (1 << canal)){
+			LPC_TIM3->IR = (1 << canal);
+			if(LPC_TIM3->MCR & (1 << (3 * canal))){
+				LPC_TIM3->MCR &= ~(1 << (3 * canal));
+				if(alarmas[canal]) alarmas[canal]();
+			}
+		}
+	}
+	TRAZA_SALE();
+}
@@ -0,0 +1,24 @@
+#ifndef TIEMPO_H_
+#define TIEMPO_H_
+
+#include "lpc17xx.h"
+#include "secciones.h"
+
+// --- Base de tiempo libre en microsegundos (TIMER3) ---
+// El contador nunca se resetea: da marcas de tiempo de 32 bits (desborda cada
+// ~71 minutos, las diferencias sin signo siguen siendo validas). Los cuatro
+// registros de match quedan como alarmas de un solo disparo.
+
+#define TIEMPO_CANAL_MODBUS		0		// MR0: silencio de 3,5 caracteres de Modbus RTU
+
+typedef void (*tiempo_fn_t)(void);
+
+void tiempo_init(void);
+void tiempo_alarma(uint8_t canal, uint32_t retardo_us, tiempo_fn_t fn);
+void tiempo_cancelar(uint8_t canal);
+
+EN_LINEA uint32_t tiempo_us(void){
+	return LPC_TIM3->TC;
+}
+
+#endif /* TIEMPO_H_ */
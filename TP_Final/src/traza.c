@@ -0,0 +1,30 @@
+#include "traza.h"
+#include <string.h>
+
+#define TRAZA_MEDICIONES		16
+
+traza_t traza;
+
+void traza_init(void){
+	memset(&traza, 0, sizeof(traza));
+	traza.magia = TRAZA_MAGIA;
+	traza.hz = SystemCoreClock;
+	traza.capacidad = TRAZA_EVENTOS;
+
+	// Costo de un evento: las marcas de eventos consecutivos distan lo que
+	// tarda uno completo (el contador corre desde ResetISR)
+	traza.activo = 1;
+	for(uint8_t i = 0; i < TRAZA_MEDICIONES; i++) traza_evento(0, 0, 0);
+	traza.ciclos_evento = (traza.ev[TRAZA_MEDICIONES - 1].t - traza.ev[0].t) / (TRAZA_MEDICIONES - 1);
+
+	memset(traza.ev, 0, sizeof(traza.ev));
+	traza.escritos = 0;
+}
+
+void traza_detener(void){
+	traza.activo = 0;
+}
+
+void traza_reanudar(void){
+	traza.activo = 1;
+}
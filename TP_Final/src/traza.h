@@ -0,0 +1,94 @@
+#ifndef TRAZA_H_
+#define TRAZA_H_
+
+#include "lpc17xx.h"
+#include "app_cfg.h"
+#include "secciones.h"
+#include "registros.h"
+#include "atomico.h"
+
+// --- Registro de eventos con marca de tiempo ---
+// Buffer circular en RAM con los ultimos TRAZA_EVENTOS eventos: entrada y
+// salida de interrupciones, registros encolados, bytes pasados a la UART,
+// fin de DMA y cambios de alarma. La marca es el contador de ciclos del DWT.
+// Se lee con el depurador, volcando la variable 'traza' entera (por ejemplo
+// en gdb: dump binary value traza.bin traza); tools/traza.py la convierte
+// al formato de trazas de Chrome/Perfetto.
+//
+// Cada evento reserva su posicion y toma la marca de tiempo dentro del mismo
+// LDREX/STREX, asi el orden del buffer es el orden temporal aunque una
+// interrupcion expropie a otra mientras registra. Cuesta unas dos decenas de
+// ciclos; traza_init() lo mide y lo deja en ciclos_evento. Fuera del micro
+// (atomico.h con C11) la reserva es una comparacion e intercambio con la
+// marca tomada antes, y se ejercita con hilos en la PC.
+
+#define TRAZA_EVENTOS			512		// Potencia de 2 (8 bytes cada uno)
+#define TRAZA_MAGIA				0x5A415254UL	// "TRAZ"
+
+// Tipos de evento
+#define TRAZA_IRQ_ENTRA			1		// id: numero de excepcion
+#define TRAZA_IRQ_SALE			2		// id: numero de excepcion
+#define TRAZA_COLA				3		// id: tipo de registro, dato: valor
+#define TRAZA_UART				4		// id: UART, dato: bytes cargados en la FIFO
+#define TRAZA_DMA				5		// id: canal, dato: 0 fin, 1 error
+#define TRAZA_ALARMA			6		// dato: estado nuevo
+
+typedef struct {
+	uint32_t t;				// Ciclos del DWT
+	uint8_t  tipo;
+	uint8_t  id;
+	uint16_t dato;
+} traza_evento_t;
+
+typedef struct {
+	uint32_t magia;
+	uint32_t hz;					// Frecuencia del contador de ciclos
+	atomico_u32_t escritos;			// Eventos registrados; el proximo va en escritos % TRAZA_EVENTOS
+	uint32_t capacidad;
+	uint32_t ciclos_evento;			// Costo medido de traza_evento()
+	volatile uint32_t activo;
+	traza_evento_t ev[TRAZA_EVENTOS];
+} traza_t;
+
+extern traza_t traza;
+
+void traza_init(void);
+void traza_detener(void);		// Congela el buffer (p. ej. desde un punto de interes)
+void traza_reanudar(void);
+
+EN_LINEA void traza_evento(uint8_t tipo, uint8_t id, uint16_t dato){
+	uint32_t i, t;
+
+	if(!traza.activo) return;
+#if defined(__arm__) && !defined(ATOMICO_C11)
+	do{
+		i = __LDREXW(&traza.escritos);
+		t = dwt_ciclos();
+	} while(__STREXW(i + 1, &traza.escritos));
+#else
+	// Si otro evento reservo entre la lectura y el CAS, se repiten las dos
+	do{
+		i = atomico_leer(&traza.escritos);
+		t = dwt_ciclos();
+	} while(!atomico_cas(&traza.escritos, i, i + 1));
+#endif
+
+	traza_evento_t *e = &traza.ev[i & (TRAZA_EVENTOS - 1)];
+	e->t = t;
+	e->tipo = tipo;
+	e->id = id;
+	e->dato = dato;
+}
+
+// Puntos de traza: sin APP_USE_TRAZA no generan codigo
+#if APP_USE_TRAZA
+#define TRAZA(tipo, id, dato)	traza_evento((tipo), (id), (dato))
+#define TRAZA_ENTRA()			traza_evento(TRAZA_IRQ_ENTRA, (uint8_t)__get_IPSR(), 0)
+#define TRAZA_SALE()			traza_evento(TRAZA_IRQ_SALE, (uint8_t)__get_IPSR(), 0)
+#else
+#define TRAZA(tipo, id, dato)	((void)0)
+#define TRAZA_ENTRA()			((void)0)
+#define TRAZA_SALE()			((void)0)
+#endif
+
+#endif /* TRAZA_H_ */
@@ -0,0 +1,54 @@
+#ifndef VENTANA_H_
+#define VENTANA_H_
+
+#include <stdint.h>
+#include "atomico.h"
+
+// --- Ventana de muestras con doble buffer, sin copias ---
+// El escritor (la interrupcion del ADC) llena una ventana mientras la otra
+// queda publicada para los lectores. Al completar una ventana se intercambian
+// los punteros bajo un seqlock, asi un lector detecta que la ventana se reuso
+// mientras la leia y reintenta. En el micro los lectores nunca interrumpen al
+// escritor, no pueden encontrar el contador impar para siempre.
+// tests/prueba_ventana.c lo ejercita con hilos en la PC.
+
+#ifndef VENTANA_MUESTRAS
+#define VENTANA_MUESTRAS		10
+#endif
+
+typedef struct {
+	volatile uint16_t muestras[2][VENTANA_MUESTRAS];
+	volatile uint16_t *volatile escritura;
+	const volatile uint16_t *volatile publicada;
+	uint32_t idx;				// Solo lo usa el escritor
+	seqlock_t seq;
+} ventana_t;
+
+#define VENTANA_INIT(v)		{ .escritura = (v).muestras[0], .publicada = (v).muestras[1] }
+
+// Escritor: agrega una muestra; devuelve 1 si completo y publico una ventana
+EN_LINEA uint8_t ventana_agregar(ventana_t *v, uint16_t muestra){
+	v->escritura[v->idx] = muestra;
+	if(++v->idx < VENTANA_MUESTRAS) return 0;
+
+	v->idx = 0;
+	seqlock_escribir_inicio(&v->seq);
+	volatile uint16_t *llena = v->escritura;
+	v->escritura = (llena == v->muestras[0]) ? v->muestras[1] : v->muestras[0];
+	v->publicada = llena;
+	seqlock_escribir_fin(&v->seq);
+	return 1;
+}
+
+// Lector: ventana publicada y numero de secuencia para ventana_reintentar()
+EN_LINEA const volatile uint16_t *ventana_leer_inicio(ventana_t *v, uint32_t *seq){
+	*seq = seqlock_leer_inicio(&v->seq);
+	return v->publicada;
+}
+
+// Devuelve 1 si la ventana leida pudo haberse reescrito: hay que repetir
+EN_LINEA uint8_t ventana_reintentar(ventana_t *v, uint32_t seq){
+	return seqlock_reintentar(&v->seq, seq);
+}
+
+#endif /* VENTANA_H_ */
@@ -0,0 +1,190 @@
+#include "anfitrion.h"
+#include "lpc17xx.h"
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+volatile uint32_t anfitrion_primask;
+volatile uint32_t anfitrion_basepri;
+_Thread_local uint32_t anfitrion_exclusivo;
+_Thread_local uint32_t anfitrion_cyccnt;
+uint32_t SystemCoreClock = 100000000;
+
+// CHECK_PARAM de los drivers (en el equipo, lpc17xx_libcfg_default.c se cuelga)
+void check_failed(uint8_t *file, uint32_t line) {
+	fprintf(stderr, "%s:%u: parametro invalido\n", (const char *)file, line);
+	exit(1);
+}
+
+void (*anfitrion_iap)(uint32_t *cmd, uint32_t *res) = anfitrion_iap_nor;
+
+static void *mapear(uintptr_t dir, size_t tam, int prot, int compartida) {
+	void *p = mmap((void *)dir, tam, prot, MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | (compartida ? MAP_SHARED : MAP_PRIVATE), -1, 0);
+	if (p != (void *)dir) {
+		fprintf(stderr, "anfitrion: no se pudo mapear 0x%08lx\n", (unsigned long)dir);
+		exit(2);
+	}
+	return p;
+}
+
+// --- Perifericos emulados ---
+// Un acceso a una pagina sin permisos llega como SIGSEGV; se habilita la
+// pagina, se carga el valor a leer y se ejecuta la instruccion paso a paso
+// (bandera TF). El SIGTRAP siguiente entrega lo escrito y vuelve a cerrarla.
+
+#define PAGINA		0x1000UL
+#define MAX_PERIFERICOS		8
+
+typedef struct {
+	uint32_t base, tam;
+	anfitrion_leer_t leer;
+	anfitrion_escribir_t escribir;
+} periferico_t;
+
+static periferico_t perifericos[MAX_PERIFERICOS];
+static uint32_t num_perifericos;
+static struct {
+	const periferico_t *p;
+	uint32_t dir;
+	int escritura;
+} acceso;
+
+uint64_t anfitrion_accesos;
+
+static void al_fallar(int sig, siginfo_t *si, void *ctx) {
+	ucontext_t *uc = ctx;
+	uintptr_t dir = (uintptr_t)si->si_addr;
+
+	for (uint32_t i = 0; i < num_perifericos; i++) {
+		const periferico_t *p = &perifericos[i];
+		if (dir < p->base || dir >= (uintptr_t)p->base + p->tam) continue;
+
+		mprotect((void *)(dir & ~(PAGINA - 1)), PAGINA, PROT_READ | PROT_WRITE);
+		acceso.p = p;
+		acceso.dir = (uint32_t)dir & ~3UL;
+		acceso.escritura = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+		if (!acceso.escritura && p->leer) *(volatile uint32_t *)(uintptr_t)acceso.dir = p->leer(acceso.dir);
+		uc->uc_mcontext.gregs[REG_EFL] |= 0x100;
+		anfitrion_accesos++;
+		return;
+	}
+	signal(SIGSEGV, SIG_DFL);	// Un acceso invalido de verdad
+}
+
+static void al_paso(int sig, siginfo_t *si, void *ctx) {
+	ucontext_t *uc = ctx;
+
+	uc->uc_mcontext.gregs[REG_EFL] &= ~0x100UL;
+	if (acceso.escritura && acceso.p->escribir) acceso.p->escribir(acceso.dir, *(volatile uint32_t *)(uintptr_t)acceso.dir);
+	mprotect((void *)((uintptr_t)acceso.dir & ~(PAGINA - 1)), PAGINA, PROT_NONE);
+}
+
+void anfitrion_periferico(uint32_t base, uint32_t tam, anfitrion_leer_t leer, anfitrion_escribir_t escribir) {
+	if (num_perifericos == 0) {
+		struct sigaction sa = {0};
+		sa.sa_flags = SA_SIGINFO;
+		sa.sa_sigaction = al_fallar;
+		sigaction(SIGSEGV, &sa, NULL);
+		sa.sa_sigaction = al_paso;
+		sigaction(SIGTRAP, &sa, NULL);
+	}
+	VERIFICAR(num_perifericos < MAX_PERIFERICOS && base % PAGINA == 0);
+	perifericos[num_perifericos++] = (periferico_t){base, tam, leer, escribir};
+	mprotect((void *)(uintptr_t)base, (tam + PAGINA - 1) & ~(PAGINA - 1), PROT_NONE);
+}
+
+static void entrada_iap(uint32_t *cmd, uint32_t *res) {
+	anfitrion_iap(cmd, res);
+}
+
+void anfitrion_init(void) {
+	static int listo;
+	if (listo) return;
+	listo = 1;
+
+	mapear(0x40000000UL, 0x100000, PROT_READ | PROT_WRITE, 0);		// APB0 y APB1
+	mapear(0x50000000UL, 0x200000, PROT_READ | PROT_WRITE, 0);		// AHB (DMA, EMAC, USB)
+	mapear(0x2009C000UL, 0x4000, PROT_READ | PROT_WRITE, 0);		// GPIO
+	mapear(0xE0000000UL, 0x100000, PROT_READ | PROT_WRITE, 0);		// Nucleo
+	memset(mapear(ANFITRION_FLASH_INICIO, ANFITRION_FLASH_FIN - ANFITRION_FLASH_INICIO,
+			PROT_READ | PROT_WRITE, 1), 0xFF, ANFITRION_FLASH_FIN - ANFITRION_FLASH_INICIO);
+
+	// IAP: movabs rax, entrada_iap; jmp rax
+	uint8_t *rom = mapear(0x1FFF1000UL, 0x1000, PROT_READ | PROT_WRITE | PROT_EXEC, 0);
+	uint8_t *t = rom + 0xFF1;
+	uintptr_t destino = (uintptr_t)entrada_iap;
+	t[0] = 0x48;
+	t[1] = 0xB8;
+	memcpy(t + 2, &destino, sizeof(destino));
+	t[10] = 0xFF;
+	t[11] = 0xE0;
+}
+
+// Sectores del LPC1769: 16 de 4 KB y despues de 32 KB
+uint32_t anfitrion_sector_dir(uint32_t sector) {
+	return sector < 16 ? sector * 0x1000UL : 0x10000UL + (sector - 16) * 0x8000UL;
+}
+
+uint32_t anfitrion_sector_tam(uint32_t sector) {
+	return sector < 16 ? 0x1000UL : 0x8000UL;
+}
+
+static uint32_t preparado_desde = 1, preparado_hasta = 0;
+
+static int preparado(uint32_t sector) {
+	return sector >= preparado_desde && sector <= preparado_hasta;
+}
+
+static uint32_t sector_de(uint32_t dir) {
+	return dir < 0x10000UL ? dir / 0x1000UL : 16 + (dir - 0x10000UL) / 0x8000UL;
+}
+
+// Flash NOR: borrar pone todo en 1, programar solo baja bits. Como en la ROM,
+// cada escritura o borrado consume la preparacion.
+void anfitrion_iap_nor(uint32_t *cmd, uint32_t *res) {
+	switch (cmd[0]) {
+	case 50:
+		preparado_desde = cmd[1];
+		preparado_hasta = cmd[2];
+		res[0] = 0;
+		break;
+	case 51: {
+		uint32_t s = sector_de(cmd[1]);
+		if (!preparado(s) || anfitrion_sector_dir(s) < ANFITRION_FLASH_INICIO) { res[0] = 9; break; }
+		uint8_t *d = (uint8_t *)(uintptr_t)cmd[1];
+		const uint8_t *o = (const uint8_t *)(uintptr_t)cmd[2];
+		for (uint32_t i = 0; i < cmd[3]; i++) d[i] &= o[i];
+		preparado_desde = 1;
+		preparado_hasta = 0;
+		res[0] = 0;
+		break;
+	}
+	case 52:
+		for (uint32_t s = cmd[1]; s <= cmd[2]; s++) {
+			if (!preparado(s)) { res[0] = 9; return; }
+		}
+		for (uint32_t s = cmd[1]; s <= cmd[2]; s++) {
+			memset((void *)(uintptr_t)anfitrion_sector_dir(s), 0xFF, anfitrion_sector_tam(s));
+		}
+		preparado_desde = 1;
+		preparado_hasta = 0;
+		res[0] = 0;
+		break;
+	case 53:
+		res[0] = 0;
+		for (uint32_t s = cmd[1]; s <= cmd[2] && !res[0]; s++) {
+			const uint8_t *p = (const uint8_t *)(uintptr_t)anfitrion_sector_dir(s);
+			for (uint32_t i = 0; i < anfitrion_sector_tam(s); i++) {
+				if (p[i] != 0xFF) {
+					res[0] = 8;
+					res[1] = anfitrion_sector_dir(s) + i;
+					break;
+				}
+			}
+		}
+		break;
+	default:
+		res[0] = 1;
+	}
+}
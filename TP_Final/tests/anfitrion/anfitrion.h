@@ -0,0 +1,48 @@
+#ifndef ANFITRION_H_
+#define ANFITRION_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// --- Soporte para correr modulos del firmware en la PC ---
+// anfitrion_init() mapea memoria en las direcciones reales del LPC1769:
+//   - perifericos APB/AHB, GPIO y del nucleo (SCB, NVIC, DWT), en cero
+//   - la flash desde 0x10000 (sectores de 32 KB), en 0xFF y compartida entre
+//     procesos: un hijo creado con fork() que "pierde la energia" deja la
+//     flash como quedo y el siguiente hijo arranca sobre ella
+//   - la entrada del IAP de la ROM (0x1FFF1FF1), que salta a anfitrion_iap
+// Las pruebas se enlazan sin PIE: el firmware guarda punteros a sus
+// variables estaticas en registros de 32 bits (direcciones del DMA, del IAP).
+
+#define ANFITRION_FLASH_INICIO		0x00010000UL
+#define ANFITRION_FLASH_FIN			0x00080000UL
+
+void anfitrion_init(void);
+
+// Comando IAP; por defecto una flash NOR ideal (anfitrion_iap_nor)
+extern void (*anfitrion_iap)(uint32_t *cmd, uint32_t *res);
+void anfitrion_iap_nor(uint32_t *cmd, uint32_t *res);
+uint32_t anfitrion_sector_dir(uint32_t sector);
+uint32_t anfitrion_sector_tam(uint32_t sector);
+
+// Periferico emulado: la pagina queda sin permisos y cada acceso del
+// firmware salta al modelo. 'leer' da el valor antes de que la instruccion
+// lea (NULL: el ultimo escrito); 'escribir' recibe el valor despues de que
+// la instruccion escribe. Los modelos no deben tocar paginas emuladas.
+typedef uint32_t (*anfitrion_leer_t)(uint32_t dir);
+typedef void (*anfitrion_escribir_t)(uint32_t dir, uint32_t valor);
+void anfitrion_periferico(uint32_t base, uint32_t tam, anfitrion_leer_t leer, anfitrion_escribir_t escribir);
+extern uint64_t anfitrion_accesos;		// Accesos a perifericos emulados
+
+// Ciclos del reloj de la PC, para comparar variantes entre si
+static inline uint64_t anfitrion_ciclos(void) { return __builtin_ia32_rdtsc(); }
+
+#define VERIFICAR(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: fallo: %s\n", __FILE__, __LINE__, #cond); \
+		exit(1); \
+	} \
+} while (0)
+
+#endif /* ANFITRION_H_ */
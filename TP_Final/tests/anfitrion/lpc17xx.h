@@ -0,0 +1,62 @@
+#ifndef ANFITRION_LPC17XX_H_
+#define ANFITRION_LPC17XX_H_
+
+// --- LPC17xx.h para compilar el firmware en la PC ---
+// Se incluye antes que nada (-include en el Makefile). Usa el LPC17xx.h real
+// de CMSIS, con sus estructuras y direcciones, pero reemplaza las funciones
+// del nucleo escritas en ensamblador de Thumb: la PRIMASK y la BASEPRI son
+// variables y las barreras son barreras de C11. anfitrion_init() mapea los
+// perifericos en sus direcciones reales (anfitrion.h).
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define __CORE_CMFUNC_H__
+#define __CORE_CMINSTR_H__
+
+extern volatile uint32_t anfitrion_primask;
+extern volatile uint32_t anfitrion_basepri;
+
+static inline void __enable_irq(void) { anfitrion_primask = 0; }
+static inline void __disable_irq(void) { anfitrion_primask = 1; }
+static inline uint32_t __get_PRIMASK(void) { return anfitrion_primask; }
+static inline void __set_PRIMASK(uint32_t p) { anfitrion_primask = p; }
+static inline uint32_t __get_BASEPRI(void) { return anfitrion_basepri; }
+static inline void __set_BASEPRI(uint32_t p) { anfitrion_basepri = p; }
+
+static inline void __NOP(void) { }
+static inline void __WFI(void) { }
+static inline void __DMB(void) { atomic_thread_fence(memory_order_seq_cst); }
+static inline void __DSB(void) { atomic_thread_fence(memory_order_seq_cst); }
+static inline void __ISB(void) { atomic_thread_fence(memory_order_seq_cst); }
+static inline uint32_t __RBIT(uint32_t v) {
+	uint32_t r = 0;
+	for (int i = 0; i < 32; i++) r |= ((v >> i) & 1u) << (31 - i);
+	return r;
+}
+static inline uint8_t __CLZ(uint32_t v) { return v ? (uint8_t)__builtin_clz(v) : 32; }
+
+// LDREX/STREX: el monitor exclusivo se emula con el valor leido y una
+// comparacion e intercambio (falla si otro hilo escribio en el medio)
+extern _Thread_local uint32_t anfitrion_exclusivo;
+static inline uint32_t __LDREXW(volatile uint32_t *p) {
+	return anfitrion_exclusivo = __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+static inline uint32_t __STREXW(uint32_t v, volatile uint32_t *p) {
+	uint32_t esperado = anfitrion_exclusivo;
+	return !__atomic_compare_exchange_n(p, &esperado, v, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline void __CLREX(void) { }
+
+// El contador de ciclos del DWT es el TSC de la PC (registros.h): cada
+// lectura lo toma de nuevo; escribirlo no tiene efecto
+extern _Thread_local uint32_t anfitrion_cyccnt;
+static inline volatile uint32_t *anfitrion_dwt_cyccnt(void) {
+	anfitrion_cyccnt = (uint32_t)__builtin_ia32_rdtsc();
+	return &anfitrion_cyccnt;
+}
+#define DWT_CYCCNT	(*anfitrion_dwt_cyccnt())
+
+#include "LPC17xx.h"
+
+#endif /* ANFITRION_LPC17XX_H_ */
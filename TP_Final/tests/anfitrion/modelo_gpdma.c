@@ -0,0 +1,190 @@
+#include "modelo_gpdma.h"
+#include "anfitrion.h"
+#include "lpc17xx.h"
+#include "lpc17xx_gpdma.h"
+#include <string.h>
+
+#define MAX_CONEXIONES	8
+
+typedef struct {
+	uint32_t src, dst, lli, control, config;
+} canal_t;
+
+static struct {
+	uint32_t config;
+	uint32_t raw_tc, raw_err;
+	uint32_t forzar_error;
+	canal_t canal[8];
+} r;
+
+static struct {
+	uint32_t dir;
+	uint32_t (*leer)(void);
+	void (*escribir)(uint32_t valor);
+} conexiones[MAX_CONEXIONES];
+static uint32_t num_conexiones;
+static modelo_gpdma_stats_t stats;
+
+static uint32_t habilitados(void) {
+	uint32_t m = 0;
+	for (uint32_t c = 0; c < 8; c++) {
+		if (r.canal[c].config & GPDMA_DMACCxConfig_E) m |= 1UL << c;
+	}
+	return m;
+}
+
+// Con las mascaras ITC/IE del canal, como DMACIntTCStat/DMACIntErrStat
+static uint32_t enmascarado(uint32_t raw, uint32_t mascara) {
+	uint32_t m = 0;
+	for (uint32_t c = 0; c < 8; c++) {
+		if ((raw & (1UL << c)) && (r.canal[c].config & mascara)) m |= 1UL << c;
+	}
+	return m;
+}
+
+static uint32_t leer(uint32_t dir) {
+	uint32_t off = dir - LPC_GPDMA_BASE;
+	stats.lecturas++;
+	if (off >= 0x100) {
+		canal_t *c = &r.canal[(off - 0x100) / 0x20];
+		switch ((off - 0x100) % 0x20) {
+		case 0x00: return c->src;
+		case 0x04: return c->dst;
+		case 0x08: return c->lli;
+		case 0x0C: return c->control;
+		case 0x10: return c->config;
+		}
+		return 0;
+	}
+	switch (off) {
+	case 0x000: return enmascarado(r.raw_tc, GPDMA_DMACCxConfig_ITC) | enmascarado(r.raw_err, GPDMA_DMACCxConfig_IE);
+	case 0x004: return enmascarado(r.raw_tc, GPDMA_DMACCxConfig_ITC);
+	case 0x00C: return enmascarado(r.raw_err, GPDMA_DMACCxConfig_IE);
+	case 0x014: return r.raw_tc;
+	case 0x018: return r.raw_err;
+	case 0x01C: return habilitados();
+	case 0x030: return r.config;
+	}
+	return 0;
+}
+
+static void escribir(uint32_t dir, uint32_t v) {
+	uint32_t off = dir - LPC_GPDMA_BASE;
+	stats.escrituras++;
+	if (off >= 0x100) {
+		uint32_t n = (off - 0x100) / 0x20;
+		canal_t *c = &r.canal[n];
+		stats.escrituras_canal[n]++;
+		switch ((off - 0x100) % 0x20) {
+		case 0x00: c->src = v; break;
+		case 0x04: c->dst = v; break;
+		case 0x08: c->lli = v; break;
+		case 0x0C: c->control = v; break;
+		case 0x10: c->config = v & GPDMA_DMACCxConfig_BITMASK; break;
+		}
+		return;
+	}
+	switch (off) {
+	case 0x008: r.raw_tc &= ~v; break;
+	case 0x010: r.raw_err &= ~v; break;
+	case 0x030: r.config = v & GPDMA_DMACConfig_BITMASK; break;
+	}
+}
+
+void modelo_gpdma_init(void) {
+	memset(&r, 0, sizeof(r));
+	memset(&stats, 0, sizeof(stats));
+	anfitrion_periferico(LPC_GPDMA_BASE, 0x200, leer, escribir);
+}
+
+void modelo_gpdma_conectar(uint32_t dir, uint32_t (*leer)(void), void (*escribir)(uint32_t valor)) {
+	VERIFICAR(num_conexiones < MAX_CONEXIONES);
+	conexiones[num_conexiones].dir = dir;
+	conexiones[num_conexiones].leer = leer;
+	conexiones[num_conexiones].escribir = escribir;
+	num_conexiones++;
+}
+
+static int conexion(uint32_t dir) {
+	for (uint32_t i = 0; i < num_conexiones; i++) {
+		if (conexiones[i].dir == dir) return i;
+	}
+	return -1;
+}
+
+static int en_ram(uint32_t dir) {
+	// RAM del programa de prueba (sin PIE queda debajo de 4 GB) o RAM AHB emulada
+	return dir >= 0x400000UL && dir < 0x10000000UL;
+}
+
+// Mueve un bloque (TransferSize elementos); 0 si hubo error de bus. La
+// cuenta del registro de control no se descuenta.
+static int mover(canal_t *c) {
+	uint32_t n = c->control & 0xFFF;
+	uint32_t ancho_src = 1UL << ((c->control >> 18) & 7);
+	uint32_t ancho_dst = 1UL << ((c->control >> 21) & 7);
+	int ps = conexion(c->src), pd = conexion(c->dst);
+
+	if ((ps < 0 && !en_ram(c->src)) || (pd < 0 && !en_ram(c->dst))) return 0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t v = 0;
+		if (ps >= 0) v = conexiones[ps].leer();
+		else memcpy(&v, (const void *)(uintptr_t)c->src, ancho_src);
+		if (pd >= 0) conexiones[pd].escribir(v);
+		else memcpy((void *)(uintptr_t)c->dst, &v, ancho_dst);
+		if (c->control & GPDMA_DMACCxControl_SI) c->src += ancho_src;
+		if (c->control & GPDMA_DMACCxControl_DI) c->dst += ancho_dst;
+		stats.bytes += ancho_src;
+	}
+	return 1;
+}
+
+uint32_t modelo_gpdma_avanzar(void) {
+	uint32_t terminados = 0;
+
+	if (!(r.config & GPDMA_DMACConfig_E)) return 0;
+	for (uint32_t n = 0; n < 8; n++) {
+		canal_t *c = &r.canal[n];
+		if (!(c->config & GPDMA_DMACCxConfig_E) || (c->config & GPDMA_DMACCxConfig_H)) continue;
+
+		int ok = !(r.forzar_error & (1UL << n)) && mover(c);
+		r.forzar_error &= ~(1UL << n);
+		if (ok && c->lli != 0) {
+			// Siguiente elemento de la lista (src, dst, lli, control): el
+			// canal sigue habilitado, como en un anillo
+			const uint32_t *l = (const uint32_t *)(uintptr_t)c->lli;
+			if (en_ram(c->lli)) {
+				if (c->control & GPDMA_DMACCxControl_I) r.raw_tc |= 1UL << n;
+				c->src = l[0];
+				c->dst = l[1];
+				c->control = l[3];
+				c->lli = l[2];
+				terminados |= 1UL << n;
+				continue;
+			}
+			ok = 0;
+		}
+		c->config &= ~GPDMA_DMACCxConfig_E;
+		if (ok) {
+			if (c->control & GPDMA_DMACCxControl_I) r.raw_tc |= 1UL << n;
+			stats.transferencias++;
+		} else {
+			r.raw_err |= 1UL << n;
+			stats.errores++;
+		}
+		terminados |= 1UL << n;
+	}
+	return terminados;
+}
+
+uint8_t modelo_gpdma_irq(void) {
+	return (enmascarado(r.raw_tc, GPDMA_DMACCxConfig_ITC) | enmascarado(r.raw_err, GPDMA_DMACCxConfig_IE)) != 0;
+}
+
+void modelo_gpdma_error(uint8_t canal) {
+	r.forzar_error |= 1UL << canal;
+}
+
+modelo_gpdma_stats_t *modelo_gpdma_stats(void) {
+	return &stats;
+}
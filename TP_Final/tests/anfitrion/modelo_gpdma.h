@@ -0,0 +1,31 @@
+#ifndef MODELO_GPDMA_H_
+#define MODELO_GPDMA_H_
+
+#include <stdint.h>
+
+// --- Modelo del GPDMA para las pruebas en la PC ---
+// Emula los registros en LPC_GPDMA_BASE (estado de interrupciones, canales
+// habilitados, registros de cada canal). Un canal habilitado no se mueve
+// solo: cada modelo_gpdma_avanzar() mueve un bloque de cada canal, carga el
+// siguiente elemento de la lista (LLI) y levanta el estado de fin o error. La
+// prueba llama despues a DMA_IRQHandler() si modelo_gpdma_irq() lo pide.
+// Las direcciones de perifericos (SSPx->DR, ...) se conectan con
+// modelo_gpdma_conectar(); otra direccion fuera de la RAM es un error de bus.
+
+typedef struct {
+	uint64_t escrituras;		// Escrituras a registros del GPDMA
+	uint64_t lecturas;
+	uint64_t escrituras_canal[8];
+	uint32_t transferencias;	// Canales completados
+	uint32_t errores;
+	uint64_t bytes;
+} modelo_gpdma_stats_t;
+
+void modelo_gpdma_init(void);
+void modelo_gpdma_conectar(uint32_t dir, uint32_t (*leer)(void), void (*escribir)(uint32_t valor));
+uint32_t modelo_gpdma_avanzar(void);		// Devuelve los canales que movieron un bloque
+uint8_t modelo_gpdma_irq(void);
+void modelo_gpdma_error(uint8_t canal);	// El canal termina con error en el proximo avance
+modelo_gpdma_stats_t *modelo_gpdma_stats(void);
+
+#endif /* MODELO_GPDMA_H_ */
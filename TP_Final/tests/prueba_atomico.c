@@ -0,0 +1,278 @@
+// --- Prueba de atomico.h con hilos (atomicos de C11) ---
+// Fuera del micro atomico.h usa <stdatomic.h>: los mismos algoritmos que
+// corren en las interrupciones se ejercitan con hilos. Verifica:
+//   - contadores: HILOS hilos suman con atomico_sumar y con un lazo de
+//     atomico_cas, y el total es exacto
+//   - banderas: HILOS hilos ponen y uno toma; los poner se juntan pero el
+//     ultimo nunca se pierde (la ultima toma ve todos los poner)
+//   - cola SPSC: un productor y un consumidor, todo llega una vez y en orden
+//   - cola MPSC: HILOS productores (como interrupciones de distinta
+//     prioridad) y un consumidor: todo llega una vez y en orden por productor;
+//     con la cola llena reservar devuelve -1 y el productor reintenta
+// El seqlock lo ejercita prueba_ventana.c. Los alias de bit-band solo existen
+// en el micro.
+//
+// Mide ns por operacion contra lo mismo con un pthread_mutex. Con un solo
+// nucleo los hilos se desalojan entre si, como las interrupciones; las
+// esperas ceden el procesador (en el micro nunca se espera).
+
+#include "anfitrion.h"
+#include "atomico.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define HILOS			3
+#define SUMAS			2000000		// Por hilo
+#define ELEMENTOS		500000		// Por productor
+#define TAM_COLA		16			// Como LOG_PENDIENTES
+
+static uint64_t ahora_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void correr(void *(*fn)(void *), int n, void *args, size_t tam_arg) {
+	pthread_t h[HILOS + 1];
+	for (int i = 0; i < n; i++) VERIFICAR(pthread_create(&h[i], NULL, fn, (char *)args + i * tam_arg) == 0);
+	for (int i = 0; i < n; i++) pthread_join(h[i], NULL);
+}
+
+// --- Contadores ---
+
+static atomico_u32_t contador;
+static uint32_t contador_mutex;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *sumar(void *arg) {
+	(void)arg;
+	for (uint32_t i = 0; i < SUMAS; i++) atomico_sumar(&contador, 1);
+	return NULL;
+}
+
+static void *sumar_cas(void *arg) {
+	(void)arg;
+	for (uint32_t i = 0; i < SUMAS; i++) {
+		uint32_t v;
+		do v = atomico_leer(&contador); while (!atomico_cas(&contador, v, v + 1));
+	}
+	return NULL;
+}
+
+static void *sumar_mutex(void *arg) {
+	(void)arg;
+	for (uint32_t i = 0; i < SUMAS; i++) {
+		pthread_mutex_lock(&mutex);
+		contador_mutex++;
+		pthread_mutex_unlock(&mutex);
+	}
+	return NULL;
+}
+
+// --- Banderas ---
+
+static atomico_u32_t bandera, puestas, fin_banderas;
+
+static void *poner(void *arg) {
+	(void)arg;
+	for (uint32_t i = 0; i < SUMAS / 4; i++) {
+		atomico_sumar(&puestas, 1);
+		atomico_bandera_poner(&bandera);
+	}
+	return NULL;
+}
+
+static void *tomar(void *arg) {
+	uint32_t *tomadas = arg;
+	uint32_t vistas = 0;
+	for (;;) {
+		uint8_t fin = atomico_leer(&fin_banderas);
+		if (atomico_bandera_tomar(&bandera)) {
+			uint32_t p = atomico_leer(&puestas);
+			VERIFICAR(p >= vistas);
+			vistas = p;
+			(*tomadas)++;
+		} else if (fin) {
+			break;
+		} else {
+			sched_yield();
+		}
+	}
+	VERIFICAR(vistas == HILOS * (SUMAS / 4));
+	return NULL;
+}
+
+// --- Cola SPSC ---
+
+static cola_spsc_t spsc = COLA_SPSC_INIT(TAM_COLA);
+static uint32_t datos_spsc[TAM_COLA];
+
+static void *productor_spsc(void *arg) {
+	(void)arg;
+	for (uint32_t n = 0; n < ELEMENTOS; n++) {
+		int32_t i;
+		while ((i = cola_spsc_reservar(&spsc)) < 0) sched_yield();
+		datos_spsc[i] = n;
+		cola_spsc_publicar(&spsc);
+	}
+	return NULL;
+}
+
+static void *consumidor_spsc(void *arg) {
+	(void)arg;
+	for (uint32_t n = 0; n < ELEMENTOS; n++) {
+		int32_t i;
+		while ((i = cola_spsc_siguiente(&spsc)) < 0) sched_yield();
+		VERIFICAR(datos_spsc[i] == n);
+		cola_spsc_liberar(&spsc);
+	}
+	return NULL;
+}
+
+// --- Cola MPSC ---
+
+static cola_mpsc_t mpsc;
+static atomico_u32_t seq_mpsc[TAM_COLA];
+static struct {
+	uint32_t productor, n;
+} datos_mpsc[TAM_COLA];
+static uint64_t llenas[HILOS];
+
+static void *productor_mpsc(void *arg) {
+	uint32_t id = (uint32_t)(uintptr_t)arg;
+	for (uint32_t n = 0; n < ELEMENTOS; n++) {
+		uint32_t pos;
+		int32_t i;
+		while ((i = cola_mpsc_reservar(&mpsc, &pos)) < 0) {
+			llenas[id]++;
+			sched_yield();
+		}
+		datos_mpsc[i].productor = id;
+		datos_mpsc[i].n = n;
+		cola_mpsc_publicar(&mpsc, pos);
+	}
+	return NULL;
+}
+
+static void *consumidor_mpsc(void *arg) {
+	(void)arg;
+	uint32_t siguiente[HILOS] = {0};
+	for (uint32_t total = 0; total < HILOS * ELEMENTOS; total++) {
+		int32_t i;
+		while ((i = cola_mpsc_siguiente(&mpsc)) < 0) sched_yield();
+		uint32_t p = datos_mpsc[i].productor;
+		VERIFICAR(p < HILOS && datos_mpsc[i].n == siguiente[p]);
+		siguiente[p]++;
+		cola_mpsc_liberar(&mpsc);
+	}
+	VERIFICAR(cola_mpsc_siguiente(&mpsc) < 0);
+	return NULL;
+}
+
+// Cola con mutex, para comparar
+static uint32_t datos_mutex[TAM_COLA], cab_mutex, cola_mutex_n;
+
+static void *productor_mutex(void *arg) {
+	(void)arg;
+	for (uint32_t n = 0; n < ELEMENTOS; n++) {
+		for (;;) {
+			pthread_mutex_lock(&mutex);
+			if (cab_mutex - cola_mutex_n < TAM_COLA) break;
+			pthread_mutex_unlock(&mutex);
+			sched_yield();
+		}
+		datos_mutex[cab_mutex++ % TAM_COLA] = n;
+		pthread_mutex_unlock(&mutex);
+	}
+	return NULL;
+}
+
+static void *consumidor_mutex(void *arg) {
+	(void)arg;
+	for (uint32_t n = 0; n < ELEMENTOS; n++) {
+		for (;;) {
+			pthread_mutex_lock(&mutex);
+			if (cab_mutex != cola_mutex_n) break;
+			pthread_mutex_unlock(&mutex);
+			sched_yield();
+		}
+		VERIFICAR(datos_mutex[cola_mutex_n++ % TAM_COLA] == n);
+		pthread_mutex_unlock(&mutex);
+	}
+	return NULL;
+}
+
+static void *spsc_o_mutex(void *arg) {
+	int cual = *(int *)arg;
+	switch (cual) {
+	case 0: return productor_spsc(NULL);
+	case 1: return consumidor_spsc(NULL);
+	case 2: return productor_mutex(NULL);
+	default: return consumidor_mutex(NULL);
+	}
+}
+
+static void *mpsc_hilo(void *arg) {
+	uint32_t id = *(uint32_t *)arg;
+	return (id < HILOS) ? productor_mpsc((void *)(uintptr_t)id) : consumidor_mpsc(NULL);
+}
+
+int main(void) {
+	int nada[HILOS] = {0};
+
+	// Contadores
+	uint64_t t0 = ahora_ns();
+	correr(sumar, HILOS, nada, sizeof(int));
+	uint64_t t1 = ahora_ns();
+	VERIFICAR(atomico_leer(&contador) == HILOS * SUMAS);
+	atomico_escribir(&contador, 0);
+	correr(sumar_cas, HILOS, nada, sizeof(int));
+	uint64_t t2 = ahora_ns();
+	VERIFICAR(atomico_leer(&contador) == HILOS * SUMAS);
+	correr(sumar_mutex, HILOS, nada, sizeof(int));
+	uint64_t t3 = ahora_ns();
+	VERIFICAR(contador_mutex == HILOS * SUMAS);
+	double n_sumas = (double)HILOS * SUMAS;
+	printf("contador, %d hilos x %u: exacto; ns por suma: atomico_sumar %.1f, lazo de atomico_cas %.1f, mutex %.1f\n",
+			HILOS, SUMAS, (t1 - t0) / n_sumas, (t2 - t1) / n_sumas, (t3 - t2) / n_sumas);
+
+	// Banderas: HILOS ponen, uno toma
+	uint32_t tomadas = 0;
+	pthread_t h[HILOS], consumidor;
+	VERIFICAR(pthread_create(&consumidor, NULL, tomar, &tomadas) == 0);
+	for (int i = 0; i < HILOS; i++) VERIFICAR(pthread_create(&h[i], NULL, poner, NULL) == 0);
+	for (int i = 0; i < HILOS; i++) pthread_join(h[i], NULL);
+	atomico_escribir(&fin_banderas, 1);
+	pthread_join(consumidor, NULL);
+	VERIFICAR(tomadas > 0 && tomadas <= HILOS * (SUMAS / 4));
+	VERIFICAR(!atomico_bandera_tomar(&bandera));
+	printf("banderas: %u puestas, %u tomas, la ultima ve todas\n",
+			HILOS * (SUMAS / 4), tomadas);
+
+	// SPSC y la misma cola con mutex
+	int cual[4] = {0, 1, 2, 3};
+	t0 = ahora_ns();
+	correr(spsc_o_mutex, 2, cual, sizeof(int));
+	t1 = ahora_ns();
+	correr(spsc_o_mutex, 2, cual + 2, sizeof(int));
+	t2 = ahora_ns();
+	printf("cola SPSC de %u: %u elementos en orden; ns por elemento: sin bloqueo %.1f, mutex %.1f\n",
+			TAM_COLA, ELEMENTOS, (double)(t1 - t0) / ELEMENTOS, (double)(t2 - t1) / ELEMENTOS);
+
+	// MPSC
+	uint32_t ids[HILOS + 1];
+	for (uint32_t i = 0; i <= HILOS; i++) ids[i] = i;
+	cola_mpsc_init(&mpsc, seq_mpsc, TAM_COLA);
+	t0 = ahora_ns();
+	correr(mpsc_hilo, HILOS + 1, ids, sizeof(uint32_t));
+	t1 = ahora_ns();
+	uint64_t total_llenas = 0;
+	for (int i = 0; i < HILOS; i++) total_llenas += llenas[i];
+	printf("cola MPSC de %u: %d productores x %u, todo una vez y en orden por productor; %.1f ns por elemento,"
+			" %llu reservas con la cola llena\n", TAM_COLA, HILOS, ELEMENTOS,
+			(double)(t1 - t0) / (HILOS * ELEMENTOS), (unsigned long long)total_llenas);
+
+	printf("atomico: OK\n");
+	return 0;
+}
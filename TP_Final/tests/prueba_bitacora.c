@@ -0,0 +1,273 @@
+// --- Prueba de ida y vuelta de la bitacora (bitacora.c + tools/bitacora.py) ---
+// Cada mensaje se registra con BITACORA() y, en la misma linea, se arma con
+// snprintf el texto que deberia reconstruir la PC. bitacora.c envia las
+// tramas por un modelo de la UART3 (THR se captura, LSR siempre con THRE);
+// la captura se decodifica con tools/bitacora.py leyendo la tabla de la
+// seccion bitacora_fmt de este mismo ejecutable. Verifica:
+//   - texto, archivo:linea y tiempo de cada mensaje, con los seis tipos de
+//     argumento, anchos, negativos con %x, %c, %% y de 0 a 6 argumentos
+//   - el tiempo extendido cuando tiempo_us() desborda, con diferencias y con
+//     el tiempo completo cada BITACORA_SINCRO_US
+//   - con basura entre tramas y una trama danada: se resincroniza, descarta
+//     solo la danada y la cuenta; hasta la proxima trama con el tiempo
+//     completo los mensajes salen sin hora ('?')
+//   - despues de un mensaje descartado por falta de lugar, la proxima trama
+//     lleva el tiempo completo
+//   - que la tabla no tiene llamadas con argumentos de mas o de menos
+//   - los bytes enviados son a lo sumo 1/RELACION_MINIMA de los del mismo texto
+
+#include "anfitrion.h"
+#include "app_cfg.h"
+#undef APP_USE_BITACORA
+#define APP_USE_BITACORA	1
+#include "bitacora.h"
+#include "lpc17xx_uart.h"
+#include <libgen.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_MENSAJES	64
+#define MAX_CAPTURA		4096
+#define RELACION_MINIMA	3.3
+
+// --- Modelo de la UART3 ---
+
+static struct {
+	uint8_t lcr;
+	uint8_t captura[MAX_CAPTURA];
+	uint32_t n;
+} uart;
+
+static uint32_t uart_leer(uint32_t dir) {
+	switch (dir - LPC_UART3_BASE) {
+	case 0x0C: return uart.lcr;
+	case 0x14: return UART_LSR_THRE | UART_LSR_TEMT;
+	}
+	return 0;
+}
+
+static void uart_escribir(uint32_t dir, uint32_t v) {
+	switch (dir - LPC_UART3_BASE) {
+	case 0x00:
+		if (!(uart.lcr & UART_LCR_DLAB_EN)) {
+			VERIFICAR(uart.n < MAX_CAPTURA);
+			uart.captura[uart.n++] = (uint8_t)v;
+		}
+		break;
+	case 0x0C: uart.lcr = (uint8_t)v; break;
+	}
+}
+
+// --- Mensajes esperados ---
+
+static struct {
+	char texto[160];
+	uint32_t fin;			// Fin de su trama en la captura
+} esperados[MAX_MENSAJES];
+static uint32_t num_esperados;
+static uint64_t t_ext;
+static uint32_t t_anterior;
+
+__attribute__((format(printf, 2, 3)))
+static void esperado(int linea, const char *formato, ...) {
+	char texto[100];
+	va_list ap;
+
+	va_start(ap, formato);
+	vsnprintf(texto, sizeof(texto), formato, ap);
+	va_end(ap);
+	// Tiempo extendido como el decodificador: suma las diferencias de 32 bits
+	uint32_t t = LPC_TIM3->TC;
+	t_ext = num_esperados ? t_ext + (uint32_t)(t - t_anterior) : t;
+	t_anterior = t;
+	VERIFICAR(num_esperados < MAX_MENSAJES);
+	snprintf(esperados[num_esperados++].texto, sizeof(esperados[0].texto), "%12.6f prueba_bitacora.c:%d %s",
+			t_ext / 1e6, linea, texto);
+}
+
+// La llamada y el texto esperado en la misma linea: mismo __LINE__
+#define MENSAJE(formato, ...) do { \
+	BITACORA(formato, ##__VA_ARGS__); esperado(__LINE__, formato, ##__VA_ARGS__); \
+	while (bitacora_get_stats()->bytes > uart.n - base_captura) bitacora_service(); \
+	esperados[num_esperados - 1].fin = uart.n - base_captura; \
+} while (0)
+
+static uint32_t base_captura;
+
+static void registrar(void) {
+	uint8_t u8 = 200;
+	int8_t i8 = -100;
+	uint16_t u16 = 65000;
+	int16_t i16 = -2;
+	uint32_t u32 = 4000000000u;
+	int32_t i32 = -123456789;
+	char c = 'Z';
+
+	LPC_TIM3->TC = 1000;
+	MENSAJE("arranque");
+	LPC_TIM3->TC = 2500;
+	MENSAJE("primera muestra a %u us del reset", u32);
+	MENSAJE("u8 %u i8 %d u16 %u i16 %d", u8, i8, u16, i16);
+	MENSAJE("i32 %d, i16 en hex %x, u32 en hex %08X", i32, i16, u32);
+	MENSAJE("anchos [%5u] [%-4d] [%04x] [%c]", u16, i8, u8, c);
+	MENSAJE("100%% de %u", u8);
+	MENSAJE("%u %u %u %u %u %u", u8, u16, u32, (uint8_t)1, (uint16_t)2, 3u);
+	for (uint16_t i = 0; i < 20; i++) {
+		LPC_TIM3->TC += 1000003;
+		MENSAJE("alarma %u -> %u (%u ppm)", (uint8_t)(i % 3), (uint8_t)((i + 1) % 3), (uint16_t)(i * 37));
+	}
+	// tiempo_us() desborda: el decodificador sigue contando
+	LPC_TIM3->TC = 0xFFFFFF00u;
+	MENSAJE("antes del desborde");
+	LPC_TIM3->TC = 0x100;
+	MENSAJE("despues del desborde, %d", i32);
+}
+
+// Si la trama del mensaje i lleva el tiempo completo
+static uint8_t absoluta(const uint8_t *captura, uint32_t i) {
+	return captura[i ? esperados[i - 1].fin : 0] == BITACORA_SINCRO_ABS;
+}
+
+// Decodificado igual al esperado, o con '?' en lugar de la hora
+static void comparar(const char *linea, uint32_t i, uint8_t sin_hora) {
+	char esperado[200];
+	if (sin_hora) snprintf(esperado, sizeof(esperado), "%12s%s", "?", esperados[i].texto + 12);
+	else snprintf(esperado, sizeof(esperado), "%s", esperados[i].texto);
+	if (strcmp(linea, esperado) != 0) {
+		printf("decodificado: '%s'\nesperado:     '%s'\n", linea, esperado);
+		VERIFICAR(0);
+	}
+}
+
+// Corre el decodificador sobre la captura; devuelve las lineas decodificadas,
+// y del resumen los bytes que ocuparia el texto y las tramas descartadas
+static uint32_t decodificar(const char *dir, const uint8_t *datos, uint32_t n, char lineas[][160],
+		uint32_t *texto, uint32_t *descartes) {
+	char ruta[300], orden[1000], linea[160];
+
+	snprintf(ruta, sizeof(ruta), "%s/bitacora.bin", dir);
+	FILE *f = fopen(ruta, "wb");
+	VERIFICAR(f && fwrite(datos, 1, n, f) == n);
+	fclose(f);
+	snprintf(orden, sizeof(orden), "python3 %s/../../tools/bitacora.py %s --elf %s/prueba_bitacora 2>%s/bitacora.err",
+			dir, ruta, dir, dir);
+	FILE *p = popen(orden, "r");
+	VERIFICAR(p != NULL);
+	uint32_t k = 0;
+	while (fgets(linea, sizeof(linea), p)) {
+		linea[strcspn(linea, "\n")] = 0;
+		VERIFICAR(k < MAX_MENSAJES);
+		snprintf(lineas[k++], 160, "%s", linea);
+	}
+	VERIFICAR(pclose(p) == 0);
+
+	// Resumen en la salida de errores: '# N mensajes, ... M tramas descartadas'
+	snprintf(ruta, sizeof(ruta), "%s/bitacora.err", dir);
+	f = fopen(ruta, "r");
+	VERIFICAR(f && fgets(linea, sizeof(linea), f));
+	fclose(f);
+	char *d = strstr(linea, "bytes (");
+	VERIFICAR(d && sscanf(d + 7, "%u", texto) == 1);
+	VERIFICAR(sscanf(strrchr(linea, ',') + 1, "%u", descartes) == 1);
+	return k;
+}
+
+int main(void) {
+	static char lineas[MAX_MENSAJES][160];
+	static uint8_t danada[MAX_CAPTURA + 64];
+	char ejecutable[256], orden[600];
+	uint32_t descartes;
+
+	anfitrion_init();
+	anfitrion_periferico(LPC_UART3_BASE, 0x1000, uart_leer, uart_escribir);
+	ssize_t largo = readlink("/proc/self/exe", ejecutable, sizeof(ejecutable) - 1);
+	VERIFICAR(largo > 0);
+	ejecutable[largo] = 0;
+	const char *dir = dirname(ejecutable);
+
+	// La tabla: cada llamada con tantos argumentos como pide su formato
+	snprintf(orden, sizeof(orden), "python3 %s/../../tools/bitacora.py --tabla --elf %s/prueba_bitacora >/dev/null",
+			dir, dir);
+	bitacora_init();
+	base_captura = uart.n;
+	registrar();
+	VERIFICAR(system(orden) == 0);
+	VERIFICAR(bitacora_get_stats()->mensajes == num_esperados && bitacora_get_stats()->descartados == 0);
+
+	// 1. Ida y vuelta
+	const uint8_t *captura = uart.captura + base_captura;
+	uint32_t total = uart.n - base_captura, texto;
+	uint32_t n = decodificar(dir, captura, total, lineas, &texto, &descartes);
+	VERIFICAR(n == num_esperados && descartes == 0);
+	uint32_t absolutas = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		comparar(lineas[i], i, 0);
+		absolutas += absoluta(captura, i);
+	}
+	VERIFICAR(absoluta(captura, 0) && absolutas > 1 && absolutas < n / 2);
+	VERIFICAR(total == bitacora_get_stats()->bytes);
+	printf("%u mensajes (%u con el tiempo completo): texto, archivo:linea y tiempo iguales a los de snprintf "
+			"(con desborde de tiempo_us)\n", n, absolutas);
+	printf("%u bytes enviados, %u como texto (%.1fx)\n", total, texto, (double)texto / total);
+	VERIFICAR(texto >= RELACION_MINIMA * total);
+
+	// 2. Basura al principio y entre tramas: un 0xA5 suelto, bytes sueltos
+	static const uint8_t basura[] = { 0xA5, 0x00, 0xA6, 0xFF, 0x13 };
+	uint8_t sin_hora[MAX_MENSAJES], perdido = 1;
+	uint32_t m = 0, inciertos = 0;
+	memcpy(danada, basura, sizeof(basura));
+	m = sizeof(basura);
+	for (uint32_t i = 0, desde = 0; i < num_esperados; desde = esperados[i++].fin) {
+		if (absoluta(captura, i)) perdido = 0;
+		sin_hora[i] = perdido;
+		inciertos += perdido;
+		memcpy(danada + m, captura + desde, esperados[i].fin - desde);
+		m += esperados[i].fin - desde;
+		if (i == 1) danada[m++] = 0x42;
+		if (i == 4) danada[m++] = BITACORA_SINCRO;
+		if (i == 9) {
+			memcpy(danada + m, basura, sizeof(basura));
+			m += sizeof(basura);
+		}
+		if (i == 1 || i == 4 || i == 9) perdido = 1;
+	}
+	n = decodificar(dir, danada, m, lineas, &texto, &descartes);
+	VERIFICAR(n == num_esperados && descartes > 0 && inciertos > 0 && inciertos < n);
+	for (uint32_t i = 0; i < n; i++) comparar(lineas[i], i, sin_hora[i]);
+	printf("con basura entre tramas: se resincroniza y no pierde ninguna (%u falsas tramas descartadas); "
+			"%u sin hora hasta la trama con el tiempo completo\n", descartes, inciertos);
+
+	// 3. Un byte de argumento cambiado en el tercer mensaje: solo ese se pierde
+	memcpy(danada, captura, total);
+	danada[esperados[1].fin + 3] ^= 0x01;
+	n = decodificar(dir, danada, total, lineas, &texto, &descartes);
+	VERIFICAR(n == num_esperados - 1 && descartes >= 1);
+	perdido = 0;
+	for (uint32_t i = 0, j = 0; i < num_esperados; i++) {
+		if (absoluta(captura, i)) perdido = 0;
+		if (i != 2) comparar(lineas[j++], i, perdido);
+		else perdido = 1;
+	}
+	printf("trama danada: se descarta solo esa, las demas se decodifican\n");
+
+	// 4. Sin lugar en el buffer: se descarta y la proxima va con el tiempo completo
+	uint32_t descartados = bitacora_get_stats()->descartados;
+	while (bitacora_get_stats()->descartados == descartados) BITACORA("llenando %u", descartados);
+	while (bitacora_get_stats()->bytes > uart.n - base_captura) bitacora_service();
+	uint32_t antes = uart.n;
+	LPC_TIM3->TC += 10;
+	BITACORA("despues del descarte");
+	while (bitacora_get_stats()->bytes > uart.n - base_captura) bitacora_service();
+	VERIFICAR(uart.n > antes && uart.captura[antes] == BITACORA_SINCRO_ABS);
+	antes = uart.n;
+	LPC_TIM3->TC += 10;
+	BITACORA("y la siguiente con diferencia");
+	while (bitacora_get_stats()->bytes > uart.n - base_captura) bitacora_service();
+	VERIFICAR(uart.n > antes && uart.captura[antes] == BITACORA_SINCRO);
+	printf("sin lugar: %u descartado, la proxima trama con el tiempo completo\n",
+			bitacora_get_stats()->descartados - descartados);
+
+	printf("bitacora: OK\n");
+	return 0;
+}
@@ -0,0 +1,494 @@
+// --- Prueba de can_net.c y can_modelo.c con el CAN1 emulado ---
+// El modelo de CAN1 atiende los registros del controlador (tres buffers de
+// TX, recepcion doble, ICR que se limpia al leer) y aplica el filtro de
+// aceptacion leyendo la tabla que arma CAN_SetupAFLUT en la RAM del filtro,
+// como el hardware. Las tramas van por el "bus":
+//   - una interfaz SocketCAN ya creada, si PRUEBA_VCAN la nombra:
+//       ip link add vcan0 type vcan && ip link set vcan0 up
+//       PRUEBA_VCAN=vcan0 make     (candump vcan0 muestra el trafico)
+//   - si no, un socketpair que lleva las mismas struct can_frame
+// Un proceso hijo es el nodo 1 (el firmware) y ademas genera el trafico de
+// los nodos 2..16 y tramas que el filtro tiene que rechazar; el proceso
+// principal es el concentrador. Tambien se verifica el descarte con el bus
+// caido, el desborde de recepcion y los errores de bus, y se contrasta el
+// modelo de carga y latencia con una simulacion del arbitraje.
+
+#include "anfitrion.h"
+#include "can_net.h"
+#include "flash_log.h"
+#include "lpc17xx_can.h"
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+void CAN_IRQHandler(void);
+
+#define REGISTROS_NODO		300		// Registros del firmware (nodo 1)
+#define TRAMAS_OTROS		50		// Tramas de cada uno de los nodos 2..16
+#define NODO_HUECO			7		// Este nodo saltea seq: el concentrador cuenta perdidas
+#define HUECO				3
+
+// --- CAN1 ---
+
+#define REG(campo)		offsetof(LPC_CAN_TypeDef, campo)
+#define SR_RBS			(1u << 0)
+#define SR_DOS			(1u << 1)
+#define SR_TBS(b)		(1u << (2 + 8 * (b)))
+#define SR_TCS(b)		(1u << (3 + 8 * (b)))
+#define ICR_RI			(1u << 0)
+#define ICR_BEI			(1u << 7)
+
+static struct {
+	uint32_t r[0x1000 / 4];
+	uint8_t  tx_ocupado[3];
+	struct can_frame rx[2];		// Buffer visible y el segundo de la recepcion doble
+	uint32_t rx_n;
+	uint32_t icr;
+	uint8_t  dos;
+	uint8_t  bus_caido;			// Los buffers de TX nunca terminan de transmitir
+	int      bus;
+	uint32_t enviadas, aceptadas, rechazadas, desbordes;
+	uint64_t accesos;
+} can;
+
+static uint32_t can_leer(uint32_t dir) {
+	uint32_t off = dir - LPC_CAN1_BASE;
+	can.accesos++;
+	if (off == REG(SR)) {
+		uint32_t sr = (can.rx_n ? SR_RBS : 0) | (can.dos ? SR_DOS : 0);
+		for (int b = 0; b < 3; b++) if (!can.tx_ocupado[b]) sr |= SR_TBS(b) | SR_TCS(b);
+		return sr;
+	}
+	if (off == REG(ICR)) {
+		// RI sigue al buffer de recepcion; el resto se limpia al leer
+		uint32_t icr = can.icr | ((can.rx_n && (can.r[REG(IER) / 4] & ICR_RI)) ? ICR_RI : 0);
+		can.icr = 0;
+		return icr;
+	}
+	if (off == REG(RFS)) {
+		const struct can_frame *f = &can.rx[0];
+		return ((f->can_id & CAN_EFF_FLAG) ? (1u << 31) : 0) | ((f->can_id & CAN_RTR_FLAG) ? (1u << 30) : 0) |
+				((uint32_t)f->can_dlc << 16);
+	}
+	if (off == REG(RID)) return can.rx[0].can_id & ((can.rx[0].can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+	if (off == REG(RDA) || off == REG(RDB)) {
+		uint32_t v;
+		memcpy(&v, can.rx[0].data + (off == REG(RDB) ? 4 : 0), 4);
+		return v;
+	}
+	return can.r[off / 4];
+}
+
+static void can_transmitir(int b) {
+	const uint32_t *buf = &can.r[(REG(TFI1) + 0x10 * b) / 4];	// TFI, TID, TDA, TDB
+	struct can_frame f;
+	memset(&f, 0, sizeof(f));
+	f.can_id = buf[1] | ((buf[0] & (1u << 31)) ? CAN_EFF_FLAG : 0) | ((buf[0] & (1u << 30)) ? CAN_RTR_FLAG : 0);
+	f.can_dlc = (buf[0] >> 16) & 0xF;
+	memcpy(f.data, &buf[2], 4);
+	memcpy(f.data + 4, &buf[3], 4);
+	if (can.bus_caido) {
+		can.tx_ocupado[b] = 1;
+		return;
+	}
+	VERIFICAR(write(can.bus, &f, sizeof(f)) == sizeof(f));
+	can.enviadas++;
+}
+
+static void can_escribir(uint32_t dir, uint32_t v) {
+	uint32_t off = dir - LPC_CAN1_BASE;
+	can.accesos++;
+	can.r[off / 4] = v;
+	if (off != REG(CMR)) return;
+	if (v & (1u << 0)) {		// TR con STB1..STB3
+		for (int b = 0; b < 3; b++) if (v & (1u << (5 + b))) can_transmitir(b);
+	}
+	if ((v & (1u << 2)) && can.rx_n) {		// RRB
+		can.rx[0] = can.rx[1];
+		can.rx_n--;
+	}
+	if (v & (1u << 3)) can.dos = 0;			// CDO
+}
+
+// Filtro de aceptacion en modo normal, sobre la tabla en LPC_CANAF_RAM. Las
+// entradas estandar son de 16 bits (SCC en 15..13, deshabilitada en 12, ID
+// en 10..0), la de la mitad alta primero; CAN1 es el controlador 0.
+static uint16_t entrada_sff(uint32_t palabra, int alta) {
+	return (uint16_t)(alta ? palabra >> 16 : palabra);
+}
+
+static int sff_coincide(uint16_t e, uint32_t id) {
+	return (e >> 13) == 0 && !(e & (1u << 12)) && (e & 0x7FF) == id;
+}
+
+static int filtro_acepta(const struct can_frame *f) {
+	uint32_t afmr = LPC_CANAF->AFMR;
+	if (afmr & 0x02) return 1;		// AccBP
+	if (afmr & 0x01) return 0;		// AccOff
+
+	const volatile uint32_t *m = LPC_CANAF_RAM->mask;
+	if (f->can_id & CAN_EFF_FLAG) {
+		uint32_t id = f->can_id & CAN_EFF_MASK;
+		for (uint32_t a = LPC_CANAF->EFF_sa; a < LPC_CANAF->EFF_GRP_sa; a += 4)
+			if ((m[a / 4] >> 29) == 0 && (m[a / 4] & CAN_EFF_MASK) == id) return 1;
+		for (uint32_t a = LPC_CANAF->EFF_GRP_sa; a + 4 < LPC_CANAF->ENDofTable; a += 8)
+			if ((m[a / 4] >> 29) == 0 && (m[a / 4] & CAN_EFF_MASK) <= id && id <= (m[a / 4 + 1] & CAN_EFF_MASK)) return 1;
+		return 0;
+	}
+
+	uint32_t id = f->can_id & CAN_SFF_MASK;
+	for (uint32_t a = LPC_CANAF->SFF_sa; a < LPC_CANAF->SFF_GRP_sa; a += 4)
+		if (sff_coincide(entrada_sff(m[a / 4], 1), id) || sff_coincide(entrada_sff(m[a / 4], 0), id)) return 1;
+	for (uint32_t a = LPC_CANAF->SFF_GRP_sa; a < LPC_CANAF->EFF_sa; a += 4) {
+		uint16_t inf = entrada_sff(m[a / 4], 1), sup = entrada_sff(m[a / 4], 0);
+		if ((inf >> 13) || (sup >> 13) || (inf & (1u << 12))) continue;
+		if ((inf & 0x7FF) <= id && id <= (sup & 0x7FF)) return 1;
+	}
+	return 0;
+}
+
+// Una trama llega del bus: filtro, recepcion doble y desborde
+static void can_llega(const struct can_frame *f) {
+	if (!filtro_acepta(f)) {
+		can.rechazadas++;
+		return;
+	}
+	can.aceptadas++;
+	if (can.rx_n == 2) {
+		can.dos = 1;
+		can.desbordes++;
+		return;
+	}
+	can.rx[can.rx_n++] = *f;
+}
+
+// NVIC: la interrupcion entra si esta habilitada y hay algo pendiente
+static void can_atender(void) {
+	if (!(NVIC->ISER[0] & (1u << CAN_IRQn))) return;
+	uint32_t ier = can.r[REG(IER) / 4];
+	if ((can.rx_n && (ier & ICR_RI)) || (can.icr & ier)) CAN_IRQHandler();
+}
+
+static void can_init(int bus) {
+	memset(&can, 0, sizeof(can));
+	can.bus = bus;
+}
+
+// --- Bus ---
+
+static int abrir_vcan(const char *nombre) {
+	struct sockaddr_can sa;
+	struct ifreq ifr;
+	int s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	if (s < 0) return -1;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, nombre, IFNAMSIZ - 1);
+	if (ioctl(s, SIOCGIFINDEX, &ifr) < 0) {
+		close(s);
+		return -1;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.can_family = AF_CAN;
+	sa.can_ifindex = ifr.ifr_ifindex;
+	if (bind(s, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		close(s);
+		return -1;
+	}
+	int tam = 4 << 20;
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, &tam, sizeof(tam));
+	return s;
+}
+
+static const char *vcan;
+
+// Extremo para transmitir (nodos) y para recibir (concentrador)
+static void abrir_bus(int *tx, int *rx) {
+	int par[2];
+	if (vcan) {
+		*rx = abrir_vcan(vcan);
+		*tx = abrir_vcan(vcan);
+		VERIFICAR(*rx >= 0 && *tx >= 0);
+		return;
+	}
+	VERIFICAR(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, par) == 0);
+	*tx = par[0];
+	*rx = par[1];
+}
+
+static void enviar_trama(int bus, uint32_t can_id, uint8_t nodo_seq, uint16_t valor, uint8_t aux, uint32_t t) {
+	struct can_frame f;
+	memset(&f, 0, sizeof(f));
+	f.can_id = can_id;
+	f.can_dlc = 8;
+	memcpy(f.data, &t, 4);
+	f.data[4] = (uint8_t)valor;
+	f.data[5] = (uint8_t)(valor >> 8);
+	f.data[6] = aux;
+	f.data[7] = nodo_seq;
+	VERIFICAR(write(bus, &f, sizeof(f)) == sizeof(f));
+	// vcan no tiene control de flujo: se le da tiempo al concentrador
+	if (vcan) usleep(50);
+}
+
+// IDs fuera de la tabla del concentrador
+static const uint32_t rechazados[] = {
+	CAN_ID(CAN_CLASE_MUESTRA, CAN_NET_MAX_NODOS + 1),
+	CAN_ID(CAN_CLASE_MUESTRA, 0),
+	CAN_ID(CAN_CLASE_ALARMA, 63),
+	CAN_ID(6, 1),
+	CAN_ID(1, 1),
+	CAN_ID(CAN_CLASE_MUESTRA, 1) | CAN_EFF_FLAG,
+};
+#define N_RECHAZADOS	(sizeof(rechazados) / sizeof(rechazados[0]))
+
+static uint8_t estado_nodo1(uint32_t t) { return t >= REGISTROS_NODO / 2 ? 2 : 0; }
+
+// --- Nodo 1 (firmware) y resto de la red, en el proceso hijo ---
+
+static void red(int bus) {
+	can_init(bus);
+	VERIFICAR(can_net_init(0));
+
+	uint64_t accesos = 0;
+	for (uint32_t t = 0; t < REGISTROS_NODO; t++) {
+		uint64_t a0 = can.accesos;
+		if (t == REGISTROS_NODO / 2) can_net_append(FLOG_EVENTO_ALARMA, (uint16_t)(t * 2), 2, t);
+		can_net_append(FLOG_MUESTRA, (uint16_t)(t * 2), estado_nodo1(t), t);
+		if (t % 13 == 12) can_net_append(FLOG_PROMEDIO, (uint16_t)(1000 + t), estado_nodo1(t), t);
+		accesos += can.accesos - a0;
+
+		// Los demas nodos transmiten intercalados con el firmware
+		if (t < TRAMAS_OTROS) {
+			for (uint8_t n = 2; n <= CAN_NET_MAX_NODOS; n++) {
+				uint8_t seq = (uint8_t)t;
+				if (n == NODO_HUECO && t >= TRAMAS_OTROS / 2) seq += HUECO;
+				enviar_trama(bus, CAN_ID(CAN_CLASE_MUESTRA, n), seq, (uint16_t)(n * 100 + t), 0, t);
+			}
+		}
+		if (t < N_RECHAZADOS) enviar_trama(bus, rechazados[t], 0, 9999, 9, t);
+	}
+
+	const can_stats_t *s = can_net_get_stats();
+	VERIFICAR(s->tramas_perdidas == 0);
+	VERIFICAR(s->tramas_enviadas == can.enviadas);
+	printf("nodo 1: %u tramas, %.1f accesos a CAN1 por trama\n", s->tramas_enviadas,
+			(double)accesos / (s->tramas_enviadas - 1));
+}
+
+// --- Concentrador, en el proceso principal ---
+
+static uint32_t tramas_nodo1(void) {
+	return 1 + REGISTROS_NODO + 1 + REGISTROS_NODO / 13;	// Inicio, muestras, alarma, promedios
+}
+
+static void concentrador(int bus, pid_t hijo) {
+	struct can_frame f;
+	int estado = -1;
+	uint32_t esperadas = tramas_nodo1() + (CAN_NET_MAX_NODOS - 1) * TRAMAS_OTROS + N_RECHAZADOS;
+	uint64_t accesos = 0;
+
+	while (can.aceptadas + can.rechazadas < esperadas) {
+		struct pollfd p = {bus, POLLIN, 0};
+		if (poll(&p, 1, 1000) <= 0) {
+			// El hijo termino y no llega nada mas
+			if (estado != -1 || waitpid(hijo, &estado, WNOHANG) == hijo) break;
+			continue;
+		}
+		ssize_t r = read(bus, &f, sizeof(f));
+		if (r <= 0) break;
+		VERIFICAR(r == sizeof(f));
+		can_llega(&f);
+		uint64_t a0 = can.accesos;
+		can_atender();
+		accesos += can.accesos - a0;
+	}
+	if (estado == -1) VERIFICAR(waitpid(hijo, &estado, 0) == hijo);
+	VERIFICAR(WIFEXITED(estado) && WEXITSTATUS(estado) == 0);
+
+	const can_stats_t *s = can_net_get_stats();
+	VERIFICAR(can.rechazadas == N_RECHAZADOS);
+	VERIFICAR(can.aceptadas == esperadas - N_RECHAZADOS);
+	VERIFICAR(can.desbordes == 0);
+	VERIFICAR(s->tramas_recibidas == can.aceptadas);
+
+	const can_nodo_t *n1 = can_net_get_nodo(1);
+	VERIFICAR(n1->tramas == tramas_nodo1());
+	VERIFICAR(n1->perdidas == 0);
+	VERIFICAR(n1->t == REGISTROS_NODO - 1);
+	VERIFICAR(n1->ultimo_ppm == (REGISTROS_NODO - 1) * 2);
+	VERIFICAR(n1->promedio_ppm == 1000 + (REGISTROS_NODO / 13) * 13 - 1);
+	VERIFICAR(n1->estado == estado_nodo1(REGISTROS_NODO - 1));
+	for (uint8_t n = 2; n <= CAN_NET_MAX_NODOS; n++) {
+		const can_nodo_t *nodo = can_net_get_nodo(n);
+		VERIFICAR(nodo->tramas == TRAMAS_OTROS);
+		VERIFICAR(nodo->perdidas == (n == NODO_HUECO ? HUECO : 0));
+		VERIFICAR(nodo->ultimo_ppm == n * 100 + TRAMAS_OTROS - 1);
+	}
+	printf("concentrador: %u tramas de %u nodos; %u rechazadas por el filtro de aceptacion;"
+			" %.1f accesos a CAN1 por trama recibida\n", s->tramas_recibidas, CAN_NET_MAX_NODOS,
+			can.rechazadas, (double)accesos / can.aceptadas);
+	printf("  nodo %u: %u tramas perdidas detectadas por seq\n", NODO_HUECO, can_net_get_nodo(NODO_HUECO)->perdidas);
+}
+
+// Sin atender la interrupcion a tiempo: la tercera trama desborda la
+// recepcion doble y el concentrador lo ve como un hueco en seq con la cuarta
+static void desborde(void) {
+	const can_nodo_t *n = can_net_get_nodo(5);
+	uint32_t perdidas = n->perdidas, tramas = n->tramas;
+	struct can_frame f;
+	memset(&f, 0, sizeof(f));
+	f.can_id = CAN_ID(CAN_CLASE_MUESTRA, 5);
+	f.can_dlc = 8;
+	for (uint8_t i = 0; i < 4; i++) {
+		f.data[7] = (uint8_t)(TRAMAS_OTROS + i);
+		can_llega(&f);
+		if (i >= 2) can_atender();
+	}
+	VERIFICAR(can.desbordes == 1);
+	VERIFICAR(n->tramas == tramas + 3);
+	VERIFICAR(n->perdidas == perdidas + 1);
+
+	can.icr |= ICR_BEI;
+	can_atender();
+	VERIFICAR(can_net_get_stats()->errores_bus == 1);
+	printf("desborde de recepcion y error de bus: contados\n");
+}
+
+// Sin otro nodo que de el acuse, los buffers de TX no se liberan: despues
+// de los tres se descarta y se cuenta, sin esperar
+static void bus_caido(void) {
+	can_init(-1);
+	can.bus_caido = 1;
+	VERIFICAR(can_net_init(0));
+	for (uint32_t t = 0; t < 10; t++) can_net_append(FLOG_MUESTRA, 0, 0, t);
+	VERIFICAR(can_net_get_stats()->tramas_enviadas == 3);
+	VERIFICAR(can_net_get_stats()->tramas_perdidas == 8);
+	printf("bus caido: 3 tramas en los buffers, 8 descartadas y contadas\n");
+}
+
+// --- Modelo de carga y latencia contra una simulacion del arbitraje ---
+// Los mismos flujos que can_modelo_red: cada trama se libera con su periodo
+// (las alarmas con la separacion minima, su peor caso) y, cuando el bus queda
+// libre, gana la pendiente de menor ID. Sin expropiacion: una trama ya
+// empezada termina aunque se libere otra de mayor prioridad.
+
+#define PERIODO_MUESTRA_NS		1000000000ULL
+#define PERIODO_ALARMA_NS		1000000000ULL
+#define PERIODO_PROMEDIO_NS		13000000000ULL
+
+typedef struct {
+	uint16_t id;
+	uint64_t periodo, proxima, liberada;
+	uint8_t  pendiente;
+	uint64_t peor;
+} flujo_sim_t;
+
+static void simular(uint32_t nodos, uint32_t baud, uint64_t fases, uint64_t duracion,
+		uint64_t *peor_alarma, uint64_t *peor_muestra, uint32_t *carga_pmil) {
+	static flujo_sim_t f[3 * 63];
+	uint32_t n = 0;
+	uint64_t ns_bit = 1000000000ULL / baud;
+	uint64_t c = can_modelo_bits_trama(8) * ns_bit;
+
+	for (uint32_t nodo = 1; nodo <= nodos; nodo++) {
+		f[n++] = (flujo_sim_t){CAN_ID(CAN_CLASE_ALARMA, nodo), PERIODO_ALARMA_NS};
+		f[n++] = (flujo_sim_t){CAN_ID(CAN_CLASE_PROMEDIO, nodo), PERIODO_PROMEDIO_NS};
+		f[n++] = (flujo_sim_t){CAN_ID(CAN_CLASE_MUESTRA, nodo), PERIODO_MUESTRA_NS};
+	}
+	for (uint32_t i = 0; i < n; i++) f[i].proxima = fases ? (uint64_t)rand() % fases : 0;
+
+	uint64_t t = 0, ocupado = 0;
+	while (t < duracion) {
+		int ganador = -1;
+		uint64_t siguiente = UINT64_MAX;
+		for (uint32_t i = 0; i < n; i++) {
+			if (f[i].proxima <= t) {
+				VERIFICAR(!f[i].pendiente);		// Se perdio el periodo
+				f[i].pendiente = 1;
+				f[i].liberada = f[i].proxima;
+				f[i].proxima += f[i].periodo;
+			}
+			if (f[i].proxima < siguiente) siguiente = f[i].proxima;
+			if (f[i].pendiente && (ganador < 0 || f[i].id < f[ganador].id)) ganador = i;
+		}
+		if (ganador < 0) {
+			t = siguiente;
+			continue;
+		}
+		t += c;
+		ocupado += c;
+		f[ganador].pendiente = 0;
+		if (t - f[ganador].liberada > f[ganador].peor) f[ganador].peor = t - f[ganador].liberada;
+	}
+	*peor_alarma = f[n - 3].peor;
+	*peor_muestra = f[n - 1].peor;
+	*carga_pmil = (uint32_t)(ocupado * 1000 / t);
+}
+
+static void modelo(void) {
+	VERIFICAR(can_modelo_bits_trama(0) == 55);
+	VERIFICAR(can_modelo_bits_trama(8) == 135);
+
+	static const uint32_t redes[] = {1, 16, 63};
+	srand(1);
+	for (uint32_t r = 0; r < sizeof(redes) / sizeof(redes[0]); r++) {
+		can_modelo_t m;
+		uint64_t peor_alarma = 0, peor_muestra = 0;
+		uint32_t carga = 0;
+		can_modelo_red(redes[r], CAN_NET_BAUD, &m);
+		VERIFICAR(m.latencia_alarma_us != UINT32_MAX && m.latencia_muestra_us != UINT32_MAX);
+
+		// Liberacion simultanea (instante critico) y varias fases al azar
+		for (uint32_t k = 0; k < 8; k++) {
+			uint64_t a, mu;
+			simular(redes[r], CAN_NET_BAUD, k ? PERIODO_MUESTRA_NS : 0, 26 * PERIODO_MUESTRA_NS, &a, &mu, &carga);
+			if (a > peor_alarma) peor_alarma = a;
+			if (mu > peor_muestra) peor_muestra = mu;
+		}
+		VERIFICAR(peor_alarma <= (uint64_t)m.latencia_alarma_us * 1000);
+		VERIFICAR(peor_muestra <= (uint64_t)m.latencia_muestra_us * 1000);
+		VERIFICAR(carga + 1 >= m.carga_pmil && carga <= m.carga_pmil + 1);
+		printf("%2u nodos a %u bit/s: carga %u/1000 (simulada %u); alarma %u us (simulada %.0f),"
+				" muestra %u us (simulada %.0f)\n", redes[r], CAN_NET_BAUD, m.carga_pmil, carga,
+				m.latencia_alarma_us, peor_alarma / 1e3, m.latencia_muestra_us, peor_muestra / 1e3);
+	}
+}
+
+int main(void) {
+	int tx, rx;
+
+	anfitrion_init();
+	anfitrion_periferico(LPC_CAN1_BASE, 0x1000, can_leer, can_escribir);
+	vcan = getenv("PRUEBA_VCAN");
+	printf("bus: %s%s\n", vcan ? "SocketCAN " : "socketpair dentro de la prueba (sin PRUEBA_VCAN)", vcan ? vcan : "");
+
+	modelo();
+	bus_caido();
+
+	abrir_bus(&tx, &rx);
+	fflush(stdout);
+	pid_t hijo = fork();
+	VERIFICAR(hijo >= 0);
+	if (hijo == 0) {
+		close(rx);
+		red(tx);
+		fflush(stdout);
+		_exit(0);
+	}
+	close(tx);
+	can_init(-1);
+	VERIFICAR(can_net_init(1));
+	VERIFICAR(can.enviadas == 0);		// El concentrador no transmite
+	concentrador(rx, hijo);
+	desborde();
+	printf("can_net: OK\n");
+	return 0;
+}
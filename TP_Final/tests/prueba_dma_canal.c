@@ -0,0 +1,171 @@
+// --- Prueba de dma_canal.c sobre el modelo del GPDMA ---
+// Los registros de estado de interrupciones (DMACIntTCStat, DMACIntErrStat y
+// sus borrados) son los del modelo (modelo_gpdma.h); TIMER3, la base de
+// tiempo, es memoria comun que la prueba avanza a mano. Verifica:
+//   - el reparto de canales por prioridad, el agotamiento y la liberacion
+//   - que DMA_IRQHandler lee y borra cada registro de estado una vez, con
+//     cualquier cantidad de canales pendientes, y llama a fin o error de
+//     cada canal en orden de prioridad
+//   - que un fin que llega mientras corre el despacho no se pierde
+//   - las estadisticas por canal (arranques, fines, errores, tiempo ocupado)
+// Compara los accesos al GPDMA por interrupcion con un despacho canal por
+// canal con GPDMA_IntGetStatus/GPDMA_ClearIntPending, como era antes.
+
+#include "anfitrion.h"
+#include "modelo_gpdma.h"
+#include "dma_canal.h"
+#include <string.h>
+
+#define TAM				8
+
+void DMA_IRQHandler(void);
+
+static uint8_t origen[DMA_NUM_CANALES][TAM] __attribute__((aligned(4)));
+static uint8_t destino[DMA_NUM_CANALES][TAM] __attribute__((aligned(4)));
+static GPDMA_Image_Type imagen[DMA_NUM_CANALES];
+
+static struct {
+	uint8_t canal;
+	uint8_t error;
+} llamadas[64];
+static uint32_t num_llamadas;
+static uint8_t rearmar_en_fin = DMA_SIN_CANAL;	// Canal que arranca el proximo fin
+
+static void fin(uint8_t canal) {
+	llamadas[num_llamadas++] = (typeof(llamadas[0])){canal, 0};
+	// Un canal arrancado aca que termina antes de que salga la interrupcion
+	if (rearmar_en_fin != DMA_SIN_CANAL) {
+		uint8_t otro = rearmar_en_fin;
+		rearmar_en_fin = DMA_SIN_CANAL;
+		VERIFICAR(dma_canal_arrancar(&imagen[otro]) == SUCCESS);
+		VERIFICAR(modelo_gpdma_avanzar() == (1UL << otro));
+	}
+}
+
+static void error(uint8_t canal) {
+	llamadas[num_llamadas++] = (typeof(llamadas[0])){canal, 1};
+}
+
+static uint64_t accesos(void) {
+	modelo_gpdma_stats_t *s = modelo_gpdma_stats();
+	return s->lecturas + s->escrituras;
+}
+
+static void armar(uint8_t c) {
+	GPDMA_Channel_CFG_Type cfg = {0};
+
+	cfg.ChannelNum = c;
+	cfg.TransferSize = TAM;
+	cfg.TransferType = GPDMA_TRANSFERTYPE_M2M;
+	cfg.TransferWidth = GPDMA_WIDTH_BYTE;
+	cfg.SrcMemAddr = (uint32_t)origen[c];
+	cfg.DstMemAddr = (uint32_t)destino[c];
+	VERIFICAR(GPDMA_BuildImage(&cfg, &imagen[c]) == SUCCESS);
+}
+
+// Atiende la interrupcion mientras el modelo la pida; devuelve las vueltas
+static uint32_t atender(void) {
+	uint32_t n = 0;
+	while (modelo_gpdma_irq()) {
+		DMA_IRQHandler();
+		VERIFICAR(++n < 10);
+	}
+	return n;
+}
+
+// Despacho de antes: dos consultas y un borrado por canal con el driver
+static void despacho_por_canal(void) {
+	for (uint8_t c = 0; c < DMA_NUM_CANALES; c++) {
+		if (GPDMA_IntGetStatus(GPDMA_STAT_INTTC, c)) {
+			GPDMA_ClearIntPending(GPDMA_STATCLR_INTTC, c);
+			fin(c);
+		}
+		if (GPDMA_IntGetStatus(GPDMA_STAT_INTERR, c)) {
+			GPDMA_ClearIntPending(GPDMA_STATCLR_INTERR, c);
+			error(c);
+		}
+	}
+}
+
+int main(void) {
+	anfitrion_init();
+	modelo_gpdma_init();
+	dma_canal_init();
+
+	// Reparto: ALTA toma del canal 0 para arriba, BAJA del 7 para abajo
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_ALTA, fin, error) == 0);
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_BAJA, fin, error) == 7);
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_ALTA, fin, error) == 1);
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_BAJA, fin, error) == 6);
+	for (uint8_t c = 2; c < 6; c++) VERIFICAR(dma_canal_pedir(DMA_PRIO_ALTA, fin, error) == c);
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_ALTA, fin, error) == DMA_SIN_CANAL);
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_BAJA, fin, error) == DMA_SIN_CANAL);
+	dma_canal_liberar(4);
+	VERIFICAR(dma_canal_pedir(DMA_PRIO_BAJA, fin, error) == 4);
+	VERIFICAR(dma_canal_get_stats(8) == NULL);
+	printf("reparto: por prioridad, sin canal cuando se agotan, el liberado se reutiliza\n");
+
+	for (uint8_t c = 0; c < DMA_NUM_CANALES; c++) {
+		memset(origen[c], 0x10 + c, TAM);
+		armar(c);
+	}
+
+	// Todos los canales a la vez, con errores en el 2 y el 5: una sola
+	// interrupcion, dos lecturas y dos borrados
+	LPC_TIM3->TC = 1000;
+	for (uint8_t c = 0; c < DMA_NUM_CANALES; c++) VERIFICAR(dma_canal_arrancar(&imagen[c]) == SUCCESS);
+	modelo_gpdma_error(2);
+	modelo_gpdma_error(5);
+	VERIFICAR(modelo_gpdma_avanzar() == 0xFF);
+	LPC_TIM3->TC = 1250;
+	modelo_gpdma_stats_t s0 = *modelo_gpdma_stats();
+	num_llamadas = 0;
+	VERIFICAR(atender() == 1);
+	VERIFICAR(modelo_gpdma_stats()->lecturas - s0.lecturas == 2);
+	VERIFICAR(modelo_gpdma_stats()->escrituras - s0.escrituras == 2);
+	VERIFICAR(num_llamadas == DMA_NUM_CANALES);
+	for (uint8_t c = 0; c < DMA_NUM_CANALES; c++) {
+		VERIFICAR(llamadas[c].canal == c);
+		VERIFICAR(llamadas[c].error == (c == 2 || c == 5));
+		if (!llamadas[c].error) VERIFICAR(memcmp(origen[c], destino[c], TAM) == 0);
+		const dma_stats_t *st = dma_canal_get_stats(c);
+		VERIFICAR(st->transferencias == 1 && st->ocupado_us == 250);
+		VERIFICAR(st->completas == !llamadas[c].error && st->errores == llamadas[c].error);
+	}
+	VERIFICAR(LPC_GPDMA->DMACRawIntTCStat == 0 && LPC_GPDMA->DMACRawIntErrStat == 0);
+	printf("despacho: 8 canales en una interrupcion, en orden de prioridad, errores a su funcion\n");
+
+	// El fin del canal 1 rearma el canal 3, que termina antes de salir: el
+	// borrado no lo toca y la interrupcion vuelve a entrar por el
+	VERIFICAR(dma_canal_arrancar(&imagen[1]) == SUCCESS);
+	VERIFICAR(modelo_gpdma_avanzar() == (1UL << 1));
+	rearmar_en_fin = 3;
+	num_llamadas = 0;
+	VERIFICAR(atender() == 2);
+	VERIFICAR(num_llamadas == 2 && llamadas[0].canal == 1 && llamadas[1].canal == 3);
+	VERIFICAR(dma_canal_get_stats(3)->completas == 2);
+	printf("un fin durante el despacho no se pierde: entra en la interrupcion siguiente\n");
+
+	// Accesos al GPDMA por interrupcion: 1 y 8 canales pendientes
+	uint64_t por_irq[2][2];
+	for (int modo = 0; modo < 2; modo++) {
+		for (int todos = 0; todos < 2; todos++) {
+			uint8_t n = todos ? DMA_NUM_CANALES : 1;
+			for (uint8_t c = 0; c < n; c++) VERIFICAR(dma_canal_arrancar(&imagen[c]) == SUCCESS);
+			modelo_gpdma_avanzar();
+			uint64_t a = accesos();
+			if (modo == 0) DMA_IRQHandler();
+			else despacho_por_canal();
+			por_irq[modo][todos] = accesos() - a;
+			VERIFICAR(!modelo_gpdma_irq());
+		}
+	}
+	VERIFICAR(por_irq[0][0] == 4 && por_irq[0][1] == 4);
+	VERIFICAR(por_irq[1][0] > por_irq[0][0] && por_irq[1][1] > por_irq[0][1]);
+	printf("accesos al GPDMA por interrupcion (1 / 8 canales): dma_canal %llu / %llu, canal por canal %llu / %llu\n",
+			(unsigned long long)por_irq[0][0], (unsigned long long)por_irq[0][1],
+			(unsigned long long)por_irq[1][0], (unsigned long long)por_irq[1][1]);
+
+	printf("dma_canal: OK\n");
+	return 0;
+}
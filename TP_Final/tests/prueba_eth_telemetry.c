@@ -0,0 +1,396 @@
+// --- Prueba de eth_telemetry.c con el EMAC emulado ---
+// El modelo del EMAC atiende los registros (MII con un PHY LAN8720, indices
+// de los anillos) y mueve las tramas entre los descriptores del firmware y
+// el "cable":
+//   - un TAP en un espacio de red propio (unshare), con el Linux de la PC
+//     como colector en 192.168.1.10: resuelve ARP, recibe los datagramas en
+//     un socket UDP y hace ping al equipo
+//   - si no hay TAP (sin permisos, o con PRUEBA_SIN_TAP en el entorno), un
+//     colector dentro del proceso que hace lo mismo con tramas armadas a mano
+// Verifica secuencia, contenido y checksums de los datagramas, ARP, ping,
+// tramas mal formadas, y el descarte con el anillo de TX lleno. Reporta los
+// accesos a registros por registro enviado y la capacidad del enlace.
+
+#include "anfitrion.h"
+#include "eth_telemetry.h"
+#include "lpc17xx_emac.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#define REGISTROS			2000
+#define IP_EQUIPO			"192.168.1.50"
+#define IP_COLECTOR			"192.168.1.10"
+
+static const uint8_t mac_colector[6] = {0x02, 0xC0, 0x1E, 0xC7, 0x00, 0x01};
+static const uint8_t ip_colector[4] = ETH_IP_COLECTOR;
+static const uint8_t ip_equipo[4] = ETH_IP;
+
+// --- EMAC ---
+
+#define REG(campo)		offsetof(LPC_EMAC_TypeDef, campo)
+
+static struct {
+	uint32_t r[0x1000 / 4];
+	uint16_t phy[32];
+	uint32_t mrdd;
+	uint32_t rx_prod, tx_cons;
+	uint32_t tramas_tx, tramas_rx, desbordes_rx, filtradas;
+	uint64_t accesos;
+} emac;
+
+static uint32_t emac_leer(uint32_t dir) {
+	uint32_t off = dir - LPC_EMAC_BASE;
+	emac.accesos++;
+	if (off == REG(MIND)) return 0;
+	if (off == REG(MRDD)) return emac.mrdd;
+	if (off == REG(RxProduceIndex)) return emac.rx_prod;
+	if (off == REG(TxConsumeIndex)) return emac.tx_cons;
+	return emac.r[off / 4];
+}
+
+static void emac_escribir(uint32_t dir, uint32_t v) {
+	uint32_t off = dir - LPC_EMAC_BASE;
+	emac.accesos++;
+	emac.r[off / 4] = v;
+	if (off == REG(MCMD) && (v & EMAC_MCMD_READ)) {
+		emac.mrdd = emac.phy[emac.r[REG(MADR) / 4] & 0x1F];
+	} else if (off == REG(MWTD)) {
+		uint32_t reg = emac.r[REG(MADR) / 4] & 0x1F;
+		if (reg == EMAC_PHY_REG_BMCR) v &= ~(EMAC_PHY_BMCR_RESET | EMAC_PHY_BMCR_RE_AN);
+		emac.phy[reg] = (uint16_t)v;
+	} else if (off == REG(Command) && (v & (EMAC_CR_REG_RES | EMAC_CR_TX_RES | EMAC_CR_RX_RES))) {
+		emac.rx_prod = emac.tx_cons = 0;
+	} else if (off == REG(RxDescriptor) || off == REG(TxDescriptor)) {
+		emac.rx_prod = emac.tx_cons = 0;
+	}
+}
+
+static void emac_init(void) {
+	memset(&emac, 0, sizeof(emac));
+	emac.phy[EMAC_PHY_REG_IDR1] = 0x0007;		// LAN8720
+	emac.phy[EMAC_PHY_REG_IDR2] = 0xC0F1;
+	emac.phy[EMAC_PHY_REG_BMSR] = 0x7809 | EMAC_PHY_BMSR_LINK_ESTABLISHED | EMAC_PHY_BMSR_AUTO_DONE;
+	emac.phy[EMAC_PHY_REG_ANAR] = 0x01E1;
+	emac.phy[EMAC_PHY_REG_ANLPAR] = 0x45E1;		// 100 Mbit full duplex
+}
+
+static uint8_t *dir_ram(uint32_t dir) {
+	return (uint8_t *)(uintptr_t)dir;
+}
+
+// Entrega al firmware una trama del cable, si hay descriptor libre y pasa el filtro
+static void emac_recibir(const uint8_t *f, uint32_t len) {
+	uint32_t n = emac.r[REG(RxDescriptorNumber) / 4] + 1;
+	uint32_t filtro = emac.r[REG(RxFilterCtrl) / 4];
+	uint8_t mac[6] = {
+		emac.r[REG(SA2) / 4], emac.r[REG(SA2) / 4] >> 8, emac.r[REG(SA1) / 4],
+		emac.r[REG(SA1) / 4] >> 8, emac.r[REG(SA0) / 4], emac.r[REG(SA0) / 4] >> 8
+	};
+	static const uint8_t bcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+	if (!(emac.r[REG(Command) / 4] & EMAC_CR_RX_EN)) return;
+	if (!((filtro & EMAC_RFC_PERFECT_EN) && memcmp(f, mac, 6) == 0) &&
+			!((filtro & EMAC_RFC_BCAST_EN) && memcmp(f, bcast, 6) == 0)) {
+		emac.filtradas++;
+		return;
+	}
+	if ((emac.rx_prod + 1) % n == emac.r[REG(RxConsumeIndex) / 4]) {
+		emac.desbordes_rx++;
+		return;
+	}
+	RX_Desc *d = (RX_Desc *)dir_ram(emac.r[REG(RxDescriptor) / 4]) + emac.rx_prod;
+	RX_Stat *s = (RX_Stat *)dir_ram(emac.r[REG(RxStatus) / 4]) + emac.rx_prod;
+	VERIFICAR(len + 4 <= (d->Ctrl & EMAC_RCTRL_SIZE(0x7FF)) + 1);
+	memcpy(dir_ram(d->Packet), f, len);
+	memset(dir_ram(d->Packet) + len, 0, 4);		// CRC
+	s->Info = (len + 4 - 1) | EMAC_RINFO_LAST_FLAG;
+	emac.rx_prod = (emac.rx_prod + 1) % n;
+	emac.tramas_rx++;
+}
+
+// --- Cable ---
+
+static int tap = -1, udp = -1, icmp = -1;
+
+typedef struct {
+	uint32_t datagramas;
+	uint32_t seq_siguiente;
+	uint32_t t_siguiente;
+	uint32_t pings;
+	uint32_t broadcast;		// Datagramas enviados antes de resolver el colector
+} colector_t;
+
+static colector_t col;
+
+static uint16_t suma16(const uint8_t *p, uint32_t len) {
+	uint32_t s = 0;
+	for (uint32_t i = 0; i + 1 < len; i += 2) s += (uint32_t)p[i] << 8 | p[i + 1];
+	if (len & 1) s += (uint32_t)p[len - 1] << 8;
+	while (s >> 16) s = (s & 0xFFFF) + (s >> 16);
+	return (uint16_t)s;
+}
+
+static void revisar_datagrama(const uint8_t *d, uint32_t len) {
+	const eth_tlm_hdr_t *h = (const eth_tlm_hdr_t *)d;
+	VERIFICAR(len == sizeof(*h) + h->n * sizeof(flog_reg_t));
+	VERIFICAR(h->magic[0] == 'C' && h->magic[1] == 'O' && h->version == 1 && h->nodo == ETH_NODO);
+	VERIFICAR(h->arranque == 7);
+	VERIFICAR(h->seq == col.seq_siguiente);
+	col.seq_siguiente++;
+	for (uint32_t i = 0; i < h->n; i++) {
+		flog_reg_t r;
+		memcpy(&r, d + sizeof(*h) + i * sizeof(r), sizeof(r));
+		VERIFICAR(r.t == col.t_siguiente && r.valor == (uint16_t)(r.t * 3) && r.tipo == FLOG_MUESTRA);
+		col.t_siguiente++;
+	}
+	col.datagramas++;
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = (uint8_t)v;
+}
+
+// Colector dentro del proceso: contesta ARP y recibe UDP, con los checksums
+// verificados a mano (el Linux del TAP los verifica solo)
+static void colector_trama(const uint8_t *f, uint32_t len) {
+	uint16_t tipo = (uint16_t)(f[12] << 8 | f[13]);
+	const uint8_t *p = f + 14;
+
+	if (tipo == 0x0806) {
+		VERIFICAR(len >= 42);
+		if (p[7] != 1 || memcmp(p + 24, ip_colector, 4) != 0) return;
+		uint8_t r[42];
+		memcpy(r, f + 6, 6);
+		memcpy(r + 6, mac_colector, 6);
+		put16(r + 12, 0x0806);
+		memcpy(r + 14, p, 6);
+		put16(r + 20, 2);
+		memcpy(r + 22, mac_colector, 6);
+		memcpy(r + 28, ip_colector, 4);
+		memcpy(r + 32, p + 8, 10);
+		emac_recibir(r, sizeof(r));
+		return;
+	}
+	VERIFICAR(tipo == 0x0800);
+	uint32_t ihl = (p[0] & 0x0F) * 4;
+	VERIFICAR(suma16(p, ihl) == 0xFFFF);
+	if (p[9] == 17) {
+		if (memcmp(f, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0) col.broadcast++;
+		else VERIFICAR(memcmp(f, mac_colector, 6) == 0);
+		VERIFICAR(((p[ihl + 2] << 8) | p[ihl + 3]) == ETH_PUERTO_COLECTOR);
+		revisar_datagrama(p + ihl + 8, ((p[ihl + 4] << 8) | p[ihl + 5]) - 8);
+	} else if (p[9] == 1 && p[ihl] == 0) {
+		uint32_t largo = (p[2] << 8) | p[3];
+		VERIFICAR(suma16(p + ihl, largo - ihl) == 0xFFFF);
+		VERIFICAR(memcmp(p + 16, ip_colector, 4) == 0 && memcmp(p + 12, ip_equipo, 4) == 0);
+		col.pings++;
+	}
+}
+
+static uint32_t armar_ping(uint8_t *f, uint16_t n) {
+	uint8_t *p = f + 14;
+	memcpy(f, "\x02\x00\x4C\x50\x43\x01", 6);
+	memcpy(f + 6, mac_colector, 6);
+	put16(f + 12, 0x0800);
+	memset(p, 0, 28 + 16);
+	p[0] = 0x45;
+	put16(p + 2, 28 + 16);
+	p[8] = 64;
+	p[9] = 1;
+	memcpy(p + 12, ip_colector, 4);
+	memcpy(p + 16, ip_equipo, 4);
+	put16(p + 10, ~suma16(p, 20));
+	p[20] = 8;
+	put16(p + 24, 0x1234);
+	put16(p + 26, n);
+	for (uint32_t i = 0; i < 16; i++) p[28 + i] = (uint8_t)i;
+	put16(p + 22, ~suma16(p + 20, 24));
+	return 14 + 28 + 16;
+}
+
+static int configurar_if(int s, const char *nombre, const char *ip, const char *mascara) {
+	struct ifreq ifr = {0};
+	struct sockaddr_in *sin = (struct sockaddr_in *)&ifr.ifr_addr;
+
+	strncpy(ifr.ifr_name, nombre, IFNAMSIZ - 1);
+	sin->sin_family = AF_INET;
+	inet_pton(AF_INET, ip, &sin->sin_addr);
+	if (ioctl(s, SIOCSIFADDR, &ifr) < 0) return -1;
+	inet_pton(AF_INET, mascara, &sin->sin_addr);
+	if (ioctl(s, SIOCSIFNETMASK, &ifr) < 0) return -1;
+	if (ioctl(s, SIOCGIFFLAGS, &ifr) < 0) return -1;
+	ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+	return ioctl(s, SIOCSIFFLAGS, &ifr);
+}
+
+// TAP en un espacio de red propio, para no tocar la red de la PC
+static int abrir_tap(void) {
+	if (unshare(CLONE_NEWNET) < 0) return -1;
+	tap = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (tap < 0) return -1;
+	struct ifreq ifr = {0};
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strcpy(ifr.ifr_name, "colector0");
+	if (ioctl(tap, TUNSETIFF, &ifr) < 0) goto fallo;
+
+	int s = socket(AF_INET, SOCK_DGRAM, 0);
+	int r = configurar_if(s, "colector0", IP_COLECTOR, "255.255.255.0");
+	close(s);
+	if (r < 0) goto fallo;
+
+	struct sockaddr_in a = {.sin_family = AF_INET, .sin_port = htons(ETH_PUERTO_COLECTOR)};
+	inet_pton(AF_INET, IP_COLECTOR, &a.sin_addr);
+	udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if (bind(udp, (struct sockaddr *)&a, sizeof(a)) < 0) goto fallo;
+	icmp = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK, IPPROTO_ICMP);
+	if (icmp < 0) goto fallo;
+	return 0;
+fallo:
+	close(tap);
+	tap = -1;
+	return -1;
+}
+
+// Transmite lo que el firmware dejo en el anillo de TX
+static void emac_avanzar(void) {
+	uint32_t n = emac.r[REG(TxDescriptorNumber) / 4] + 1;
+
+	while ((emac.r[REG(Command) / 4] & EMAC_CR_TX_EN) && emac.tx_cons != emac.r[REG(TxProduceIndex) / 4]) {
+		TX_Desc *d = (TX_Desc *)dir_ram(emac.r[REG(TxDescriptor) / 4]) + emac.tx_cons;
+		TX_Stat *s = (TX_Stat *)dir_ram(emac.r[REG(TxStatus) / 4]) + emac.tx_cons;
+		uint32_t len = (d->Ctrl & 0x7FF) + 1;
+		VERIFICAR(d->Ctrl & EMAC_TCTRL_LAST);
+		if (tap >= 0) VERIFICAR(write(tap, dir_ram(d->Packet), len) == (ssize_t)len);
+		else colector_trama(dir_ram(d->Packet), len);
+		s->Info = 0;
+		emac.tx_cons = (emac.tx_cons + 1) % n;
+		emac.tramas_tx++;
+	}
+}
+
+static void cable(void) {
+	uint8_t b[1600];
+	ssize_t n;
+
+	emac_avanzar();
+	if (tap < 0) return;
+	while ((n = read(tap, b, sizeof(b))) > 0) emac_recibir(b, (uint32_t)n);
+	while ((n = recv(udp, b, sizeof(b), 0)) > 0) revisar_datagrama(b, (uint32_t)n);
+	struct sockaddr_in de;
+	socklen_t l = sizeof(de);
+	while ((n = recvfrom(icmp, b, sizeof(b), 0, (struct sockaddr *)&de, &l)) > 0) {
+		uint32_t ihl = (b[0] & 0x0F) * 4;
+		if (b[ihl] == 0 && memcmp(&de.sin_addr, ip_equipo, 4) == 0) col.pings++;
+	}
+}
+
+static void lazo(uint32_t veces) {
+	for (uint32_t i = 0; i < veces; i++) {
+		eth_telemetry_service();
+		cable();
+		if (tap >= 0 && i % 16 == 15) usleep(100);
+	}
+}
+
+static void ping(uint16_t n) {
+	if (tap >= 0) {
+		uint8_t f[64];
+		uint32_t len = armar_ping(f, n);
+		struct sockaddr_in a = {.sin_family = AF_INET};
+		inet_pton(AF_INET, IP_EQUIPO, &a.sin_addr);
+		VERIFICAR(sendto(icmp, f + 14 + 20, len - 14 - 20, 0, (struct sockaddr *)&a, sizeof(a)) > 0);
+	} else {
+		uint8_t f[64];
+		emac_recibir(f, armar_ping(f, n));
+	}
+}
+
+// Tramas que no deben contestarse: encabezado IP mas largo que la trama,
+// IHL invalido, ARP por otra IP
+static void tramas_invalidas(void) {
+	uint8_t f[64];
+	uint32_t tx = emac.tramas_tx, pings = eth_telemetry_get_stats()->ping_respuestas;
+
+	armar_ping(f, 99);
+	f[14] = 0x4F;				// IHL 60 > 28 bytes de IP en la trama
+	emac_recibir(f, 14 + 28);
+	armar_ping(f, 99);
+	f[14] = 0x43;				// IHL 12 < 20
+	emac_recibir(f, sizeof(f));
+	armar_ping(f, 99);
+	put16(f + 14 + 2, 200);		// Largo IP mayor que la trama
+	emac_recibir(f, 14 + 28 + 16);
+	lazo(8);
+
+	VERIFICAR(emac.tramas_tx == tx);
+	VERIFICAR(eth_telemetry_get_stats()->ping_respuestas == pings);
+}
+
+int main(void) {
+	anfitrion_init();
+	emac_init();
+	anfitrion_periferico(LPC_EMAC_BASE, 0x1000, emac_leer, emac_escribir);
+	uint8_t con_tap = !getenv("PRUEBA_SIN_TAP") && abrir_tap() == 0;
+	printf("cable: %s\n", con_tap ? "TAP colector0 (" IP_COLECTOR ") en un espacio de red propio"
+			: "colector dentro del proceso (sin TAP)");
+
+	VERIFICAR(eth_telemetry_init(7));
+	VERIFICAR(emac.r[REG(RxDescriptor) / 4] != 0);
+	lazo(4);
+	VERIFICAR(eth_telemetry_get_stats()->enlace_ok);
+
+	// Un registro por "segundo": cada uno sale en su datagrama en el mismo
+	// append, sin pasar por el lazo
+	uint64_t accesos = 0;
+	for (uint32_t t = 0; t < REGISTROS; t++) {
+		uint32_t antes = emac.r[REG(TxProduceIndex) / 4];
+		uint64_t a0 = emac.accesos;
+		eth_telemetry_append(FLOG_MUESTRA, (uint16_t)(t * 3), 0, t);
+		accesos += emac.accesos - a0;
+		VERIFICAR(emac.r[REG(TxProduceIndex) / 4] != antes);
+		lazo(2);
+	}
+	lazo(200);
+	VERIFICAR(eth_telemetry_get_stats()->colector_resuelto);
+	VERIFICAR(col.datagramas == REGISTROS);
+	VERIFICAR(eth_telemetry_get_stats()->registros_perdidos == 0);
+	printf("telemetria: %u datagramas en orden y sin perdidas\n", col.datagramas);
+	if (!con_tap) printf("  %u por broadcast hasta resolver el colector por ARP\n", col.broadcast);
+
+	for (uint16_t i = 0; i < 5; i++) {
+		ping(i);
+		lazo(50);
+	}
+	VERIFICAR(col.pings == 5);
+	printf("ping: 5 de 5 respuestas\n");
+
+	tramas_invalidas();
+	printf("tramas invalidas: ignoradas\n");
+
+	// Sin que el EMAC transmita, el anillo se llena: se cuenta la perdida
+	uint32_t perdidos = eth_telemetry_get_stats()->registros_perdidos;
+	uint32_t enviados = eth_telemetry_get_stats()->datagramas_enviados;
+	for (uint32_t t = REGISTROS; t < REGISTROS + 10; t++) eth_telemetry_append(FLOG_MUESTRA, (uint16_t)(t * 3), 0, t);
+	VERIFICAR(eth_telemetry_get_stats()->datagramas_enviados - enviados == ETH_NUM_TX - 1);
+	VERIFICAR(eth_telemetry_get_stats()->registros_perdidos - perdidos == 10 - (ETH_NUM_TX - 1));
+	printf("anillo de TX lleno: %u registros descartados y contados\n", 10 - (ETH_NUM_TX - 1));
+
+	// Trama minima de Ethernet (64 bytes con CRC) mas preambulo y separacion
+	uint32_t trama = 14 + 20 + 8 + sizeof(eth_tlm_hdr_t) + ETH_REGS_DATAGRAMA * sizeof(flog_reg_t) + 4;
+	if (trama < 64) trama = 64;
+	printf("costo: %.1f accesos a registros del EMAC por registro; %u bytes en el cable por datagrama,"
+			" %.0f registros/s a 100 Mbit/s\n", (double)accesos / REGISTROS, trama + 20,
+			100e6 / 8 / (trama + 20) * ETH_REGS_DATAGRAMA);
+	printf("eth_telemetry: OK\n");
+	return 0;
+}
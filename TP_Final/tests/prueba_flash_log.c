@@ -0,0 +1,374 @@
+// --- Prueba de flash_log.c sobre una flash NOR emulada ---
+// Cada prueba corre el registro en un proceso hijo que comparte la flash con
+// el padre. La falla se inyecta en la operacion numero 'corte' del IAP
+// (programar o borrar):
+//   - CORTE_PREFIJO: se pierde la energia a mitad de una programacion, que
+//     llega hasta un byte al azar
+//   - CORTE_BITS: idem, pero quedan bajados bits al azar de toda la pagina
+//     (el encabezado puede quedar en blanco con los datos a medias)
+//   - FALLA_IAP: el IAP devuelve error sin programar, y el registro sigue
+//   - FALLA_VERIFICACION: el IAP dice que programo pero la pagina no coincide
+// Un corte durante un borrado deja bytes borrados al azar en el sector.
+// Luego un segundo hijo arranca sobre esa flash, verifica lo que quedo y
+// sigue registrando, y un tercero verifica todo otra vez.
+//
+// Ademas, la region de flash del enlazador (Debug y Release) termina antes de
+// FLOG_BASE: el programa nunca ocupa los sectores del registro.
+//
+// Reporta la amplificacion de escritura y el costo de recuperacion (encabezados
+// leidos y tiempo de flog_init en la PC).
+
+#include "anfitrion.h"
+#include "flash_log.h"
+#include <libgen.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define SALIDA_CORTE		42
+#define MUESTRAS_A			20000	// Llena el anillo mas de una vez
+#define MUESTRAS_B			4000
+#define ALARMA_CADA			97		// Evento de alarma y flush
+#define PERIODO_ALARMA		3000	// La alarma dura las ultimas 600 muestras de cada periodo
+#define MUESTRAS_POR_PAGINA	20		// Cota baja con los flush de las alarmas
+// Historia garantizada: dos sectores completos detras del actual
+#define RETENCION			((FLOG_NUM_SECTORES - 2) * FLOG_PAGINAS_SECTOR * MUESTRAS_POR_PAGINA)
+
+enum { SIN_FALLA, CORTE_PREFIJO, CORTE_BITS, FALLA_IAP, FALLA_VERIFICACION, PAGINA_MUERTA, NUM_MODOS };
+
+static const char *nombre_modo[NUM_MODOS] = {
+	"sin falla", "corte (prefijo)", "corte (bits)", "error del IAP", "verificacion", "pagina muerta"
+};
+
+// Compartido entre el padre y los hijos
+typedef struct {
+	uint32_t ops;					// Programaciones y borrados del hijo actual
+	uint32_t corte;					// Operacion en la que se inyecta la falla (0 = ninguna)
+	uint32_t modo;
+	uint32_t pagina_muerta;			// Direccion que no acepta programacion (PAGINA_MUERTA)
+	uint32_t comprometido;			// Ultima muestra que quedo entera en la flash
+	uint32_t ultimo_t;				// Ultima muestra entregada a flog_append
+	uint32_t hueco_desde, hueco_hasta;	// Muestras que estaban en RAM al cortarse la energia
+	uint32_t borrados[FLOG_NUM_SECTORES];
+	uint32_t borrados_en_alarma;
+	uint32_t max_lecturas_arranque;
+	uint32_t max_paginas_corruptas;
+	flog_stats_t stats;
+} compartido_t;
+
+static compartido_t *com;
+static uint8_t en_alarma;
+static uint32_t azar = 1;
+
+uint8_t flog_borrado_permitido(void) {
+	return !en_alarma;
+}
+
+static uint32_t aleatorio(void) {
+	azar ^= azar << 13;
+	azar ^= azar >> 17;
+	azar ^= azar << 5;
+	return azar;
+}
+
+static uint16_t valor_de(uint32_t t) {
+	return (uint16_t)(t * 2654435761u >> 16);
+}
+
+static void anotar_comprometido(const flog_pagina_t *pg) {
+	if (pg->enc.magic != 0x474F4C43UL) return;	// Marca de pagina fallida
+	for (uint32_t i = 0; i < pg->enc.n; i++) {
+		if (pg->reg[i].tipo == FLOG_MUESTRA && pg->reg[i].t > com->comprometido) com->comprometido = pg->reg[i].t;
+	}
+}
+
+static void iap_con_fallas(uint32_t *cmd, uint32_t *res) {
+	if (cmd[0] == 51 && cmd[1] == com->pagina_muerta) {
+		res[0] = 0;		// Dice que programo pero la celda no cambia
+		return;
+	}
+	if (cmd[0] != 51 && cmd[0] != 52) {
+		anfitrion_iap_nor(cmd, res);
+		return;
+	}
+
+	if (++com->ops == com->corte) {
+		uint8_t *d = (uint8_t *)(uintptr_t)cmd[1];
+		const uint8_t *o = (const uint8_t *)(uintptr_t)cmd[2];
+
+		if (cmd[0] == 52) {
+			// Borrado interrumpido: bytes sueltos quedan borrados
+			uint8_t *s = (uint8_t *)(uintptr_t)anfitrion_sector_dir(cmd[1]);
+			for (uint32_t i = 0; i < anfitrion_sector_tam(cmd[1]); i++) {
+				if (aleatorio() & 1) s[i] = 0xFF;
+			}
+			_exit(SALIDA_CORTE);
+		}
+		switch (com->modo) {
+		case CORTE_PREFIJO: {
+			uint32_t n = aleatorio() % cmd[3];
+			for (uint32_t i = 0; i < n; i++) d[i] &= o[i];
+			d[n] &= o[n] | (uint8_t)aleatorio();
+			_exit(SALIDA_CORTE);
+		}
+		case CORTE_BITS:
+			for (uint32_t i = 0; i < cmd[3]; i++) d[i] &= o[i] | (uint8_t)aleatorio();
+			_exit(SALIDA_CORTE);
+		case FALLA_IAP:
+			res[0] = 11;	// BUSY
+			return;
+		case FALLA_VERIFICACION:
+			anfitrion_iap_nor(cmd, res);
+			d[aleatorio() % cmd[3]] ^= 0xFF;
+			d[0] &= 0x7F;	// Por si el byte alterado se "arreglo" volviendo a 0xFF
+			return;
+		case PAGINA_MUERTA:
+			com->pagina_muerta = cmd[1];
+			res[0] = 0;
+			return;
+		}
+	}
+
+	anfitrion_iap_nor(cmd, res);
+	if (res[0] != 0) return;
+	if (cmd[0] == 51) {
+		anotar_comprometido((const flog_pagina_t *)(uintptr_t)cmd[1]);
+	} else {
+		com->borrados[cmd[1] - FLOG_PRIMER_SECTOR]++;
+		if (en_alarma) com->borrados_en_alarma++;
+	}
+}
+
+static void servir_hasta_vaciar(void) {
+	flog_flush();
+	for (int i = 0; i < 4; i++) flog_service();
+}
+
+// Registra 'n' muestras desde t0, como lo haria main.c: las interrupciones
+// agregan y el lazo principal llama a flog_service()
+static void registrar(uint32_t t0, uint32_t n) {
+	for (uint32_t t = t0; t < t0 + n; t++) {
+		en_alarma = (t % PERIODO_ALARMA) >= PERIODO_ALARMA - 600;
+		flog_append(FLOG_MUESTRA, valor_de(t), 0, t);
+		com->ultimo_t = t;
+		if (t % ALARMA_CADA == 0) {
+			flog_append(FLOG_EVENTO_ALARMA, valor_de(t), en_alarma, t);
+			flog_flush();
+		}
+		flog_service();
+	}
+	servir_hasta_vaciar();
+	com->stats = *flog_get_stats();
+}
+
+typedef struct {
+	uint32_t n;
+	uint32_t ultimo;
+	uint32_t t[FLOG_NUM_SECTORES * FLOG_PAGINAS_SECTOR * FLOG_REGS_PAGINA];
+} muestras_t;
+
+static muestras_t muestras;
+
+static void juntar(const flog_reg_t *reg, uint32_t seq, void *ctx) {
+	muestras_t *m = ctx;
+	if (reg->tipo != FLOG_MUESTRA) return;
+	VERIFICAR(reg->valor == valor_de(reg->t));
+	VERIFICAR(m->n == 0 || reg->t > m->ultimo);		// En orden y sin duplicados
+	m->t[m->n++] = reg->t;
+	m->ultimo = reg->t;
+}
+
+static uint32_t contiene(uint32_t t) {
+	uint32_t lo = 0, hi = muestras.n;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		if (muestras.t[mid] < t) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < muestras.n && muestras.t[lo] == t;
+}
+
+// Arranca sobre la flash que dejo el hijo anterior y controla que este todo
+// lo que llego a quedar entero, con la historia reciente sin huecos
+static void verificar(void) {
+	flog_init();
+	const flog_stats_t *st = flog_get_stats();
+	if (st->lecturas_arranque > com->max_lecturas_arranque) com->max_lecturas_arranque = st->lecturas_arranque;
+	if (st->paginas_corruptas > com->max_paginas_corruptas) com->max_paginas_corruptas = st->paginas_corruptas;
+
+	muestras.n = 0;
+	flog_iterate(juntar, &muestras);
+	if (com->comprometido == 0) return;
+	VERIFICAR(muestras.n > 0);
+	VERIFICAR(muestras.ultimo >= com->comprometido);
+	VERIFICAR(muestras.ultimo <= com->ultimo_t);
+	uint32_t desde = com->comprometido > RETENCION ? com->comprometido - RETENCION : 1;
+	for (uint32_t t = desde; t <= com->comprometido; t++) {
+		if (t < com->hueco_desde || t > com->hueco_hasta) VERIFICAR(contiene(t));
+	}
+}
+
+static int correr(void (*fn)(void)) {
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		fn();
+		fflush(stdout);
+		_exit(0);
+	}
+	int estado;
+	waitpid(pid, &estado, 0);
+	return WIFEXITED(estado) ? WEXITSTATUS(estado) : 128 + WTERMSIG(estado);
+}
+
+static void hijo_a(void) {
+	flog_init();
+	registrar(1, MUESTRAS_A);
+}
+
+static void hijo_b(void) {
+	verificar();
+	com->hueco_desde = com->comprometido + 1;
+	com->hueco_hasta = com->ultimo_t;
+	com->ops = 0;
+	com->corte = 0;
+	registrar(com->ultimo_t + 1, MUESTRAS_B);
+}
+
+static void hijo_c(void) {
+	verificar();
+}
+
+static void hijo_medir_init(void) {
+	struct timespec a, b;
+	const uint32_t veces = 200;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (uint32_t i = 0; i < veces; i++) flog_init();
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	double us = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / 1e3 / veces;
+	printf("  recuperacion: %u encabezados leidos, flog_init %.1f us en la PC\n",
+			flog_get_stats()->lecturas_arranque, us);
+}
+
+static void borrar_flash(void) {
+	memset((void *)FLOG_BASE, 0xFF, FLOG_NUM_SECTORES * FLOG_TAM_SECTOR);
+}
+
+static void reiniciar(uint32_t corte, uint32_t modo) {
+	memset(com, 0, sizeof(*com));
+	com->corte = corte;
+	com->modo = modo;
+	com->pagina_muerta = 0xFFFFFFFFUL;
+}
+
+// Sin fallas: amplificacion de escritura, desgaste y costo de arranque
+static uint32_t referencia(void) {
+	borrar_flash();
+	reiniciar(0, SIN_FALLA);
+	VERIFICAR(correr(hijo_a) == 0);
+	uint32_t ops = com->ops;
+	const flog_stats_t *st = &com->stats;
+
+	printf("referencia: %u muestras, alarma con flush cada %u\n", MUESTRAS_A, ALARMA_CADA);
+	printf("  amplificacion de escritura: %.3f (%u bytes programados / %u registrados)\n",
+			(double)st->bytes_programados / st->bytes_registrados, st->bytes_programados, st->bytes_registrados);
+	printf("  con borrados: %.3f bytes de flash ciclados por byte registrado\n",
+			(double)(st->bytes_programados + st->sectores_borrados * FLOG_TAM_SECTOR) / st->bytes_registrados);
+	printf("  borrados por sector:");
+	for (uint32_t s = 0; s < FLOG_NUM_SECTORES; s++) printf(" %u", com->borrados[s]);
+	printf(", durante la alarma: %u\n", com->borrados_en_alarma);
+	VERIFICAR(st->registros_perdidos == 0);
+	VERIFICAR(com->borrados_en_alarma == 0);
+	VERIFICAR(correr(hijo_c) == 0);
+	VERIFICAR(correr(hijo_medir_init) == 0);
+	return ops;
+}
+
+// Sin flush: solo paginas completas
+static void hijo_sin_flush(void) {
+	flog_init();
+	for (uint32_t t = 1; t <= MUESTRAS_A; t++) {
+		flog_append(FLOG_MUESTRA, valor_de(t), 0, t);
+		flog_service();
+	}
+	const flog_stats_t *st = flog_get_stats();
+	printf("  sin alarmas: amplificacion %.3f\n", (double)st->bytes_programados / st->bytes_registrados);
+}
+
+// Una pagina que no acepta ni la marca detiene el registro sin perder lo anterior
+static void prueba_pagina_muerta(void) {
+	borrar_flash();
+	reiniciar(300, PAGINA_MUERTA);
+	VERIFICAR(correr(hijo_a) == 0);
+	VERIFICAR(com->stats.error_iap != 0);
+	VERIFICAR(com->ops == 300);		// No hubo mas operaciones
+	VERIFICAR(correr(hijo_c) == 0);
+	printf("pagina muerta: registro detenido, muestras hasta t=%u intactas\n", com->comprometido);
+}
+
+// MFlash512 en el mapa de memoria generado por MCUXpresso
+static void prueba_mapa_memoria(const char *dir, const char *config) {
+	char ruta[300], linea[200];
+	uint32_t origen, largo;
+	uint8_t encontrada = 0;
+
+	snprintf(ruta, sizeof(ruta), "%s/../../%s/TP_Final_%s_memory.ld", dir, config, config);
+	FILE *f = fopen(ruta, "r");
+	VERIFICAR(f != NULL);
+	while (fgets(linea, sizeof(linea), f)) {
+		if (sscanf(linea, " MFlash512 (rx) : ORIGIN = %x, LENGTH = %x", &origen, &largo) == 2) encontrada = 1;
+	}
+	fclose(f);
+	VERIFICAR(encontrada && origen + largo <= FLOG_BASE);
+	printf("%s: MFlash512 termina en 0x%05x, el registro empieza en 0x%05lx\n", config, origen + largo, FLOG_BASE);
+}
+
+int main(void) {
+	anfitrion_init();
+	anfitrion_iap = iap_con_fallas;
+	com = mmap(NULL, sizeof(*com), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	VERIFICAR(com != MAP_FAILED);
+
+	uint32_t ops = referencia();
+	VERIFICAR(correr(hijo_sin_flush) == 0);
+
+	// Una falla en cada operacion, rotando los modos
+	uint32_t fallas[NUM_MODOS] = {0};
+	uint32_t max_lecturas = 0, max_corruptas = 0;
+	for (uint32_t corte = 1; corte <= ops; corte++) {
+		uint32_t modo = CORTE_PREFIJO + corte % (FALLA_VERIFICACION - CORTE_PREFIJO + 1);
+		borrar_flash();
+		reiniciar(corte, modo);
+		azar = corte * 7919;
+		int r = correr(hijo_a);
+		if (r != 0 && r != SALIDA_CORTE) {
+			fprintf(stderr, "corte %u (%s): el registro fallo (%d)\n", corte, nombre_modo[modo], r);
+			return 1;
+		}
+		if (correr(hijo_b) != 0 || correr(hijo_c) != 0) {
+			fprintf(stderr, "corte %u (%s): no se recupero\n", corte, nombre_modo[modo]);
+			return 1;
+		}
+		VERIFICAR(com->stats.error_iap == 0);	// El hijo b no debe ver errores
+		fallas[modo]++;
+		if (com->max_lecturas_arranque > max_lecturas) max_lecturas = com->max_lecturas_arranque;
+		if (com->max_paginas_corruptas > max_corruptas) max_corruptas = com->max_paginas_corruptas;
+	}
+	printf("fallas inyectadas en %u operaciones:", ops);
+	for (uint32_t m = CORTE_PREFIJO; m <= FALLA_VERIFICACION; m++) printf(" %s %u,", nombre_modo[m], fallas[m]);
+	printf("\n  peor arranque: %u encabezados leidos, %u paginas corruptas\n", max_lecturas, max_corruptas);
+
+	prueba_pagina_muerta();
+
+	char ejecutable[256];
+	ssize_t n = readlink("/proc/self/exe", ejecutable, sizeof(ejecutable) - 1);
+	VERIFICAR(n > 0);
+	ejecutable[n] = 0;
+	const char *dir = dirname(ejecutable);
+	prueba_mapa_memoria(dir, "Debug");
+	prueba_mapa_memoria(dir, "Release");
+	printf("flash_log: OK\n");
+	return 0;
+}
@@ -0,0 +1,206 @@
+// --- Prueba de formato.c contra snprintf ---
+// Cada valor se escribe con formato.c y con snprintf y se compara byte a
+// byte: fmt_u32 con %u, fmt_i32 con %d, fmt_hex con %x y %0*x, fmt_fijo con
+// %.*f (valor / 10^dec) y FMT() con el printf equivalente. Verifica:
+//   - los bordes: 0, potencias de 10 y sus vecinos, INT32_MIN/MAX,
+//     UINT32_MAX, -0.05 y los ceros de relleno de mas de 8 digitos hex
+//   - VALORES valores al azar de todos los tamanios
+//   - en un buffer circular de 32 bytes, empezando al azar poco antes del
+//     final (tambien cuando pos da la vuelta de 32 bits): lo escrito
+//     cruza el final y no toca nada fuera del mensaje
+//   - sin lugar: marca desborde, no pasa de 'fin' y no escribe mas despues
+// Informa ciclos por valor en la PC frente a snprintf.
+
+#include "anfitrion.h"
+#include "formato.h"
+#include <string.h>
+
+#define VALORES			1000000
+#define MEDICIONES		200000
+#define TAM_ANILLO		32
+
+static uint32_t semilla = 12345;
+
+static uint32_t azar(void) {
+	semilla ^= semilla << 13;
+	semilla ^= semilla >> 17;
+	semilla ^= semilla << 5;
+	return semilla;
+}
+
+// Numero al azar con una cantidad de bits al azar (si no, casi todos
+// tendrian 10 digitos)
+static uint32_t azar_tamanio(void) {
+	return azar() >> (azar() % 32);
+}
+
+typedef enum { U32, I32, HEX, FIJO } tipo_t;
+
+static void escribir(fmt_t *f, tipo_t tipo, uint32_t v, uint8_t arg) {
+	switch (tipo) {
+	case U32: fmt_u32(f, v); break;
+	case I32: fmt_i32(f, (int32_t)v); break;
+	case HEX: fmt_hex(f, v, arg); break;
+	case FIJO: fmt_fijo(f, (int32_t)v, arg); break;
+	}
+}
+
+// Lo que escribe formato.c en un buffer lineal y en el anillo, empezando
+// antes del final, contra lo que escribe snprintf
+static void comparar(tipo_t tipo, uint32_t v, uint8_t arg) {
+	char esperado[40], lineal[40];
+	switch (tipo) {
+	case U32: snprintf(esperado, sizeof(esperado), "%u", v); break;
+	case I32: snprintf(esperado, sizeof(esperado), "%d", (int32_t)v); break;
+	case HEX:
+		if (arg) snprintf(esperado, sizeof(esperado), "%0*x", arg, v);
+		else snprintf(esperado, sizeof(esperado), "%x", v);
+		break;
+	case FIJO: {
+		double d = (int32_t)v;
+		for (uint8_t i = 0; i < arg; i++) d /= 10;
+		snprintf(esperado, sizeof(esperado), "%.*f", arg, d);
+		break;
+	}
+	}
+	uint32_t n = strlen(esperado);
+
+	fmt_t f;
+	fmt_en_buffer(&f, lineal, sizeof(lineal));
+	escribir(&f, tipo, v, arg);
+	if (f.desborde || f.pos != n || memcmp(lineal, esperado, n) != 0) {
+		printf("tipo %d, %u (%u): '%.*s', esperado '%s'\n", tipo, v, arg, (int)f.pos, lineal, esperado);
+		VERIFICAR(0);
+	}
+
+	// En el anillo: del final hacia el principio, con el resto intacto
+	char anillo[TAM_ANILLO];
+	uint32_t inicios[] = { TAM_ANILLO * 5 - azar() % n - 1, 0xFFFFFFFFu - azar() % n };
+	for (uint32_t k = 0; k < 2; k++) {
+		memset(anillo, '#', sizeof(anillo));
+		f.buf = anillo;
+		f.mascara = TAM_ANILLO - 1;
+		f.pos = inicios[k];
+		f.fin = f.pos + TAM_ANILLO;
+		f.desborde = 0;
+		escribir(&f, tipo, v, arg);
+		VERIFICAR(!f.desborde && f.pos - inicios[k] == n);
+		for (uint32_t i = 0; i < n; i++) VERIFICAR(anillo[(inicios[k] + i) & f.mascara] == esperado[i]);
+		for (uint32_t i = n; i < TAM_ANILLO; i++) VERIFICAR(anillo[(inicios[k] + i) & f.mascara] == '#');
+	}
+
+	// Con un lugar menos: desborde, sin pasar de fin; lo que siga tampoco escribe
+	memset(lineal, '#', sizeof(lineal));
+	fmt_en_buffer(&f, lineal, n - 1);
+	escribir(&f, tipo, v, arg);
+	fmt_caracter(&f, 'x');
+	VERIFICAR(f.desborde && f.pos <= n - 1 && lineal[n - 1] == '#' && lineal[n] == '#');
+}
+
+static void comparar_todos(uint32_t v) {
+	comparar(U32, v, 0);
+	comparar(I32, v, 0);
+	for (uint8_t d = 0; d <= 10; d++) comparar(HEX, v, d);
+	for (uint8_t d = 0; d <= 9; d++) comparar(FIJO, v, d);
+}
+
+static void bordes(void) {
+	static const uint32_t fijos[] = { 0, 1, 5, 9, (uint32_t)-1, (uint32_t)-5, (uint32_t)-9,
+			0x7FFFFFFFu, 0x80000000u, 0x80000001u, 0xFFFFFFFFu, 0xFFFFFFFEu, 0x0FFFFFFFu, 0x10000000u };
+	for (uint32_t i = 0; i < sizeof(fijos) / sizeof(fijos[0]); i++) comparar_todos(fijos[i]);
+	for (uint64_t p = 1; p <= 0xFFFFFFFFu; p *= 10) {
+		comparar_todos((uint32_t)p - 1);
+		comparar_todos((uint32_t)p);
+		comparar_todos((uint32_t)p + 1);
+		comparar_todos((uint32_t)-(int64_t)p);
+	}
+	for (uint32_t b = 0; b < 32; b++) comparar_todos(1u << b);
+
+	// -0.05 y parecidos: el signo con parte entera 0
+	char buf[16];
+	fmt_t f;
+	fmt_en_buffer(&f, buf, sizeof(buf));
+	fmt_fijo(&f, -5, 2);
+	VERIFICAR(f.pos == 5 && memcmp(buf, "-0.05", 5) == 0);
+}
+
+// FMT() con cada tipo de argumento, contra el printf equivalente
+static void comparar_fmt(void) {
+	for (uint32_t i = 0; i < VALORES / 10; i++) {
+		uint16_t ppm = azar();
+		uint32_t t = azar_tamanio();
+		int8_t i8 = azar();
+		int16_t i16 = azar();
+		long l = (int32_t)azar_tamanio();
+		unsigned char u8 = azar();
+		uint32_t h = azar_tamanio();
+		uint8_t digitos = azar() % 9;
+		int32_t x = (int32_t)azar_tamanio();
+		uint8_t dec = azar() % 4;
+		char buf[128], esperado[128];
+		fmt_t f;
+
+		double d = x;
+		for (uint8_t k = 0; k < dec; k++) d /= 10;
+		int n = snprintf(esperado, sizeof(esperado), "U%u@%u %d,%d;%ld:%u=%0*x|%.*f\n",
+				ppm, t, i8, i16, l, u8, digitos, h, dec, d);
+		fmt_en_buffer(&f, buf, sizeof(buf));
+		FMT(&f, "U", ppm, "@", t, (char)' ', i8, ",", i16, ";", l);
+		FMT(&f, ":", u8, "=", FMT_HEX(h, digitos), "|", FMT_FIJO(x, dec), "\n");
+		VERIFICAR(!f.desborde && f.pos == (uint32_t)n && memcmp(buf, esperado, n) == 0);
+	}
+}
+
+// Ciclos por valor de una forma y de la otra sobre los mismos valores
+static uint32_t muestras[MEDICIONES];
+
+static void medir(const char *nombre, tipo_t tipo, uint8_t arg) {
+	char buf[40];
+	fmt_t f;
+	volatile uint32_t largo = 0;
+
+	uint64_t t0 = anfitrion_ciclos();
+	for (uint32_t i = 0; i < MEDICIONES; i++) {
+		fmt_en_buffer(&f, buf, sizeof(buf));
+		escribir(&f, tipo, muestras[i], arg);
+		largo += f.pos;
+	}
+	uint64_t t1 = anfitrion_ciclos();
+	for (uint32_t i = 0; i < MEDICIONES; i++) {
+		switch (tipo) {
+		case U32: largo += snprintf(buf, sizeof(buf), "%u", muestras[i]); break;
+		case I32: largo += snprintf(buf, sizeof(buf), "%d", (int32_t)muestras[i]); break;
+		case HEX: largo += snprintf(buf, sizeof(buf), "%0*x", arg, muestras[i]); break;
+		case FIJO: largo += snprintf(buf, sizeof(buf), "%.*f", arg, (int32_t)muestras[i] / 100.0); break;
+		}
+	}
+	uint64_t t2 = anfitrion_ciclos();
+	printf("  %-10s %6.1f ciclos, snprintf %6.1f (%.1fx)\n", nombre, (double)(t1 - t0) / MEDICIONES,
+			(double)(t2 - t1) / MEDICIONES, (double)(t2 - t1) / (t1 - t0));
+}
+
+int main(void) {
+	bordes();
+	printf("bordes: 0, potencias de 10, INT32_MIN/MAX, -0.05 y relleno hex: iguales a snprintf\n");
+	for (uint32_t i = 0; i < VALORES; i++) {
+		uint32_t v = azar_tamanio();
+		comparar(U32, v, 0);
+		comparar(I32, v, 0);
+		comparar(HEX, v, azar() % 11);
+		comparar(FIJO, v, azar() % 10);
+	}
+	printf("%u valores al azar por tipo, tambien cruzando el final del anillo y sin lugar: iguales a snprintf\n",
+			VALORES);
+	comparar_fmt();
+	printf("FMT() con cada tipo de argumento: igual a snprintf\n");
+
+	printf("ciclos por valor en la PC:\n");
+	for (uint32_t i = 0; i < MEDICIONES; i++) muestras[i] = azar_tamanio();
+	medir("%u", U32, 0);
+	medir("%d", I32, 0);
+	medir("%08x", HEX, 8);
+	medir("%.2f", FIJO, 2);
+
+	printf("formato: OK\n");
+	return 0;
+}
@@ -0,0 +1,152 @@
+// --- Prueba del rearmado del GPDMA por imagen de registros ---
+// Compara, en el driver de CMSIS, el arranque por bloque de antes
+// (GPDMA_Setup + GPDMA_ChannelCmd) con GPDMA_Rearm sobre una imagen armada
+// una sola vez con GPDMA_BuildImage:
+//   - con el GPDMA como memoria comun, ciclos de la PC por arranque (el
+//     costo de validar, buscar en las tablas y tocar DMAREQSEL)
+//   - con el modelo del GPDMA (modelo_gpdma.h), accesos a los registros por
+//     arranque y que ambos caminos dejan el canal exactamente igual, para
+//     varios tipos de transferencia y canales
+// Despues arma un anillo de LLI con GPDMA_BuildRingLLI y verifica en el
+// modelo que el canal recorre los bloques en orden, vuelve al primero y
+// marca el fin de cada bloque sin deshabilitarse.
+
+#include "anfitrion.h"
+#include "modelo_gpdma.h"
+#include "lpc17xx_gpdma.h"
+#include <string.h>
+
+#define VUELTAS			200000
+#define BLOQUES			4
+#define TAM_BLOQUE		16
+
+#define CANAL(n)		((LPC_GPDMACH_TypeDef *)(LPC_GPDMACH0_BASE + (n) * 0x20))
+
+static uint8_t datos[64] __attribute__((aligned(4)));
+static uint8_t origen[BLOQUES * TAM_BLOQUE] __attribute__((aligned(4)));
+static uint8_t destino[BLOQUES * TAM_BLOQUE] __attribute__((aligned(4)));
+static GPDMA_LLI_Type anillo[BLOQUES];
+
+typedef struct {
+	uint32_t src, dst, lli, control, config;
+} registros_t;
+
+static GPDMA_Channel_CFG_Type configuracion(uint32_t canal, uint32_t tipo) {
+	GPDMA_Channel_CFG_Type cfg = {0};
+
+	cfg.ChannelNum = canal;
+	cfg.TransferSize = sizeof(datos);
+	cfg.TransferType = tipo;
+	cfg.TransferWidth = GPDMA_WIDTH_BYTE;
+	cfg.SrcMemAddr = (uint32_t)datos;
+	cfg.DstMemAddr = (uint32_t)destino;
+	cfg.SrcConn = (tipo == GPDMA_TRANSFERTYPE_P2M) ? GPDMA_CONN_SSP0_Rx : 0;
+	cfg.DstConn = (tipo == GPDMA_TRANSFERTYPE_M2P) ? GPDMA_CONN_SSP0_Tx : 0;
+	return cfg;
+}
+
+static registros_t leer_canal(uint32_t n) {
+	LPC_GPDMACH_TypeDef *c = CANAL(n);
+	return (registros_t){c->DMACCSrcAddr, c->DMACCDestAddr, c->DMACCLLI, c->DMACCControl, c->DMACCConfig};
+}
+
+static uint64_t accesos(void) {
+	modelo_gpdma_stats_t *s = modelo_gpdma_stats();
+	return s->lecturas + s->escrituras;
+}
+
+// Arranque por bloque como lo hacia sd_log.c antes de las imagenes
+static void arranque_setup(GPDMA_Channel_CFG_Type *cfg) {
+	VERIFICAR(GPDMA_Setup(cfg) == SUCCESS);
+	GPDMA_ChannelCmd(cfg->ChannelNum, ENABLE);
+}
+
+int main(void) {
+	anfitrion_init();
+
+	// 1. Ciclos de la PC, con los registros como memoria comun
+	GPDMA_Channel_CFG_Type cfg = configuracion(0, GPDMA_TRANSFERTYPE_M2P);
+	GPDMA_Image_Type imagen;
+	VERIFICAR(GPDMA_BuildImage(&cfg, &imagen) == SUCCESS);
+	uint64_t t0 = anfitrion_ciclos();
+	for (uint32_t i = 0; i < VUELTAS; i++) {
+		arranque_setup(&cfg);
+		CANAL(0)->DMACCConfig = 0;
+	}
+	uint64_t t1 = anfitrion_ciclos();
+	for (uint32_t i = 0; i < VUELTAS; i++) {
+		VERIFICAR(GPDMA_Rearm(&imagen) == SUCCESS);
+		CANAL(0)->DMACCConfig = 0;
+	}
+	uint64_t t2 = anfitrion_ciclos();
+	double ciclos_setup = (double)(t1 - t0) / VUELTAS, ciclos_rearm = (double)(t2 - t1) / VUELTAS;
+	VERIFICAR(ciclos_rearm < ciclos_setup);
+
+	// 2. Con el modelo: mismos registros y menos accesos
+	modelo_gpdma_init();
+	GPDMA_Init();
+	static const uint32_t tipos[] = { GPDMA_TRANSFERTYPE_M2P, GPDMA_TRANSFERTYPE_P2M, GPDMA_TRANSFERTYPE_M2M };
+	static const char *nombres[] = { "M2P", "P2M", "M2M" };
+	for (uint32_t t = 0; t < 3; t++) {
+		uint64_t acc_setup = 0, acc_rearm = 0;
+		for (uint32_t n = 0; n < 8; n++) {
+			cfg = configuracion(n, tipos[t]);
+			uint32_t reqsel;
+
+			uint64_t a = accesos();
+			arranque_setup(&cfg);
+			acc_setup += accesos() - a;
+			registros_t antes = leer_canal(n);
+			reqsel = LPC_SC->DMAREQSEL;
+			VERIFICAR(LPC_GPDMA->DMACEnbldChns == (1UL << n));
+			GPDMA_ChannelCmd(n, DISABLE);
+
+			VERIFICAR(GPDMA_BuildImage(&cfg, &imagen) == SUCCESS);
+			a = accesos();
+			VERIFICAR(GPDMA_Rearm(&imagen) == SUCCESS);
+			acc_rearm += accesos() - a;
+			registros_t despues = leer_canal(n);
+			VERIFICAR(memcmp(&antes, &despues, sizeof(antes)) == 0);
+			VERIFICAR(LPC_SC->DMAREQSEL == reqsel);
+			VERIFICAR(GPDMA_Rearm(&imagen) == ERROR);	// Un canal habilitado no se rearma
+			GPDMA_ChannelCmd(n, DISABLE);
+		}
+		VERIFICAR(acc_rearm < acc_setup);
+		printf("%s: canal identico por los dos caminos en los 8 canales; %.0f accesos al GPDMA por arranque"
+				" con GPDMA_Setup, %.0f con GPDMA_Rearm\n", nombres[t], acc_setup / 8.0, acc_rearm / 8.0);
+	}
+	printf("por arranque en la PC (registros en memoria): GPDMA_Setup %.0f ciclos, GPDMA_Rearm %.0f ciclos\n",
+			ciclos_setup, ciclos_rearm);
+
+	// 3. Anillo de LLI: M2M de bloques de TAM_BLOQUE bytes
+	for (uint32_t i = 0; i < sizeof(origen); i++) origen[i] = i;
+	cfg = configuracion(3, GPDMA_TRANSFERTYPE_M2M);
+	cfg.TransferSize = TAM_BLOQUE;
+	cfg.SrcMemAddr = (uint32_t)origen;
+	cfg.DstMemAddr = (uint32_t)destino;
+	VERIFICAR(GPDMA_BuildImage(&cfg, &imagen) == SUCCESS);
+	GPDMA_BuildRingLLI(&imagen, anillo, BLOQUES, TAM_BLOQUE);
+	VERIFICAR(anillo[BLOQUES - 1].NextLLI == (uint32_t)&anillo[0]);
+	VERIFICAR(GPDMA_Rearm(&imagen) == SUCCESS);
+
+	for (uint32_t vuelta = 0; vuelta < 3; vuelta++) {
+		memset(destino, 0, sizeof(destino));
+		for (uint32_t b = 0; b < BLOQUES; b++) {
+			VERIFICAR(modelo_gpdma_avanzar() == (1UL << 3));
+			VERIFICAR(LPC_GPDMA->DMACIntTCStat == (1UL << 3));
+			LPC_GPDMA->DMACIntTCClear = 1UL << 3;
+			// Llego el bloque b, y ninguno de los siguientes
+			VERIFICAR(memcmp(destino, origen, (b + 1) * TAM_BLOQUE) == 0);
+			for (uint32_t i = (b + 1) * TAM_BLOQUE; i < sizeof(destino); i++) VERIFICAR(destino[i] == 0);
+			VERIFICAR(LPC_GPDMA->DMACEnbldChns == (1UL << 3));
+		}
+		for (uint32_t i = 0; i < sizeof(origen); i++) origen[i] += 0x40;
+	}
+	GPDMA_ChannelCmd(3, DISABLE);
+	VERIFICAR(modelo_gpdma_avanzar() == 0);
+	VERIFICAR(modelo_gpdma_stats()->errores == 0);
+	printf("anillo de %u LLI: 3 vueltas en orden, fin de bloque en cada uno, el canal sigue habilitado\n", BLOQUES);
+
+	printf("gpdma: OK\n");
+	return 0;
+}
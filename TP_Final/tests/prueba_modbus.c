@@ -0,0 +1,563 @@
+// --- Prueba de modbus.c con la UART1 y el TIMER3 emulados ---
+// El modelo de la UART1 tiene las FIFO de 16 bytes, la identificacion de
+// interrupciones del IIR y el tiempo de cada caracter segun los divisores y
+// el LCR que programa el firmware; el TIMER3 cuenta microsegundos del tiempo
+// simulado y dispara el silencio de 3,5 caracteres de tiempo.c. El otro lado
+// de la linea es un pseudoterminal: un proceso hijo hace de maestro Modbus
+// sobre el /dev/pts como si fuera un puerto serie. Con PRUEBA_PTY_EXTERNO en
+// el entorno no se lanza el maestro y el esclavo queda atendiendo el pts que
+// se imprime (p. ej. mbpoll -m rtu -b 19200 -P even -a 1 -r 1 -c 10 -t 3 /dev/pts/N).
+// Verifica las funciones 03/04/06/16, excepciones, CRC, difusion, tramas
+// cortadas por un silencio y errores de paridad, que el mapa de registros
+// nunca se lee desde la interrupcion, y mide registros por segundo.
+
+#include "anfitrion.h"
+#include "modbus.h"
+#include "tiempo.h"
+#include "lpc17xx_uart.h"
+#include "lpc17xx_clkpwr.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stddef.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+void UART1_IRQHandler(void);
+void TIMER3_IRQHandler(void);
+
+#define ENTRADAS			125			// Registros de entrada del mapa de la prueba
+#define HOLDINGS			4
+#define LECTURAS_CARGA		40			// Lecturas de 125 registros para medir el caudal
+#define ESPERA_MAESTRO_NS	4000000ULL	// Del fin de una respuesta a la proxima consulta
+#define SIN_RESPUESTA_MS	150
+
+static uint64_t ahora_ns;
+
+// --- Mapa de registros de la prueba (en main.c, el de la aplicacion) ---
+
+static uint16_t holding[HOLDINGS] = {400, 1000, 10, 0};
+static volatile uint8_t en_isr;
+static uint32_t lecturas_en_isr;
+
+static uint16_t valor_entrada(uint16_t dir) { return (uint16_t)(dir * 7 + 1); }
+
+uint8_t modbus_leer_registro(uint8_t tabla, uint16_t dir, uint16_t *valor) {
+	if (en_isr) lecturas_en_isr++;
+	if (tabla == MODBUS_INPUT) {
+		if (dir >= ENTRADAS) return MODBUS_EXC_DIRECCION;
+		*valor = valor_entrada(dir);
+	} else {
+		if (dir >= HOLDINGS) return MODBUS_EXC_DIRECCION;
+		*valor = holding[dir];
+	}
+	return 0;
+}
+
+uint8_t modbus_escribir_registro(uint16_t dir, uint16_t valor) {
+	if (en_isr) lecturas_en_isr++;
+	if (dir >= HOLDINGS) return MODBUS_EXC_DIRECCION;
+	if (valor == 0 && dir != 3) return MODBUS_EXC_VALOR;
+	holding[dir] = valor;
+	return 0;
+}
+
+// --- UART1 ---
+
+#define REG(campo)		offsetof(LPC_UART1_TypeDef, campo)
+
+static struct {
+	uint8_t  r[0x1000];
+	uint8_t  dl[2];			// DLL y DLM, con DLAB en el LCR
+	uint16_t rx[16];		// Byte y, en el bit 8, error de paridad
+	uint32_t rx_n;
+	uint8_t  tx[16];
+	uint32_t tx_n;
+	uint8_t  lsr_error;
+	uint8_t  thre_pend;
+	uint64_t tx_fin_ns;		// Fin del caracter en el registro de desplazamiento (0: libre)
+	uint8_t  tx_byte;
+	// Linea de recepcion: bytes del pts que todavia no terminaron de llegar
+	uint16_t linea[4096];
+	uint32_t linea_ini, linea_fin;
+	uint64_t rx_prox_ns, rx_ultimo_ns;
+	int      pty;
+	uint8_t  respuesta[MODBUS_TAM_TRAMA + 4];
+	uint32_t respuesta_n;
+	uint64_t tx_bytes, desbordes;
+	uint64_t accesos, peor_isr;
+} uart;
+
+static uint32_t divisor(void) {
+	return uart.dl[0] | ((uint32_t)uart.dl[1] << 8);
+}
+
+static uint32_t uart_baud(void) {
+	uint32_t fdr = uart.r[REG(FDR)], mul = (fdr >> 4) & 0xF, add = fdr & 0xF;
+	if (mul == 0) mul = 1, add = 0;
+	return (uint32_t)((uint64_t)CLKPWR_GetPCLK(CLKPWR_PCLKSEL_UART1) * mul / (16ULL * divisor() * (mul + add)));
+}
+
+// Bits por caracter segun el LCR: arranque, datos, paridad y parada
+static uint64_t caracter_ns(void) {
+	uint8_t lcr = uart.r[REG(LCR)];
+	uint32_t bits = 1 + 5 + (lcr & 3) + ((lcr & 8) ? 1 : 0) + ((lcr & 4) ? 2 : 1);
+	return 1000000000ULL * bits / uart_baud();
+}
+
+static uint8_t uart_iir(void) {
+	uint8_t ier = uart.r[REG(IER)];
+	uint8_t error = uart.lsr_error || (uart.rx_n && (uart.rx[0] & 0x100));
+	if ((ier & UART_IER_RLSINT_EN) && error) return UART_IIR_INTID_RLS;
+	if ((ier & UART_IER_RBRINT_EN) && uart.rx_n) return UART_IIR_INTID_RDA;
+	if ((ier & UART_IER_THREINT_EN) && uart.thre_pend) return UART_IIR_INTID_THRE;
+	return UART_IIR_INTSTAT_PEND;
+}
+
+static uint32_t uart_leer(uint32_t dir) {
+	uint32_t off = dir - LPC_UART1_BASE;
+	uint8_t dlab = uart.r[REG(LCR)] & UART_LCR_DLAB_EN;
+	uart.accesos++;
+	if (dlab && (off == REG(DLL) || off == REG(DLM))) return uart.dl[off / 4];
+	if (off == REG(RBR)) {
+		if (!uart.rx_n) return 0;
+		uint8_t c = (uint8_t)uart.rx[0];
+		memmove(uart.rx, uart.rx + 1, --uart.rx_n * sizeof(uart.rx[0]));
+		return c;
+	}
+	if (off == REG(IIR)) {
+		uint8_t iir = uart_iir();
+		if (iir == UART_IIR_INTID_THRE) uart.thre_pend = 0;	// Leer el IIR la limpia
+		return 0xC0 | iir;
+	}
+	if (off == REG(LSR)) {
+		uint8_t lsr = uart.lsr_error;
+		uart.lsr_error = 0;
+		// El error de paridad se informa cuando el byte llega al frente de la FIFO
+		if (uart.rx_n && (uart.rx[0] & 0x100)) {
+			lsr |= UART_LSR_PE;
+			uart.rx[0] &= 0xFF;
+		}
+		if (uart.rx_n) lsr |= UART_LSR_RDR;
+		if (!uart.tx_n) lsr |= UART_LSR_THRE;
+		if (!uart.tx_n && !uart.tx_fin_ns) lsr |= UART_LSR_TEMT;
+		return lsr;
+	}
+	return uart.r[off];
+}
+
+static void uart_escribir(uint32_t dir, uint32_t v) {
+	uint32_t off = dir - LPC_UART1_BASE;
+	uint8_t dlab = uart.r[REG(LCR)] & UART_LCR_DLAB_EN;
+	uart.accesos++;
+	v &= 0xFF;
+	if (dlab && (off == REG(DLL) || off == REG(DLM))) {
+		uart.dl[off / 4] = (uint8_t)v;
+		return;
+	}
+	if (off == REG(THR)) {
+		if (uart.tx_n < 16) uart.tx[uart.tx_n++] = (uint8_t)v;
+		uart.thre_pend = 0;
+		return;
+	}
+	if (off == REG(FCR)) {
+		if (v & UART_FCR_RX_RS) uart.rx_n = 0;
+		if (v & UART_FCR_TX_RS) uart.tx_n = 0;
+		return;
+	}
+	if (off == REG(IER)) {
+		// Habilitar THRE con el THR vacio genera la interrupcion
+		if ((v & UART_IER_THREINT_EN) && !(uart.r[off] & UART_IER_THREINT_EN) && !uart.tx_n) uart.thre_pend = 1;
+	}
+	uart.r[off] = (uint8_t)v;
+}
+
+// Transacciones medidas: primer byte del pedido y ultimo de la respuesta
+static struct {
+	uint64_t pedido_ns;
+	uint8_t  fc;
+	uint16_t cant;
+	uint32_t bytes;
+} actual;
+static uint64_t carga_ns, carga_registros;
+
+// La linea recibe un pedido del pts: si estaba en silencio, el primer byte
+// empieza despues de la espera del maestro
+static void linea_agregar(const uint8_t *p, uint32_t n, int32_t con_error) {
+	if (uart.linea_ini == uart.linea_fin) {
+		uart.linea_ini = uart.linea_fin = 0;
+		actual.bytes = 0;
+		uint64_t inicio = uart.rx_ultimo_ns + ESPERA_MAESTRO_NS;
+		if (inicio < ahora_ns) inicio = ahora_ns;
+		uart.rx_prox_ns = inicio + caracter_ns();
+	}
+	for (uint32_t i = 0; i < n && uart.linea_fin < 4096; i++)
+		uart.linea[uart.linea_fin++] = p[i] | ((int32_t)i == con_error ? 0x100 : 0);
+}
+
+// --- TIMER3 ---
+
+#define TREG(campo)		offsetof(LPC_TIM_TypeDef, campo)
+
+static struct {
+	uint32_t r[0x1000 / 4];
+	uint32_t ir;
+} tim;
+
+static uint32_t tc_us(void) { return (uint32_t)(ahora_ns / 1000); }
+
+static uint32_t tim_leer(uint32_t dir) {
+	uint32_t off = dir - LPC_TIM3_BASE;
+	if (off == TREG(TC)) return (tim.r[TREG(TCR) / 4] & 1) ? tc_us() : 0;
+	if (off == TREG(IR)) return tim.ir;
+	return tim.r[off / 4];
+}
+
+static void tim_escribir(uint32_t dir, uint32_t v) {
+	uint32_t off = dir - LPC_TIM3_BASE;
+	if (off == TREG(IR)) {
+		tim.ir &= ~v;		// Escribir un 1 limpia
+		return;
+	}
+	tim.r[off / 4] = v;
+}
+
+// Proximo match con interrupcion habilitada y todavia no disparado
+static uint64_t tim_proximo_ns(void) {
+	uint64_t prox = UINT64_MAX;
+	for (uint32_t c = 0; c < 4; c++) {
+		if (!(tim.r[TREG(MCR) / 4] & (1u << (3 * c))) || (tim.ir & (1u << c))) continue;
+		uint64_t t = (uint64_t)tim.r[TREG(MR0) / 4 + c] * 1000;
+		if (t < prox) prox = t;
+	}
+	return prox;
+}
+
+// --- Simulacion ---
+
+// Los dos modulos habilitan su interrupcion en el NVIC al iniciar (en la PC
+// el ISER es memoria comun y no acumula los bits)
+static uint32_t isr_demorada;		// Bytes que se juntan en la FIFO antes de atender
+
+static void interrupciones(void) {
+	uint8_t demorada = uart.rx_n < isr_demorada && uart.linea_ini != uart.linea_fin;
+	if (!demorada && uart_iir() != UART_IIR_INTSTAT_PEND) {
+		uint64_t a0 = uart.accesos;
+		en_isr = 1;
+		UART1_IRQHandler();
+		en_isr = 0;
+		if (uart.accesos - a0 > uart.peor_isr) uart.peor_isr = uart.accesos - a0;
+	}
+	if (tim.ir & 0x0F) {
+		en_isr = 1;
+		TIMER3_IRQHandler();
+		en_isr = 0;
+	}
+}
+
+static void byte_transmitido(uint8_t c) {
+	uart.tx_bytes++;
+	if (uart.respuesta_n < sizeof(uart.respuesta)) uart.respuesta[uart.respuesta_n++] = c;
+	if (uart.pty >= 0 && write(uart.pty, &c, 1) != 1) uart.pty = -1;
+	if (actual.bytes && uart.tx_n == 0) {
+		// Respuesta completa: se mide con la espera del maestro incluida
+		if (actual.fc == MODBUS_INPUT && actual.cant == ENTRADAS) {
+			carga_ns += ahora_ns - actual.pedido_ns + ESPERA_MAESTRO_NS;
+			carga_registros += actual.cant;
+		}
+		actual.bytes = 0;
+	}
+}
+
+// Avanza al proximo evento; 0 si no queda ninguno
+static int paso(void) {
+	uint64_t t = UINT64_MAX, t_tim = tim_proximo_ns();
+	if (uart.linea_ini != uart.linea_fin) t = uart.rx_prox_ns;
+	if (uart.tx_fin_ns && uart.tx_fin_ns < t) t = uart.tx_fin_ns;
+	if (!uart.tx_fin_ns && uart.tx_n && ahora_ns < t) t = ahora_ns;
+	if (t_tim < t) t = t_tim;
+	if (t == UINT64_MAX) return 0;
+	if (t > ahora_ns) ahora_ns = t;
+
+	if (uart.linea_ini != uart.linea_fin && uart.rx_prox_ns <= ahora_ns) {
+		uint16_t c = uart.linea[uart.linea_ini++];
+		if (!actual.bytes) {
+			actual.pedido_ns = ahora_ns - caracter_ns();
+			uart.respuesta_n = 0;
+		}
+		if (actual.bytes == 1) actual.fc = (uint8_t)c;
+		if (actual.bytes == 4) actual.cant = 0;
+		if (actual.bytes == 4 || actual.bytes == 5) actual.cant = (uint16_t)(actual.cant << 8 | (c & 0xFF));
+		actual.bytes++;
+		if (uart.rx_n < 16) uart.rx[uart.rx_n++] = c;
+		else uart.lsr_error |= UART_LSR_OE, uart.desbordes++;
+		uart.rx_ultimo_ns = ahora_ns;
+		uart.rx_prox_ns = ahora_ns + caracter_ns();
+	}
+	if (uart.tx_fin_ns && uart.tx_fin_ns <= ahora_ns) {
+		uart.tx_fin_ns = 0;
+		byte_transmitido(uart.tx_byte);
+	}
+	if (!uart.tx_fin_ns && uart.tx_n) {
+		uart.tx_byte = uart.tx[0];
+		memmove(uart.tx, uart.tx + 1, --uart.tx_n);
+		uart.tx_fin_ns = ahora_ns + caracter_ns();
+		if (!uart.tx_n) uart.thre_pend = 1;
+	}
+	for (uint32_t c = 0; c < 4; c++) {
+		if ((tim.r[TREG(MCR) / 4] & (1u << (3 * c))) && (uint64_t)tim.r[TREG(MR0) / 4 + c] * 1000 <= ahora_ns)
+			tim.ir |= 1u << c;
+	}
+
+	interrupciones();
+	modbus_service();		// Lazo principal
+	interrupciones();
+	return 1;
+}
+
+static void correr_hasta_silencio(void) {
+	while (paso());
+}
+
+// --- Maestro Modbus (proceso hijo, del otro lado del pts) ---
+
+static uint16_t crc16(const uint8_t *p, uint32_t n) {
+	uint16_t crc = 0xFFFF;
+	while (n--) {
+		crc ^= *p++;
+		for (int b = 0; b < 8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+	return crc;
+}
+
+static uint32_t armar(uint8_t *t, uint8_t esclavo, uint8_t fc, uint16_t dir, uint16_t cant) {
+	t[0] = esclavo;
+	t[1] = fc;
+	t[2] = (uint8_t)(dir >> 8);
+	t[3] = (uint8_t)dir;
+	t[4] = (uint8_t)(cant >> 8);
+	t[5] = (uint8_t)cant;
+	uint16_t crc = crc16(t, 6);
+	t[6] = (uint8_t)crc;
+	t[7] = (uint8_t)(crc >> 8);
+	return 8;
+}
+
+// Manda el pedido y espera la respuesta: completa por largo, o hasta un
+// silencio si el esclavo no responde
+static uint32_t consultar(int fd, const uint8_t *pedido, uint32_t n, uint8_t *resp, uint32_t esperado) {
+	uint32_t r = 0;
+	VERIFICAR(write(fd, pedido, n) == (ssize_t)n);
+	while (esperado == 0 || r < esperado) {
+		struct pollfd p = {fd, POLLIN, 0};
+		if (poll(&p, 1, esperado == 0 ? SIN_RESPUESTA_MS : 2000) <= 0) break;
+		ssize_t k = read(fd, resp + r, MODBUS_TAM_TRAMA + 4 - r);
+		if (k <= 0) break;
+		r += (uint32_t)k;
+		// Una excepcion es mas corta que la respuesta esperada
+		if (r >= 5 && (resp[1] & 0x80)) break;
+	}
+	if (r >= 4) VERIFICAR(crc16(resp, r - 2) == (resp[r - 2] | (uint16_t)resp[r - 1] << 8));
+	return r;
+}
+
+static uint16_t get16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+static void leer_verificar(int fd, uint8_t fc, uint16_t dir, uint16_t cant, const uint16_t *esperado) {
+	uint8_t t[8], r[MODBUS_TAM_TRAMA + 4];
+	armar(t, MODBUS_DIRECCION, fc, dir, cant);
+	VERIFICAR(consultar(fd, t, 8, r, 5 + 2 * cant) == 5u + 2 * cant);
+	VERIFICAR(r[0] == MODBUS_DIRECCION && r[1] == fc && r[2] == 2 * cant);
+	for (uint16_t i = 0; i < cant; i++) {
+		uint16_t v = esperado ? esperado[i] : valor_entrada(dir + i);
+		VERIFICAR(get16(&r[3 + 2 * i]) == v);
+	}
+}
+
+static void excepcion(int fd, const uint8_t *t, uint32_t n, uint8_t codigo) {
+	uint8_t r[MODBUS_TAM_TRAMA + 4];
+	VERIFICAR(consultar(fd, t, n, r, 5) == 5);
+	VERIFICAR(r[1] == (t[1] | 0x80) && r[2] == codigo);
+}
+
+static void sin_respuesta(int fd, const uint8_t *t, uint32_t n) {
+	uint8_t r[MODBUS_TAM_TRAMA + 4];
+	VERIFICAR(consultar(fd, t, n, r, 0) == 0);
+}
+
+static void maestro(const char *pts) {
+	uint8_t t[MODBUS_TAM_TRAMA], r[MODBUS_TAM_TRAMA + 4];
+	int fd = open(pts, O_RDWR | O_NOCTTY);
+	VERIFICAR(fd >= 0);
+
+	// 03 y 04
+	const uint16_t h0[HOLDINGS] = {400, 1000, 10, 0};
+	leer_verificar(fd, MODBUS_HOLDING, 0, HOLDINGS, h0);
+	leer_verificar(fd, MODBUS_INPUT, 0, 10, NULL);
+	leer_verificar(fd, MODBUS_INPUT, ENTRADAS - 3, 3, NULL);
+
+	// 06: la respuesta es el eco del pedido
+	uint32_t n = armar(t, MODBUS_DIRECCION, 6, 0, 555);
+	VERIFICAR(consultar(fd, t, n, r, 8) == 8 && memcmp(r, t, 8) == 0);
+
+	// 16
+	static const uint8_t escritura[] = {MODBUS_DIRECCION, 16, 0, 1, 0, 2, 4, 0x04, 0xD2, 0x00, 0x4D};
+	memcpy(t, escritura, sizeof(escritura));
+	uint16_t crc = crc16(t, sizeof(escritura));
+	t[sizeof(escritura)] = (uint8_t)crc;
+	t[sizeof(escritura) + 1] = (uint8_t)(crc >> 8);
+	VERIFICAR(consultar(fd, t, sizeof(escritura) + 2, r, 8) == 8 && memcmp(r, t, 6) == 0);
+	const uint16_t h1[HOLDINGS] = {555, 1234, 77, 0};
+	leer_verificar(fd, MODBUS_HOLDING, 0, HOLDINGS, h1);
+
+	// Excepciones: funcion, direccion y valor
+	n = armar(t, MODBUS_DIRECCION, 0x2B, 0, 1);
+	excepcion(fd, t, n, MODBUS_EXC_FUNCION);
+	n = armar(t, MODBUS_DIRECCION, MODBUS_INPUT, ENTRADAS - 1, 2);
+	excepcion(fd, t, n, MODBUS_EXC_DIRECCION);
+	n = armar(t, MODBUS_DIRECCION, MODBUS_HOLDING, 0, 0);
+	excepcion(fd, t, n, MODBUS_EXC_VALOR);
+	n = armar(t, MODBUS_DIRECCION, 6, 1, 0);
+	excepcion(fd, t, n, MODBUS_EXC_VALOR);
+
+	// Sin respuesta: CRC malo, otro esclavo, difusion (se ejecuta igual)
+	n = armar(t, MODBUS_DIRECCION, MODBUS_INPUT, 0, 1);
+	t[7] ^= 0x55;
+	sin_respuesta(fd, t, n);
+	n = armar(t, MODBUS_DIRECCION + 1, MODBUS_INPUT, 0, 1);
+	sin_respuesta(fd, t, n);
+	n = armar(t, 0, 6, 3, 9);
+	sin_respuesta(fd, t, n);
+	const uint16_t h2[HOLDINGS] = {555, 1234, 77, 9};
+	leer_verificar(fd, MODBUS_HOLDING, 0, HOLDINGS, h2);
+
+	// Un silencio en medio del pedido lo parte en dos tramas invalidas
+	n = armar(t, MODBUS_DIRECCION, MODBUS_INPUT, 0, 1);
+	VERIFICAR(write(fd, t, 3) == 3);
+	usleep(50000);
+	sin_respuesta(fd, t + 3, n - 3);
+
+	// Caudal: lecturas del maximo de registros por pedido
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (uint32_t i = 0; i < LECTURAS_CARGA; i++) leer_verificar(fd, MODBUS_INPUT, 0, ENTRADAS, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	printf("maestro: %u lecturas de %u registros por el pts, %.0f registros/s en la PC\n",
+			LECTURAS_CARGA, ENTRADAS, LECTURAS_CARGA * ENTRADAS / s);
+	close(fd);
+}
+
+// --- Esclavo ---
+
+static void atender(pid_t hijo) {
+	uint8_t buf[512];
+	int estado;
+	for (;;) {
+		ssize_t k = read(uart.pty, buf, sizeof(buf));
+		if (k > 0) linea_agregar(buf, (uint32_t)k, -1);
+		if (paso()) continue;
+		if (hijo > 0 && waitpid(hijo, &estado, WNOHANG) == hijo) {
+			VERIFICAR(WIFEXITED(estado) && WEXITSTATUS(estado) == 0);
+			return;
+		}
+		struct pollfd p = {uart.pty, POLLIN, 0};
+		poll(&p, 1, 20);
+	}
+}
+
+// Tramas inyectadas en la linea, sin el pts
+static uint32_t inyectar(const uint8_t *t, uint32_t n, int32_t con_error) {
+	uint64_t antes = uart.tx_bytes;
+	linea_agregar(t, n, con_error);
+	correr_hasta_silencio();
+	return (uint32_t)(uart.tx_bytes - antes);
+}
+
+int main(void) {
+	anfitrion_init();
+	memset(&uart, 0, sizeof(uart));
+	uart.pty = -1;
+	uart.r[REG(FDR)] = 0x10;
+	anfitrion_periferico(LPC_UART1_BASE, 0x1000, uart_leer, uart_escribir);
+	anfitrion_periferico(LPC_TIM3_BASE, 0x1000, tim_leer, tim_escribir);
+
+	tiempo_init();
+	modbus_init();
+	uint32_t baud = uart_baud();
+	VERIFICAR(baud > MODBUS_BAUD * 99 / 100 && baud < MODBUS_BAUD * 101 / 100);
+	VERIFICAR(uart.r[REG(LCR)] == (UART_LCR_WLEN8 | UART_LCR_PARITY_EN | UART_LCR_PARITY_EVEN));
+	VERIFICAR(uart.r[REG(RS485CTRL)] == (UART1_RS485CTRL_DCTRL_EN | UART1_RS485CTRL_SEL_DTR | UART1_RS485CTRL_OINV_1));
+	printf("UART1: %u baudios 8E1, direccion automatica por DTR1; caracter de %.0f us\n", baud, caracter_ns() / 1e3);
+
+	int esclavo_pts;
+	char pts[64];
+	struct termios tio;
+	VERIFICAR(openpty(&uart.pty, &esclavo_pts, pts, NULL, NULL) == 0);
+	tcgetattr(esclavo_pts, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(esclavo_pts, TCSANOW, &tio);
+	fcntl(uart.pty, F_SETFL, O_NONBLOCK);
+
+	if (getenv("PRUEBA_PTY_EXTERNO")) {
+		printf("esclavo %u en %s (Ctrl-C para terminar)\n", MODBUS_DIRECCION, pts);
+		fflush(stdout);
+		atender(0);
+	}
+
+	fflush(stdout);
+	pid_t hijo = fork();
+	VERIFICAR(hijo >= 0);
+	if (hijo == 0) {
+		close(uart.pty);
+		close(esclavo_pts);
+		maestro(pts);
+		fflush(stdout);
+		_exit(0);
+	}
+	atender(hijo);
+	close(esclavo_pts);
+	correr_hasta_silencio();
+
+	const modbus_stats_t *s = modbus_get_stats();
+	VERIFICAR(s->errores_crc == 3);			// CRC malo y el pedido partido en dos
+	VERIFICAR(s->excepciones == 4);
+	VERIFICAR(s->errores_trama == 0);
+	VERIFICAR(s->registros_escritos == 1 + 2 + 1);
+	VERIFICAR(lecturas_en_isr == 0);
+	VERIFICAR(uart.desbordes == 0);
+	printf("funciones 03/04/06/16, excepciones, CRC, difusion y silencio en la trama: correctos\n");
+
+	// Error de paridad en un byte: la trama se descarta sin responder
+	uint8_t t[8];
+	armar(t, MODBUS_DIRECCION, MODBUS_INPUT, 0, 1);
+	VERIFICAR(inyectar(t, 8, 3) == 0);
+	VERIFICAR(s->errores_trama == 1);
+	VERIFICAR(inyectar(t, 8, -1) == 7);
+	// Con la interrupcion demorada dos caracteres (otra de mayor prioridad) el
+	// byte con error no queda primero en la FIFO: se detecta en el lazo de lectura
+	isr_demorada = 3;
+	VERIFICAR(inyectar(t, 8, 1) == 0);
+	VERIFICAR(s->errores_trama == 2);
+	VERIFICAR(inyectar(t, 8, -1) == 7);
+	isr_demorada = 0;
+	printf("error de paridad: trama descartada (tambien con 3 bytes en la FIFO), la siguiente se responde\n");
+
+	// Caudal en el tiempo simulado: del primer byte del pedido al ultimo de la
+	// respuesta, mas la espera del maestro. El limite es la linea: pedido de 8
+	// bytes, silencio de 3,5 caracteres y respuesta de 5 + 250 bytes.
+	double caracter_s = caracter_ns() / 1e9;
+	double limite = ENTRADAS / ((8 + 3.5 + 5 + 2 * ENTRADAS) * caracter_s + ESPERA_MAESTRO_NS / 1e9);
+	double caudal = carga_registros / (carga_ns / 1e9);
+	VERIFICAR(carga_registros == LECTURAS_CARGA * ENTRADAS);
+	VERIFICAR(caudal > limite * 0.99);
+	printf("caudal: %.0f registros/s a %u baudios (limite de la linea %.0f); %.1f ms por lectura de %u\n",
+			caudal, baud, limite, carga_ns / 1e6 / LECTURAS_CARGA, ENTRADAS);
+	printf("interrupcion de la UART1: a lo sumo %llu accesos a registros por entrada; el mapa de registros"
+			" se lee solo desde modbus_service\n", (unsigned long long)uart.peor_isr);
+	printf("modbus: OK\n");
+	return 0;
+}
@@ -0,0 +1,130 @@
+// --- Prueba de tools/perfil.py con un volcado sintetico ---
+// datos/perfil.txt es un volcado como el que manda perfil.c por la UART3
+// (con ruido y un volcado anterior que se descarta) y datos/perfil.map un
+// mapa del enlazador recortado con el mismo formato que Debug/TP_Final.map.
+// Verifica, contra la salida esperada completa:
+//   - el perfil plano por funcion y por contexto, con las excepciones
+//     nombradas desde LPC17xx.h y las que no tienen nombre como excN
+//   - funciones en .after_vectors, .text.<funcion>, .text de una biblioteca
+//     y .ramfunc; las static (sin simbolo en el mapa) por su seccion
+//   - PCs fuera del codigo (ROM, .rodata) en hexadecimal
+//   - --folded: 'contexto;funcion muestras' para flamegraph.pl
+// Con --elf, los simbolos de este mismo ejecutable via nm, tambien static.
+
+#include "anfitrion.h"
+#include <libgen.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char plano[] =
+	"muestras: 2015 (perdidas: 3), 2.0 s\n"
+	"\n"
+	"funcion                           muestras       %\n"
+	"main                                  1000  49.63%\n"
+	"TIMER0_IRQHandler                      300  14.89%\n"
+	"procesar_pendientes                    200   9.93%\n"
+	"ADC_IRQHandler                         150   7.44%\n"
+	"NVIC_EnableIRQ                         100   4.96%\n"
+	"convertir                              100   4.96%\n"
+	"PendSV_Handler                          80   3.97%\n"
+	"__aeabi_uidiv                           70   3.47%\n"
+	"enlace_esp_service                      12   0.60%\n"
+	"0x00000510                               2   0.10%\n"
+	"0x1fff1ff0                               1   0.05%\n"
+	"\n"
+	"contexto                          muestras       %\n"
+	"main                                  1351  67.05%\n"
+	"TIMER0                                 320  15.88%\n"
+	"ADC                                    250  12.41%\n"
+	"PendSV                                  92   4.57%\n"
+	"exc4                                     2   0.10%\n";
+
+static const char plegadas[] =
+	"ADC;ADC_IRQHandler 150\n"
+	"ADC;convertir 100\n"
+	"PendSV;PendSV_Handler 80\n"
+	"PendSV;enlace_esp_service 12\n"
+	"TIMER0;TIMER0_IRQHandler 300\n"
+	"TIMER0;__aeabi_uidiv 20\n"
+	"exc4;0x00000510 2\n"
+	"main;0x1fff1ff0 1\n"
+	"main;NVIC_EnableIRQ 100\n"
+	"main;__aeabi_uidiv 50\n"
+	"main;main 1000\n"
+	"main;procesar_pendientes 200\n";
+
+// Para el volcado con --elf: una static y una global de este ejecutable
+__attribute__((noinline)) static uint32_t muestreada_static(uint32_t x) {
+	return x * 2654435761u + (x >> 7);
+}
+
+__attribute__((noinline)) uint32_t muestreada_global(uint32_t x) {
+	return muestreada_static(x) ^ (x << 3);
+}
+
+static char salida[4096];
+
+// Corre perfil.py con 'args' y devuelve su salida estandar
+static const char *perfil(const char *dir, const char *args) {
+	char orden[1000];
+	snprintf(orden, sizeof(orden), "python3 %s/../../tools/perfil.py %s", dir, args);
+	FILE *p = popen(orden, "r");
+	VERIFICAR(p != NULL);
+	size_t n = fread(salida, 1, sizeof(salida) - 1, p);
+	salida[n] = 0;
+	VERIFICAR(pclose(p) == 0);
+	return salida;
+}
+
+static void comparar(const char *obtenido, const char *esperado) {
+	if (strcmp(obtenido, esperado) != 0) {
+		printf("obtenido:\n%s\nesperado:\n%s\n", obtenido, esperado);
+		VERIFICAR(0);
+	}
+}
+
+static const char *leer(const char *ruta) {
+	FILE *f = fopen(ruta, "r");
+	VERIFICAR(f != NULL);
+	size_t n = fread(salida, 1, sizeof(salida) - 1, f);
+	salida[n] = 0;
+	fclose(f);
+	return salida;
+}
+
+int main(void) {
+	char ejecutable[256], args[800], ruta[300];
+	ssize_t largo = readlink("/proc/self/exe", ejecutable, sizeof(ejecutable) - 1);
+	VERIFICAR(largo > 0);
+	ejecutable[largo] = 0;
+	char copia[256];
+	strcpy(copia, ejecutable);
+	const char *dir = dirname(copia);
+
+	// 1. Con el mapa
+	snprintf(ruta, sizeof(ruta), "%s/perfil.folded", dir);
+	snprintf(args, sizeof(args), "%s/../datos/perfil.txt --map %s/../datos/perfil.map --folded %s", dir, dir, ruta);
+	comparar(perfil(dir, args), plano);
+	comparar(leer(ruta), plegadas);
+	printf("con el .map: perfil por funcion y por contexto, static por su seccion, PCs fuera del codigo; --folded\n");
+
+	// 2. Con --elf sobre este ejecutable (sin PIE: las direcciones son las de nm)
+	snprintf(ruta, sizeof(ruta), "%s/perfil.txt", dir);
+	FILE *f = fopen(ruta, "w");
+	VERIFICAR(f != NULL);
+	fprintf(f, "#perfil hz=1009 muestras=60 perdidas=0\n");
+	fprintf(f, "%08x 0 40\n", (uint32_t)(uintptr_t)muestreada_static + 2);
+	fprintf(f, "%08x 15 20\n", (uint32_t)(uintptr_t)muestreada_global + 2);
+	fprintf(f, "#fin\n");
+	fclose(f);
+	VERIFICAR(muestreada_global(3) != 0);
+	snprintf(args, sizeof(args), "%s --elf %s --nm nm --top 2", ruta, ejecutable);
+	const char *s = perfil(dir, args);
+	VERIFICAR(strstr(s, "\nmuestreada_static                       40  66.67%\n"));
+	VERIFICAR(strstr(s, "\nmuestreada_global                       20  33.33%\n"));
+	VERIFICAR(strstr(s, "\nSysTick                                 20  33.33%\n"));
+	printf("con --elf: simbolos globales y static de nm\n");
+
+	printf("perfil: OK\n");
+	return 0;
+}
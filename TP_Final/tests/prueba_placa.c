@@ -0,0 +1,173 @@
+// --- Prueba de la tabla de pines (placa.h) contra la configuracion de antes ---
+// El Makefile extrae de la linea base (primer commit) la pinConfiguration
+// original con su cfgPin (PINSEL_ConfigPin pin por pin y FIODIR/FIOCLR |=) y
+// la compila como pinConfiguration_base. Las dos corren sobre modelos de
+// PINCON (registros comunes) y de los GPIO (FIOSET/FIOCLR actuan sobre el
+// latch de salida, FIOCLR se lee como 0), partiendo de todos los registros en
+// 0 y de todos en 1: un campo que termina igual desde los dos estados es uno
+// que la configuracion fija. Verifica:
+//   - que cada funcion, modo, open drain, direccion y nivel que fijaba la
+//     linea base la tabla lo fija con el mismo valor
+//   - que las diferencias son solo pines que la linea base dejaba como al
+//     reset, y que todos estan en la tabla (se listan)
+// Cuenta los accesos a PINCON y a los GPIO de cada forma.
+
+#include "anfitrion.h"
+#include "placa.h"
+#include <string.h>
+
+void pinConfiguration_base(void);
+
+#define CAMPOS		5
+
+static const char *campos[CAMPOS] = { "funcion", "modo", "open drain", "direccion", "nivel" };
+
+typedef struct {
+	uint64_t lecturas, escrituras;
+} cuenta_t;
+
+// --- Modelos ---
+
+static struct {
+	uint32_t r[0x80 / 4];
+	cuenta_t c;
+} pincon;
+
+static struct {
+	uint32_t dir[5], salida[5];
+	cuenta_t c;
+} gpio;
+
+static uint32_t pincon_leer(uint32_t dir) {
+	pincon.c.lecturas++;
+	return pincon.r[((dir - LPC_PINCON_BASE) & 0x7F) / 4];
+}
+
+static void pincon_escribir(uint32_t dir, uint32_t v) {
+	pincon.c.escrituras++;
+	pincon.r[((dir - LPC_PINCON_BASE) & 0x7F) / 4] = v;
+}
+
+static uint32_t gpio_leer(uint32_t dir) {
+	uint32_t p = (dir - LPC_GPIO0_BASE) / 0x20;
+	gpio.c.lecturas++;
+	if (p >= 5) return 0;
+	switch ((dir - LPC_GPIO0_BASE) % 0x20) {
+	case 0x00: return gpio.dir[p];
+	case 0x14:
+	case 0x18: return gpio.salida[p];	// FIOPIN y FIOSET devuelven el latch
+	}
+	return 0;
+}
+
+static void gpio_escribir(uint32_t dir, uint32_t v) {
+	uint32_t p = (dir - LPC_GPIO0_BASE) / 0x20;
+	gpio.c.escrituras++;
+	if (p >= 5) return;
+	switch ((dir - LPC_GPIO0_BASE) % 0x20) {
+	case 0x00: gpio.dir[p] = v; break;
+	case 0x18: gpio.salida[p] |= v; break;
+	case 0x1C: gpio.salida[p] &= ~v; break;
+	}
+}
+
+// --- Estado de los pines ---
+
+typedef struct {
+	uint32_t pinsel[10], pinmode[10], od[5], dir[5], salida[5];
+	cuenta_t pines, puertos;
+} estado_t;
+
+// Corre la configuracion desde todos los registros en 'inicial'
+static estado_t correr(void (*configurar)(void), uint32_t inicial) {
+	estado_t e;
+
+	memset(pincon.r, inicial ? 0xFF : 0, sizeof(pincon.r));
+	memset(gpio.dir, inicial ? 0xFF : 0, sizeof(gpio.dir));
+	memset(gpio.salida, inicial ? 0xFF : 0, sizeof(gpio.salida));
+	memset(&pincon.c, 0, sizeof(pincon.c));
+	memset(&gpio.c, 0, sizeof(gpio.c));
+	configurar();
+	memcpy(e.pinsel, &pincon.r[0x00 / 4], sizeof(e.pinsel));
+	memcpy(e.pinmode, &pincon.r[0x40 / 4], sizeof(e.pinmode));
+	memcpy(e.od, &pincon.r[0x68 / 4], sizeof(e.od));
+	memcpy(e.dir, gpio.dir, sizeof(e.dir));
+	memcpy(e.salida, gpio.salida, sizeof(e.salida));
+	e.pines = pincon.c;
+	e.puertos = gpio.c;
+	return e;
+}
+
+static uint32_t campo(const estado_t *e, uint32_t p, uint32_t n, uint32_t f) {
+	uint32_t r = p * 2 + n / 16, d = (n & 15) * 2;
+	switch (f) {
+	case 0: return (e->pinsel[r] >> d) & 3;
+	case 1: return (e->pinmode[r] >> d) & 3;
+	case 2: return (e->od[p] >> n) & 1;
+	case 3: return (e->dir[p] >> n) & 1;
+	default: return (e->salida[p] >> n) & 1;
+	}
+}
+
+#define EN_TABLA_X(a, p, n, f, m, od, s, v)		|| ((a) == (p) * 32 + (n))
+
+static uint8_t en_tabla(uint32_t p, uint32_t n) {
+	uint32_t pin = p * 32 + n;
+	return 0 PLACA_PINES(EN_TABLA_X, pin);
+}
+
+int main(void) {
+	anfitrion_init();
+	anfitrion_periferico(LPC_PINCON_BASE, 0x1000, pincon_leer, pincon_escribir);
+	anfitrion_periferico(LPC_GPIO0_BASE & ~0xFFFUL, 0x1000, gpio_leer, gpio_escribir);
+
+	estado_t base[2] = { correr(pinConfiguration_base, 0), correr(pinConfiguration_base, 1) };
+	estado_t tabla[2] = { correr(pinConfiguration, 0), correr(pinConfiguration, 1) };
+
+	uint32_t fijados = 0, agregados = 0, leds = 0;
+	printf("diferencias (pines que la linea base dejaba como al reset):\n");
+	for (uint32_t p = 0; p < 5; p++) {
+		for (uint32_t n = 0; n < 32; n++) {
+			char cambios[64] = "";
+			for (uint32_t f = 0; f < CAMPOS; f++) {
+				uint32_t b = campo(&base[0], p, n, f);
+				uint32_t t = campo(&tabla[0], p, n, f);
+				uint8_t fija_tabla = (t == campo(&tabla[1], p, n, f));
+				if (b == campo(&base[1], p, n, f)) {
+					// Fijado por la linea base: la tabla lo deja igual
+					VERIFICAR(fija_tabla && t == b);
+					fijados++;
+				} else if (fija_tabla && t != b) {
+					// b es el valor de reset: la linea base no tocaba el campo
+					snprintf(cambios + strlen(cambios), sizeof(cambios) - strlen(cambios), "%s%s %u",
+							cambios[0] ? ", " : "", campos[f], t);
+				}
+			}
+			if (cambios[0]) {
+				VERIFICAR(en_tabla(p, n));
+				agregados++;
+				printf("  P%u.%u: %s\n", p, n, cambios);
+				// LEDs: ya eran salidas en bajo; solo cambia el modo
+				if (p == 0 && (n == 2 || n == 3 || n == 27)) {
+					VERIFICAR(strcmp(cambios, "modo 2") == 0);
+					leds++;
+				}
+			}
+		}
+	}
+	VERIFICAR(fijados > 0 && leds == 3);
+	VERIFICAR(campo(&tabla[0], 0, 11, 0) == 1);	// RXD2, que la linea base no configuraba
+	printf("%u campos que fijaba la linea base, iguales con la tabla; %u pines con diferencias, todos en placa.h\n",
+			fijados, agregados);
+
+	VERIFICAR(tabla[0].pines.lecturas == 0 && tabla[0].puertos.lecturas == 0);
+	printf("accesos a PINCON (lecturas/escrituras): linea base %llu/%llu, tabla %llu/%llu\n",
+			(unsigned long long)base[0].pines.lecturas, (unsigned long long)base[0].pines.escrituras,
+			(unsigned long long)tabla[0].pines.lecturas, (unsigned long long)tabla[0].pines.escrituras);
+	printf("accesos a los GPIO (lecturas/escrituras): linea base %llu/%llu, tabla %llu/%llu\n",
+			(unsigned long long)base[0].puertos.lecturas, (unsigned long long)base[0].puertos.escrituras,
+			(unsigned long long)tabla[0].puertos.lecturas, (unsigned long long)tabla[0].puertos.escrituras);
+
+	printf("placa: OK\n");
+	return 0;
+}
@@ -0,0 +1,316 @@
+// --- Prueba de registros.h contra los drivers de CMSIS ---
+// Cada acceso de los caminos rapidos se hace de las dos formas: como lo hacia
+// main.c con los drivers (y FIOSET |=) y con registros.h. Se compila con -O0,
+// como la configuracion Debug del firmware.
+//   - Con los registros como memoria comun: ciclos de la PC por operacion.
+//   - Con modelos de GPIO0, ADC y TIMER1 (FIOSET/FIOCLR actuan sobre el
+//     latch de salida, ADDR0 borra DONE al leerse, IR se borra escribiendo 1,
+//     TCR con reset pone TC en 0): el mismo estado final y los accesos a
+//     registros de cada forma. Con dos matches pendientes, TIM_ClearIntPending
+//     (IR |= bit) borra tambien el otro; tim_int_limpiar no.
+// Al final verifica con nm que ninguna funcion de registros.h, ni de los otros
+// encabezados que usan las interrupciones EN_RAM (atomico.h, ventana.h,
+// tiempo.h y traza.h), quedo fuera de linea, que es lo que garantiza EN_LINEA
+// con -O0.
+
+#include "anfitrion.h"
+#include "registros.h"
+#include "atomico.h"
+#include "ventana.h"
+#include "tiempo.h"
+#include "traza.h"
+#include "lpc17xx_adc.h"
+#include "lpc17xx_timer.h"
+#include <string.h>
+#include <unistd.h>
+
+#define VUELTAS		1000000
+#define LEDS		((1UL << 2) | (1UL << 3) | (1UL << 27))
+
+static const char *funciones[] = {
+	"gpio_poner", "gpio_limpiar", "adc_leer_canal", "tim_int_pendiente", "tim_int_limpiar",
+	"tim_arrancar", "tim_detener", "tim_rearmar", "dwt_init", "dwt_ciclos",
+	"atomico_leer", "atomico_escribir", "atomico_sumar", "atomico_intercambiar", "atomico_cas",
+	"atomico_bandera_poner", "atomico_bandera_tomar", "seqlock_escribir_inicio", "seqlock_escribir_fin",
+	"seqlock_leer_inicio", "seqlock_reintentar", "cola_spsc_reservar", "cola_spsc_publicar",
+	"cola_spsc_siguiente", "cola_spsc_liberar", "cola_mpsc_init", "cola_mpsc_reservar", "cola_mpsc_publicar",
+	"cola_mpsc_siguiente", "cola_mpsc_liberar", "ventana_agregar", "ventana_leer_inicio", "ventana_reintentar",
+	"tiempo_us", "traza_evento",
+};
+
+traza_t traza;
+
+// Usa una vez cada funcion de los otros encabezados, para el control con nm
+static void otros_encabezados(void) {
+	static atomico_u32_t a, seq_mpsc[4];
+	static cola_spsc_t spsc = COLA_SPSC_INIT(4);
+	static cola_mpsc_t mpsc;
+	static ventana_t v = VENTANA_INIT(v);
+	uint32_t pos, seq;
+
+	atomico_escribir(&a, atomico_leer(&a));
+	atomico_sumar(&a, 1);
+	atomico_intercambiar(&a, 2);
+	VERIFICAR(atomico_cas(&a, 2, 3));
+	atomico_bandera_poner(&a);
+	VERIFICAR(atomico_bandera_tomar(&a));
+	if (cola_spsc_reservar(&spsc) >= 0) cola_spsc_publicar(&spsc);
+	if (cola_spsc_siguiente(&spsc) >= 0) cola_spsc_liberar(&spsc);
+	cola_mpsc_init(&mpsc, seq_mpsc, 4);
+	if (cola_mpsc_reservar(&mpsc, &pos) >= 0) cola_mpsc_publicar(&mpsc, pos);
+	if (cola_mpsc_siguiente(&mpsc) >= 0) cola_mpsc_liberar(&mpsc);
+	seqlock_escribir_inicio(&v.seq);
+	seqlock_escribir_fin(&v.seq);
+	VERIFICAR(!seqlock_reintentar(&v.seq, seqlock_leer_inicio(&v.seq)));
+	ventana_agregar(&v, 1);
+	ventana_leer_inicio(&v, &seq);
+	VERIFICAR(!ventana_reintentar(&v, seq));
+	VERIFICAR(tiempo_us() == LPC_TIM3->TC);
+	traza_evento(TRAZA_ALARMA, 0, 1);
+}
+
+// --- Modelos ---
+
+typedef struct {
+	uint64_t lecturas, escrituras;
+} cuenta_t;
+
+static struct {
+	uint32_t salida;
+	cuenta_t c;
+} gpio;
+
+static struct {
+	uint32_t dr;
+	cuenta_t c;
+} adc;
+
+static struct {
+	uint32_t ir, tcr, tc, mr[4];
+	uint32_t resets;
+	cuenta_t c;
+} tim;
+
+static uint32_t gpio_leer(uint32_t dir) {
+	gpio.c.lecturas++;
+	switch (dir - LPC_GPIO0_BASE) {
+	case 0x14:
+	case 0x18: return gpio.salida;		// FIOPIN y FIOSET devuelven el latch
+	}
+	return 0;
+}
+
+static void gpio_escribir(uint32_t dir, uint32_t v) {
+	gpio.c.escrituras++;
+	switch (dir - LPC_GPIO0_BASE) {
+	case 0x18: gpio.salida |= v; break;
+	case 0x1C: gpio.salida &= ~v; break;
+	}
+}
+
+static uint32_t adc_leer(uint32_t dir) {
+	adc.c.lecturas++;
+	if (dir == (uint32_t)&LPC_ADC->ADDR0) {
+		uint32_t v = adc.dr;
+		adc.dr &= ~ADC_DR_LISTO;
+		return v;
+	}
+	return 0;
+}
+
+static void adc_escribir(uint32_t dir, uint32_t v) {
+	(void)dir; (void)v;
+	adc.c.escrituras++;
+}
+
+static uint32_t tim_leer(uint32_t dir) {
+	tim.c.lecturas++;
+	uint32_t off = dir - LPC_TIM1_BASE;
+	switch (off) {
+	case 0x00: return tim.ir;
+	case 0x04: return tim.tcr;
+	case 0x08: return tim.tc;
+	case 0x18: case 0x1C: case 0x20: case 0x24: return tim.mr[(off - 0x18) / 4];
+	}
+	return 0;
+}
+
+static void tim_escribir(uint32_t dir, uint32_t v) {
+	tim.c.escrituras++;
+	uint32_t off = dir - LPC_TIM1_BASE;
+	switch (off) {
+	case 0x00: tim.ir &= ~v; break;
+	case 0x04:
+		tim.tcr = v & 3;
+		if (v & TIM_TCR_RESET) {
+			tim.tc = 0;
+			tim.resets++;
+		}
+		break;
+	case 0x18: case 0x1C: case 0x20: case 0x24: tim.mr[(off - 0x18) / 4] = v; break;
+	}
+}
+
+// --- Operaciones, de las dos formas ---
+
+static void led_driver(void) {
+	LPC_GPIO0->FIOSET |= LEDS;
+	LPC_GPIO0->FIOCLR |= (1UL << 22);
+}
+
+static void led_registros(void) {
+	gpio_poner(LPC_GPIO0, LEDS);
+	gpio_limpiar(LPC_GPIO0, 1UL << 22);
+}
+
+static uint16_t dato_leido;
+
+static void adc_driver(void) {
+	if (ADC_ChannelGetStatus(LPC_ADC, ADC_CHANNEL_0, ADC_DATA_DONE))
+		dato_leido = ADC_ChannelGetData(LPC_ADC, ADC_CHANNEL_0);
+}
+
+static void adc_registros(void) {
+	uint16_t d;
+	if (adc_leer_canal(ADC_CHANNEL_0, &d)) dato_leido = d;
+}
+
+static uint8_t atendida;
+
+static void irq_driver(void) {
+	if (TIM_GetIntStatus(LPC_TIM1, TIM_MR0_INT)) {
+		TIM_ClearIntPending(LPC_TIM1, TIM_MR0_INT);
+		atendida = 1;
+	}
+}
+
+static void irq_registros(void) {
+	if (tim_int_pendiente(LPC_TIM1, 0)) {
+		tim_int_limpiar(LPC_TIM1, 0);
+		atendida = 1;
+	}
+}
+
+static void rearmar_driver(void) {
+	TIM_UpdateMatchValue(LPC_TIM1, 0, 3000);
+	TIM_ResetCounter(LPC_TIM1);
+	TIM_Cmd(LPC_TIM1, ENABLE);
+}
+
+static void rearmar_registros(void) {
+	tim_rearmar(LPC_TIM1, 0, 3000);
+}
+
+static void detener_driver(void) {
+	TIM_Cmd(LPC_TIM1, DISABLE);
+}
+
+static void detener_registros(void) {
+	tim_detener(LPC_TIM1);
+}
+
+static const struct {
+	const char *nombre;
+	void (*driver)(void);
+	void (*registros)(void);
+} ops[] = {
+	{ "LEDs (poner y limpiar)", led_driver, led_registros },
+	{ "leer el ADC", adc_driver, adc_registros },
+	{ "consultar y borrar MR0", irq_driver, irq_registros },
+	{ "rearmar el timer", rearmar_driver, rearmar_registros },
+	{ "detener el timer", detener_driver, detener_registros },
+};
+#define NUM_OPS		(sizeof(ops) / sizeof(ops[0]))
+
+// Estado inicial de cada operacion en los modelos
+static void preparar(void) {
+	gpio.salida = 1UL << 22;
+	adc.dr = ADC_DR_LISTO | (0xABC << ADC_DR_RESULTADO_POS);
+	tim.ir = 1;
+	tim.tcr = 1;
+	tim.tc = 1234;
+	tim.mr[0] = 1000;
+	dato_leido = 0;
+	atendida = 0;
+}
+
+static uint64_t accesos(void) {
+	return gpio.c.lecturas + gpio.c.escrituras + adc.c.lecturas + adc.c.escrituras + tim.c.lecturas + tim.c.escrituras;
+}
+
+int main(void) {
+	anfitrion_init();
+
+	// 1. Ciclos de la PC con los registros como memoria comun
+	double ciclos[NUM_OPS][2];
+	*(volatile uint32_t *)&LPC_ADC->ADDR0 = ADC_DR_LISTO;
+	LPC_TIM1->IR = 1;
+	for (uint32_t o = 0; o < NUM_OPS; o++) {
+		for (int forma = 0; forma < 2; forma++) {
+			void (*fn)(void) = forma ? ops[o].registros : ops[o].driver;
+			uint64_t t0 = anfitrion_ciclos();
+			for (uint32_t i = 0; i < VUELTAS; i++) fn();
+			ciclos[o][forma] = (double)(anfitrion_ciclos() - t0) / VUELTAS;
+		}
+	}
+
+	// 2. Con los modelos: mismo estado final y accesos
+	anfitrion_periferico(LPC_GPIO0_BASE & ~0xFFFUL, 0x1000, gpio_leer, gpio_escribir);
+	anfitrion_periferico(LPC_ADC_BASE, 0x1000, adc_leer, adc_escribir);
+	anfitrion_periferico(LPC_TIM1_BASE, 0x1000, tim_leer, tim_escribir);
+	printf("%-24s %18s %18s\n", "operacion", "accesos drv/reg", "ciclos PC drv/reg");
+	for (uint32_t o = 0; o < NUM_OPS; o++) {
+		uint64_t n[2];
+		uint32_t fin[2][6];
+		for (int forma = 0; forma < 2; forma++) {
+			preparar();
+			uint64_t a = accesos();
+			(forma ? ops[o].registros : ops[o].driver)();
+			n[forma] = accesos() - a;
+			uint32_t f[6] = { gpio.salida, adc.dr, dato_leido, tim.ir | (atendida << 8), tim.tcr | (tim.tc << 2), tim.mr[0] };
+			memcpy(fin[forma], f, sizeof(f));
+		}
+		VERIFICAR(memcmp(fin[0], fin[1], sizeof(fin[0])) == 0);
+		VERIFICAR(n[1] <= n[0]);
+		printf("%-24s %9llu / %-6llu %9.1f / %-6.1f\n", ops[o].nombre, (unsigned long long)n[0],
+				(unsigned long long)n[1], ciclos[o][0], ciclos[o][1]);
+	}
+
+	// TIM_ClearIntPending lee IR y lo reescribe: borra tambien el MR1 pendiente
+	preparar();
+	tim.ir = 3;
+	irq_driver();
+	VERIFICAR(tim.ir == 0);
+	preparar();
+	tim.ir = 3;
+	irq_registros();
+	VERIFICAR(tim.ir == 2);
+	printf("con MR0 y MR1 pendientes: TIM_ClearIntPending pierde MR1, tim_int_limpiar lo conserva\n");
+
+	// 3. Nada de los encabezados quedo fuera de linea con -O0
+	otros_encabezados();
+	char ejecutable[200], orden[256];
+	ssize_t largo = readlink("/proc/self/exe", ejecutable, sizeof(ejecutable) - 1);
+	VERIFICAR(largo > 0);
+	ejecutable[largo] = 0;
+	snprintf(orden, sizeof(orden), "nm %s", ejecutable);
+	FILE *nm = popen(orden, "r");
+	VERIFICAR(nm != NULL);
+	char linea[256];
+	uint32_t simbolos = 0;
+	while (fgets(linea, sizeof(linea), nm)) {
+		char *nombre = strrchr(linea, ' ');
+		if (!nombre) continue;
+		nombre++;
+		nombre[strcspn(nombre, "\n")] = 0;
+		for (uint32_t i = 0; i < sizeof(funciones) / sizeof(funciones[0]); i++) {
+			VERIFICAR(strcmp(nombre, funciones[i]) != 0);
+		}
+		simbolos++;
+	}
+	VERIFICAR(pclose(nm) == 0 && simbolos > 0);
+	printf("con -O0: ninguna funcion de registros.h, atomico.h, ventana.h, tiempo.h ni traza.h quedo fuera de linea (%u simbolos revisados)\n", simbolos);
+
+	printf("registros: OK\n");
+	return 0;
+}
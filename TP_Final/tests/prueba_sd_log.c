@@ -0,0 +1,393 @@
+// --- Prueba de sd_log.c contra una tarjeta SD emulada sobre un archivo ---
+// sd_log.c, dma_canal.c y los drivers de CMSIS corren sin cambios: el SSP0,
+// el GPIO (CS en P0.16) y el GPDMA son perifericos emulados (anfitrion.h) y
+// la tarjeta responde el protocolo SPI de SD sobre build/sd.img, un bloque de
+// 512 bytes por LBA. El tiempo es simulado: cada byte por el SPI cuesta
+// 8 ciclos del reloj que programo el driver, la tarjeta tarda en programar
+// cada bloque y cada tanto se demora lo maximo que permite la norma.
+//
+// Verifica el formato en el archivo (orden, generacion, sin huecos) despues
+// de reiniciar, con bloques rechazados por la tarjeta y con tarjetas SDSC y
+// SDHC, y mide el caudal sostenido y la tasa de registro sin perdidas.
+
+#include "anfitrion.h"
+#include "modelo_gpdma.h"
+#include "sd_log.h"
+#include "dma_canal.h"
+#include "lpc17xx_ssp.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define IMAGEN				"build/sd.img"
+#define PROGRAMA_NS			700000ULL		// Programacion de un bloque
+#define DEMORA_NS			250000000ULL	// Peor caso de escritura de la norma (SDHC)
+#define DEMORA_CADA			64				// Bloques entre demoras largas
+#define LAZO_NS				50000ULL		// Periodo del lazo principal
+
+void DMA_IRQHandler(void);
+
+static uint64_t ahora_ns;
+static uint32_t registros_arranque;	// Entregados a sd_log_append desde sd_log_init
+
+// --- Tarjeta SD en modo SPI ---
+
+enum { T_COMANDO, T_ESPERA_TOKEN, T_RECIBIENDO };
+
+static struct {
+	int fd;
+	uint8_t sdhc, v2;
+	uint8_t idle, app, multi, cs;
+	uint32_t acmd41_restantes;
+	uint8_t cmd[6];
+	uint32_t n_cmd;
+	uint8_t salida[520];
+	uint32_t sal_pos, sal_n;
+	uint32_t estado;
+	uint8_t bloque[514];
+	uint32_t rx_n;
+	uint32_t lba;
+	uint64_t ocupada_hasta;
+	uint32_t recibidos;
+	uint32_t rechazar;			// Numero de bloque recibido a rechazar (0 = ninguno)
+} sd;
+
+static void responder(const uint8_t *b, uint32_t n) {
+	memcpy(sd.salida + sd.sal_n, b, n);
+	sd.sal_n += n;
+}
+
+static void r1(uint8_t r) {
+	uint8_t b[2] = {0xFF, r};	// Un byte de espera (Ncr) y la respuesta
+	responder(b, 2);
+}
+
+static uint32_t lba_de(uint32_t arg) {
+	if (sd.sdhc) return arg;
+	VERIFICAR(arg % SD_TAM_BLOQUE == 0);
+	return arg / SD_TAM_BLOQUE;
+}
+
+static void ejecutar(void) {
+	uint8_t cmd = sd.cmd[0] & 0x3F;
+	uint32_t arg = (uint32_t)sd.cmd[1] << 24 | sd.cmd[2] << 16 | sd.cmd[3] << 8 | sd.cmd[4];
+	uint8_t app = sd.app;
+
+	sd.app = 0;
+	sd.sal_pos = sd.sal_n = 0;
+	if (cmd == 0) {
+		sd.idle = 1;
+		r1(0x01);
+	} else if (cmd == 8) {
+		if (!sd.v2) { r1(0x05); return; }		// Comando ilegal: tarjeta v1
+		uint8_t r7[4] = {0x00, 0x00, 0x01, arg & 0xFF};
+		r1(0x01);
+		responder(r7, 4);
+	} else if (cmd == 55) {
+		sd.app = 1;
+		r1(sd.idle);
+	} else if (cmd == 41 && app) {
+		if (sd.acmd41_restantes) sd.acmd41_restantes--;
+		else sd.idle = 0;
+		r1(sd.idle);
+	} else if (sd.idle) {
+		r1(cmd == 58 ? 0x01 : 0x05);
+	} else if (cmd == 58) {
+		uint8_t ocr[4] = {0x80 | (sd.sdhc ? 0x40 : 0), 0xFF, 0x80, 0x00};
+		r1(0x00);
+		responder(ocr, 4);
+	} else if (cmd == 16) {
+		r1(arg == SD_TAM_BLOQUE ? 0x00 : 0x40);
+	} else if (cmd == 17) {
+		uint8_t b[SD_TAM_BLOQUE + 4] = {0xFF, 0xFE};
+		VERIFICAR(pread(sd.fd, b + 2, SD_TAM_BLOQUE, (off_t)lba_de(arg) * SD_TAM_BLOQUE) >= 0);
+		b[SD_TAM_BLOQUE + 2] = b[SD_TAM_BLOQUE + 3] = 0x55;
+		r1(0x00);
+		responder(b, sizeof(b));
+	} else if (cmd == 24 || cmd == 25) {
+		sd.lba = lba_de(arg);
+		sd.multi = (cmd == 25);
+		sd.estado = T_ESPERA_TOKEN;
+		r1(0x00);
+	} else {
+		r1(0x04);
+	}
+}
+
+// Un byte en cada sentido
+static uint8_t tarjeta(uint8_t mosi) {
+	if (sd.cs) return 0xFF;
+	if (sd.sal_pos < sd.sal_n) return sd.salida[sd.sal_pos++];
+	if (ahora_ns < sd.ocupada_hasta) return 0x00;
+
+	switch (sd.estado) {
+	case T_COMANDO:
+		if (sd.n_cmd == 0 && (mosi & 0xC0) != 0x40) return 0xFF;
+		sd.cmd[sd.n_cmd++] = mosi;
+		if (sd.n_cmd == 6) {
+			sd.n_cmd = 0;
+			ejecutar();
+		}
+		return 0xFF;
+	case T_ESPERA_TOKEN:
+		if (mosi == (sd.multi ? 0xFC : 0xFE)) {
+			sd.estado = T_RECIBIENDO;
+			sd.rx_n = 0;
+		} else if (sd.multi && mosi == 0xFD) {
+			sd.estado = T_COMANDO;
+			sd.ocupada_hasta = ahora_ns + PROGRAMA_NS;
+		}
+		return 0xFF;
+	case T_RECIBIENDO:
+		sd.bloque[sd.rx_n++] = mosi;
+		if (sd.rx_n < sizeof(sd.bloque)) return 0xFF;
+		sd.sal_pos = sd.sal_n = 0;
+		sd.estado = sd.multi ? T_ESPERA_TOKEN : T_COMANDO;
+		if (++sd.recibidos == sd.rechazar) {
+			uint8_t r = 0x0B;		// Error de CRC: no se escribe
+			responder(&r, 1);
+			return 0xFF;
+		}
+		VERIFICAR(pwrite(sd.fd, sd.bloque, SD_TAM_BLOQUE, (off_t)sd.lba * SD_TAM_BLOQUE) == SD_TAM_BLOQUE);
+		sd.lba++;
+		uint8_t r = 0x05;
+		responder(&r, 1);
+		sd.ocupada_hasta = ahora_ns + PROGRAMA_NS + (sd.recibidos % DEMORA_CADA == 0 ? DEMORA_NS : 0);
+		return 0xFF;
+	}
+	return 0xFF;
+}
+
+static void tarjeta_init(uint8_t v2, uint8_t sdhc) {
+	memset(&sd, 0, sizeof(sd));
+	sd.fd = open(IMAGEN, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	VERIFICAR(sd.fd >= 0);
+	VERIFICAR(ftruncate(sd.fd, (off_t)(SD_LOG_LBA_INICIO + 1 + SD_LOG_MAX_BLOQUES) * SD_TAM_BLOQUE) == 0);
+	sd.v2 = v2;
+	sd.sdhc = sdhc;
+	sd.cs = 1;
+	sd.acmd41_restantes = 20;
+}
+
+// --- SSP0 ---
+
+static struct {
+	uint32_t cr0, cpsr, dmacr;
+	uint8_t rx[8];
+	uint32_t rx_ini, rx_n;
+	uint64_t bytes;
+} ssp;
+
+static void ssp_byte(uint32_t mosi) {
+	uint32_t pclk = SystemCoreClock / 4;	// PCLKSEL en 0
+	uint32_t scr = (ssp.cr0 >> 8) & 0xFF;
+	uint8_t miso = tarjeta((uint8_t)mosi);
+
+	ahora_ns += 8ULL * 1000000000ULL * ssp.cpsr * (scr + 1) / pclk;
+	ssp.bytes++;
+	if (ssp.rx_n < 8) ssp.rx[(ssp.rx_ini + ssp.rx_n++) % 8] = miso;	// Lleno: se pierde (ROR)
+}
+
+static uint32_t ssp_rx(void) {
+	if (ssp.rx_n == 0) return 0;
+	uint8_t b = ssp.rx[ssp.rx_ini];
+	ssp.rx_ini = (ssp.rx_ini + 1) % 8;
+	ssp.rx_n--;
+	return b;
+}
+
+static uint32_t ssp_leer(uint32_t dir) {
+	switch (dir - LPC_SSP0_BASE) {
+	case 0x00: return ssp.cr0;
+	case 0x08: return ssp_rx();
+	case 0x0C: return SSP_SR_TFE | SSP_SR_TNF | (ssp.rx_n ? SSP_SR_RNE : 0);
+	case 0x10: return ssp.cpsr;
+	case 0x24: return ssp.dmacr;
+	}
+	return 0;
+}
+
+static void ssp_escribir(uint32_t dir, uint32_t v) {
+	switch (dir - LPC_SSP0_BASE) {
+	case 0x00: ssp.cr0 = v; break;
+	case 0x08: ssp_byte(v); break;
+	case 0x10: ssp.cpsr = v; break;
+	case 0x24: ssp.dmacr = v; break;
+	}
+}
+
+static void gpio_escribir(uint32_t dir, uint32_t v) {
+	if (!(v & SD_CS)) return;
+	if (dir == (uint32_t)(uintptr_t)&LPC_GPIO0->FIOSET) sd.cs = 1;
+	if (dir == (uint32_t)(uintptr_t)&LPC_GPIO0->FIOCLR) sd.cs = 0;
+}
+
+// --- Escenarios ---
+
+typedef struct {
+	uint32_t bloques;
+	uint32_t perdidos;
+	uint32_t errores;
+	uint64_t ns;
+	uint32_t ultimo_t;
+	uint32_t gen;
+} resultado_t;
+
+static resultado_t *res;
+
+// Un paso del lazo principal: servicio, DMA e interrupcion
+static void paso(void) {
+	sd_log_service();
+	if (modelo_gpdma_avanzar() && modelo_gpdma_irq()) DMA_IRQHandler();
+	ahora_ns += LAZO_NS;
+}
+
+static void esperar_vacio(void) {
+	for (uint32_t i = 0; i < 20000 && sd_log_get_stats()->bloques_escritos * SD_REGS_BLOQUE < registros_arranque; i++) paso();
+}
+
+// Registra a 'tasa' registros por segundo (0 = un bloque por paso del lazo,
+// mas de lo que la tarjeta puede escribir)
+static void registrar(uint32_t n, uint32_t tasa, uint8_t completar) {
+	uint64_t proximo = ahora_ns, inicio = ahora_ns;
+	uint32_t escritos_antes = sd_log_get_stats()->bloques_escritos;
+
+	for (uint32_t i = 0; i < n; ) {
+		while (ahora_ns >= proximo && i < n) {
+			sd_log_append(FLOG_MUESTRA, (uint16_t)(res->ultimo_t * 7), 0, res->ultimo_t + 1);
+			res->ultimo_t++;
+			registros_arranque++;
+			i++;
+			if (tasa) proximo += 1000000000ULL / tasa;
+			else if (i % SD_REGS_BLOQUE == 0) break;
+		}
+		paso();
+	}
+	// Completa el ultimo bloque para que todo quede en la tarjeta
+	while (completar && registros_arranque % SD_REGS_BLOQUE) {
+		sd_log_append(FLOG_MUESTRA, (uint16_t)(res->ultimo_t * 7), 0, res->ultimo_t + 1);
+		res->ultimo_t++;
+		registros_arranque++;
+	}
+	if (completar) esperar_vacio();
+
+	const sd_stats_t *st = sd_log_get_stats();
+	res->bloques = st->bloques_escritos - escritos_antes;
+	res->perdidos = st->registros_perdidos;
+	res->errores = st->errores;
+	res->ns = ahora_ns - inicio;
+}
+
+// Recorre el log en el archivo: registros consecutivos desde t = 1
+static uint32_t verificar_imagen(void) {
+	uint8_t b[SD_TAM_BLOQUE];
+	const sd_bloque_t *bl = (const sd_bloque_t *)b;
+	uint32_t t = 0;
+
+	VERIFICAR(pread(sd.fd, b, sizeof(b), (off_t)SD_LOG_LBA_INICIO * SD_TAM_BLOQUE) == sizeof(b));
+	uint32_t gen = ((const uint32_t *)b)[1];
+	for (uint32_t seq = 0; ; seq++) {
+		VERIFICAR(pread(sd.fd, b, sizeof(b), (off_t)(SD_LOG_LBA_INICIO + 1 + seq) * SD_TAM_BLOQUE) == sizeof(b));
+		if (bl->magic != 0x4C44534DUL || bl->gen != gen || bl->seq != seq) break;
+		VERIFICAR(bl->n <= SD_REGS_BLOQUE);
+		for (uint32_t i = 0; i < bl->n; i++) {
+			VERIFICAR(bl->reg[i].t == t + 1);
+			VERIFICAR(bl->reg[i].valor == (uint16_t)(t * 7));
+			t++;
+		}
+	}
+	return t;
+}
+
+static void arrancar(void) {
+	modelo_gpdma_init();
+	dma_canal_init();
+	VERIFICAR(sd_log_init(0));
+	registros_arranque = 0;
+}
+
+static int correr(void (*fn)(void)) {
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		fn();
+		fflush(stdout);
+		_exit(0);
+	}
+	int estado;
+	waitpid(pid, &estado, 0);
+	return WIFEXITED(estado) ? WEXITSTATUS(estado) : 128 + WTERMSIG(estado);
+}
+
+// Escritura a la tasa de una auditoria acelerada, con demoras de la tarjeta
+static void hijo_tasa(void) {
+	arrancar();
+	registrar(3000, 200, 1);
+}
+
+// Reinicio: el log sigue en el bloque siguiente y la generacion se conserva
+static void hijo_reinicio(void) {
+	arrancar();
+	VERIFICAR(sd_log_get_stats()->bloques_escritos == 0);
+	registrar(1000, 200, 1);
+}
+
+static void hijo_caudal(void) {
+	arrancar();
+	registrar(20000 * SD_REGS_BLOQUE, 0, 0);	// 1 s simulado
+
+	// Entre demoras largas, y el promedio con una cada DEMORA_CADA bloques
+	uint32_t demoras = res->bloques / DEMORA_CADA;
+	double s = (res->ns - demoras * DEMORA_NS) / 1e9;
+	double pico = res->bloques * (double)SD_TAM_BLOQUE / s;
+	double promedio = DEMORA_CADA * (double)SD_TAM_BLOQUE / (DEMORA_CADA * SD_TAM_BLOQUE / pico + DEMORA_NS / 1e9);
+	printf("caudal: %.1f KB/s entre demoras (%u bloques, SPI a %.1f MHz), %.1f KB/s sostenido con %llu ms cada %u bloques\n",
+			pico / 1024, res->bloques, SystemCoreClock / 4 / (double)(ssp.cpsr * (((ssp.cr0 >> 8) & 0xFF) + 1)) / 1e6,
+			promedio / 1024, DEMORA_NS / 1000000, DEMORA_CADA);
+	printf("  = %.0f registros/s sostenidos\n", promedio / SD_TAM_BLOQUE * SD_REGS_BLOQUE);
+}
+
+static void escenario(const char *nombre, uint8_t v2, uint8_t sdhc, uint32_t rechazar) {
+	tarjeta_init(v2, sdhc);
+	sd.rechazar = rechazar;
+	memset(res, 0, sizeof(*res));
+
+	VERIFICAR(correr(hijo_tasa) == 0);
+	VERIFICAR(res->perdidos == 0);
+	VERIFICAR(res->errores == (rechazar ? 1 : 0));
+	VERIFICAR(verificar_imagen() == res->ultimo_t);
+	uint64_t ns = res->ns;
+
+	VERIFICAR(correr(hijo_reinicio) == 0);
+	VERIFICAR(res->perdidos == 0);
+	VERIFICAR(verificar_imagen() == res->ultimo_t);
+	printf("%s: %u registros en %.1f s simulados, sin perdidas, verificado tras reiniciar\n",
+			nombre, res->ultimo_t, (ns + res->ns) / 1e9);
+	close(sd.fd);
+}
+
+int main(void) {
+	anfitrion_init();
+	anfitrion_periferico(LPC_SSP0_BASE, 0x1000, ssp_leer, ssp_escribir);
+	anfitrion_periferico(LPC_GPIO_BASE, 0x1000, NULL, gpio_escribir);
+	modelo_gpdma_conectar((uint32_t)(uintptr_t)&LPC_SSP0->DR, ssp_rx, ssp_byte);
+	res = mmap(NULL, sizeof(*res), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	VERIFICAR(res != MAP_FAILED);
+
+	escenario("SDHC", 1, 1, 0);
+	escenario("SDSC v1 (direccion por byte)", 0, 0, 0);
+	escenario("SDHC con un bloque rechazado", 1, 1, 17);
+
+	tarjeta_init(1, 1);
+	memset(res, 0, sizeof(*res));
+	VERIFICAR(correr(hijo_caudal) == 0);
+	printf("  sin perdidas mientras se registre a menos de %.0f registros/s (%u por bloque doble buffer)\n",
+			SD_REGS_BLOQUE / (DEMORA_NS / 1e9), SD_REGS_BLOQUE);
+
+	close(sd.fd);
+	unlink(IMAGEN);
+	printf("sd_log: OK\n");
+	return 0;
+}
@@ -0,0 +1,87 @@
+// --- Prueba de sensor.c: umbrales en codigos del ADC ---
+// La interrupcion del ADC compara el codigo crudo contra umbrales calculados
+// con ppm_to_adc_threshold, y la conversion a ppm se hace despues en PendSV.
+// Para una grilla de calibraciones (R0, RL) verifica, en los 4096 codigos:
+//   - que convert_adc_to_ppm es creciente (condicion para que exista el umbral)
+//   - que (raw >= umbral) coincide con (convert(raw) >= ppm) para cada nivel
+//   - que el umbral de convert(raw) no pasa de raw, y es raw justo donde la
+//     conversion sube
+//   - que las bandas de histeresis quedan por debajo del nivel que cierran
+// Reporta el costo en la PC de una conversion frente a una comparacion entera.
+
+#include "anfitrion.h"
+#include "sensor.h"
+
+#define NUM_CODIGOS		4096
+// Mismos niveles que main.c
+#define PRECAUCION_PPM	25
+#define CRITICO_PPM		200
+#define HISTERESIS_PPM	3
+
+static const float r0s[] = { 1.0f, 10.0f, R0_SENSOR, 200.0f, 655.35f };
+static const float rls[] = { 1.0f, 10.0f, RL_SENSOR, 100.0f, 1000.0f };
+static const uint16_t niveles[] = { 0, 1, 2, PRECAUCION_PPM - HISTERESIS_PPM, PRECAUCION_PPM,
+		CRITICO_PPM - HISTERESIS_PPM, CRITICO_PPM, 1000, 65535 };
+
+#define N(a)	(sizeof(a) / sizeof((a)[0]))
+
+static uint16_t ppm[NUM_CODIGOS];
+
+static void verificar_calibracion(void) {
+	for (uint32_t c = 0; c < NUM_CODIGOS; c++) {
+		ppm[c] = convert_adc_to_ppm(c);
+		if (c > 0) VERIFICAR(ppm[c] >= ppm[c - 1]);
+	}
+
+	for (uint32_t n = 0; n < N(niveles); n++) {
+		uint16_t umbral = ppm_to_adc_threshold(niveles[n]);
+		VERIFICAR(umbral <= NUM_CODIGOS);
+		for (uint32_t c = 0; c < NUM_CODIGOS; c++)
+			VERIFICAR((c >= umbral) == (ppm[c] >= niveles[n]));
+	}
+
+	for (uint32_t c = 0; c < NUM_CODIGOS; c++) {
+		uint16_t umbral = ppm_to_adc_threshold(ppm[c]);
+		VERIFICAR(umbral <= c);
+		if (c == 0 || ppm[c - 1] < ppm[c]) VERIFICAR(umbral == c);
+	}
+
+	VERIFICAR(ppm_to_adc_threshold(PRECAUCION_PPM - HISTERESIS_PPM) <= ppm_to_adc_threshold(PRECAUCION_PPM));
+	VERIFICAR(ppm_to_adc_threshold(CRITICO_PPM - HISTERESIS_PPM) <= ppm_to_adc_threshold(CRITICO_PPM));
+	VERIFICAR(ppm_to_adc_threshold(PRECAUCION_PPM) <= ppm_to_adc_threshold(CRITICO_PPM - HISTERESIS_PPM));
+}
+
+int main(void) {
+	uint32_t calibraciones = 0;
+	for (uint32_t i = 0; i < N(r0s); i++) {
+		for (uint32_t j = 0; j < N(rls); j++) {
+			r0_sensor = r0s[i];
+			rl_sensor = rls[j];
+			verificar_calibracion();
+			calibraciones++;
+		}
+	}
+	printf("%u calibraciones x %u codigos: umbral en codigos equivalente a comparar en ppm\n",
+			calibraciones, NUM_CODIGOS);
+
+	// Calibracion por defecto: bandas de main.c
+	r0_sensor = R0_SENSOR;
+	rl_sensor = RL_SENSOR;
+	printf("umbrales por defecto: precaucion %u (baja en %u), critico %u (baja en %u)\n",
+			ppm_to_adc_threshold(PRECAUCION_PPM), ppm_to_adc_threshold(PRECAUCION_PPM - HISTERESIS_PPM),
+			ppm_to_adc_threshold(CRITICO_PPM), ppm_to_adc_threshold(CRITICO_PPM - HISTERESIS_PPM));
+
+	// Costo por muestra en la PC (con FPU; en el Cortex-M3 pow es por software)
+	volatile uint32_t acumulado = 0;
+	uint16_t umbral = ppm_to_adc_threshold(CRITICO_PPM);
+	uint64_t t0 = anfitrion_ciclos();
+	for (uint32_t c = 0; c < NUM_CODIGOS; c++) acumulado += convert_adc_to_ppm(c);
+	uint64_t t1 = anfitrion_ciclos();
+	for (uint32_t c = 0; c < NUM_CODIGOS; c++) acumulado += (*(volatile uint16_t *)&umbral <= c);
+	uint64_t t2 = anfitrion_ciclos();
+	printf("por muestra en la PC: conversion %.1f ciclos, comparacion entera %.1f ciclos\n",
+			(double)(t1 - t0) / NUM_CODIGOS, (double)(t2 - t1) / NUM_CODIGOS);
+
+	printf("sensor: OK\n");
+	return 0;
+}
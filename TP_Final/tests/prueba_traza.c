@@ -0,0 +1,277 @@
+// --- Prueba de traza.h (atomicos de C11) y de tools/traza.py ---
+// En la PC la marca es el TSC (anfitrion/lpc17xx.h) y traza_evento reserva
+// con el CAS de atomico.h. Verifica:
+//   - una secuencia de interrupciones anidadas (TIMER0 expropiado por el ADC,
+//     y este por el SysTick; PendSV con cambios de alarma) que da mas de una
+//     vuelta al buffer: el buffer tiene los ultimos TRAZA_EVENTOS en orden
+//   - traza.py sobre ese volcado, con las marcas corridas para que el
+//     contador de 32 bits desborde a mitad del buffer: los sobrescritos, los
+//     bloques B/E anidados, los instantaneos y el contador de alarma, una
+//     salida sin su entrada (anterior al buffer) descartada y los tiempos
+//   - HILOS hilos registrando a la vez: no se pierde ni se repite ninguna
+//     posicion y el orden del buffer es el orden de las marcas (en una PC de
+//     un nucleo la expropiacion justo dentro de la reserva es rara)
+// Informa ciclos por evento en la PC, medidos de afuera y por traza_init().
+
+#include "anfitrion.h"
+#include "traza.h"
+#include <libgen.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VUELTAS			700
+#define MEDICIONES		1000000
+#define HILOS			4
+#define RONDAS			20
+#define EVENTOS_HILO	200000
+
+#define EXC_PENDSV		14
+#define EXC_SYSTICK		15
+#define EXC_TIMER0		17
+#define EXC_ADC			38
+
+// Lo registrado, en orden, para compararlo con el buffer
+typedef struct {
+	uint8_t tipo, id;
+	uint16_t dato;
+} registrado_t;
+
+static registrado_t registrados[VUELTAS * 16];
+static uint32_t n_registrados;
+
+static void evento(uint8_t tipo, uint8_t id, uint16_t dato) {
+	traza_evento(tipo, id, dato);
+	registrados[n_registrados++] = (registrado_t){ tipo, id, dato };
+}
+
+// Lo que hacen los manejadores, con la expropiacion simulada en un hilo
+static void secuencia(void) {
+	for (uint32_t k = 0; k < VUELTAS; k++) {
+		evento(TRAZA_IRQ_ENTRA, EXC_TIMER0, 0);
+		evento(TRAZA_COLA, 1, k);
+		if (k % 3 == 0) {
+			evento(TRAZA_IRQ_ENTRA, EXC_ADC, 0);
+			if (k % 9 == 0) {
+				evento(TRAZA_IRQ_ENTRA, EXC_SYSTICK, 0);
+				evento(TRAZA_IRQ_SALE, EXC_SYSTICK, 0);
+			}
+			evento(TRAZA_DMA, 2, k % 4 == 0);
+			evento(TRAZA_IRQ_SALE, EXC_ADC, 0);
+		}
+		evento(TRAZA_UART, 2, 16);
+		evento(TRAZA_IRQ_SALE, EXC_TIMER0, 0);
+		if (k % 5 == 0) {
+			evento(TRAZA_IRQ_ENTRA, EXC_PENDSV, 0);
+			if (k % 10 == 0) evento(TRAZA_ALARMA, 0, k % 3);
+			evento(TRAZA_IRQ_SALE, EXC_PENDSV, 0);
+		}
+	}
+}
+
+static const char *nombre_exc(uint8_t id) {
+	switch (id) {
+	case EXC_PENDSV: return "PendSV";
+	case EXC_SYSTICK: return "SysTick";
+	case EXC_TIMER0: return "TIMER0";
+	case EXC_ADC: return "ADC";
+	}
+	return "?";
+}
+
+// La salida esperada de traza.py para los ultimos eventos: 'ph\tnombre'
+typedef struct {
+	char ph[4];
+	char nombre[32];
+	uint32_t t;
+} esperado_t;
+
+static esperado_t esperados[2 * TRAZA_EVENTOS + 1];
+static uint32_t n_esperados, descartadas, anidadas;
+
+static void esperar(const char *ph, const char *nombre, uint32_t t) {
+	esperado_t *e = &esperados[n_esperados++];
+	snprintf(e->ph, sizeof(e->ph), "%s", ph);
+	snprintf(e->nombre, sizeof(e->nombre), "%s", nombre);
+	e->t = t;
+}
+
+static void calcular_esperados(uint32_t desfase) {
+	static const char *const estados[] = { "seguro", "precaucion", "critico" };
+	uint8_t abiertos[8];
+	uint32_t profundidad = 0;
+	char nombre[32];
+
+	esperar("M", "thread_name", 0);
+	for (uint32_t i = n_registrados - TRAZA_EVENTOS; i < n_registrados; i++) {
+		const registrado_t *r = &registrados[i];
+		uint32_t t = traza.ev[i & (TRAZA_EVENTOS - 1)].t - desfase;
+		switch (r->tipo) {
+		case TRAZA_IRQ_ENTRA:
+			if (profundidad > 0) anidadas++;
+			abiertos[profundidad++] = r->id;
+			esperar("B", nombre_exc(r->id), t);
+			break;
+		case TRAZA_IRQ_SALE:
+			if (profundidad == 0) {
+				descartadas++;
+				break;
+			}
+			VERIFICAR(abiertos[--profundidad] == r->id);
+			esperar("E", nombre_exc(r->id), t);
+			break;
+		case TRAZA_COLA:
+			esperar("i", "cola muestra", t);
+			break;
+		case TRAZA_UART:
+			esperar("i", "UART2", t);
+			break;
+		case TRAZA_DMA:
+			esperar("i", r->dato ? "DMA2 error" : "DMA2 fin", t);
+			break;
+		case TRAZA_ALARMA:
+			esperar("C", "alarma", t);
+			snprintf(nombre, sizeof(nombre), "alarma %s", estados[r->dato]);
+			esperar("i", nombre, t);
+			break;
+		}
+	}
+}
+
+// Corre traza.py sobre el volcado y compara su JSON, aplanado por un
+// python -c a 'ph\tnombre\tts' por linea, con lo esperado
+static void verificar_traza_py(const char *dir, uint32_t desfase) {
+	char ruta[300], orden[1200], linea[200];
+	snprintf(ruta, sizeof(ruta), "%s/traza.bin", dir);
+	FILE *f = fopen(ruta, "wb");
+	VERIFICAR(f != NULL);
+	VERIFICAR(fwrite(&traza, sizeof(traza), 1, f) == 1);
+	fclose(f);
+
+	snprintf(orden, sizeof(orden), "python3 %s/../../tools/traza.py %s -o %s/traza.json", dir, ruta, dir);
+	FILE *p = popen(orden, "r");
+	VERIFICAR(p != NULL);
+	VERIFICAR(fgets(linea, sizeof(linea), p) != NULL);
+	VERIFICAR(pclose(p) == 0);
+	char resumen[200];
+	snprintf(resumen, sizeof(resumen), "%u eventos (%u sobrescritos), 100.0 MHz, %u ciclos por evento -> %s/traza.json\n",
+			TRAZA_EVENTOS, n_registrados - TRAZA_EVENTOS, traza.ciclos_evento, dir);
+	if (strcmp(linea, resumen) != 0) {
+		printf("obtenido: %sesperado: %s", linea, resumen);
+		VERIFICAR(0);
+	}
+
+	snprintf(orden, sizeof(orden), "python3 -c 'import json, sys\n"
+			"for e in json.load(open(sys.argv[1]))[\"traceEvents\"]:\n"
+			"    print(\"%%s\\t%%s\\t%%.6f\" %% (e[\"ph\"], e[\"name\"], e.get(\"ts\", 0)))' %s/traza.json", dir);
+	p = popen(orden, "r");
+	VERIFICAR(p != NULL);
+	uint32_t i = 0;
+	char ph[4], nombre[32];
+	double ts, anterior = 0;
+	uint32_t t0 = traza.ev[n_registrados & (TRAZA_EVENTOS - 1)].t - desfase;
+	while (fgets(linea, sizeof(linea), p) != NULL) {
+		VERIFICAR(sscanf(linea, "%3[^\t]\t%31[^\t]\t%lf", ph, nombre, &ts) == 3);
+		VERIFICAR(i < n_esperados);
+		if (strcmp(ph, esperados[i].ph) != 0 || strcmp(nombre, esperados[i].nombre) != 0) {
+			printf("evento %u: '%s %s', esperado '%s %s'\n", i, ph, nombre, esperados[i].ph, esperados[i].nombre);
+			VERIFICAR(0);
+		}
+		// Tiempos desde el primer evento del buffer, a traves del desborde
+		if (i > 0) {
+			VERIFICAR(fabs(ts - (esperados[i].t - t0) * 1e6 / traza.hz) < 1e-5);
+			VERIFICAR(ts >= anterior);
+			anterior = ts;
+		}
+		i++;
+	}
+	VERIFICAR(pclose(p) == 0);
+	VERIFICAR(i == n_esperados);
+}
+
+// --- Varios hilos a la vez ---
+static void *registrar(void *arg) {
+	uint8_t hilo = (uint8_t)(uintptr_t)arg;
+	for (uint32_t i = 0; i < EVENTOS_HILO; i++) traza_evento(TRAZA_COLA, hilo, (uint16_t)i);
+	return NULL;
+}
+
+static uint64_t con_hilos(void) {
+	uint64_t ciclos = 0;
+	for (uint32_t ronda = 0; ronda < RONDAS; ronda++) {
+		pthread_t hilos[HILOS];
+		traza_init();
+		uint64_t t0 = anfitrion_ciclos();
+		for (uintptr_t h = 0; h < HILOS; h++) VERIFICAR(pthread_create(&hilos[h], NULL, registrar, (void *)h) == 0);
+		for (uint32_t h = 0; h < HILOS; h++) pthread_join(hilos[h], NULL);
+		ciclos += anfitrion_ciclos() - t0;
+
+		// Ninguna reserva perdida; en el buffer, marcas crecientes y cada
+		// hilo con sus ultimos eventos consecutivos
+		uint32_t escritos = atomico_leer(&traza.escritos);
+		VERIFICAR(escritos == HILOS * EVENTOS_HILO);
+		int32_t ultimo[HILOS];
+		for (uint32_t h = 0; h < HILOS; h++) ultimo[h] = -1;
+		for (uint32_t i = escritos - TRAZA_EVENTOS; i < escritos; i++) {
+			const traza_evento_t *e = &traza.ev[i & (TRAZA_EVENTOS - 1)];
+			VERIFICAR(e->tipo == TRAZA_COLA && e->id < HILOS);
+			if (i > escritos - TRAZA_EVENTOS) VERIFICAR((int32_t)(e->t - traza.ev[(i - 1) & (TRAZA_EVENTOS - 1)].t) >= 0);
+			if (ultimo[e->id] >= 0) VERIFICAR(e->dato == (uint16_t)(ultimo[e->id] + 1));
+			ultimo[e->id] = e->dato;
+		}
+		for (uint32_t h = 0; h < HILOS; h++) VERIFICAR(ultimo[h] < 0 || ultimo[h] == (uint16_t)(EVENTOS_HILO - 1));
+	}
+	return ciclos;
+}
+
+int main(void) {
+	char ejecutable[256];
+	ssize_t largo = readlink("/proc/self/exe", ejecutable, sizeof(ejecutable) - 1);
+	VERIFICAR(largo > 0);
+	ejecutable[largo] = 0;
+	const char *dir = dirname(ejecutable);
+
+	// 1. Secuencia anidada, mas de una vuelta
+	traza_init();
+	VERIFICAR(traza.magia == TRAZA_MAGIA && traza.activo && atomico_leer(&traza.escritos) == 0);
+	secuencia();
+	VERIFICAR(atomico_leer(&traza.escritos) == n_registrados && n_registrados > 2 * TRAZA_EVENTOS);
+	for (uint32_t i = n_registrados - TRAZA_EVENTOS; i < n_registrados; i++) {
+		const traza_evento_t *e = &traza.ev[i & (TRAZA_EVENTOS - 1)];
+		VERIFICAR(e->tipo == registrados[i].tipo && e->id == registrados[i].id && e->dato == registrados[i].dato);
+		if (i > n_registrados - TRAZA_EVENTOS) VERIFICAR((int32_t)(e->t - traza.ev[(i - 1) & (TRAZA_EVENTOS - 1)].t) >= 0);
+	}
+	traza_detener();
+	traza_evento(TRAZA_COLA, 1, 0);
+	VERIFICAR(atomico_leer(&traza.escritos) == n_registrados);
+	printf("%u eventos anidados en un buffer de %u: los ultimos, en orden; detenida no registra\n",
+			n_registrados, TRAZA_EVENTOS);
+
+	// 2. traza.py, con el contador de 32 bits desbordando a mitad del buffer
+	uint32_t desfase = traza.ev[(n_registrados + TRAZA_EVENTOS / 2) & (TRAZA_EVENTOS - 1)].t;
+	for (uint32_t i = 0; i < TRAZA_EVENTOS; i++) traza.ev[i].t -= desfase;
+	calcular_esperados(desfase);
+	VERIFICAR(anidadas > 0 && descartadas > 0);
+	verificar_traza_py(dir, desfase);
+	printf("traza.py: %u sobrescritos, %u bloques anidados, %u salidas sin entrada descartadas, "
+			"tiempos a traves del desborde\n", n_registrados - TRAZA_EVENTOS, anidadas, descartadas);
+
+	// 3. Costo por evento
+	traza_init();
+	uint64_t t0 = anfitrion_ciclos();
+	for (uint32_t i = 0; i < MEDICIONES; i++) traza_evento(TRAZA_COLA, 1, (uint16_t)i);
+	uint64_t t1 = anfitrion_ciclos();
+	traza_detener();
+	for (uint32_t i = 0; i < MEDICIONES; i++) traza_evento(TRAZA_COLA, 1, (uint16_t)i);
+	uint64_t t2 = anfitrion_ciclos();
+	uint64_t hilos = con_hilos();
+	printf("%u hilos x %u eventos, %u rondas: ninguna posicion perdida ni repetida, en orden\n",
+			HILOS, EVENTOS_HILO, RONDAS);
+	printf("ciclos por evento en la PC: %.1f (traza_init: %u), detenida %.1f, con %u hilos %.1f\n",
+			(double)(t1 - t0) / MEDICIONES, traza.ciclos_evento, (double)(t2 - t1) / MEDICIONES,
+			HILOS, (double)hilos / RONDAS / HILOS / EVENTOS_HILO);
+
+	printf("traza: OK\n");
+	return 0;
+}
@@ -0,0 +1,162 @@
+// --- Prueba de ventana.h: doble buffer con seqlock, con hilos ---
+// atomico.h compila en la PC con los atomicos de C11, asi que el mismo codigo
+// que corre en la interrupcion del ADC y en calc_average_ppm se ejercita con
+// hilos reales:
+//   - un hilo escritor hace de interrupcion del ADC y agrega muestras sin
+//     parar; cada muestra lleva el numero de ventana y su posicion en ella
+//   - varios hilos lectores leen la ventana publicada con una demora por
+//     muestra (la conversion a ppm) y verifican que toda instantanea aceptada
+//     es una sola ventana completa, justo la publicada con el seq leido, y
+//     que no retroceden. Con un solo nucleo los hilos se desalojan entre si,
+//     como la interrupcion desaloja al lector en el micro
+// Antes, con un solo hilo, se intercala el escritor a mitad de una lectura
+// para verificar que ventana_reintentar detecta exactamente los casos en los
+// que la ventana leida pudo reescribirse.
+
+#include "anfitrion.h"
+#include "ventana.h"
+#include <pthread.h>
+#include <time.h>
+
+#define LECTORES		3
+#define VENTANAS		2000000		// Ventanas que publica el escritor
+#define DEMORA_MUESTRA	20			// Vueltas por muestra leida (conversion)
+
+#define MUESTRA(k, i)	((uint16_t)((((k) & 0xFFF) << 4) | (i)))
+#define VENTANA_DE(m)	((m) >> 4)
+#define POSICION_DE(m)	((m) & 0xF)
+
+static ventana_t ventana = VENTANA_INIT(ventana);
+static atomico_u32_t fin;
+static uint32_t desfase;		// Publicaciones anteriores a la ventana 0 de los hilos
+
+typedef struct {
+	uint64_t leidas;
+	uint64_t reintentos;
+	uint64_t rotas;				// Instantaneas aceptadas que mezclan ventanas
+	uint64_t retrocesos;
+	uint64_t desfasadas;		// La ventana no es la publicada con ese seq
+	uint64_t ns;
+} lector_t;
+
+static uint64_t ahora_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void agregar_ventana(uint32_t k) {
+	for (uint32_t i = 0; i < VENTANA_MUESTRAS; i++)
+		VERIFICAR(ventana_agregar(&ventana, MUESTRA(k, i)) == (i == VENTANA_MUESTRAS - 1));
+}
+
+// Copia la ventana como calc_average_ppm: muestra por muestra, con demora
+static void leer(const volatile uint16_t *p, uint16_t *copia) {
+	for (uint32_t i = 0; i < VENTANA_MUESTRAS; i++) {
+		copia[i] = p[i];
+		for (volatile uint32_t d = 0; d < DEMORA_MUESTRA; d++);
+	}
+}
+
+// Numero de ventana si la copia es una sola ventana completa, o -1
+static int32_t ventana_entera(const uint16_t *copia) {
+	for (uint32_t i = 0; i < VENTANA_MUESTRAS; i++) {
+		if (POSICION_DE(copia[i]) != i || VENTANA_DE(copia[i]) != VENTANA_DE(copia[0])) return -1;
+	}
+	return VENTANA_DE(copia[0]);
+}
+
+static void *escritor(void *arg) {
+	(void)arg;
+	for (uint32_t k = 1; k <= VENTANAS; k++) agregar_ventana(k);
+	atomico_escribir(&fin, 1);
+	return NULL;
+}
+
+static void *lector(void *arg) {
+	lector_t *l = arg;
+	uint16_t copia[VENTANA_MUESTRAS];
+	uint32_t anterior = 0;
+	uint64_t t0 = ahora_ns();
+
+	while (!atomico_leer(&fin)) {
+		uint32_t seq;
+		int32_t k;
+		do {
+			leer(ventana_leer_inicio(&ventana, &seq), copia);
+			l->reintentos++;
+		} while (ventana_reintentar(&ventana, seq));
+		l->reintentos--;
+		l->leidas++;
+
+		if ((k = ventana_entera(copia)) < 0) {
+			l->rotas++;
+			continue;
+		}
+		// Cada publicacion suma 2 al seq: la instantanea debe ser justo la
+		// ventana publicada en ese momento, y nunca una anterior a la ya leida
+		if (((seq / 2 - desfase - k) & 0xFFF) != 0) l->desfasadas++;
+		if (seq < anterior) l->retrocesos++;
+		anterior = seq;
+	}
+	l->ns = ahora_ns() - t0;
+	return NULL;
+}
+
+// Un solo hilo: el escritor agrega 'n' muestras entre el inicio y el fin de
+// la lectura; devuelve lo que dice ventana_reintentar
+static uint8_t intercalar(uint32_t n, uint16_t *copia) {
+	static uint32_t k = 100;	// Cada llamada escribe otra ventana
+	uint32_t seq;
+	const volatile uint16_t *p = ventana_leer_inicio(&ventana, &seq);
+	k++;
+	for (uint32_t i = 0; i < n; i++) ventana_agregar(&ventana, MUESTRA(k, ventana.idx));
+	leer(p, copia);
+	return ventana_reintentar(&ventana, seq);
+}
+
+int main(void) {
+	uint16_t copia[VENTANA_MUESTRAS];
+
+	// Determinista: con la escritura a mitad de la ventana siguiente
+	agregar_ventana(0);
+	for (uint32_t i = 0; i < VENTANA_MUESTRAS / 2; i++) ventana_agregar(&ventana, MUESTRA(1, i));
+	VERIFICAR(intercalar(0, copia) == 0 && ventana_entera(copia) == 0);
+	// Completar la ventana en curso publica otra: la leida pasa a escribirse
+	VERIFICAR(intercalar(VENTANA_MUESTRAS - VENTANA_MUESTRAS / 2 - 1, copia) == 0 && ventana_entera(copia) == 0);
+	VERIFICAR(intercalar(1, copia) == 1);
+	// Sin publicar, el escritor solo toca la otra ventana
+	VERIFICAR(intercalar(VENTANA_MUESTRAS - 1, copia) == 0);
+	// Se publica y se reescribe en parte la ventana leida: la copia sale rota
+	VERIFICAR(intercalar(1 + VENTANA_MUESTRAS / 2, copia) == 1 && ventana_entera(copia) < 0);
+	printf("intercalado: la lectura se repite si y solo si se publico una ventana durante ella\n");
+	while (ventana.idx != 0) ventana_agregar(&ventana, MUESTRA(0, ventana.idx));
+	agregar_ventana(0);
+	desfase = atomico_leer(&ventana.seq.seq) / 2;
+
+	// Con hilos
+	pthread_t e, h[LECTORES];
+	lector_t l[LECTORES] = {0};
+	for (int i = 0; i < LECTORES; i++) VERIFICAR(pthread_create(&h[i], NULL, lector, &l[i]) == 0);
+	uint64_t t0 = ahora_ns();
+	VERIFICAR(pthread_create(&e, NULL, escritor, NULL) == 0);
+	pthread_join(e, NULL);
+	uint64_t escritura_ns = ahora_ns() - t0;
+	uint64_t leidas = 0, reintentos = 0;
+	for (int i = 0; i < LECTORES; i++) {
+		pthread_join(h[i], NULL);
+		VERIFICAR(l[i].rotas == 0);
+		VERIFICAR(l[i].retrocesos == 0);
+		VERIFICAR(l[i].desfasadas == 0);
+		VERIFICAR(l[i].leidas > 0);
+		leidas += l[i].leidas;
+		reintentos += l[i].reintentos;
+	}
+	printf("%u ventanas publicadas (%.0f ns por muestra), %d lectores: %llu instantaneas, ninguna rota, desfasada ni vieja\n",
+			VENTANAS, (double)escritura_ns / VENTANAS / VENTANA_MUESTRAS, LECTORES, (unsigned long long)leidas);
+	printf("reintentos: %llu (%.4f por lectura; el escritor publica sin pausa, en el micro es 1 muestra/s)\n",
+			(unsigned long long)reintentos, (double)reintentos / leidas);
+
+	printf("ventana: OK\n");
+	return 0;
+}
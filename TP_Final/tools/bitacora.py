@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""Decodifica la bitacora binaria del monitor de CO (src/bitacora.h).
+
+El firmware solo envia, por cada llamada a BITACORA(), el numero de la
+llamada, tiempo_us() (como diferencia con la trama anterior, y completo de
+vez en cuando) y los argumentos en binario. El texto de formato, el
+archivo y la linea estan en la seccion 'bitacora_fmt' del .axf: este
+programa la lee y reconstruye los mensajes.
+
+La captura se toma de la UART3 de diagnostico (115200 8N1), por ejemplo:
+
+    stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 > bitacora.bin
+
+Salida: una linea por mensaje, '<segundos> <archivo>:<linea> <texto>', y al
+final los bytes recibidos frente a los que ocuparia el mismo texto. Los
+mensajes sin hora cierta (al principio de la captura, o despues de bytes
+descartados, hasta la proxima trama con el tiempo completo) llevan '?'.
+
+Uso: bitacora.py CAPTURA [--elf Debug/TP_Final.axf] [--tabla]
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+AQUI = os.path.dirname(os.path.abspath(__file__))
+SINCRO = 0xA5       # Diferencia de tiempo
+SINCRO_ABS = 0xA6   # Tiempo completo
+SECCION = 'bitacora_fmt'
+# Codigo de tipo (bitacora.h) -> nombre para --tabla
+TIPOS = {1: 'B', 2: 'H', 3: 'I', 4: 'b', 5: 'h', 6: 'i'}
+U8, I8 = 1, 4
+CON_SIGNO = (5, 6)  # En zigzag
+ESPECIFICADOR = re.compile(r'%([-0 #+]*\d*)([udxXc%])')
+
+
+class Elf:
+    """Lo justo de un ELF little endian (32 o 64 bits) para leer secciones."""
+
+    def __init__(self, ruta):
+        with open(ruta, 'rb') as f:
+            self.datos = f.read()
+        d = self.datos
+        if d[:4] != b'\x7fELF' or d[5] != 1:
+            sys.exit('%s: no es un ELF little endian' % ruta)
+        self.bits64 = d[4] == 2
+        if self.bits64:
+            shoff, = struct.unpack_from('<Q', d, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', d, 0x3A)
+            formato = '<IIQQQQIIQQ'
+        else:
+            shoff, = struct.unpack_from('<I', d, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', d, 0x2E)
+            formato = '<IIIIIIIIII'
+        crudas = [struct.unpack_from(formato, d, shoff + i * shentsize) for i in range(shnum)]
+        # (nombre, tipo, flags, addr, offset, size)
+        nombres = crudas[shstrndx][4]
+        self.secciones = []
+        for s in crudas:
+            fin = d.index(b'\0', nombres + s[0])
+            self.secciones.append((d[nombres + s[0]:fin].decode(), s[1], s[2], s[3], s[4], s[5]))
+
+    def seccion(self, nombre):
+        for n, tipo, _, addr, off, tam in self.secciones:
+            if n == nombre:
+                return addr, self.datos[off:off + tam]
+        return None
+
+    def texto(self, dir_):
+        """Cadena C en la direccion de memoria dir_ (secciones con contenido)."""
+        for _, tipo, flags, addr, off, tam in self.secciones:
+            if tipo != 8 and flags & 2 and addr <= dir_ < addr + tam:   # No NOBITS, SHF_ALLOC
+                i = off + dir_ - addr
+                return self.datos[i:self.datos.index(b'\0', i)].decode(errors='replace')
+        return '?0x%x' % dir_
+
+
+def leer_tabla(ruta):
+    elf = Elf(ruta)
+    sec = elf.seccion(SECCION)
+    if sec is None:
+        sys.exit('%s: sin seccion %s (APP_USE_BITACORA en 0?)' % (ruta, SECCION))
+    entrada = struct.Struct('<QQHHI' if elf.bits64 else '<IIHHI')
+    tabla = []
+    for i in range(len(sec[1]) // entrada.size):
+        formato, archivo, linea, _, tipos = entrada.unpack_from(sec[1], i * entrada.size)
+        codigos = []
+        while tipos & 0xF:
+            codigos.append(tipos & 0xF)
+            tipos >>= 4
+        tabla.append((elf.texto(formato), os.path.basename(elf.texto(archivo)), linea, codigos))
+    return tabla
+
+
+def formatear(formato, args):
+    """Aplica un formato de C con %u %d %x %c (y ancho) a los argumentos."""
+    args = list(args)
+
+    def reemplazar(m):
+        if m.group(2) == '%':
+            return '%'
+        conv = 'd' if m.group(2) == 'u' else m.group(2)
+        v = args.pop(0)
+        if m.group(2) in 'uxX' and v < 0:
+            v &= 0xFFFFFFFF     # Como en C: el argumento se toma sin signo
+        return ('%' + m.group(1) + conv) % v
+    texto = ESPECIFICADOR.sub(reemplazar, formato)
+    if args:
+        raise ValueError('sobran argumentos')
+    return texto
+
+
+def verificar(tabla):
+    """Cantidad de especificadores contra la de argumentos de cada llamada."""
+    errores = 0
+    for i, (formato, archivo, linea, codigos) in enumerate(tabla):
+        n = len([m for m in ESPECIFICADOR.finditer(formato) if m.group(2) != '%'])
+        if n != len(codigos):
+            print('%s:%d: "%s" espera %d argumentos y recibe %d' % (archivo, linea, formato, n, len(codigos)),
+                  file=sys.stderr)
+            errores += 1
+    return errores
+
+
+class TramaInvalida(Exception):
+    pass
+
+
+def varint(datos, i):
+    """(valor, indice siguiente) de un varint de hasta 32 bits en datos[i:]."""
+    v = 0
+    for k in range(5):
+        b = datos[i + k]    # IndexError: la trama sigue despues de la captura
+        v |= (b & 0x7F) << (7 * k)
+        if not b & 0x80:
+            if v > 0xFFFFFFFF:
+                raise TramaInvalida
+            return v, i + k + 1
+    raise TramaInvalida
+
+
+def trama(datos, i, tabla):
+    """Decodifica la trama en datos[i]: (absoluto, tiempo, id, args, fin)."""
+    absoluto = datos[i] == SINCRO_ABS
+    id_, j = varint(datos, i + 1)
+    if id_ >= len(tabla):
+        raise TramaInvalida
+    if absoluto:
+        if j + 4 > len(datos):
+            raise IndexError
+        t, = struct.unpack_from('<I', datos, j)
+        j += 4
+    else:
+        t, j = varint(datos, j)
+    args = []
+    for c in tabla[id_][3]:
+        if c in (U8, I8):
+            v = datos[j]
+            j += 1
+            if c == I8 and v >= 0x80:
+                v -= 0x100
+        else:
+            v, j = varint(datos, j)
+            if c in CON_SIGNO:
+                v = (v >> 1) ^ -(v & 1)
+        args.append(v)
+    if sum(datos[i:j]) & 0xFF != datos[j]:
+        raise TramaInvalida
+    return absoluto, t, id_, args, j + 1
+
+
+def decodificar(datos, tabla):
+    """Genera (t_us extendido o None si no es cierto, sitio, texto) y cuenta
+    las tramas descartadas."""
+    i = 0
+    t_ext = 0
+    anterior = 0
+    cierto = visto = False
+    descartes = [0]
+
+    def tramas():
+        nonlocal i, t_ext, anterior, cierto, visto
+        while i < len(datos):
+            if datos[i] not in (SINCRO, SINCRO_ABS):
+                cierto = False      # Se pierden bytes: quiza una trama
+                i += 1
+                continue
+            try:
+                absoluto, t, id_, args, fin = trama(datos, i, tabla)
+            except IndexError:
+                break
+            except TramaInvalida:
+                descartes[0] += 1
+                cierto = False
+                i += 1
+                continue
+            i = fin
+            # tiempo_us() desborda cada ~71 minutos: se suman las diferencias
+            if absoluto:
+                t_ext = t_ext + ((t - anterior) & 0xFFFFFFFF) if visto else t
+                anterior = t
+                cierto = visto = True
+            else:
+                t_ext += t
+                anterior = (anterior + t) & 0xFFFFFFFF
+            formato, archivo, linea, _ = tabla[id_]
+            try:
+                texto = formatear(formato, args)
+            except (ValueError, TypeError, IndexError):
+                texto = '%s %r' % (formato, args)
+            yield t_ext if cierto else None, '%s:%d' % (archivo, linea), texto, anterior
+    return tramas(), descartes
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('captura', nargs='?', help="bytes recibidos ('-' = entrada estandar)")
+    ap.add_argument('--elf', default=os.path.join(AQUI, '..', 'Debug', 'TP_Final.axf'))
+    ap.add_argument('--tabla', action='store_true', help='listar las llamadas registradas y salir')
+    args = ap.parse_args()
+
+    tabla = leer_tabla(args.elf)
+    errores = verificar(tabla)
+    if args.tabla or not args.captura:
+        for i, (formato, archivo, linea, codigos) in enumerate(tabla):
+            print('%4d %s:%d "%s" %s' % (i, archivo, linea, formato, ''.join(TIPOS[c] for c in codigos)))
+        sys.exit(1 if errores else 0)
+
+    if args.captura == '-':
+        datos = sys.stdin.buffer.read()
+    else:
+        with open(args.captura, 'rb') as f:
+            datos = f.read()
+
+    mensajes, descartes = decodificar(datos, tabla)
+    n = texto = 0
+    for t, sitio, mensaje, t_us in mensajes:
+        print('%12s %s %s' % ('?' if t is None else '%.6f' % (t / 1e6), sitio, mensaje))
+        n += 1
+        texto += len('%d %s\n' % (t_us, mensaje))    # Lo mismo enviado como texto
+    print('# %d mensajes, %d bytes (%d como texto, %.1fx), %d tramas descartadas'
+          % (n, len(datos), texto, texto / max(1, len(datos)), descartes[0]), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Simulacion de la edad del dato de CO desde la captura hasta el tablero.
+
+Recorre la cadena completa con los mismos calculos que el firmware:
+
+    TIM0 -> ADC_IRQHandler (t_captura) -> PendSV (armado de U<ppm>@<t>+<d>)
+    -> UART2 a 9600 -> handleSerial() del ESP -> /data (X-Reloj-us - lat.captura_us)
+    -> red -> render del navegador
+
+El LPC1769 y el ESP8266 tienen relojes con desfase y deriva propios; el
+ESP estima el desfase con los pings T/R (src/enlace_esp.h, ESP01.ino) y se
+queda con el de menor demora de los ultimos 8. Informa p50/p99 de la edad
+real y de la que calcula el tablero, y el error del desfase estimado, para
+ver cuanto aporta cada tramo al cambiar sus demoras.
+
+Uso: latencia_e2e.py [--segundos N] [--pendsv US] [--lazo-esp MS] ...
+"""
+
+import argparse
+import random
+
+CHAR_US = 1042.0        # 10 bits a 9600 baudios (CHAR_US en ESP01.ino)
+PING_S = 5.0            # PING_INTERVAL_MS
+PING_MUESTRAS = 8
+CUADRO_MS = 1000.0 / 60
+
+
+class Reloj:
+    """Reloj de 32 bits en us con desfase y deriva (ppm) respecto del real."""
+
+    def __init__(self, desfase_us, deriva_ppm):
+        self.desfase = desfase_us
+        self.deriva = deriva_ppm * 1e-6
+
+    def leer(self, t_us):
+        return int(self.desfase + t_us * (1 + self.deriva)) & 0xFFFFFFFF
+
+
+def s32(v):
+    v &= 0xFFFFFFFF
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def percentil(valores, p):
+    ordenados = sorted(valores)
+    return ordenados[min(len(ordenados) - 1, int(p * len(ordenados)))]
+
+
+class Simulacion:
+    def __init__(self, args, rnd):
+        self.a = args
+        self.rnd = rnd
+        self.mcu = Reloj(rnd.randrange(1 << 32), args.deriva_mcu)
+        self.esp = Reloj(rnd.randrange(1 << 32), args.deriva_esp)
+        self.pings = []
+        self.desfase = None     # Estimado: reloj LPC1769 - micros()
+        self.rtt = 0
+        self.errores_desfase = []
+
+    def sondeo_esp(self, t):
+        """Proximo paso del loop() del ESP en que se atiende algo llegado en t."""
+        return t + self.rnd.uniform(0, self.a.lazo_esp * 1000) + \
+            (self.a.ocupado_esp * 1000 if self.rnd.random() < self.a.prob_ocupado else 0)
+
+    def ping(self, t):
+        """Intercambio T/R iniciado en el instante real t; la R la lee handleSerial()."""
+        t0 = self.esp.leer(t)
+        largo = len('T%d\n' % t0)
+        llegada_mcu = t + CHAR_US + self.rnd.uniform(0, 5)                  # RBR con 1 caracter
+        m1 = self.mcu.leer(llegada_mcu)
+        fin_mcu = llegada_mcu + (largo - 1) * CHAR_US + self.a.pendsv * self.rnd.random() * 0.01
+        m2 = self.mcu.leer(fin_mcu)
+        t3 = self.esp.leer(fin_mcu + CHAR_US + self.rnd.uniform(0, self.a.sondeo_ping))
+        demora = s32((t3 - t0) - (m2 - m1))
+        desfase = ((m1 - t0) + s32((m2 - m1) - (t3 - t0)) // 2) & 0xFFFFFFFF
+        self.pings = (self.pings + [(demora, desfase)])[-PING_MUESTRAS:]
+        self.rtt, self.desfase = min(self.pings)
+        real = (self.mcu.leer(fin_mcu) - self.esp.leer(fin_mcu)) & 0xFFFFFFFF
+        self.errores_desfase.append(abs(s32(self.desfase - real)))
+
+    def muestra(self, t_captura):
+        """Devuelve lo que el ESP guarda de la muestra: (llegada real, datos)."""
+        mcu_captura = self.mcu.leer(t_captura)
+        t_armado = t_captura + self.rnd.uniform(0, self.a.pendsv)
+        d = s32(self.mcu.leer(t_armado) - mcu_captura)
+        largo = len('U%d@%d+%d\n' % (self.rnd.randrange(400), mcu_captura, d))
+        fin_linea = t_armado + largo * CHAR_US
+        # handleSerial() arma la linea con lo que haya en cada vuelta del loop;
+        # el '\n' se toma como llegado en la vuelta en que se lee
+        llegada_est = self.esp.leer(self.sondeo_esp(fin_linea))
+        return fin_linea, (mcu_captura, d, llegada_est, largo)
+
+    def edad_json(self, t_respuesta, dato):
+        """Edad que calcula el tablero: X-Reloj-us - lat.captura_us (renderCoDataJson)."""
+        mcu_captura, d, llegada, largo = dato
+        ahora = self.esp.leer(t_respuesta)
+        if self.desfase is None:
+            return d + largo * CHAR_US + s32(ahora - llegada)
+        return s32(ahora - ((mcu_captura - self.desfase) & 0xFFFFFFFF))
+
+    def correr(self):
+        a = self.a
+        eventos = []    # (t real, tipo)
+        for k in range(int(a.segundos)):
+            eventos.append((k * 1e6 + 1000.0, 'muestra'))
+        t = self.rnd.uniform(0, PING_S * 1e6)
+        while t < a.segundos * 1e6:
+            eventos.append((t, 'ping'))
+            t += PING_S * 1e6
+        t = self.rnd.uniform(0, a.sondeo * 1000)
+        while t < a.segundos * 1e6:
+            eventos.append((t, 'sondeo'))
+            t += a.sondeo * 1000
+        eventos.sort()
+
+        pendientes = []     # Muestras en camino: (llegada real, captura real, datos)
+        ultima = None
+        reales, estimadas = [], []
+        for t, tipo in eventos:
+            while pendientes and pendientes[0][0] <= t:
+                _, captura, dato = pendientes.pop(0)
+                ultima = (captura, dato)
+            if tipo == 'muestra':
+                llegada, dato = self.muestra(t)
+                pendientes.append((llegada, t, dato))
+            elif tipo == 'ping':
+                self.ping(t)
+            elif ultima is not None:
+                ida = max(0.0, self.rnd.gauss(a.red, a.jitter)) * 1000
+                vuelta = max(0.0, self.rnd.gauss(a.red, a.jitter)) * 1000
+                t_servida = self.sondeo_esp(t + ida)
+                t_respuesta = t_servida + vuelta
+                t_render = t_respuesta + self.rnd.uniform(0, CUADRO_MS) * 1000
+                edad_us = self.edad_json(t_servida, ultima[1])
+                estimada = edad_us / 1000 + (t_respuesta - t) / 2000 + (t_render - t_respuesta) / 1000
+                reales.append((t_render - ultima[0]) / 1000)
+                estimadas.append(estimada)
+        return reales, estimadas
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--segundos', type=float, default=3600, help='duracion simulada')
+    ap.add_argument('--pendsv', type=float, default=3000, help='demora maxima captura -> armado (us)')
+    ap.add_argument('--lazo-esp', type=float, default=2, help='periodo del loop() del ESP (ms)')
+    ap.add_argument('--ocupado-esp', type=float, default=5, help='bloqueo ocasional del loop, p. ej. WiFi (ms)')
+    ap.add_argument('--prob-ocupado', type=float, default=0.1, help='probabilidad del bloqueo')
+    ap.add_argument('--sondeo-ping', type=float, default=500, help='vuelta del loop al llegar la respuesta del ping (us)')
+    ap.add_argument('--sondeo', type=float, default=500, help='periodo de consulta del tablero (ms)')
+    ap.add_argument('--red', type=float, default=8, help='demora de red en un sentido (ms)')
+    ap.add_argument('--jitter', type=float, default=3, help='desvio de la demora de red (ms)')
+    ap.add_argument('--deriva-mcu', type=float, default=30, help='deriva del reloj del LPC1769 (ppm)')
+    ap.add_argument('--deriva-esp', type=float, default=-60, help='deriva del reloj del ESP8266 (ppm)')
+    ap.add_argument('--semilla', type=int, default=1)
+    args = ap.parse_args()
+
+    sim = Simulacion(args, random.Random(args.semilla))
+    reales, estimadas = sim.correr()
+    errores = [e - r for r, e in zip(reales, estimadas)]
+    print('%d consultas, %d pings' % (len(reales), len(sim.errores_desfase)))
+    print('%-22s %9s %9s' % ('', 'p50 (ms)', 'p99 (ms)'))
+    print('%-22s %9.1f %9.1f' % ('edad real', percentil(reales, 0.5), percentil(reales, 0.99)))
+    print('%-22s %9.1f %9.1f' % ('edad en el tablero', percentil(estimadas, 0.5), percentil(estimadas, 0.99)))
+    print('%-22s %9.2f %9.2f' % ('error', percentil(errores, 0.5), percentil([abs(e) for e in errores], 0.99)))
+    print('error del desfase: p50 %.0f us, p99 %.0f us' % (percentil(sim.errores_desfase, 0.5),
+                                                           percentil(sim.errores_desfase, 0.99)))
+
+
+if __name__ == '__main__':
+    main()
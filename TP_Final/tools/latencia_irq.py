@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Peor latencia de respuesta de cada interrupcion del monitor de CO.
+
+Lee las prioridades asignadas en src/prioridades.c (y sus valores en
+src/prioridades.h) y aplica el analisis de tiempo de respuesta con
+expropiacion fija:
+
+    R = B + C + sum_{j de mayor prioridad} ceil(R / T_j) * C_j
+
+B es la mayor seccion critica con PRIMASK (bloquea a todas) o, si es mayor,
+la entrada/salida de excepcion, mas una ejecucion de cada interrupcion del
+mismo nivel (no se expropian entre si). Los tiempos de ejecucion (C) son estimaciones
+en microsegundos a 100 MHz; ajustarlos con mediciones (DWT o el trazador).
+
+Uso: latencia_irq.py [--src DIR] [--bloqueo US]
+"""
+
+import argparse
+import math
+import os
+import re
+import sys
+
+# irq: (C peor caso en us, separacion minima entre disparos en us)
+CARGA = {
+    'TIMER1_IRQn': (1.0, 500.0),        # Tono del buzzer
+    'SysTick_IRQn': (1.5, 991.0),       # Perfilador a 1009 Hz (solo con APP_USE_PERFIL)
+    'TIMER3_IRQn': (2.0, 2000.0),       # Fin de trama Modbus
+    'ADC_IRQn': (60.0, 1000000.0),      # Decision de alarma + conversion a ppm
+    'DMA_IRQn': (3.0, 40960.0),         # Un bloque de 512 B a 12.5 MHz
+    'UART1_IRQn': (8.0, 520.0),         # Un caracter a 19200 baudios
+    'UART2_IRQn': (6.0, 1042.0),        # Un caracter recibido (pings) o FIFO de TX a 9600
+    'CAN_IRQn': (10.0, 1080.0),         # Una trama de 8 bytes a 125 kbit/s
+    'TIMER2_IRQn': (600.0, 3000000.0),  # Promedio (10 conversiones) y registro
+    'RIT_IRQn': (2.0, 100000.0),        # Autotest de LEDs (solo al arrancar)
+    'PendSV_IRQn': (2500.0, 1000000.0), # Reparto a logs y telemetria
+}
+
+ENTRADA_SALIDA_US = 0.24    # 12 + 12 ciclos de apilado/desapilado
+
+
+def leer_prioridades(src):
+    with open(os.path.join(src, 'prioridades.h')) as f:
+        valores = dict(re.findall(r'#define\s+(PRIO_\w+)\s+(\d+)', f.read()))
+    with open(os.path.join(src, 'prioridades.c')) as f:
+        pares = re.findall(r'NVIC_SetPriority\((\w+),\s*NVIC_EncodePriority\(PRIO_GRUPO,\s*(PRIO_\w+)', f.read())
+    return {irq: int(valores[nivel]) for irq, nivel in pares}
+
+
+def respuesta(irq, prio, bloqueo):
+    c, t = CARGA[irq]
+    superiores = [(CARGA[j][0], CARGA[j][1]) for j, p in prio.items() if p < prio[irq] and j in CARGA]
+    iguales = sum(CARGA[j][0] for j, p in prio.items() if p == prio[irq] and j != irq and j in CARGA)
+    b = max(bloqueo, ENTRADA_SALIDA_US) + iguales
+    r = b + c
+    while True:
+        nuevo = b + c + sum(math.ceil(r / tj) * cj for cj, tj in superiores)
+        if nuevo > t:
+            return None
+        if nuevo == r:
+            return r
+        r = nuevo
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--src', default=os.path.join(os.path.dirname(__file__), '..', 'src'))
+    ap.add_argument('--bloqueo', type=float, default=20.0,
+                    help='mayor seccion critica con interrupciones deshabilitadas, en us')
+    args = ap.parse_args()
+
+    prio = leer_prioridades(args.src)
+    faltan = [irq for irq in prio if irq not in CARGA]
+    if faltan:
+        print('sin estimacion de carga: ' + ', '.join(faltan), file=sys.stderr)
+
+    print('%-13s %4s %9s %11s %11s' % ('irq', 'prio', 'C (us)', 'T (us)', 'R (us)'))
+    ok = True
+    for irq in sorted(prio, key=lambda i: prio[i]):
+        if irq not in CARGA:
+            continue
+        r = respuesta(irq, prio, args.bloqueo)
+        c, t = CARGA[irq]
+        ok &= r is not None
+        print('%-13s %4d %9.1f %11.0f %11s' % (irq, prio[irq], c, t, '%.1f' % r if r else 'NO CUMPLE'))
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Uso de memoria y ubicacion de los caminos rapidos segun el mapa del enlazador.
+
+Lee un .map de GNU ld (Debug/TP_Final.map) e informa:
+
+  - lo ocupado en cada region (MFlash512, RamLoc32, RamAHB32); la flash
+    cuenta tambien la imagen de .data que ResetISR copia a la RAM
+  - las funciones en RAM (secciones .ramfunc, ver EN_RAM en src/secciones.h)
+    y los buffers en el banco AHB (BUFFER_AHB)
+  - donde quedo cada manejador de interrupcion y, si esta en la flash, cuantas
+    lineas de 128 bits ocupa: con FLASHTIM = 4 (100 MHz) cada linea que el
+    acelerador no tiene en el buffer cuesta hasta 4 ciclos de espera. Es una
+    cota para una pasada lineal (mas 4 por salto tomado a una linea nueva);
+    el costo real se mide en el micro con la traza (src/traza.h)
+
+Con --base compara contra otro mapa, por ejemplo las dos ubicaciones:
+
+    (APP_USE_RAMFUNC 0) cp Debug/TP_Final.map flash.map
+    (APP_USE_RAMFUNC 1) mapa.py Debug/TP_Final.map --base flash.map
+
+Uso: mapa.py [MAP] [--base MAP]
+"""
+
+import argparse
+import collections
+import os
+import re
+import sys
+
+AQUI = os.path.dirname(os.path.abspath(__file__))
+LINEA_FLASH = 16        # Bytes por linea del acelerador de la flash
+ESPERA_LINEA = 4        # Ciclos de espera por linea con FLASHTIM = 4
+
+Entrada = collections.namedtuple('Entrada', 'nombre salida dir tam archivo')
+
+
+class Mapa:
+    def __init__(self, ruta):
+        self.regiones = collections.OrderedDict()   # nombre: (origen, largo)
+        self.salidas = []                           # (nombre, vma, tam, lma)
+        self.entradas = []
+        self.simbolos = {}
+        self._leer(ruta)
+
+    def _leer(self, ruta):
+        with open(ruta, errors='replace') as f:
+            lineas = f.read().splitlines()
+        i = lineas.index('Memory Configuration') + 3
+        while lineas[i].strip():
+            m = re.match(r'^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)', lineas[i])
+            if m and m.group(1) != '*default*':
+                self.regiones[m.group(1)] = (int(m.group(2), 16), int(m.group(3), 16))
+            i += 1
+
+        salida = None
+        pendiente = None    # Nombre largo: la direccion sigue en la linea siguiente
+        en_mapa = False
+        for linea in lineas:
+            if not en_mapa:
+                en_mapa = linea.startswith('Linker script and memory map')
+                continue
+            if linea.startswith('OUTPUT(') or linea.startswith('Cross Reference Table'):
+                break
+            if pendiente:
+                linea = pendiente + linea
+                pendiente = None
+            m = re.match(r'^(\.?[A-Za-z_][\w.$]*)\s*$', linea)
+            if m:
+                pendiente = linea.rstrip() + ' '
+                continue
+            m = re.match(r'^( ?)(\.\S+|COMMON)\s*$', linea)
+            if m:
+                pendiente = linea.rstrip() + ' '
+                continue
+            # Seccion de salida: en la columna 0
+            m = re.match(r'^(\.?[A-Za-z_][\w.$]*)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+load address 0x([0-9a-f]+))?',
+                         linea)
+            if m:
+                vma, tam = int(m.group(2), 16), int(m.group(3), 16)
+                lma = int(m.group(4), 16) if m.group(4) else vma
+                salida = m.group(1)
+                self.salidas.append((salida, vma, tam, lma))
+                continue
+            # Seccion de entrada: un espacio, nombre, direccion, tamanio y archivo
+            m = re.match(r'^ (\.\S+|COMMON)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.*)$', linea)
+            if m and salida:
+                self.entradas.append(Entrada(m.group(1), salida, int(m.group(2), 16), int(m.group(3), 16),
+                                             os.path.basename(m.group(4).replace('\\', '/'))))
+                continue
+            m = re.match(r'^\s{16}0x([0-9a-f]+)\s+([A-Za-z_]\w*)\s*$', linea)
+            if m:
+                self.simbolos[m.group(2)] = int(m.group(1), 16)
+
+    def region(self, direccion):
+        for nombre, (origen, largo) in self.regiones.items():
+            if origen <= direccion < origen + largo:
+                return nombre
+        return None
+
+    def ocupado(self):
+        usado = collections.OrderedDict((r, 0) for r in self.regiones)
+        for nombre, vma, tam, lma in self.salidas:
+            r = self.region(vma)
+            if not tam or r is None:
+                continue
+            usado[r] += tam
+            rl = self.region(lma)
+            if rl != r and rl is not None:
+                usado[rl] += tam        # Imagen inicial que se copia al arrancar
+        return usado
+
+    def entrada_de(self, direccion):
+        for e in self.entradas:
+            if e.dir <= direccion < e.dir + e.tam:
+                return e
+        return None
+
+    def manejadores(self):
+        """Manejadores del programa (no los de cr_startup): nombre, region, tamanio."""
+        defecto = self.simbolos.get('IntDefaultHandler')
+        res = collections.OrderedDict()
+        for nombre, direccion in sorted(self.simbolos.items(), key=lambda s: s[1]):
+            if not nombre.endswith('_Handler') and not nombre.endswith('_IRQHandler'):
+                continue
+            if direccion == defecto:
+                continue
+            e = self.entrada_de(direccion)
+            if e is None or e.nombre == '.after_vectors':
+                continue
+            res[nombre] = (self.region(direccion), e.tam)
+        return res
+
+
+def lineas_flash(tam):
+    return (tam + LINEA_FLASH - 1) // LINEA_FLASH
+
+
+def informar(mapa, base):
+    usado = mapa.ocupado()
+    usado_base = base.ocupado() if base else None
+    print('%-10s %8s %8s' % ('region', 'tamanio', 'ocupado') + ('  %8s %8s' % ('base', 'delta') if base else ''))
+    for r, (_, largo) in mapa.regiones.items():
+        fila = '%-10s %8d %8d' % (r, largo, usado[r])
+        if base:
+            b = usado_base.get(r, 0)
+            fila += '  %8d %+8d' % (b, usado[r] - b)
+        print(fila)
+
+    for titulo, cond in (('funciones en RAM (.ramfunc)', lambda e: e.nombre.startswith('.ramfunc')),
+                         ('buffers en RamAHB32', lambda e: mapa.region(e.dir) == 'RamAHB32' and e.tam)):
+        elegidas = [e for e in mapa.entradas if cond(e)]
+        print('\n%s: %d bytes' % (titulo, sum(e.tam for e in elegidas)))
+        for e in elegidas:
+            nombres = sorted(n for n, d in mapa.simbolos.items() if e.dir <= d < e.dir + e.tam)
+            print('  %-22s %6d  %-20s %s' % (e.nombre, e.tam, e.archivo, ', '.join(nombres)))
+
+    print('\n%-22s %-10s %6s %7s %9s' % ('manejador', 'region', 'bytes', 'lineas', 'espera<='))
+    previos = base.manejadores() if base else {}
+    for nombre, (region, tam) in mapa.manejadores().items():
+        fila = '%-22s %-10s %6d' % (nombre, region, tam)
+        if region == 'MFlash512':
+            fila += ' %7d %9d' % (lineas_flash(tam), lineas_flash(tam) * ESPERA_LINEA)
+        else:
+            fila += ' %7s %9d' % ('-', 0)
+        if nombre in previos:
+            fila += '   (base: %s, %s bytes)' % (previos[nombre][0], previos[nombre][1])
+        print(fila)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('map', nargs='?', default=os.path.join(AQUI, '..', 'Debug', 'TP_Final.map'))
+    ap.add_argument('--base', help='mapa con el que comparar (por ejemplo, con APP_USE_RAMFUNC 0)')
+    args = ap.parse_args()
+
+    informar(Mapa(args.map), Mapa(args.base) if args.base else None)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
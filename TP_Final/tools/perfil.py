@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Traduce un volcado del perfilador (src/perfil.c) a un perfil por funcion.
+
+El volcado se obtiene por la UART3 de diagnostico enviando 'v', por ejemplo:
+
+    stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 > perfil.txt
+
+Cada linea es '<pc hex> <excepcion> <muestras>'. Las direcciones se
+resuelven con los simbolos del .map del enlazador (por defecto
+Debug/TP_Final.map) o, con --elf, del .axf via nm. Las excepciones se
+nombran con el enum IRQn de LPC17xx.h.
+
+Salidas:
+  - perfil plano: muestras y porcentaje por funcion, y por contexto;
+  - --folded ARCHIVO: lineas 'contexto;funcion muestras' para flamegraph.pl
+    o speedscope.
+
+Uso: perfil.py VOLCADO [--map MAP | --elf AXF] [--folded ARCHIVO]
+"""
+
+import argparse
+import bisect
+import collections
+import os
+import re
+import subprocess
+import sys
+
+AQUI = os.path.dirname(os.path.abspath(__file__))
+EXCEPCIONES = {0: 'main', 2: 'NMI', 3: 'HardFault', 11: 'SVCall', 14: 'PendSV', 15: 'SysTick'}
+
+
+def leer_volcado(ruta):
+    f = sys.stdin if ruta == '-' else open(ruta)
+    muestras = []
+    encabezado = {}
+    for linea in f:
+        linea = linea.strip()
+        if linea.startswith('#perfil'):
+            encabezado = dict(c.split('=') for c in linea.split()[1:])
+            muestras = []   # Se queda con el ultimo volcado del archivo
+            continue
+        m = re.match(r'^([0-9a-f]{8}) (\d+) (\d+)$', linea)
+        if m:   # Lo demas es ruido del puerto serie
+            muestras.append((int(m.group(1), 16), int(m.group(2)), int(m.group(3))))
+    return encabezado, muestras
+
+
+def funcion_de_seccion(seccion):
+    """Funcion de una seccion .text.<funcion> (-ffunction-sections), o None."""
+    m = re.match(r'^\.text\.(?:startup\.|unlikely\.|hot\.)?([A-Za-z_][\w.]*)$', seccion)
+    return m.group(1) if m else None
+
+
+def simbolos_map(ruta):
+    """Funciones del mapa del enlazador: (direccion, nombre) y rangos de codigo.
+
+    El mapa solo lista los simbolos globales: las funciones static se nombran
+    por su seccion .text.<funcion>, si no, caerian en la global anterior.
+    """
+    simbolos = []
+    rangos = []
+    por_seccion = []
+    en_mapa = False
+    seccion = None
+
+    def agregar_rango(dir_, tam):
+        rangos.append((dir_, tam))
+        funcion = funcion_de_seccion(seccion)
+        if funcion and tam:
+            por_seccion.append((dir_, funcion))
+
+    with open(ruta, errors='replace') as f:
+        for linea in f:
+            if not en_mapa:
+                en_mapa = linea.startswith('Linker script and memory map')
+                continue
+            m = re.match(r'^ (\.(?:text|ramfunc|after_vectors)\S*)\s*(?:0x([0-9a-f]+)\s+0x([0-9a-f]+))?', linea)
+            if m:
+                seccion = m.group(1)
+                if m.group(2):
+                    agregar_rango(int(m.group(2), 16), int(m.group(3), 16))
+                    seccion = None
+                continue
+            m = re.match(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s', linea)
+            if m and seccion:
+                agregar_rango(int(m.group(1), 16), int(m.group(2), 16))
+                seccion = None
+                continue
+            m = re.match(r'^\s{16}0x([0-9a-f]+)\s+([A-Za-z_]\w*)\s*$', linea)
+            if m:
+                simbolos.append((int(m.group(1), 16), m.group(2)))
+    globales = {d for d, _ in simbolos}
+    simbolos += [(d, n) for d, n in por_seccion if d not in globales]
+    return simbolos, [(a, a + t) for a, t in rangos if t]
+
+
+def simbolos_elf(ruta, nm):
+    salida = subprocess.run([nm, '-S', '--defined-only', ruta], check=True,
+                            capture_output=True, text=True).stdout
+    simbolos = []
+    rangos = []
+    for linea in salida.splitlines():
+        partes = linea.split()
+        if len(partes) == 4 and partes[2] in 'tTwW':
+            dir_, tam = int(partes[0], 16) & ~1, int(partes[1], 16)
+            simbolos.append((dir_, partes[3]))
+            rangos.append((dir_, dir_ + tam))
+    return simbolos, rangos
+
+
+class Resolvedor:
+    def __init__(self, simbolos, rangos):
+        simbolos = sorted(set(simbolos))
+        self.dirs = [d for d, _ in simbolos]
+        self.nombres = [n for _, n in simbolos]
+        self.rangos = sorted(rangos)
+
+    def en_codigo(self, pc):
+        i = bisect.bisect_right(self.rangos, (pc, float('inf'))) - 1
+        return i >= 0 and self.rangos[i][0] <= pc < self.rangos[i][1]
+
+    def nombre(self, pc):
+        i = bisect.bisect_right(self.dirs, pc) - 1
+        if i < 0 or not self.en_codigo(pc):
+            return '0x%08x' % pc
+        return self.nombres[i]
+
+
+def nombres_irq(cmsis):
+    nombres = dict(EXCEPCIONES)
+    try:
+        with open(os.path.join(cmsis, 'LPC17xx.h')) as f:
+            for nombre, num in re.findall(r'^\s*(\w+)_IRQn\s*=\s*(\d+)', f.read(), re.M):
+                nombres[16 + int(num)] = nombre
+    except OSError:
+        pass
+    return nombres
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('volcado', help="archivo con el volcado ('-' = entrada estandar)")
+    ap.add_argument('--map', default=os.path.join(AQUI, '..', 'Debug', 'TP_Final.map'))
+    ap.add_argument('--elf', help='usar los simbolos del .axf (con nm) en lugar del .map')
+    ap.add_argument('--nm', default='arm-none-eabi-nm')
+    ap.add_argument('--cmsis', default=os.path.join(AQUI, '..', '..', 'CMSISv2p00_LPC17xx', 'inc'))
+    ap.add_argument('--folded', help='escribir pilas plegadas para flamegraph.pl')
+    ap.add_argument('--top', type=int, default=30, help='funciones a listar')
+    args = ap.parse_args()
+
+    encabezado, muestras = leer_volcado(args.volcado)
+    if not muestras:
+        sys.exit('el volcado no tiene muestras')
+    simbolos, rangos = simbolos_elf(args.elf, args.nm) if args.elf else simbolos_map(args.map)
+    res = Resolvedor(simbolos, rangos)
+    irq = nombres_irq(args.cmsis)
+
+    por_funcion = collections.Counter()
+    por_contexto = collections.Counter()
+    plegadas = collections.Counter()
+    for pc, exc, n in muestras:
+        funcion = res.nombre(pc)
+        contexto = irq.get(exc, 'exc%d' % exc)
+        por_funcion[funcion] += n
+        por_contexto[contexto] += n
+        plegadas[contexto + ';' + funcion] += n
+    total = sum(por_funcion.values())
+
+    hz = float(encabezado.get('hz', 0)) or None
+    print('muestras: %d (perdidas: %s)%s' % (total, encabezado.get('perdidas', '?'),
+          ', %.1f s' % (total / hz) if hz else ''))
+    print('\n%-32s %9s %7s' % ('funcion', 'muestras', '%'))
+    for funcion, n in por_funcion.most_common(args.top):
+        print('%-32s %9d %6.2f%%' % (funcion, n, 100.0 * n / total))
+    print('\n%-32s %9s %7s' % ('contexto', 'muestras', '%'))
+    for contexto, n in por_contexto.most_common():
+        print('%-32s %9d %6.2f%%' % (contexto, n, 100.0 * n / total))
+
+    if args.folded:
+        with open(args.folded, 'w') as f:
+            for pila, n in sorted(plegadas.items()):
+                f.write('%s %d\n' % (pila, n))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Convierte un volcado de la variable 'traza' (src/traza.h) a una traza de
+Chrome/Perfetto (JSON), para abrir en ui.perfetto.dev o chrome://tracing.
+
+El volcado es la estructura completa tal como esta en RAM, por ejemplo:
+
+    (gdb) dump binary value traza.bin traza
+
+Cada interrupcion aparece como un bloque anidado en el hilo 'CPU' (la
+expropiacion se ve como un bloque dentro de otro); los registros encolados,
+los bytes pasados a las UART y los fines de DMA son eventos instantaneos, y
+el estado de alarma es un contador.
+
+Uso: traza.py traza.bin [-o traza.json]
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from perfil import nombres_irq  # noqa: E402
+
+MAGIA = 0x5A415254
+ENCABEZADO = struct.Struct('<6I')   # magia, hz, escritos, capacidad, ciclos_evento, activo
+EVENTO = struct.Struct('<IBBH')     # t, tipo, id, dato
+
+IRQ_ENTRA, IRQ_SALE, COLA, UART, DMA, ALARMA = range(1, 7)
+REGISTROS = {1: 'muestra', 2: 'promedio', 3: 'alarma', 4: 'inicio'}
+ESTADOS = {0: 'seguro', 1: 'precaucion', 2: 'critico'}
+
+
+def leer(ruta):
+    with open(ruta, 'rb') as f:
+        datos = f.read()
+    magia, hz, escritos, capacidad, ciclos_evento, _ = ENCABEZADO.unpack_from(datos)
+    if magia != MAGIA:
+        sys.exit('%s: no es un volcado de la traza (magia 0x%08x)' % (ruta, magia))
+    eventos = [EVENTO.unpack_from(datos, ENCABEZADO.size + i * EVENTO.size) for i in range(capacidad)]
+    # El buffer es circular: los validos son los ultimos 'escritos', en orden
+    n = min(escritos, capacidad)
+    inicio = escritos - n
+    ordenados = [eventos[(inicio + i) % capacidad] for i in range(n)]
+    return hz, ciclos_evento, escritos - n, ordenados
+
+
+def convertir(hz, eventos, irq):
+    salida = [{'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': 1, 'args': {'name': 'CPU'}}]
+    abiertos = []
+    base = eventos[0][0] if eventos else 0
+    t_ext = 0
+    anterior = base
+    for t, tipo, id_, dato in eventos:
+        t_ext += (t - anterior) & 0xFFFFFFFF    # El contador desborda cada ~36 s
+        anterior = t
+        us = t_ext * 1e6 / hz
+        comun = {'pid': 1, 'tid': 1, 'ts': us}
+        if tipo == IRQ_ENTRA:
+            abiertos.append(id_)
+            salida.append(dict(comun, ph='B', name=irq.get(id_, 'exc%d' % id_)))
+        elif tipo == IRQ_SALE:
+            # Una salida sin su entrada (anterior al buffer) no se puede dibujar
+            if id_ in abiertos:
+                while abiertos.pop() != id_:
+                    pass
+                salida.append(dict(comun, ph='E', name=irq.get(id_, 'exc%d' % id_)))
+        elif tipo == COLA:
+            salida.append(dict(comun, ph='i', s='t', name='cola ' + REGISTROS.get(id_, str(id_)),
+                               args={'valor': dato}))
+        elif tipo == UART:
+            salida.append(dict(comun, ph='i', s='t', name='UART%d' % id_, args={'bytes': dato}))
+        elif tipo == DMA:
+            salida.append(dict(comun, ph='i', s='t', name='DMA%d %s' % (id_, 'error' if dato else 'fin')))
+        elif tipo == ALARMA:
+            salida.append(dict(comun, ph='C', name='alarma', args={'estado': dato}))
+            salida.append(dict(comun, ph='i', s='g', name='alarma ' + ESTADOS.get(dato, str(dato))))
+    return salida
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('volcado')
+    ap.add_argument('-o', '--salida', help='archivo JSON (por defecto, el volcado con .json)')
+    ap.add_argument('--cmsis', default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                    '..', '..', 'CMSISv2p00_LPC17xx', 'inc'))
+    args = ap.parse_args()
+
+    hz, ciclos_evento, perdidos, eventos = leer(args.volcado)
+    salida = args.salida or os.path.splitext(args.volcado)[0] + '.json'
+    with open(salida, 'w') as f:
+        json.dump({'traceEvents': convertir(hz, eventos, nombres_irq(args.cmsis)),
+                   'displayTimeUnit': 'ns'}, f)
+    print('%d eventos (%d sobrescritos), %.1f MHz, %d ciclos por evento -> %s'
+          % (len(eventos), perdidos, hz / 1e6, ciclos_evento, salida))
+
+
+if __name__ == '__main__':
+    main()